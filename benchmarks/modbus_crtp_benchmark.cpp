@@ -0,0 +1,238 @@
+#include <xitren/modbus/commands/read_registers.hpp>
+#include <xitren/modbus/master.hpp>
+#include <xitren/modbus/slave.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#    include <x86intrin.h>
+#endif
+
+using namespace xitren::modbus;
+
+namespace {
+
+/**
+ * @brief The slave with the run time table of function pointers
+ */
+using table_slave_type = slave<16, 16, 16, 16, 1>;
+
+/**
+ * @brief The slave with the functions fixed at compile time, the handlers are called directly
+ */
+using compiled_slave_type = slave<16, 16, 16, 16, 1, rtu, function::read_holding_registers,
+                                  function::write_single_register, function::write_multiple_registers>;
+
+/**
+ * @brief Time stamps in CPU cycles where the counter is available, in nanoseconds otherwise
+ */
+inline std::uint64_t
+stamp() noexcept
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return static_cast<std::uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+}
+
+constexpr char const* unit =
+#if defined(__x86_64__) || defined(__i386__)
+    "cycles";
+#else
+    "ns";
+#endif
+
+/**
+ * @brief The hooks of a transport that keeps the last frame, shared by both variants
+ */
+struct wire {
+    std::vector<std::uint8_t> frame{std::vector<std::uint8_t>(modbus_base::max_adu_length)};
+    std::size_t               size{};
+
+    bool
+    put(std::uint8_t const* begin, std::uint8_t const* end) noexcept
+    {
+        size = static_cast<std::size_t>(std::copy(begin, end, frame.begin()) - frame.begin());
+        return true;
+    }
+};
+
+template <class Slave>
+class virtual_slave : public Slave {
+public:
+    using typename Slave::msg_type;
+
+    virtual_slave() : Slave(0x11) {}
+
+    bool
+    send(msg_type::array_type::iterator begin, msg_type::array_type::iterator end) noexcept override
+    {
+        return wire_.put(&*begin, &*begin + (end - begin));
+    }
+
+    void
+    changed_holding(std::size_t address, std::uint16_t value) noexcept override
+    {
+        this->input_registers()[address] = value;
+    }
+
+    wire wire_{};
+};
+
+class virtual_master : public master {
+public:
+    bool
+    send(msg_type::array_type::iterator begin, msg_type::array_type::iterator end) noexcept override
+    {
+        return wire_.put(&*begin, &*begin + (end - begin));
+    }
+
+    bool
+    timer_start(std::size_t) override
+    {
+        return true;
+    }
+
+    bool
+    timer_stop() override
+    {
+        return true;
+    }
+
+    wire wire_{};
+};
+
+template <class Slave>
+class direct_slave final : public static_slave<direct_slave<Slave>, Slave> {
+public:
+    using typename Slave::msg_type;
+
+    direct_slave() : static_slave<direct_slave<Slave>, Slave>(0x11) {}
+
+    bool
+    send(msg_type::array_type::iterator begin, msg_type::array_type::iterator end) noexcept override
+    {
+        return wire_.put(&*begin, &*begin + (end - begin));
+    }
+
+    void
+    changed_holding(std::size_t address, std::uint16_t value) noexcept override
+    {
+        this->input_registers()[address] = value;
+    }
+
+    wire wire_{};
+};
+
+class direct_master final : public static_master<direct_master> {
+public:
+    bool
+    send(msg_type::array_type::iterator begin, msg_type::array_type::iterator end) noexcept override
+    {
+        return wire_.put(&*begin, &*begin + (end - begin));
+    }
+
+    bool
+    timer_start(std::size_t) override
+    {
+        return true;
+    }
+
+    bool
+    timer_stop() override
+    {
+        return true;
+    }
+
+    wire wire_{};
+};
+
+/**
+ * @brief Runs `rounds` read holding registers transactions from the master to the slave and back
+ *
+ * @return The mean time of a transaction
+ */
+template <class Master, class Slave>
+double
+measure(std::size_t rounds)
+{
+    Master        master_object{};
+    Slave         device_object{};
+    std::uint16_t sum{};
+    // Hide the dynamic types, as for objects living in another translation unit: only a final class lets the
+    // compiler resolve the hooks
+    auto* master_pointer = &master_object;
+    auto* device_pointer = &device_object;
+    asm volatile("" : "+r"(master_pointer), "+r"(device_pointer));
+    Master& master = *master_pointer;
+    Slave&  device = *device_pointer;
+    for (std::size_t i{}; i < 16; i++) {
+        device.holding_registers()[i] = static_cast<std::uint16_t>(i);
+    }
+    commands::read_registers request(0x11, 0, 16, [&](exception, std::uint16_t* begin, std::uint16_t*) {
+        sum = static_cast<std::uint16_t>(sum + *begin);
+    });
+
+    auto const start = stamp();
+    for (std::size_t n{}; n < rounds; n++) {
+        master.run_async(request);
+        device.receive(master.wire_.frame.begin(), master.wire_.frame.begin() + master.wire_.size);
+        while (!device.idle()) {
+            device.processing();
+        }
+        master.receive(device.wire_.frame.begin(), device.wire_.frame.begin() + device.wire_.size);
+        master.processing();
+    }
+    auto const elapsed = stamp() - start;
+    asm volatile("" : : "r"(sum) : "memory");
+    return static_cast<double>(elapsed) / static_cast<double>(rounds);
+}
+
+/**
+ * @brief The mean times of one variant over the runs
+ */
+using runs_type = std::array<double, 9>;
+
+/**
+ * @brief Prints the median and the range of the runs
+ */
+void
+report(std::string const& name, runs_type runs)
+{
+    std::ranges::sort(runs);
+    std::cout << name << ": " << runs[runs.size() / 2] << " " << unit << " per transaction (" << runs.front()
+              << " - " << runs.back() << ")" << std::endl;
+}
+
+}    // namespace
+
+int
+main(int argc, char** argv)
+{
+    std::size_t const rounds = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+
+    // The variants take turns, so a change of the clock or of the load hits all of them alike
+    runs_type virtual_table{};
+    runs_type virtual_compiled{};
+    runs_type static_table{};
+    runs_type static_compiled{};
+    for (std::size_t run{}; run < runs_type{}.size(); run++) {
+        virtual_table[run]    = measure<virtual_master, virtual_slave<table_slave_type>>(rounds);
+        virtual_compiled[run] = measure<virtual_master, virtual_slave<compiled_slave_type>>(rounds);
+        static_table[run]     = measure<direct_master, direct_slave<table_slave_type>>(rounds);
+        static_compiled[run]  = measure<direct_master, direct_slave<compiled_slave_type>>(rounds);
+    }
+    report("virtual, function table", virtual_table);
+    report("virtual, compiled functions", virtual_compiled);
+    report("static, function table", static_table);
+    report("static, compiled functions", static_compiled);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,82 @@
+#include <xitren/modbus/modbus.hpp>
+#include <xitren/modbus/registers_engine.hpp>
+
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+using namespace xitren;
+using namespace xitren::modbus;
+
+namespace {
+
+constexpr std::size_t block = modbus_base::max_read_registers;
+
+using wire_type = std::array<func::msb_t<std::uint16_t>, block>;
+
+/**
+ * @brief Converts the block register by register, the path the handlers used before the engines
+ */
+void
+per_element(void const* src, std::size_t count, void* dst) noexcept
+{
+    auto const* in  = static_cast<std::uint16_t const*>(src);
+    auto*       out = static_cast<func::msb_t<std::uint16_t>*>(dst);
+    for (std::size_t i{}; i < count; i++) {
+        out[i] = in[i];
+    }
+}
+
+/**
+ * @brief Converts `rounds` blocks of 125 registers, returns nanoseconds per block
+ */
+double
+measure(registers_engine::engine_type engine, std::size_t rounds)
+{
+    std::array<std::uint16_t, block> values{};
+    wire_type                        wire{};
+    for (std::size_t i{}; i < block; i++) {
+        values[i] = static_cast<std::uint16_t>(i * 0x0101U);
+    }
+    auto const start = std::chrono::steady_clock::now();
+    for (std::size_t n{}; n < rounds; n++) {
+        engine(values.data(), block, wire.data());
+        // Feed the result back so the conversions can not be hoisted out of the loop
+        values[n % block] ^= wire[(n * 7) % block].get();
+        asm volatile("" : : "r"(wire.data()) : "memory");
+    }
+    auto const elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    return elapsed / static_cast<double>(rounds);
+}
+
+void
+report(std::string const& name, registers_engine::engine_type engine, std::size_t rounds)
+{
+    std::cout << name << ": " << measure(engine, rounds) << " ns per " << block << " registers" << std::endl;
+}
+
+}    // namespace
+
+int
+main(int argc, char** argv)
+{
+    std::size_t const rounds = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 10000000;
+
+    report("per element", &per_element, rounds);
+    report("bytewise", &registers_engine::bytewise, rounds);
+    report("scalar", &registers_engine::scalar, rounds);
+#if defined(XITREN_MODBUS_REGISTERS_SSSE3)
+    if (registers_engine::ssse3_supported()) {
+        report("ssse3", &registers_engine::ssse3, rounds);
+    }
+    if (registers_engine::avx2_supported()) {
+        report("avx2", &registers_engine::avx2, rounds);
+    }
+#elif defined(XITREN_MODBUS_REGISTERS_NEON)
+    report("neon", &registers_engine::neon, rounds);
+#endif
+    report("selected", registers_engine::selected, rounds);
+    return EXIT_SUCCESS;
+}
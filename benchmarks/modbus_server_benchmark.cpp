@@ -0,0 +1,122 @@
+#include <xitren/modbus/runtime/server.hpp>
+#include <xitren/modbus/slave.hpp>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+using namespace xitren::modbus;
+using namespace xitren::modbus::runtime;
+
+namespace {
+
+constexpr std::uint16_t registers     = 10;
+constexpr std::size_t   request_size  = mbap::prefix_length + 6;
+constexpr std::size_t   response_size = mbap::prefix_length + 3 + registers * 2;
+
+using device_type = hosted<slave<registers, registers, registers, registers, 64, mbap>>;
+
+/**
+ * @brief One client connection keeping `depth` read requests in flight
+ */
+std::size_t
+load(std::uint16_t port, std::size_t depth, std::atomic<bool> const& stop)
+{
+    int const   fd{::socket(AF_INET, SOCK_STREAM, 0)};
+    sockaddr_in addr{};
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        ::close(fd);
+        return 0;
+    }
+    int const on{1};
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+    std::array<std::uint8_t, request_size> request{0x00, 0x00, 0x00, 0x00, 0x00, 0x06, 0x01,
+                                                   0x03, 0x00, 0x00, 0x00, registers};
+    std::vector<std::uint8_t>              batch{};
+    for (std::size_t i{}; i < depth; i++) {
+        batch.insert(batch.end(), request.begin(), request.end());
+    }
+    std::vector<std::uint8_t> replies(response_size * depth);
+
+    std::size_t done{};
+    if (::send(fd, batch.data(), batch.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(batch.size())) {
+        ::close(fd);
+        return 0;
+    }
+    std::size_t pending{};
+    while (!stop.load(std::memory_order_relaxed)) {
+        auto const got = ::recv(fd, replies.data() + pending, replies.size() - pending, 0);
+        if (got <= 0) {
+            break;
+        }
+        pending += static_cast<std::size_t>(got);
+        auto const complete = pending / response_size;
+        if (complete == 0) {
+            continue;
+        }
+        done += complete;
+        pending -= complete * response_size;
+        std::memmove(replies.data(), replies.data() + complete * response_size, pending);
+        // Refill the pipeline with as many requests as were answered
+        if (::send(fd, batch.data(), complete * request_size, MSG_NOSIGNAL)
+            != static_cast<ssize_t>(complete * request_size)) {
+            break;
+        }
+    }
+    ::close(fd);
+    return done;
+}
+
+}    // namespace
+
+int
+main(int argc, char** argv)
+{
+    std::size_t const loops       = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 0;
+    std::size_t const connections = (argc > 2) ? std::strtoul(argv[2], nullptr, 10) : 8;
+    std::size_t const depth       = (argc > 3) ? std::strtoul(argv[3], nullptr, 10) : 16;
+    auto const        duration    = std::chrono::seconds{(argc > 4) ? std::strtol(argv[4], nullptr, 10) : 5};
+
+    device_type device{1};
+    unit_table  units{};
+    units.attach(device);
+
+    server     instance{loops};
+    auto const port = instance.listen(0, units, INADDR_LOOPBACK);
+    if ((port == 0) || !instance.start()) {
+        std::cerr << "Can not start the server" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::atomic<bool>        stop{false};
+    std::vector<std::size_t> done(connections);
+    std::vector<std::thread> clients{};
+    auto const               start = std::chrono::steady_clock::now();
+    for (std::size_t i{}; i < connections; i++) {
+        clients.emplace_back([&, i] { done[i] = load(port, depth, stop); });
+    }
+    std::this_thread::sleep_for(duration);
+    stop.store(true, std::memory_order_relaxed);
+    for (auto& client : clients) {
+        client.join();
+    }
+    auto const elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    instance.stop();
+
+    std::size_t total{};
+    for (auto const item : done) {
+        total += item;
+    }
+    std::cout << "loops: " << instance.size() << ", connections: " << connections << ", depth: " << depth << std::endl;
+    std::cout << "requests: " << total << ", requests/s: " << static_cast<std::size_t>(total / elapsed) << std::endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,298 @@
+/*!
+_ _
+__ _(_) |_ _ _ ___ _ _
+\ \ / |  _| '_/ -_) ' \
+/_\_\_|\__|_| \___|_||_|
+* @date 15.02.2024
+*/
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#    include <immintrin.h>
+#    define XITREN_MODBUS_BITS_SSE2 1
+#elif defined(__aarch64__)
+#    include <arm_neon.h>
+#    define XITREN_MODBUS_BITS_NEON 1
+#endif
+
+/**
+ * @brief Run time engines packing `bool` arrays into Modbus bit fields and back
+ *
+ * Modbus carries coils and discrete inputs LSB first: bit j of byte i is the bit i * 8 + j. All engines give identical
+ * results, the last byte of a packed field is padded with zeros:
+ * - `scalar` handles 8 bools per step with a multiplication, on little endian machines;
+ * - `sse2` and `avx2` handle 16 and 32 bools per step with movemask and compare instructions;
+ * - `neon` handles 16 bools per step with bit tests and horizontal additions.
+ *
+ * `pack` and `unpack` call the fastest engine the CPU supports, it is selected once at start-up.
+ */
+namespace xitren::modbus::bits_engine {
+
+using pack_type   = void (*)(bool const*, std::size_t, std::uint8_t*) noexcept;
+using unpack_type = void (*)(std::uint8_t const*, std::size_t, bool*) noexcept;
+
+struct engine_type {
+    pack_type   pack;
+    unpack_type unpack;
+};
+
+/**
+ * @brief Gathers 8 bools (one per byte, 0 or 1, first bool in the lowest byte) into the bits of a byte
+ */
+constexpr std::uint8_t
+gather(std::uint64_t bools) noexcept
+{
+    return static_cast<std::uint8_t>((bools * 0x0102040810204080ULL) >> 56U);
+}
+
+/**
+ * @brief Spreads the bits of a byte over 8 bools, the first bool in the lowest byte
+ */
+constexpr std::uint64_t
+spread(std::uint8_t byte) noexcept
+{
+    // Byte k keeps bit k of the copy it got, adding 0x7F moves any set bit up to bit 7 without a carry out
+    std::uint64_t const bits{(byte * 0x0101010101010101ULL) & 0x8040201008040201ULL};
+    return ((bits + 0x7F7F7F7F7F7F7F7FULL) >> 7U) & 0x0101010101010101ULL;
+}
+
+/**
+ * @brief Packs the tail of a field, less than 8 bools, into the last byte
+ */
+constexpr std::uint8_t
+pack_tail(bool const* src, std::size_t count) noexcept
+{
+    std::uint8_t byte{};
+    for (std::size_t i{}; i < count; i++) {
+        byte |= static_cast<std::uint8_t>(src[i]) << i;
+    }
+    return byte;
+}
+
+constexpr void
+unpack_tail(std::uint8_t byte, std::size_t count, bool* dst) noexcept
+{
+    for (std::size_t i{}; i < count; i++) {
+        dst[i] = (byte >> i) & 1U;
+    }
+}
+
+/**
+ * @brief Packs bit by bit, the reference
+ */
+constexpr void
+pack_bitwise(bool const* src, std::size_t count, std::uint8_t* dst) noexcept
+{
+    for (; count >= 8; count -= 8, src += 8) {
+        *dst++ = pack_tail(src, 8);
+    }
+    if (count > 0) {
+        *dst = pack_tail(src, count);
+    }
+}
+
+constexpr void
+unpack_bitwise(std::uint8_t const* src, std::size_t count, bool* dst) noexcept
+{
+    for (; count >= 8; count -= 8, dst += 8) {
+        unpack_tail(*src++, 8, dst);
+    }
+    if (count > 0) {
+        unpack_tail(*src, count, dst);
+    }
+}
+
+inline void
+pack_scalar(bool const* src, std::size_t count, std::uint8_t* dst) noexcept
+{
+    if constexpr (std::endian::native == std::endian::little) {
+        for (; count >= 8; count -= 8, src += 8) {
+            std::uint64_t bools;
+            std::memcpy(&bools, src, sizeof(bools));
+            *dst++ = gather(bools);
+        }
+    }
+    pack_bitwise(src, count, dst);
+}
+
+inline void
+unpack_scalar(std::uint8_t const* src, std::size_t count, bool* dst) noexcept
+{
+    if constexpr (std::endian::native == std::endian::little) {
+        for (; count >= 8; count -= 8, dst += 8) {
+            std::uint64_t const bools{spread(*src++)};
+            std::memcpy(dst, &bools, sizeof(bools));
+        }
+    }
+    unpack_bitwise(src, count, dst);
+}
+
+#if defined(XITREN_MODBUS_BITS_SSE2)
+/**
+ * @brief The bit every byte of 16 unpacked bools is tested against
+ */
+__attribute__((target("sse2"))) inline __m128i
+weights_sse2() noexcept
+{
+    return _mm_set_epi8(static_cast<char>(0x80), 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01,
+                        static_cast<char>(0x80), 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01);
+}
+
+__attribute__((target("sse2"))) inline void
+pack_sse2(bool const* src, std::size_t count, std::uint8_t* dst) noexcept
+{
+    __m128i const zero{_mm_setzero_si128()};
+    for (; count >= 16; count -= 16, src += 16, dst += 2) {
+        __m128i const bools{_mm_loadu_si128(reinterpret_cast<__m128i const*>(src))};
+        auto const    mask{static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpgt_epi8(bools, zero)))};
+        dst[0] = static_cast<std::uint8_t>(mask);
+        dst[1] = static_cast<std::uint8_t>(mask >> 8U);
+    }
+    pack_scalar(src, count, dst);
+}
+
+__attribute__((target("sse2"))) inline void
+unpack_sse2(std::uint8_t const* src, std::size_t count, bool* dst) noexcept
+{
+    __m128i const weights{weights_sse2()};
+    __m128i const one{_mm_set1_epi8(1)};
+    for (; count >= 16; count -= 16, src += 2, dst += 16) {
+        __m128i const bytes{_mm_unpacklo_epi64(_mm_set1_epi8(static_cast<char>(src[0])),
+                                               _mm_set1_epi8(static_cast<char>(src[1])))};
+        __m128i const bools{_mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(bytes, weights), weights), one)};
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), bools);
+    }
+    unpack_scalar(src, count, dst);
+}
+
+__attribute__((target("avx2"))) inline void
+pack_avx2(bool const* src, std::size_t count, std::uint8_t* dst) noexcept
+{
+    __m256i const zero{_mm256_setzero_si256()};
+    for (; count >= 32; count -= 32, src += 32, dst += 4) {
+        __m256i const bools{_mm256_loadu_si256(reinterpret_cast<__m256i const*>(src))};
+        auto const    mask{static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpgt_epi8(bools, zero)))};
+        for (unsigned byte{}; byte < 4; byte++) {
+            dst[byte] = static_cast<std::uint8_t>(mask >> (byte * 8U));
+        }
+    }
+    pack_sse2(src, count, dst);
+}
+
+__attribute__((target("avx2"))) inline void
+unpack_avx2(std::uint8_t const* src, std::size_t count, bool* dst) noexcept
+{
+    // Every 128-bit lane picks its two source bytes out of the broadcast 32-bit word
+    __m256i const select{_mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3,
+                                          3, 3, 3, 3, 3)};
+    __m256i const weights{_mm256_broadcastsi128_si256(weights_sse2())};
+    __m256i const one{_mm256_set1_epi8(1)};
+    for (; count >= 32; count -= 32, src += 4, dst += 32) {
+        std::uint32_t word;
+        std::memcpy(&word, src, sizeof(word));
+        __m256i const bytes{_mm256_shuffle_epi8(_mm256_set1_epi32(static_cast<int>(word)), select)};
+        __m256i const bools{_mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(bytes, weights), weights), one)};
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), bools);
+    }
+    unpack_sse2(src, count, dst);
+}
+
+inline bool
+avx2_supported() noexcept
+{
+    return __builtin_cpu_supports("avx2");
+}
+#endif
+
+#if defined(XITREN_MODBUS_BITS_NEON)
+inline uint8x16_t
+weights_neon() noexcept
+{
+    static constexpr std::uint8_t weights[16]{0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80,
+                                              0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80};
+    return vld1q_u8(weights);
+}
+
+inline void
+pack_neon(bool const* src, std::size_t count, std::uint8_t* dst) noexcept
+{
+    uint8x16_t const weights{weights_neon()};
+    for (; count >= 16; count -= 16, src += 16, dst += 2) {
+        uint8x16_t const bools{vld1q_u8(reinterpret_cast<std::uint8_t const*>(src))};
+        // Every set bool keeps its own bit, the bits of a half do not overlap so adding them is or-ing them
+        uint8x16_t const bits{vandq_u8(vtstq_u8(bools, bools), weights)};
+        dst[0] = vaddv_u8(vget_low_u8(bits));
+        dst[1] = vaddv_u8(vget_high_u8(bits));
+    }
+    pack_scalar(src, count, dst);
+}
+
+inline void
+unpack_neon(std::uint8_t const* src, std::size_t count, bool* dst) noexcept
+{
+    uint8x16_t const weights{weights_neon()};
+    uint8x16_t const one{vdupq_n_u8(1)};
+    for (; count >= 16; count -= 16, src += 2, dst += 16) {
+        uint8x16_t const bytes{vcombine_u8(vdup_n_u8(src[0]), vdup_n_u8(src[1]))};
+        vst1q_u8(reinterpret_cast<std::uint8_t*>(dst), vandq_u8(vtstq_u8(bytes, weights), one));
+    }
+    unpack_scalar(src, count, dst);
+}
+#endif
+
+/**
+ * @brief Picks the fastest engine the CPU supports
+ */
+inline engine_type
+select() noexcept
+{
+#if defined(XITREN_MODBUS_BITS_SSE2)
+    if (avx2_supported()) {
+        return {&pack_avx2, &unpack_avx2};
+    }
+    return {&pack_sse2, &unpack_sse2};
+#elif defined(XITREN_MODBUS_BITS_NEON)
+    return {&pack_neon, &unpack_neon};
+#else
+    return {&pack_scalar, &unpack_scalar};
+#endif
+}
+
+/**
+ * @brief The engine selected for this CPU
+ */
+inline engine_type const selected = select();
+
+/**
+ * @brief Packs `count` bools into `(count + 7) / 8` bytes with the selected engine
+ */
+inline void
+pack(bool const* src, std::size_t count, std::uint8_t* dst) noexcept
+{
+    if (selected.pack == nullptr) [[unlikely]] {
+        // Called during static initialization, before the selection
+        select().pack(src, count, dst);
+        return;
+    }
+    selected.pack(src, count, dst);
+}
+
+/**
+ * @brief Unpacks `count` bits into bools with the selected engine
+ */
+inline void
+unpack(std::uint8_t const* src, std::size_t count, bool* dst) noexcept
+{
+    if (selected.unpack == nullptr) [[unlikely]] {
+        select().unpack(src, count, dst);
+        return;
+    }
+    selected.unpack(src, count, dst);
+}
+
+}    // namespace xitren::modbus::bits_engine
@@ -0,0 +1,109 @@
+/*!
+_ _
+__ _(_) |_ _ _ ___ _ _
+\ \ / |  _| '_/ -_) ' \
+/_\_\_|\__|_| \___|_||_|
+* @date 15.02.2024
+*/
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Finds the values a write really changed
+ *
+ * Registers are compared 64 at a time into a bitmask without branches, so the compiler turns the compares into vector
+ * instructions; coils are compared a byte of the Modbus bit field at a time. Only the changed values are visited.
+ */
+namespace xitren::modbus::changes {
+
+/**
+ * @brief The registers of a block of up to 64 that differ, bit i is set if register i does
+ */
+constexpr std::uint64_t
+register_mask(std::uint16_t const* before, std::uint16_t const* after, std::size_t count) noexcept
+{
+    std::uint64_t mask{};
+    for (std::size_t i{}; i < count; i++) {
+        mask |= static_cast<std::uint64_t>(before[i] != after[i]) << i;
+    }
+    return mask;
+}
+
+/**
+ * @brief Calls `callback(base, mask)` for every block of 64 registers with a difference, see register_mask()
+ */
+template <class Callback>
+constexpr void
+for_each_register_mask(std::uint16_t const* before, std::uint16_t const* after, std::size_t count,
+                       Callback&& callback)
+{
+    for (std::size_t base{}; base < count; base += 64) {
+        auto const mask = register_mask(before + base, after + base, std::min<std::size_t>(count - base, 64));
+        if (mask != 0) {
+            callback(base, mask);
+        }
+    }
+}
+
+/**
+ * @brief Calls `callback(i)` for every register that differs
+ */
+template <class Callback>
+constexpr void
+for_each_register(std::uint16_t const* before, std::uint16_t const* after, std::size_t count, Callback&& callback)
+{
+    for_each_register_mask(before, after, count, [&](std::size_t base, std::uint64_t mask) {
+        for (; mask != 0; mask &= mask - 1) {
+            callback(base + static_cast<std::size_t>(std::countr_zero(mask)));
+        }
+    });
+}
+
+/**
+ * @brief Calls `callback(base, mask)` for every block of 64 bits of two Modbus bit fields of `count` bits with a
+ * difference, bit i of `mask` is set if bit `base + i` differs
+ */
+template <class Callback>
+constexpr void
+for_each_bit_mask(std::uint8_t const* before, std::uint8_t const* after, std::size_t count, Callback&& callback)
+{
+    for (std::size_t base{}; base < count; base += 64) {
+        auto const    bits = std::min<std::size_t>(count - base, 64);
+        std::uint64_t mask{};
+        for (std::size_t byte{}; byte * 8 < bits; byte++) {
+            auto const at = base / 8 + byte;
+            mask |= static_cast<std::uint64_t>(before[at] ^ after[at]) << (byte * 8);
+        }
+        if (bits < 64) {
+            mask &= (std::uint64_t{1} << bits) - 1;
+        }
+        if (mask != 0) {
+            callback(base, mask);
+        }
+    }
+}
+
+/**
+ * @brief Calls `callback(i, value)` for every bit of two Modbus bit fields of `count` bits that differs
+ */
+template <class Callback>
+constexpr void
+for_each_bit(std::uint8_t const* before, std::uint8_t const* after, std::size_t count, Callback&& callback)
+{
+    for (std::size_t byte{}; byte * 8 < count; byte++) {
+        auto diff = static_cast<unsigned>(before[byte] ^ after[byte]);
+        if ((byte + 1) * 8 > count) {
+            diff &= (1U << (count % 8)) - 1;
+        }
+        for (; diff != 0; diff &= diff - 1) {
+            auto const bit = static_cast<unsigned>(std::countr_zero(diff));
+            callback(byte * 8 + bit, ((after[byte] >> bit) & 1U) != 0);
+        }
+    }
+}
+
+}    // namespace xitren::modbus::changes
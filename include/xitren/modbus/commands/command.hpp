@@ -2,6 +2,7 @@
 
 #include "../../../../third_party/circular_buffer/include/xitren/circular_buffer.hpp"
 #include "../modbus.hpp"
+#include "../registers_engine.hpp"
 
 #include <functional>
 #include <memory>
@@ -39,6 +40,7 @@ public:
     static constexpr std::size_t command_buffer_max = 370;
     using command_vault_type                        = std::aligned_storage_t<command_buffer_max, 1>;
     using msg_type                                  = packet_accessor<modbus_base::max_adu_length>;
+    using framing_type                              = modbus_base::framing_type;
 
     /**
      * @brief virtual destructor
@@ -272,7 +274,7 @@ operator>>(containers::circular_buffer<T, Size>& buffer, command& out_data)
 {
     command::msg_type buff{};
     std::size_t       i{0};
-    auto              it = buff.storage().begin();
+    auto              it = buff.storage().data();
     while (!buffer.empty() && (i < buff.storage().size())) {
         auto& item = buffer.front();
         *(it++)    = item;
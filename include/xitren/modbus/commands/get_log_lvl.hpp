@@ -43,7 +43,7 @@ public:
     inline iterator
     begin() noexcept override
     {
-        return msg_output_.storage().begin();
+        return msg_output_.storage().data();
     }
 
     /**
@@ -54,7 +54,7 @@ public:
     inline const_iterator
     begin() const noexcept override
     {
-        return msg_output_.storage().begin();
+        return msg_output_.storage().data();
     }
 
     /**
@@ -65,7 +65,7 @@ public:
     inline iterator
     end() noexcept override
     {
-        return msg_output_.storage().end();
+        return msg_output_.storage().data() + msg_output_.storage().size();
     }
 
     /**
@@ -76,7 +76,7 @@ public:
     inline const_iterator
     end() const noexcept override
     {
-        return msg_output_.storage().end();
+        return msg_output_.storage().data() + msg_output_.storage().size();
     }
 
     /**
@@ -155,7 +155,7 @@ public:
     exception
     receive(msg_type const& message) noexcept override
     {
-        static std::uint16_t values{};
+        std::uint16_t values{};
         auto [pack, err] = input_msg<header, func::msb_t<std::uint16_t>, func::msb_t<std::uint16_t>>(slave(), message);
         if (error(err) != exception::no_error) [[unlikely]] {
             Callback(err, 0);
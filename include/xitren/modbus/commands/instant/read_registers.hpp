@@ -87,7 +87,7 @@ public:
     exception
     receive(msg_type const& message) noexcept override
     {
-        static std::array<std::uint16_t, modbus_base::max_read_registers> values{};
+        std::array<std::uint16_t, modbus_base::max_read_registers> values{};
         auto [pack, err] = input_msg<header, std::uint8_t, func::msb_t<std::uint16_t>>(slave(), message);
         if (error(err) != exception::no_error) [[unlikely]] {
             Callback(err, nullptr, nullptr);
@@ -97,9 +97,7 @@ public:
             Callback(err, nullptr, nullptr);
             return exception::illegal_data_value;
         }
-        for (std::size_t i{}; (i < values.size()) && (i < pack.size); i++) {
-            values[i] = pack.data[i].get();
-        }
+        registers_engine::from_wire(reinterpret_cast<std::uint8_t const*>(pack.data), pack.size, values.data());
         Callback(exception::no_error, values.begin(), values.begin() + pack.size);
         return exception::no_error;
     }
@@ -55,7 +55,7 @@ public:
     inline iterator
     begin() noexcept override
     {
-        return msg_output_.storage().begin();
+        return msg_output_.storage().data();
     }
 
     /**
@@ -66,7 +66,7 @@ public:
     inline const_iterator
     begin() const noexcept override
     {
-        return msg_output_.storage().begin();
+        return msg_output_.storage().data();
     }
 
     /**
@@ -77,7 +77,7 @@ public:
     inline iterator
     end() noexcept override
     {
-        return msg_output_.storage().end();
+        return msg_output_.storage().data() + msg_output_.storage().size();
     }
 
     /**
@@ -88,7 +88,7 @@ public:
     inline const_iterator
     end() const noexcept override
     {
-        return msg_output_.storage().end();
+        return msg_output_.storage().data() + msg_output_.storage().size();
     }
 
     /**
@@ -157,7 +157,7 @@ public:
     exception
     receive(msg_type const& message) noexcept override
     {
-        static std::array<std::uint16_t, modbus_base::max_read_registers> values{};
+        std::array<std::uint16_t, modbus_base::max_read_registers> values{};
         auto [pack, err] = input_msg<header, func::msb_t<std::uint16_t>, func::msb_t<std::uint16_t>>(slave(), message);
         if (error(err) != exception::no_error) [[unlikely]] {
             callback_(err, nullptr, nullptr);
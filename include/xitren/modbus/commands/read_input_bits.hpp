@@ -70,7 +70,7 @@ public:
     inline iterator
     begin() noexcept override
     {
-        return msg_output_.storage().begin();
+        return msg_output_.storage().data();
     }
 
     /**
@@ -81,7 +81,7 @@ public:
     inline const_iterator
     begin() const noexcept override
     {
-        return msg_output_.storage().begin();
+        return msg_output_.storage().data();
     }
 
     /**
@@ -92,7 +92,7 @@ public:
     inline iterator
     end() noexcept override
     {
-        return msg_output_.storage().end();
+        return msg_output_.storage().data() + msg_output_.storage().size();
     }
 
     /**
@@ -103,7 +103,7 @@ public:
     inline const_iterator
     end() const noexcept override
     {
-        return msg_output_.storage().end();
+        return msg_output_.storage().data() + msg_output_.storage().size();
     }
 
     /**
@@ -182,7 +182,7 @@ public:
     exception
     receive(msg_type const& message) noexcept override
     {
-        static types::bits_array_type values{};
+        types::bits_array_type values{};
         auto [pack, err] = input_msg<header, std::uint8_t, std::uint8_t>(slave(), message);
         if (error(err) != exception::no_error) [[unlikely]]
             return err;
@@ -52,25 +52,25 @@ public:
     inline iterator
     begin() noexcept override
     {
-        return msg_output_.storage().begin();
+        return msg_output_.storage().data();
     }
 
     inline const_iterator
     begin() const noexcept override
     {
-        return msg_output_.storage().begin();
+        return msg_output_.storage().data();
     }
 
     inline iterator
     end() noexcept override
     {
-        return msg_output_.storage().end();
+        return msg_output_.storage().data() + msg_output_.storage().size();
     }
 
     inline const_iterator
     end() const noexcept override
     {
-        return msg_output_.storage().end();
+        return msg_output_.storage().data() + msg_output_.storage().size();
     }
 
     inline std::size_t
@@ -114,15 +114,13 @@ public:
     exception
     receive(msg_type const& message) noexcept override
     {
-        static std::array<std::uint16_t, modbus_base::max_read_registers> values{};
+        std::array<std::uint16_t, modbus_base::max_read_registers> values{};
         auto [pack, err] = input_msg<header, std::uint8_t, func::msb_t<std::uint16_t>>(slave(), message);
         if (error(err) != exception::no_error) [[unlikely]]
             return err;
         if (pack.size > modbus_base::max_read_registers) [[unlikely]]
             return exception::illegal_data_value;
-        for (std::size_t i{}; (i < values.size()) && (i < pack.size); i++) {
-            values[i] = pack.data[i].get();
-        }
+        registers_engine::from_wire(reinterpret_cast<std::uint8_t const*>(pack.data), pack.size, values.data());
         callback_(exception::no_error, values.begin(), values.begin() + pack.size);
         return exception::no_error;
     }
@@ -64,12 +64,8 @@ public:
     value(std::array<std::uint16_t, Size> const& vals) noexcept
     {
         static_assert(Size < modbus_base::max_write_registers, "Too much to write!");
-        static std::array<func::msb_t<std::uint16_t>, Size> data_formatted;
-        auto                                                it1{vals.begin()};
-        auto                                                it2{data_formatted.begin()};
-        for (; (it1 != vals.end()) && (it2 != data_formatted.end()); it1++, it2++) {
-            (*it2) = (*it1);
-        }
+        std::array<func::msb_t<std::uint16_t>, Size> data_formatted;
+        registers_engine::to_wire(vals.data(), Size, reinterpret_cast<std::uint8_t*>(data_formatted.data()));
         if (!msg_output_.template serialize<header, request_fields_wr_single, func::msb_t<std::uint16_t>, crc16ansi>(
                 {{slave_, static_cast<std::uint8_t>(function::write_multiple_registers)},
                  {address_, static_cast<std::uint16_t>(vals.size()), static_cast<std::uint8_t>(Size * 2)},
@@ -88,7 +84,7 @@ public:
     inline iterator
     begin() noexcept override
     {
-        return msg_output_.storage().begin();
+        return msg_output_.storage().data();
     }
 
     /**
@@ -99,7 +95,7 @@ public:
     inline const_iterator
     begin() const noexcept override
     {
-        return msg_output_.storage().begin();
+        return msg_output_.storage().data();
     }
 
     /**
@@ -110,7 +106,7 @@ public:
     inline iterator
     end() noexcept override
     {
-        return msg_output_.storage().end();
+        return msg_output_.storage().data() + msg_output_.storage().size();
     }
 
     /**
@@ -121,7 +117,7 @@ public:
     inline const_iterator
     end() const noexcept override
     {
-        return msg_output_.storage().end();
+        return msg_output_.storage().data() + msg_output_.storage().size();
     }
 
     /**
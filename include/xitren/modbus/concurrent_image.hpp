@@ -0,0 +1,455 @@
+/*!
+_ _
+__ _(_) |_ _ _ ___ _ _
+\ \ / |  _| '_/ -_) ' \
+/_\_\_|\__|_| \___|_||_|
+* @date 15.02.2024
+*/
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+#if defined(__x86_64__) || defined(__i386__)
+#    include <immintrin.h>
+#endif
+
+/**
+ * @brief Register and bit images shared between an application thread and the protocol thread
+ *
+ * Both are guarded by a seqlock: a writer makes the sequence odd, stores and makes it even again; a reader copies the
+ * range and retries if the sequence was odd or moved meanwhile. Readers never write shared memory and never block a
+ * writer, a writer only waits for another writer. The elements are accessed with relaxed atomics, the sequence orders
+ * them, so a range read by the protocol is always one consistent snapshot.
+ */
+namespace xitren::modbus {
+
+namespace seqlock {
+
+inline void
+relax() noexcept
+{
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#endif
+}
+
+/**
+ * @brief Enters the write side, writers exclude each other
+ *
+ * @return The even sequence the write started from
+ */
+inline std::uint32_t
+lock(std::atomic<std::uint32_t>& sequence) noexcept
+{
+    auto current = sequence.load(std::memory_order_relaxed);
+    for (;;) {
+        if (((current & 1U) == 0)
+            && sequence.compare_exchange_weak(current, current + 1, std::memory_order_acquire,
+                                              std::memory_order_relaxed)) [[likely]] {
+            std::atomic_thread_fence(std::memory_order_release);
+            return current;
+        }
+        relax();
+        current = sequence.load(std::memory_order_relaxed);
+    }
+}
+
+inline void
+unlock(std::atomic<std::uint32_t>& sequence, std::uint32_t start) noexcept
+{
+    sequence.store(start + 2, std::memory_order_release);
+}
+
+/**
+ * @brief Calls `copy()` until it ran without a concurrent write
+ *
+ * Unbounded: a writer that never leaves its update keeps the reader spinning, see shared_image.
+ */
+template <class Copy>
+inline void
+read(std::atomic<std::uint32_t> const& sequence, Copy&& copy) noexcept
+{
+    for (;;) {
+        auto const start = sequence.load(std::memory_order_acquire);
+        if ((start & 1U) != 0) [[unlikely]] {
+            relax();
+            continue;
+        }
+        copy();
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (sequence.load(std::memory_order_relaxed) == start) [[likely]] {
+            return;
+        }
+    }
+}
+
+}    // namespace seqlock
+
+/**
+ * @brief Storage of a seqlock image kept in the image object itself
+ */
+template <class Word, std::size_t Words>
+class local_storage {
+public:
+    [[nodiscard]] constexpr Word*
+    data() const noexcept
+    {
+        return data_.data();
+    }
+
+    [[nodiscard]] constexpr std::atomic<std::uint32_t>&
+    sequence() const noexcept
+    {
+        return sequence_;
+    }
+
+private:
+    mutable std::array<Word, Words>    data_{};
+    mutable std::atomic<std::uint32_t> sequence_{};
+};
+
+/**
+ * @brief Storage of a seqlock image living elsewhere, e.g. in a shared memory region, see shared_image
+ */
+template <class Word>
+class mapped_storage {
+public:
+    constexpr mapped_storage() noexcept = default;
+
+    constexpr mapped_storage(Word* data, std::atomic<std::uint32_t>* sequence) noexcept
+        : data_{data}, sequence_{sequence}
+    {}
+
+    [[nodiscard]] constexpr Word*
+    data() const noexcept
+    {
+        return data_;
+    }
+
+    [[nodiscard]] constexpr std::atomic<std::uint32_t>&
+    sequence() const noexcept
+    {
+        return *sequence_;
+    }
+
+private:
+    Word*                       data_{};
+    std::atomic<std::uint32_t>* sequence_{};
+};
+
+/**
+ * @brief A register image the application updates while the protocol thread reads it
+ *
+ * The protocol reads ranges with read(), the application publishes ranges with update(). Single registers are read
+ * and written through operator[].
+ *
+ * @tparam Size The number of registers.
+ * @tparam Storage Where the registers and the sequence live, local_storage or mapped_storage.
+ */
+template <std::size_t Size, class Storage = local_storage<std::uint16_t, Size>>
+class concurrent_registers {
+public:
+    using value_type = std::uint16_t;
+    using size_type  = std::size_t;
+
+    /**
+     * @brief Proxy to a single register
+     */
+    class reference {
+    public:
+        constexpr reference(concurrent_registers& image, size_type index) noexcept : image_{image}, index_{index} {}
+
+        constexpr reference(reference const&) noexcept = default;
+
+        operator value_type() const noexcept
+        {
+            value_type value{};
+            image_.read(index_, 1, &value);
+            return value;
+        }
+
+        reference&
+        operator=(value_type value) noexcept
+        {
+            image_.update(index_, std::span<value_type const>{&value, 1});
+            return *this;
+        }
+
+        reference&
+        operator=(reference const& other) noexcept
+        {
+            return *this = static_cast<value_type>(other);
+        }
+
+        ~reference() noexcept = default;
+
+    private:
+        concurrent_registers& image_;
+        size_type             index_;
+    };
+
+    constexpr concurrent_registers() noexcept = default;
+
+    constexpr explicit concurrent_registers(Storage storage) noexcept : storage_{storage} {}
+
+    [[nodiscard]] constexpr size_type
+    size() const noexcept
+    {
+        return Size;
+    }
+
+    reference
+    operator[](size_type index) noexcept
+    {
+        return {*this, index};
+    }
+
+    value_type
+    operator[](size_type index) const noexcept
+    {
+        value_type value{};
+        read(index, 1, &value);
+        return value;
+    }
+
+    /**
+     * @brief Copies a consistent snapshot of the registers [start, start + count)
+     */
+    void
+    read(size_type start, size_type count, value_type* dst) const noexcept
+    {
+        seqlock::read(storage_.sequence(), [&]() {
+            for (size_type i{}; i < count; i++) {
+                dst[i] = std::atomic_ref<value_type>{storage_.data()[start + i]}.load(std::memory_order_relaxed);
+            }
+        });
+    }
+
+    /**
+     * @brief Publishes the registers [start, start + values.size()) at once
+     */
+    void
+    update(size_type start, std::span<value_type const> values) noexcept
+    {
+        auto const sequence = seqlock::lock(storage_.sequence());
+        for (size_type i{}; i < values.size(); i++) {
+            std::atomic_ref<value_type>{storage_.data()[start + i]}.store(values[i], std::memory_order_relaxed);
+        }
+        seqlock::unlock(storage_.sequence(), sequence);
+    }
+
+    /**
+     * @brief The number of updates published, doubled
+     */
+    [[nodiscard]] std::uint32_t
+    version() const noexcept
+    {
+        return storage_.sequence().load(std::memory_order_acquire);
+    }
+
+private:
+    Storage storage_{};
+};
+
+/**
+ * @brief A bit image the application updates while the protocol thread reads it
+ *
+ * Bits are packed in 64-bit words like packed_bits, ranges are read and written in the Modbus bit field layout.
+ *
+ * @tparam Size The number of bits.
+ * @tparam Storage Where the words and the sequence live, local_storage or mapped_storage.
+ */
+template <std::size_t Size, class Storage = local_storage<std::uint64_t, (Size + 63) / 64>>
+class concurrent_bits {
+public:
+    using word_type  = std::uint64_t;
+    using size_type  = std::size_t;
+    using value_type = bool;
+
+    static constexpr size_type word_bits = 64;
+    static constexpr size_type words     = (Size + word_bits - 1) / word_bits;
+
+    /**
+     * @brief Proxy to a single bit
+     */
+    class reference {
+    public:
+        constexpr reference(concurrent_bits& image, size_type index) noexcept : image_{image}, index_{index} {}
+
+        constexpr reference(reference const&) noexcept = default;
+
+        operator bool() const noexcept
+        {
+            return image_.test(index_);
+        }
+
+        reference&
+        operator=(bool value) noexcept
+        {
+            image_.update(index_, std::span<bool const>{&value, 1});
+            return *this;
+        }
+
+        reference&
+        operator=(reference const& other) noexcept
+        {
+            return *this = static_cast<bool>(other);
+        }
+
+        ~reference() noexcept = default;
+
+    private:
+        concurrent_bits& image_;
+        size_type        index_;
+    };
+
+    constexpr concurrent_bits() noexcept = default;
+
+    constexpr explicit concurrent_bits(Storage storage) noexcept : storage_{storage} {}
+
+    [[nodiscard]] constexpr size_type
+    size() const noexcept
+    {
+        return Size;
+    }
+
+    reference
+    operator[](size_type index) noexcept
+    {
+        return {*this, index};
+    }
+
+    bool
+    operator[](size_type index) const noexcept
+    {
+        return test(index);
+    }
+
+    [[nodiscard]] bool
+    test(size_type index) const noexcept
+    {
+        return (load(index / word_bits) >> (index % word_bits)) & 1U;
+    }
+
+    /**
+     * @brief Packs a consistent snapshot of the bits [start, start + count) into Modbus bit field bytes
+     *
+     * @param start The first bit.
+     * @param count The number of bits, the range must be within the image.
+     * @param dst The destination, `(count + 7) / 8` bytes, the last byte is padded with zeros.
+     */
+    void
+    read(size_type start, size_type count, std::uint8_t* dst) const noexcept
+    {
+        seqlock::read(storage_.sequence(), [&]() {
+            auto* out = dst;
+            for (size_type at{start}, left{count}; left > 0; at += word_bits) {
+                auto const bits  = std::min(left, word_bits);
+                auto       value = extract(at);
+                if (bits < word_bits) {
+                    value &= (word_type{1} << bits) - 1;
+                }
+                for (size_type byte{}; byte * 8 < bits; byte++) {
+                    *out++ = static_cast<std::uint8_t>(value >> (byte * 8));
+                }
+                left -= bits;
+            }
+        });
+    }
+
+    /**
+     * @brief Publishes Modbus bit field bytes into the bits [start, start + count) at once
+     */
+    void
+    write(size_type start, size_type count, std::uint8_t const* src) noexcept
+    {
+        auto const sequence = seqlock::lock(storage_.sequence());
+        for (; count > 0; start += word_bits) {
+            auto const bits = std::min(count, word_bits);
+            word_type  value{};
+            for (size_type byte{}; byte * 8 < bits; byte++) {
+                value |= word_type{*src++} << (byte * 8);
+            }
+            auto const mask = (bits < word_bits) ? ((word_type{1} << bits) - 1) : ~word_type{};
+            deposit(start, value & mask, mask);
+            count -= bits;
+        }
+        seqlock::unlock(storage_.sequence(), sequence);
+    }
+
+    /**
+     * @brief Publishes the bits [start, start + values.size()) at once
+     */
+    void
+    update(size_type start, std::span<bool const> values) noexcept
+    {
+        auto const sequence = seqlock::lock(storage_.sequence());
+        for (size_type done{}; done < values.size(); done += word_bits) {
+            auto const bits = std::min(values.size() - done, word_bits);
+            word_type  value{};
+            for (size_type i{}; i < bits; i++) {
+                value |= word_type{values[done + i]} << i;
+            }
+            deposit(start + done, value, (bits < word_bits) ? ((word_type{1} << bits) - 1) : ~word_type{});
+        }
+        seqlock::unlock(storage_.sequence(), sequence);
+    }
+
+    /**
+     * @brief The number of updates published, doubled
+     */
+    [[nodiscard]] std::uint32_t
+    version() const noexcept
+    {
+        return storage_.sequence().load(std::memory_order_acquire);
+    }
+
+private:
+    Storage storage_{};
+
+    [[nodiscard]] word_type
+    load(size_type index) const noexcept
+    {
+        return std::atomic_ref<word_type>{storage_.data()[index]}.load(std::memory_order_relaxed);
+    }
+
+    void
+    store(size_type index, word_type value) noexcept
+    {
+        std::atomic_ref<word_type>{storage_.data()[index]}.store(value, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief The 64 bits starting at `start`, bits past the end are zero
+     */
+    [[nodiscard]] word_type
+    extract(size_type start) const noexcept
+    {
+        auto const index = start / word_bits;
+        auto const shift = start % word_bits;
+        word_type  value{load(index) >> shift};
+        if ((shift != 0) && (index + 1 < words)) {
+            value |= load(index + 1) << (word_bits - shift);
+        }
+        return value;
+    }
+
+    void
+    deposit(size_type start, word_type value, word_type mask) noexcept
+    {
+        auto const index = start / word_bits;
+        auto const shift = start % word_bits;
+        store(index, (load(index) & ~(mask << shift)) | (value << shift));
+        if ((shift != 0) && (index + 1 < words)) {
+            auto const high = word_bits - shift;
+            store(index + 1, (load(index + 1) & ~(mask >> high)) | (value >> high));
+        }
+    }
+};
+
+}    // namespace xitren::modbus
@@ -0,0 +1,815 @@
+/*!
+_ _
+__ _(_) |_ _ _ ___ _ _
+\ \ / |  _| '_/ -_) ' \
+/_\_\_|\__|_| \___|_||_|
+* @date 15.02.2024
+*/
+#pragma once
+
+#include <xitren/circular_buffer.hpp>
+#include <xitren/modbus/commands/command.hpp>
+#include <xitren/modbus/master.hpp>
+#include <xitren/modbus/modbus.hpp>
+
+#include <algorithm>
+#include <array>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <new>
+#include <span>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace xitren::modbus::coro {
+
+/**
+ * @brief A free list of fixed size blocks the coroutine frames are taken from
+ *
+ * Blocks are carved from the storage on first use and recycled through the free list afterwards, so once the
+ * coroutines of a steady polling loop have run once no frame touches the heap. A frame that does not fit a block, or
+ * comes when every block is taken, is allocated with `operator new` instead; see heap_frames().
+ */
+class frame_arena {
+public:
+    constexpr frame_arena(std::byte* storage, std::size_t block_size, std::size_t blocks) noexcept
+        : storage_{storage}, block_size_{block_size}, blocks_{blocks}
+    {}
+
+    frame_arena(frame_arena const&) = delete;
+    frame_arena&
+    operator=(frame_arena const&)
+        = delete;
+
+    /**
+     * @brief Takes a block, nullptr if every block is in use
+     */
+    [[nodiscard]] void*
+    allocate() noexcept
+    {
+        if (free_ != nullptr) [[likely]] {
+            used_++;
+            return std::exchange(free_, free_->next);
+        }
+        if (carved_ < blocks_) {
+            used_++;
+            return storage_ + (block_size_ * carved_++);
+        }
+        return nullptr;
+    }
+
+    void
+    deallocate(void* block) noexcept
+    {
+        free_ = ::new (block) free_block{free_};
+        used_--;
+    }
+
+    [[nodiscard]] inline std::size_t
+    block_size() const noexcept
+    {
+        return block_size_;
+    }
+
+    /**
+     * @brief The number of blocks holding a frame
+     */
+    [[nodiscard]] inline std::size_t
+    used() const noexcept
+    {
+        return used_;
+    }
+
+    /**
+     * @brief The arena new frames of the calling thread are taken from, nullptr for the heap
+     */
+    static frame_arena*&
+    current() noexcept
+    {
+        thread_local frame_arena* arena{};
+        return arena;
+    }
+
+    /**
+     * @brief The number of frames of the calling thread allocated on the heap so far
+     */
+    static std::size_t&
+    heap_frames() noexcept
+    {
+        thread_local std::size_t frames{};
+        return frames;
+    }
+
+    /**
+     * @brief Allocates a coroutine frame from the current arena, from the heap if it does not fit
+     *
+     * The arena is recorded in front of the frame, so it goes back to where it came from whichever arena is current
+     * when the coroutine ends.
+     */
+    static void*
+    allocate_frame(std::size_t size) noexcept
+    {
+        auto const total = size + sizeof(frame_header);
+        auto*      arena = current();
+        void*      block = ((arena != nullptr) && (total <= arena->block_size())) ? arena->allocate() : nullptr;
+        if (block == nullptr) [[unlikely]] {
+            arena = nullptr;
+            block = ::operator new(total, std::nothrow);
+            if (block == nullptr) {
+                return nullptr;
+            }
+            heap_frames()++;
+        }
+        return ::new (block) frame_header{arena} + 1;
+    }
+
+    static void
+    deallocate_frame(void* frame) noexcept
+    {
+        auto* header = static_cast<frame_header*>(frame) - 1;
+        if (header->arena != nullptr) [[likely]] {
+            header->arena->deallocate(header);
+        } else {
+            ::operator delete(header);
+        }
+    }
+
+private:
+    struct alignas(std::max_align_t) frame_header {
+        frame_arena* arena;
+    };
+
+    struct free_block {
+        free_block* next;
+    };
+
+    std::byte*  storage_;
+    std::size_t block_size_;
+    std::size_t blocks_;
+    std::size_t carved_{};
+    std::size_t used_{};
+    free_block* free_{};
+};
+
+/**
+ * @brief The storage of a frame_arena of `Blocks` blocks of `BlockSize` bytes
+ */
+template <std::size_t BlockSize, std::size_t Blocks>
+class frame_pool {
+    static_assert((BlockSize % alignof(std::max_align_t)) == 0, "Blocks must keep the frames aligned!");
+    static_assert(Blocks > 0, "The pool must hold at least one frame!");
+
+public:
+    frame_pool() noexcept = default;
+
+    [[nodiscard]] inline frame_arena&
+    arena() noexcept
+    {
+        return arena_;
+    }
+
+private:
+    alignas(std::max_align_t) std::array<std::byte, BlockSize * Blocks> storage_{};
+    frame_arena arena_{storage_.data(), BlockSize, Blocks};
+};
+
+namespace detail {
+
+struct promise_base {
+    std::coroutine_handle<> continuation_{};
+    bool                    detached_{};
+
+    static void*
+    operator new(std::size_t size) noexcept
+    {
+        return frame_arena::allocate_frame(size);
+    }
+
+    static void
+    operator delete(void* frame) noexcept
+    {
+        frame_arena::deallocate_frame(frame);
+    }
+
+    /**
+     * @brief Resumes the awaiting coroutine, a detached one frees its frame instead
+     */
+    struct final_awaiter {
+        [[nodiscard]] bool
+        await_ready() const noexcept
+        {
+            return false;
+        }
+
+        template <class Promise>
+        std::coroutine_handle<>
+        await_suspend(std::coroutine_handle<Promise> handle) noexcept
+        {
+            auto& promise = handle.promise();
+            if (promise.continuation_) {
+                return promise.continuation_;
+            }
+            if (promise.detached_) {
+                handle.destroy();
+            }
+            return std::noop_coroutine();
+        }
+
+        void
+        await_resume() const noexcept
+        {}
+    };
+
+    std::suspend_always
+    initial_suspend() const noexcept
+    {
+        return {};
+    }
+
+    final_awaiter
+    final_suspend() const noexcept
+    {
+        return {};
+    }
+
+    [[noreturn]] void
+    unhandled_exception() const noexcept
+    {
+        std::terminate();
+    }
+};
+
+template <class T>
+struct promise_value {
+    T value_{};
+
+    void
+    return_value(T value) noexcept
+    {
+        value_ = std::move(value);
+    }
+};
+
+template <>
+struct promise_value<void> {
+    void
+    return_void() const noexcept
+    {}
+};
+
+}    // namespace detail
+
+/**
+ * @brief A lazily started coroutine returning `T`
+ *
+ * The body runs when the task is awaited, or when an executor spawns it; the awaiting coroutine is resumed as soon as
+ * the task returns. Frames come from the frame_arena current on the thread, see executor. An exception leaving the
+ * body terminates, as everywhere in the library errors are returned.
+ *
+ * @tparam T The result type.
+ */
+template <class T = void>
+class [[nodiscard]] task {
+public:
+    struct promise_type : detail::promise_base, detail::promise_value<T> {
+        task
+        get_return_object() noexcept
+        {
+            return task{std::coroutine_handle<promise_type>::from_promise(*this)};
+        }
+
+        static task
+        get_return_object_on_allocation_failure() noexcept
+        {
+            return task{};
+        }
+    };
+
+    using handle_type = std::coroutine_handle<promise_type>;
+
+    task() noexcept = default;
+
+    task(task&& other) noexcept : handle_{std::exchange(other.handle_, {})} {}
+
+    task&
+    operator=(task&& other) noexcept
+    {
+        if (this != &other) {
+            destroy();
+            handle_ = std::exchange(other.handle_, {});
+        }
+        return *this;
+    }
+
+    ~task() noexcept { destroy(); }
+
+    /**
+     * @brief Returns false if the frame could not be allocated
+     */
+    [[nodiscard]] inline bool
+    valid() const noexcept
+    {
+        return static_cast<bool>(handle_);
+    }
+
+    [[nodiscard]] inline bool
+    done() const noexcept
+    {
+        return !handle_ || handle_.done();
+    }
+
+    /**
+     * @brief Gives up the frame, it is freed when the coroutine returns
+     */
+    handle_type
+    release() noexcept
+    {
+        if (handle_) {
+            handle_.promise().detached_ = true;
+        }
+        return std::exchange(handle_, {});
+    }
+
+    auto
+    operator co_await() && noexcept
+    {
+        struct awaiter {
+            handle_type handle_;
+
+            [[nodiscard]] bool
+            await_ready() const noexcept
+            {
+                return !handle_ || handle_.done();
+            }
+
+            std::coroutine_handle<>
+            await_suspend(std::coroutine_handle<> caller) noexcept
+            {
+                handle_.promise().continuation_ = caller;
+                return handle_;
+            }
+
+            T
+            await_resume() noexcept
+            {
+                if constexpr (!std::is_void_v<T>) {
+                    return handle_ ? std::move(handle_.promise().value_) : T{};
+                }
+            }
+        };
+        return awaiter{handle_};
+    }
+
+private:
+    handle_type handle_{};
+
+    explicit task(handle_type handle) noexcept : handle_{handle} {}
+
+    void
+    destroy() noexcept
+    {
+        if (handle_) {
+            std::exchange(handle_, {}).destroy();
+        }
+    }
+};
+
+/**
+ * @brief A single threaded executor of the coroutines driving a master
+ *
+ * Replies and timeouts complete the awaited commands from inside the master, in receive() and timer_expired(), while
+ * its state machine is halfway through the transaction. The executor defers the coroutines to run(), after the master
+ * has returned, so a coroutine may issue its next command right away. It owns the frame pool and makes it current for
+ * the thread for its lifetime: construct it before the coroutines, on the thread running them, and keep it until they
+ * have returned.
+ *
+ * @tparam Ready The number of coroutines that may be waiting to be resumed.
+ * @tparam FrameSize The size of a frame block, in bytes. A frame awaiting a command holds the command and its message
+ * buffer, about half a kilobyte.
+ * @tparam Frames The number of frame blocks.
+ */
+template <std::size_t Ready = 16, std::size_t FrameSize = 1024, std::size_t Frames = 16>
+class executor {
+public:
+    using queue_type = containers::circular_buffer<std::coroutine_handle<>, Ready>;
+
+    executor() noexcept : previous_{std::exchange(frame_arena::current(), &frames_.arena())} {}
+
+    executor(executor const&) = delete;
+    executor&
+    operator=(executor const&)
+        = delete;
+
+    ~executor() noexcept
+    {
+        if (frame_arena::current() == &frames_.arena()) {
+            frame_arena::current() = previous_;
+        }
+    }
+
+    /**
+     * @brief Schedules a suspended coroutine to be resumed by run()
+     *
+     * @return false If every place of the queue is taken or reserved
+     */
+    bool
+    post(std::coroutine_handle<> handle) noexcept
+    {
+        if ((ready_.size() + reserved_) >= Ready) [[unlikely]] {
+            return false;
+        }
+        ready_.push(handle);
+        return true;
+    }
+
+    /**
+     * @brief Keeps a place of the queue for a coroutine that suspends now and is posted later by post_reserved()
+     *
+     * A coroutine is only suspended with its place reserved, so its resumption can not be lost to a full queue.
+     *
+     * @return false If every place of the queue is taken or reserved
+     */
+    bool
+    reserve() noexcept
+    {
+        if ((ready_.size() + reserved_) >= Ready) [[unlikely]] {
+            return false;
+        }
+        reserved_++;
+        return true;
+    }
+
+    /**
+     * @brief Gives back a place taken by reserve() that will not be used
+     */
+    void
+    unreserve() noexcept
+    {
+        reserved_--;
+    }
+
+    /**
+     * @brief Schedules a coroutine in the place reserved for it
+     */
+    void
+    post_reserved(std::coroutine_handle<> handle) noexcept
+    {
+        reserved_--;
+        ready_.push(handle);
+    }
+
+    /**
+     * @brief Starts a task on the next run(), the executor frees it when it returns
+     *
+     * @return false If the frame of the task could not be allocated or the queue is full, the task is destroyed
+     */
+    bool
+    spawn(task<void>&& work) noexcept
+    {
+        if (!work.valid()) [[unlikely]] {
+            return false;
+        }
+        auto const handle = work.release();
+        if (!post(handle)) [[unlikely]] {
+            handle.destroy();
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Resumes the scheduled coroutines, and the ones they schedule, until none is left
+     *
+     * @return The number of coroutines resumed
+     */
+    std::size_t
+    run() noexcept
+    {
+        std::size_t resumed{};
+        while (!ready_.empty()) {
+            auto const handle = ready_.front();
+            ready_.pop();
+            handle.resume();
+            resumed++;
+        }
+        return resumed;
+    }
+
+    [[nodiscard]] inline std::size_t
+    pending() const noexcept
+    {
+        return ready_.size();
+    }
+
+    /**
+     * @brief The number of suspended coroutines holding a place of the queue
+     */
+    [[nodiscard]] inline std::size_t
+    reserved() const noexcept
+    {
+        return reserved_;
+    }
+
+    [[nodiscard]] inline frame_arena&
+    frames() noexcept
+    {
+        return frames_.arena();
+    }
+
+private:
+    frame_pool<FrameSize, Frames> frames_{};
+    frame_arena*                  previous_;
+    queue_type                    ready_{};
+    std::size_t                   reserved_{};
+};
+
+/**
+ * @brief A request waiting in a slot of an awaitable_master
+ */
+class pending_request {
+public:
+    /**
+     * @brief Called once the request is done, after the callback of its command
+     *
+     * @param result The error of the reply, exception::gateway_target if it timed out.
+     */
+    virtual void
+    completed(exception result) noexcept
+        = 0;
+
+protected:
+    ~pending_request() = default;
+};
+
+/**
+ * @brief A master reporting the end of every awaited request to the awaitable waiting for it
+ *
+ * The callback of a command is not called for every outcome, e.g. most commands skip it on an exception reply; the
+ * completed() hook of the master is. Each slot keeps the request waiting in it, completed() hands it the result.
+ *
+ * @tparam Master The master to build on, e.g. `master`, `basic_master<mbap, 4>` or a static_master.
+ */
+template <class Master = modbus::master>
+class awaitable_master : public Master {
+public:
+    using Master::Master;
+    using Master::window;
+
+    /**
+     * @brief Sends a command, `request` is completed when it is done
+     *
+     * @return false If no slot is free or the request could not be sent, `request` is not completed then
+     */
+    bool
+    run_awaited(command const& in_data, pending_request& request) noexcept
+    {
+        auto const slot{this->free_slot()};
+        if (slot == window) [[unlikely]] {
+            return false;
+        }
+        waiters_[slot] = &request;
+        if (this->run_async(in_data)) [[likely]] {
+            return true;
+        }
+        // A request answered from inside send() is completed already
+        return std::exchange(waiters_[slot], nullptr) == nullptr;
+    }
+
+    void
+    completed(std::size_t slot, exception result) noexcept override
+    {
+        Master::completed(slot, result);
+        if (auto* request = std::exchange(waiters_[slot], nullptr); request != nullptr) {
+            request->completed(result);
+        }
+    }
+
+    /**
+     * @brief Resets the master, the awaited requests dropped complete with exception::slave_or_server_failure
+     */
+    void
+    reset() noexcept override
+    {
+        Master::reset();
+        for (auto& request : waiters_) {
+            if (auto* item = std::exchange(request, nullptr); item != nullptr) {
+                item->completed(exception::slave_or_server_failure);
+            }
+        }
+    }
+
+private:
+    std::array<pending_request*, window> waiters_{};
+};
+
+/**
+ * @brief The outcome of an awaited command
+ */
+struct reply {
+    exception     error{exception::no_error};
+    std::size_t   size{};       ///< The number of values copied to the output span
+    std::uint16_t address{};    ///< The address reported by read_log and read_identification
+
+    explicit
+    operator bool() const noexcept
+    {
+        return error == exception::no_error;
+    }
+};
+
+/**
+ * @brief Runs one command on the master and suspends the awaiting coroutine until it completes
+ *
+ * The command is built with a callback that copies the values of the reply to `out`, so it works with any
+ * `commands::*` type: the callback receives the error and, depending on the command, nothing, a range of values, or an
+ * address and a range. The awaitable_master reports the end of the request, which schedules the coroutine in the place
+ * of the executor queue reserved before it suspended. The awaitable lives in the frame of the coroutine while the
+ * command is in flight, it can not be moved.
+ *
+ * @tparam Client The client the command runs on.
+ * @tparam Command The command type.
+ * @tparam T The type of the values copied out of the reply.
+ */
+template <class Client, class Command, class T>
+class command_awaitable : public pending_request {
+public:
+    template <class... Args>
+    command_awaitable(Client& client, std::span<T> out, Args&&... args) noexcept
+        : client_{client},
+          out_{out},
+          command_(std::forward<Args>(args)...,
+                   [this](exception error, auto... data) noexcept { values(error, data...); })
+    {}
+
+    command_awaitable(command_awaitable const&) = delete;
+    command_awaitable&
+    operator=(command_awaitable const&)
+        = delete;
+
+    /**
+     * @brief A command rejected on construction, e.g. for its size, completes without being sent
+     */
+    [[nodiscard]] bool
+    await_ready() noexcept
+    {
+        reply_.error = command_.error();
+        return reply_.error != exception::no_error;
+    }
+
+    /**
+     * @brief Sends the command, the coroutine goes on at once with slave_or_server_busy if the executor queue or the
+     * window of the master is full
+     */
+    bool
+    await_suspend(std::coroutine_handle<> caller) noexcept
+    {
+        auto& loop = client_.executor();
+        if (!loop.reserve()) [[unlikely]] {
+            reply_.error = exception::slave_or_server_busy;
+            return false;
+        }
+        caller_ = caller;
+        if (!client_.master().run_awaited(command_, *this)) [[unlikely]] {
+            loop.unreserve();
+            reply_.error = exception::slave_or_server_busy;
+            return false;
+        }
+        return true;
+    }
+
+    [[nodiscard]] reply
+    await_resume() const noexcept
+    {
+        return reply_;
+    }
+
+    void
+    completed(exception result) noexcept override
+    {
+        reply_.error = result;
+        client_.executor().post_reserved(caller_);
+    }
+
+private:
+    Client&                 client_;
+    std::span<T>            out_;
+    Command                 command_;
+    std::coroutine_handle<> caller_{};
+    reply                   reply_{};
+
+    template <class... Data>
+    void
+    values(exception error, Data... data) noexcept
+    {
+        if constexpr (sizeof...(Data) > 0) {
+            std::tuple const values{data...};
+            if constexpr (sizeof...(Data) == 3) {
+                reply_.address = std::get<0>(values);
+            }
+            auto const begin = std::get<sizeof...(Data) - 2>(values);
+            auto const end   = std::get<sizeof...(Data) - 1>(values);
+            if ((error == exception::no_error) && (begin != nullptr)) {
+                reply_.size = std::min(static_cast<std::size_t>(end - begin), out_.size());
+                std::copy_n(begin, reply_.size, out_.begin());
+            }
+        }
+    }
+};
+
+/**
+ * @brief The master of a bus driven by coroutines
+ *
+ * Every `commands::*` type can be awaited: command() for the ones only reporting an error, read() for the ones
+ * returning values, copied to the given span.
+ * @code
+ * class my_master final : public coro::awaitable_master<> { ... };    // send(), timer_start(), timer_stop()
+ *
+ * coro::executor<>                        loop;
+ * coro::client<my_master, decltype(loop)> bus{master, loop};
+ *
+ * coro::task<> cycle(decltype(bus)& bus) {
+ *     std::array<std::uint16_t, 2> values{};
+ *     if (co_await bus.read<commands::read_registers>(std::span{values}, 0x11, 0, 2)) {
+ *         co_await bus.command<commands::write_register>(0x11, 2, values[0] + values[1]);
+ *     }
+ * }
+ *
+ * loop.spawn(cycle(bus));
+ * loop.run();
+ * // the transport and the reply timer call bus.receive() and bus.timer_expired()
+ * @endcode
+ * receive(), timer_expired() and slot_expired() forward to the master and run the executor, so the coroutines whose
+ * commands completed continue right after.
+ *
+ * @tparam Master The master type, an awaitable_master descendant.
+ * @tparam Executor The executor type.
+ */
+template <class Master, class Executor>
+class client {
+public:
+    client(Master& master, Executor& executor) noexcept : master_{&master}, executor_{&executor} {}
+
+    /**
+     * @brief Awaits a command whose reply carries no values, e.g. commands::write_register
+     */
+    template <class Command, class... Args>
+    [[nodiscard]] command_awaitable<client, Command, std::uint8_t>
+    command(Args&&... args) noexcept
+    {
+        return {*this, std::span<std::uint8_t>{}, std::forward<Args>(args)...};
+    }
+
+    /**
+     * @brief Awaits a command whose reply carries values, e.g. commands::read_registers, they are copied to `out`
+     */
+    template <class Command, class T, std::size_t Extent, class... Args>
+    [[nodiscard]] command_awaitable<client, Command, T>
+    read(std::span<T, Extent> out, Args&&... args) noexcept
+    {
+        return {*this, std::span<T>{out}, std::forward<Args>(args)...};
+    }
+
+    template <class InputIterator>
+    exception
+    receive(InputIterator begin, InputIterator end) noexcept
+    {
+        auto const result = master_->receive(begin, end);
+        executor_->run();
+        return result;
+    }
+
+    void
+    timer_expired() noexcept
+    {
+        master_->timer_expired();
+        executor_->run();
+    }
+
+    void
+    slot_expired(std::size_t slot) noexcept
+    {
+        master_->slot_expired(slot);
+        executor_->run();
+    }
+
+    [[nodiscard]] inline Master&
+    master() const noexcept
+    {
+        return *master_;
+    }
+
+    [[nodiscard]] inline Executor&
+    executor() const noexcept
+    {
+        return *executor_;
+    }
+
+private:
+    Master*   master_;
+    Executor* executor_;
+};
+
+}    // namespace xitren::modbus::coro
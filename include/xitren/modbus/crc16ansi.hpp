@@ -9,11 +9,14 @@ __ _(_) |_ _ _ ___ _ _
 
 #include <xitren/crc16.hpp>
 #include <xitren/func/data.hpp>
+#include <xitren/modbus/crc16ansi_engine.hpp>
 
 #include <array>
 #include <concepts>
 #include <cstdint>
 #include <cstring>
+#include <iterator>
+#include <type_traits>
 
 namespace xitren::modbus {
 
@@ -21,9 +24,60 @@ class crc16ansi {
 public:
     using value_type = func::lsb_t<std::uint16_t>;
 
+    /**
+     * @brief Incremental CRC-16 ANSI calculation, one byte or one chunk at a time
+     *
+     * Used to check a frame while it is being received: the CRC of a frame followed by its own (LSB first) checksum is
+     * always zero, so a frame is complete and intact as soon as the running value drops to zero on its last byte.
+     */
+    class accumulator {
+    public:
+        constexpr void
+        reset() noexcept
+        {
+            crc_ = crc16_engine::initial;
+        }
+
+        constexpr void
+        update(std::uint8_t byte) noexcept
+        {
+            crc_ = crc16_engine::update_table(crc_, byte);
+        }
+
+        inline void
+        update(std::uint8_t const* data, std::size_t size) noexcept
+        {
+            crc_ = crc16_engine::update_slice8(crc_, data, size);
+        }
+
+        /**
+         * @brief The CRC of the bytes fed so far
+         */
+        [[nodiscard]] constexpr value_type
+        value() const noexcept
+        {
+            return value_type{crc_};
+        }
+
+        /**
+         * @brief Checks if the bytes fed so far end with their own valid checksum
+         */
+        [[nodiscard]] constexpr bool
+        complete() const noexcept
+        {
+            return crc_ == 0;
+        }
+
+    private:
+        std::uint16_t crc_{crc16_engine::initial};
+    };
+
     /**
      * @brief Calculates the CRC-16 ANSI checksum
      *
+     * Contiguous buffers are handed to the fastest engine of crc16_engine at run time, constant evaluation and other
+     * iterators take the portable byte-wise path.
+     *
      * @tparam InputIterator An input iterator that points to a sequence of bytes
      * @param begin An iterator to the first element in the sequence
      * @param end An iterator to one past the last element in the sequence
@@ -34,6 +88,12 @@ public:
     calculate(InputIterator begin, InputIterator end) noexcept
     {
         static_assert(sizeof(*begin) == sizeof(std::uint8_t));
+        if constexpr (std::contiguous_iterator<InputIterator>) {
+            if (!std::is_constant_evaluated()) {
+                return crc16_engine::calculate(reinterpret_cast<std::uint8_t const*>(std::to_address(begin)),
+                                               static_cast<std::size_t>(end - begin));
+            }
+        }
         return crc::crc16::calculate(begin, end);
     }
 
@@ -0,0 +1,275 @@
+/*!
+_ _
+__ _(_) |_ _ _ ___ _ _
+\ \ / |  _| '_/ -_) ' \
+/_\_\_|\__|_| \___|_||_|
+* @date 15.02.2024
+*/
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#    include <immintrin.h>
+#    define XITREN_MODBUS_CRC_CLMUL 1
+#elif defined(__aarch64__) && (defined(__ARM_FEATURE_CRYPTO) || defined(__ARM_FEATURE_AES))
+#    include <arm_neon.h>
+#    define XITREN_MODBUS_CRC_PMULL 1
+#endif
+
+/**
+ * @brief Run time engines of the CRC-16 ANSI (Modbus) checksum
+ *
+ * All engines compute the reflected CRC with the polynomial 0x8005 and the initial value 0xFFFF over a contiguous
+ * buffer and give identical results:
+ * - `bitwise` is the reference, one bit per step;
+ * - `slice4` and `slice8` consume 4 and 8 bytes per step with 4 and 8 lookup tables;
+ * - `clmul` (x86 PCLMULQDQ) and `pmull` (ARMv8 PMULL) fold 16 bytes per step with carry-less multiplications and
+ *   finish the last 16 folded bytes and the tail with `slice8`.
+ *
+ * `calculate` calls the fastest engine the CPU supports, it is selected once at start-up.
+ */
+namespace xitren::modbus::crc16_engine {
+
+using engine_type = std::uint16_t (*)(std::uint8_t const*, std::size_t) noexcept;
+
+inline constexpr std::uint16_t polynomial = 0xA001;    // 0x8005 reflected
+inline constexpr std::uint16_t initial    = 0xFFFF;
+
+/**
+ * @brief Frames shorter than this are not worth the folding set-up
+ */
+inline constexpr std::size_t fold_threshold = 32;
+
+/**
+ * @brief Updates a CRC with one byte, bit by bit
+ */
+constexpr std::uint16_t
+update_bitwise(std::uint16_t crc, std::uint8_t byte) noexcept
+{
+    crc ^= byte;
+    for (int bit{}; bit < 8; bit++) {
+        crc = (crc & 1U) ? static_cast<std::uint16_t>((crc >> 1U) ^ polynomial) : static_cast<std::uint16_t>(crc >> 1U);
+    }
+    return crc;
+}
+
+/**
+ * @brief Lookup tables: tables[0] is the classic byte table, tables[k] advances a byte by k more zero bytes
+ */
+inline constexpr auto tables = [] {
+    std::array<std::array<std::uint16_t, 256>, 8> result{};
+    for (std::size_t byte{}; byte < 256; byte++) {
+        result[0][byte] = update_bitwise(0, static_cast<std::uint8_t>(byte));
+    }
+    for (std::size_t k{1}; k < result.size(); k++) {
+        for (std::size_t byte{}; byte < 256; byte++) {
+            auto const previous = result[k - 1][byte];
+            result[k][byte] = static_cast<std::uint16_t>((previous >> 8U) ^ result[0][previous & 0xFFU]);
+        }
+    }
+    return result;
+}();
+
+constexpr std::uint16_t
+update_table(std::uint16_t crc, std::uint8_t byte) noexcept
+{
+    return static_cast<std::uint16_t>((crc >> 8U) ^ tables[0][(crc ^ byte) & 0xFFU]);
+}
+
+constexpr std::uint16_t
+update_bitwise(std::uint16_t crc, std::uint8_t const* data, std::size_t size) noexcept
+{
+    for (std::size_t i{}; i < size; i++) {
+        crc = update_bitwise(crc, data[i]);
+    }
+    return crc;
+}
+
+inline std::uint16_t
+update_slice4(std::uint16_t crc, std::uint8_t const* data, std::size_t size) noexcept
+{
+    for (; size >= 4; size -= 4, data += 4) {
+        crc ^= static_cast<std::uint16_t>(data[0] | (data[1] << 8U));
+        crc = tables[3][crc & 0xFFU] ^ tables[2][crc >> 8U] ^ tables[1][data[2]] ^ tables[0][data[3]];
+    }
+    for (; size > 0; size--, data++) {
+        crc = update_table(crc, *data);
+    }
+    return crc;
+}
+
+inline std::uint16_t
+update_slice8(std::uint16_t crc, std::uint8_t const* data, std::size_t size) noexcept
+{
+    for (; size >= 8; size -= 8, data += 8) {
+        crc ^= static_cast<std::uint16_t>(data[0] | (data[1] << 8U));
+        crc = tables[7][crc & 0xFFU] ^ tables[6][crc >> 8U] ^ tables[5][data[2]] ^ tables[4][data[3]]
+              ^ tables[3][data[4]] ^ tables[2][data[5]] ^ tables[1][data[6]] ^ tables[0][data[7]];
+    }
+    for (; size > 0; size--, data++) {
+        crc = update_table(crc, *data);
+    }
+    return crc;
+}
+
+inline std::uint16_t
+bitwise(std::uint8_t const* data, std::size_t size) noexcept
+{
+    return update_bitwise(initial, data, size);
+}
+
+inline std::uint16_t
+slice4(std::uint8_t const* data, std::size_t size) noexcept
+{
+    return update_slice4(initial, data, size);
+}
+
+inline std::uint16_t
+slice8(std::uint8_t const* data, std::size_t size) noexcept
+{
+    return update_slice8(initial, data, size);
+}
+
+/**
+ * @brief Folding constants
+ *
+ * A 16-byte block A followed by 128 more bits is replaced by A * x^128 mod P. The first 8 bytes (A_H) are multiplied
+ * by x^192 mod P and the last 8 (A_L) by x^128 mod P. In the reflected bit order the carry-less product comes out one
+ * bit short, so the constants are x^191 mod P and x^127 mod P, stored bit-reversed in 64 bits.
+ */
+namespace fold {
+
+constexpr std::uint16_t
+x_pow_mod(std::size_t power) noexcept
+{
+    // Normal (not reflected) representation, 0x8005 is P without its x^16 term
+    std::uint32_t value{1};
+    for (std::size_t i{}; i < power; i++) {
+        value <<= 1U;
+        if (value & 0x10000U) {
+            value ^= 0x18005U;
+        }
+    }
+    return static_cast<std::uint16_t>(value);
+}
+
+constexpr std::uint64_t
+reflect64(std::uint16_t value) noexcept
+{
+    std::uint64_t result{};
+    for (unsigned bit{}; bit < 16; bit++) {
+        if (value & (1U << bit)) {
+            result |= std::uint64_t{1} << (63U - bit);
+        }
+    }
+    return result;
+}
+
+inline constexpr std::uint64_t k_high = reflect64(x_pow_mod(191));
+inline constexpr std::uint64_t k_low  = reflect64(x_pow_mod(127));
+
+/**
+ * @brief Finishes a folded block and the tail with the table engine
+ */
+inline std::uint16_t
+finish(std::array<std::uint8_t, 16> const& block, std::uint8_t const* data, std::size_t size) noexcept
+{
+    return update_slice8(update_slice8(0, block.data(), block.size()), data, size);
+}
+
+}    // namespace fold
+
+#if defined(XITREN_MODBUS_CRC_CLMUL)
+__attribute__((target("pclmul,sse2"))) inline std::uint16_t
+clmul(std::uint8_t const* data, std::size_t size) noexcept
+{
+    if (size < fold_threshold) {
+        return slice8(data, size);
+    }
+    __m128i const k{_mm_set_epi64x(static_cast<long long>(fold::k_low), static_cast<long long>(fold::k_high))};
+    // The initial value of a reflected CRC is the same as the first bytes of the message inverted
+    __m128i acc{_mm_xor_si128(_mm_loadu_si128(reinterpret_cast<__m128i const*>(data)), _mm_cvtsi32_si128(initial))};
+    data += 16;
+    size -= 16;
+    for (; size >= 16; size -= 16, data += 16) {
+        __m128i const high{_mm_clmulepi64_si128(acc, k, 0x00)};
+        __m128i const low{_mm_clmulepi64_si128(acc, k, 0x11)};
+        acc = _mm_xor_si128(_mm_xor_si128(high, low), _mm_loadu_si128(reinterpret_cast<__m128i const*>(data)));
+    }
+    std::array<std::uint8_t, 16> block{};
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(block.data()), acc);
+    return fold::finish(block, data, size);
+}
+
+inline bool
+clmul_supported() noexcept
+{
+    return __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse2");
+}
+#endif
+
+#if defined(XITREN_MODBUS_CRC_PMULL)
+inline std::uint16_t
+pmull(std::uint8_t const* data, std::size_t size) noexcept
+{
+    if (size < fold_threshold) {
+        return slice8(data, size);
+    }
+    poly64_t const k_high{fold::k_high};
+    poly64_t const k_low{fold::k_low};
+    uint8x16_t     acc{vld1q_u8(data)};
+    acc = veorq_u8(acc, vreinterpretq_u8_u64(vcombine_u64(vcreate_u64(initial), vcreate_u64(0))));
+    data += 16;
+    size -= 16;
+    for (; size >= 16; size -= 16, data += 16) {
+        uint64x2_t const lanes{vreinterpretq_u64_u8(acc)};
+        poly128_t const  high{vmull_p64(static_cast<poly64_t>(vgetq_lane_u64(lanes, 0)), k_high)};
+        poly128_t const  low{vmull_p64(static_cast<poly64_t>(vgetq_lane_u64(lanes, 1)), k_low)};
+        uint8x16_t const folded{veorq_u8(vreinterpretq_u8_p128(high), vreinterpretq_u8_p128(low))};
+        acc = veorq_u8(folded, vld1q_u8(data));
+    }
+    std::array<std::uint8_t, 16> block{};
+    vst1q_u8(block.data(), acc);
+    return fold::finish(block, data, size);
+}
+#endif
+
+/**
+ * @brief Picks the fastest engine the CPU supports
+ */
+inline engine_type
+select() noexcept
+{
+#if defined(XITREN_MODBUS_CRC_CLMUL)
+    if (clmul_supported()) {
+        return &clmul;
+    }
+#elif defined(XITREN_MODBUS_CRC_PMULL)
+    return &pmull;
+#endif
+    return &slice8;
+}
+
+/**
+ * @brief The engine selected for this CPU
+ */
+inline engine_type const selected = select();
+
+/**
+ * @brief Calculates the CRC of a contiguous buffer with the selected engine
+ */
+inline std::uint16_t
+calculate(std::uint8_t const* data, std::size_t size) noexcept
+{
+    if (selected == nullptr) [[unlikely]] {
+        // Called during static initialization, before the selection
+        return select()(data, size);
+    }
+    return selected(data, size);
+}
+
+}    // namespace xitren::modbus::crc16_engine
@@ -0,0 +1,246 @@
+/*!
+_ _
+__ _(_) |_ _ _ ___ _ _
+\ \ / |  _| '_/ -_) ' \
+/_\_\_|\__|_| \___|_||_|
+* @date 15.02.2024
+*/
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+
+namespace xitren::modbus {
+
+/**
+ * @brief Tracks which elements of an image changed since the last checkpoint
+ *
+ * One bit per element in 64-bit words and a generation counter that counts the changing writes. Marking takes a
+ * 64-bit mask of changed elements at any offset; the dirty elements are walked as ranges of consecutive elements, a
+ * word at a time with `countr_zero`, so a checkpoint costs O(changes + words) and not O(image size) of element
+ * compares.
+ *
+ * @tparam Size The number of elements.
+ */
+template <std::size_t Size>
+class dirty_bits {
+public:
+    using word_type = std::uint64_t;
+    using size_type = std::size_t;
+
+    static constexpr size_type word_bits = 64;
+    static constexpr size_type words     = (Size + word_bits - 1) / word_bits;
+
+    /**
+     * @brief Consecutive dirty elements [start, start + count)
+     */
+    struct range {
+        size_type start;
+        size_type count;
+
+        constexpr bool
+        operator==(range const&) const noexcept
+            = default;
+    };
+
+    /**
+     * @brief Walks the dirty ranges in ascending order
+     */
+    class range_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = range;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = range const*;
+        using reference         = range const&;
+
+        constexpr range_iterator() noexcept = default;
+
+        constexpr range_iterator(dirty_bits const& bits, size_type from) noexcept : bits_{&bits} { seek(from); }
+
+        constexpr reference
+        operator*() const noexcept
+        {
+            return current_;
+        }
+
+        constexpr pointer
+        operator->() const noexcept
+        {
+            return &current_;
+        }
+
+        constexpr range_iterator&
+        operator++() noexcept
+        {
+            seek(current_.start + current_.count);
+            return *this;
+        }
+
+        constexpr range_iterator
+        operator++(int) noexcept
+        {
+            auto result{*this};
+            ++(*this);
+            return result;
+        }
+
+        constexpr bool
+        operator==(range_iterator const& other) const noexcept
+        {
+            return current_ == other.current_;
+        }
+
+        constexpr bool
+        operator==(std::default_sentinel_t) const noexcept
+        {
+            return current_.start == Size;
+        }
+
+    private:
+        dirty_bits const* bits_{};
+        range             current_{Size, 0};
+
+        constexpr void
+        seek(size_type from) noexcept
+        {
+            auto const start = bits_->find(from, true);
+            current_         = {start, bits_->find(start, false) - start};
+        }
+    };
+
+    [[nodiscard]] constexpr size_type
+    size() const noexcept
+    {
+        return Size;
+    }
+
+    /**
+     * @brief The number of changing writes marked since the creation, it is not reset by clear()
+     */
+    [[nodiscard]] constexpr std::uint32_t
+    generation() const noexcept
+    {
+        return generation_;
+    }
+
+    /**
+     * @brief Marks the elements `start + i` for every bit i set in `mask`, commit() closes the write
+     */
+    constexpr void
+    mark(size_type start, word_type mask) noexcept
+    {
+        auto const index = start / word_bits;
+        auto const shift = start % word_bits;
+        words_[index] |= mask << shift;
+        if ((shift != 0) && (index + 1 < words)) {
+            words_[index + 1] |= mask >> (word_bits - shift);
+        }
+        any_ = true;
+    }
+
+    /**
+     * @brief Marks the elements [start, start + count)
+     */
+    constexpr void
+    mark_range(size_type start, size_type count) noexcept
+    {
+        for (; count > 0; start += word_bits) {
+            auto const bits = (count < word_bits) ? count : word_bits;
+            mark(start, (bits < word_bits) ? ((word_type{1} << bits) - 1) : ~word_type{});
+            count -= bits;
+        }
+    }
+
+    /**
+     * @brief Closes a write: the generation advances if it marked anything
+     */
+    constexpr void
+    commit() noexcept
+    {
+        if (any_) {
+            generation_++;
+            any_ = false;
+        }
+    }
+
+    [[nodiscard]] constexpr bool
+    test(size_type index) const noexcept
+    {
+        return (words_[index / word_bits] >> (index % word_bits)) & 1U;
+    }
+
+    /**
+     * @brief Any element is dirty
+     */
+    [[nodiscard]] constexpr bool
+    dirty() const noexcept
+    {
+        for (auto const word : words_) {
+            if (word != 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * @brief Forgets the dirty elements, e.g. after a checkpoint
+     */
+    constexpr void
+    clear() noexcept
+    {
+        words_.fill(0);
+    }
+
+    [[nodiscard]] constexpr range_iterator
+    begin() const noexcept
+    {
+        return {*this, 0};
+    }
+
+    [[nodiscard]] constexpr std::default_sentinel_t
+    end() const noexcept
+    {
+        return {};
+    }
+
+    /**
+     * @brief The first element from `from` with the given state, `Size` if there is none
+     */
+    [[nodiscard]] constexpr size_type
+    find(size_type from, bool dirty) const noexcept
+    {
+        if (from >= Size) {
+            return Size;
+        }
+        auto      index = from / word_bits;
+        word_type word  = (dirty ? words_[index] : ~words_[index]) >> (from % word_bits);
+        if (word != 0) {
+            return clamp(from + static_cast<size_type>(std::countr_zero(word)));
+        }
+        for (index++; index < words; index++) {
+            word = dirty ? words_[index] : ~words_[index];
+            if (word != 0) {
+                return clamp(index * word_bits + static_cast<size_type>(std::countr_zero(word)));
+            }
+        }
+        return Size;
+    }
+
+private:
+    std::array<word_type, words> words_{};
+    std::uint32_t                generation_{};
+    bool                         any_{};
+
+    static constexpr size_type
+    clamp(size_type index) noexcept
+    {
+        return (index < Size) ? index : Size;
+    }
+};
+
+}    // namespace xitren::modbus
@@ -0,0 +1,445 @@
+/*!
+_ _
+__ _(_) |_ _ _ ___ _ _
+\ \ / |  _| '_/ -_) ' \
+/_\_\_|\__|_| \___|_||_|
+* @date 15.02.2024
+*/
+#pragma once
+
+#include <xitren/func/data.hpp>
+#include <xitren/modbus/crc16ansi.hpp>
+
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstdint>
+#include <type_traits>
+
+namespace xitren::modbus {
+
+template <typename Header, typename Fields, crc::crc_concept Crc>
+union packet;
+
+/**
+ * @brief Concept describing an ADU framing policy
+ *
+ * A framing policy tells the packet accessors and the protocol state machines how a PDU (slave/unit id, function code
+ * and data) is wrapped on the wire: how many bytes precede it, how many bytes follow it and how the frame is sealed and
+ * validated. Policies are stateless and all of their members are static.
+ */
+template <class T>
+concept framing_policy = requires(std::uint8_t* it, std::uint8_t const* cit, std::uint16_t id) {
+    {
+        T::prefix_length
+    } -> std::convertible_to<std::size_t>;
+    {
+        T::suffix_length
+    } -> std::convertible_to<std::size_t>;
+    {
+        T::max_adu_length
+    } -> std::convertible_to<std::uint16_t>;
+    {
+        T::min_adu_length
+    } -> std::convertible_to<std::uint16_t>;
+    {
+        T::broadcast
+    } -> std::convertible_to<bool>;
+    {
+        T::pipelining
+    } -> std::convertible_to<bool>;
+    {
+        T::seal(it, it)
+    } -> std::same_as<std::uint8_t*>;
+    {
+        T::valid(cit, cit)
+    } -> std::same_as<bool>;
+    {
+        T::transaction(cit)
+    } -> std::same_as<std::uint16_t>;
+    T::transaction(it, id);
+    T::reply(cit, it);
+    typename T::stream;
+    requires requires(typename T::stream s, std::uint8_t byte) {
+        s.reset();
+        s.update(byte);
+        {
+            s.valid(cit, cit)
+        } -> std::same_as<bool>;
+    };
+};
+
+/**
+ * @brief Checks for a checksum that can be calculated incrementally, see crc16ansi::accumulator
+ */
+template <class Crc>
+concept incremental_crc = requires(typename Crc::accumulator acc, std::uint8_t byte) {
+    acc.reset();
+    acc.update(byte);
+    {
+        acc.complete()
+    } -> std::convertible_to<bool>;
+};
+
+/**
+ * @brief The running state of an incremental checksum, empty for the other ones
+ */
+template <class Crc>
+struct accumulator_of {
+    struct type {};
+};
+
+template <incremental_crc Crc>
+struct accumulator_of<Crc> {
+    using type = typename Crc::accumulator;
+};
+
+/**
+ * @brief Serial line framing: the PDU followed by a checksum
+ *
+ * This is the Modbus RTU ADU. Nothing precedes the slave id, the frame is closed by the checksum calculated by `Crc`
+ * over everything before it. There are no transaction identifiers on a serial line, so only one request may be in
+ * flight.
+ *
+ * @tparam Crc The checksum algorithm, see crc16ansi.
+ */
+template <crc::crc_concept Crc>
+class crc_framing {
+public:
+    using crc_type = Crc;
+
+    static constexpr std::size_t   prefix_length  = 0;
+    static constexpr std::size_t   suffix_length  = sizeof(typename Crc::value_type);
+    static constexpr std::uint16_t max_adu_length = 256;
+    static constexpr std::uint16_t min_adu_length = 3;
+    static constexpr bool          broadcast      = true;
+    static constexpr bool          pipelining     = false;
+
+    template <typename Header, typename Fields>
+    using packet_type = packet<Header, Fields, Crc>;
+
+    /**
+     * @brief Closes the frame by appending the checksum
+     *
+     * @param begin Iterator to the first byte of the frame
+     * @param body_end Iterator past the last byte of the PDU
+     * @return Iterator past the last byte of the sealed frame
+     */
+    template <class Iterator>
+    static constexpr Iterator
+    seal(Iterator begin, Iterator body_end) noexcept
+    {
+        typename Crc::value_type const crc{Crc::calculate(begin, body_end)};
+        func::data<typename Crc::value_type>::serialize(crc, body_end);
+        return body_end + suffix_length;
+    }
+
+    /**
+     * @brief Checks the checksum of a complete frame
+     *
+     * @param begin Iterator to the first byte of the frame
+     * @param end Iterator past the last byte of the frame
+     * @return true If the stored checksum matches the calculated one
+     */
+    template <class Iterator>
+    static constexpr bool
+    valid(Iterator begin, Iterator end) noexcept
+    {
+        auto const crc_ptr        = end - suffix_length;
+        auto const crc            = func::data<typename Crc::value_type>::deserialize(crc_ptr);
+        auto const crc_calculated = Crc::calculate(begin, crc_ptr);
+        return crc.get() == crc_calculated.get();
+    }
+
+    template <class Iterator>
+    static constexpr std::uint16_t
+    transaction(Iterator) noexcept
+    {
+        return 0;
+    }
+
+    template <class Iterator>
+    static constexpr void
+    transaction(Iterator, std::uint16_t) noexcept
+    {}
+
+    template <class InputIterator, class OutputIterator>
+    static constexpr void
+    reply(InputIterator, OutputIterator) noexcept
+    {}
+
+    static constexpr bool
+    any_unit(std::uint8_t) noexcept
+    {
+        return false;
+    }
+
+    /**
+     * @brief Checks a frame while it is being received byte by byte
+     *
+     * With an incremental checksum every byte updates the running CRC as it lands and validation of the complete frame
+     * costs nothing. Other checksums are calculated over the whole frame once it is complete.
+     */
+    class stream {
+    public:
+        constexpr void
+        reset() noexcept
+        {
+            if constexpr (incremental_crc<Crc>) {
+                crc_.reset();
+            }
+        }
+
+        constexpr void
+        update([[maybe_unused]] std::uint8_t byte) noexcept
+        {
+            if constexpr (incremental_crc<Crc>) {
+                crc_.update(byte);
+            }
+        }
+
+        /**
+         * @brief Checks the frame made of the bytes fed since the last reset
+         *
+         * @param begin Iterator to the first byte of the frame
+         * @param end Iterator past the last byte of the frame
+         * @return true If the stored checksum matches the calculated one
+         */
+        template <class Iterator>
+        [[nodiscard]] constexpr bool
+        valid([[maybe_unused]] Iterator begin, [[maybe_unused]] Iterator end) const noexcept
+        {
+            if constexpr (incremental_crc<Crc>) {
+                return crc_.complete();
+            } else {
+                return crc_framing::valid(begin, end);
+            }
+        }
+
+    private:
+        [[no_unique_address]] typename accumulator_of<Crc>::type crc_{};
+    };
+};
+
+/**
+ * @brief Modbus RTU framing with the CRC-16 ANSI checksum
+ */
+using rtu = crc_framing<crc16ansi>;
+
+/*!
+ * @brief The MBAP prefix of a Modbus TCP ADU, without the unit identifier.
+ *
+ * @details The unit identifier that closes the 7-byte MBAP header takes the place of the slave id in `header`, so the
+ * rest of the PDU layout is shared with the serial line.
+ */
+struct __attribute__((__packed__)) mbap_prefix {
+    func::msb_t<std::uint16_t> transaction_id{}; /*!< Matches a reply to its request. */
+    func::msb_t<std::uint16_t> protocol_id{};    /*!< Always 0 for Modbus. */
+    func::msb_t<std::uint16_t> length{};         /*!< Number of following bytes, unit identifier included. */
+};
+
+/**
+ * @brief Modbus TCP framing: the MBAP header followed by the PDU, no checksum
+ *
+ * The stream transport already guarantees integrity, so nothing is calculated on the hot path: sealing writes the
+ * protocol id and the length field, validation compares them with the frame size. Replies carry the transaction id of
+ * their request, so a client may pipeline several requests.
+ */
+class mbap {
+public:
+    static constexpr std::size_t   prefix_length  = sizeof(mbap_prefix);
+    static constexpr std::size_t   suffix_length  = 0;
+    static constexpr std::uint16_t max_adu_length = 260;
+    static constexpr std::uint16_t min_adu_length = prefix_length + 2;
+    static constexpr bool          broadcast      = false;
+    static constexpr bool          pipelining     = true;
+    static constexpr std::uint16_t protocol_id    = 0;
+    static constexpr std::uint8_t  no_unit        = 0xff;
+
+    /**
+     * @brief The fixed part of a Modbus TCP request: MBAP prefix, header and fields
+     *
+     * @tparam Header The packet header type.
+     * @tparam Fields The packet fields type.
+     */
+    template <typename Header, typename Fields>
+    struct packet_type {
+        using size_type                   = std::size_t;
+        static constexpr size_type length = (prefix_length + sizeof(Header) + sizeof(Fields));
+        using struct_type                 = struct __attribute__((__packed__)) {
+            mbap_prefix prefix;
+            Header      header;
+            Fields      fields;
+        };
+        using array_type = std::array<std::uint8_t, sizeof(struct_type)>;
+
+        /**
+         * Serializes a packet into an array of bytes.
+         *
+         * @param transaction_id The MBAP transaction identifier.
+         * @param header The packet header.
+         * @param fields The packet fields.
+         * @return The serialized packet as an array of bytes.
+         */
+        static constexpr array_type
+        serialize(std::uint16_t transaction_id, Header const& header, Fields const& fields) noexcept
+        {
+            return func::data<struct_type>::serialize(
+                {{transaction_id, protocol_id, sizeof(Header) + sizeof(Fields)}, header, fields});
+        }
+    };
+
+    /**
+     * @brief Closes the frame by filling the protocol id and the length field
+     *
+     * The transaction id is left untouched, it is owned by the master that issues the request.
+     *
+     * @param begin Iterator to the first byte of the frame
+     * @param body_end Iterator past the last byte of the PDU
+     * @return Iterator past the last byte of the sealed frame
+     */
+    template <class Iterator>
+    static constexpr Iterator
+    seal(Iterator begin, Iterator body_end) noexcept
+    {
+        auto const length = static_cast<std::uint16_t>((body_end - begin) - prefix_length);
+        func::data<func::msb_t<std::uint16_t>>::serialize(func::msb_t<std::uint16_t>{protocol_id}, begin + 2);
+        func::data<func::msb_t<std::uint16_t>>::serialize(func::msb_t<std::uint16_t>{length}, begin + 4);
+        return body_end;
+    }
+
+    /**
+     * @brief Checks the protocol id and the length field of a complete frame
+     *
+     * @param begin Iterator to the first byte of the frame
+     * @param end Iterator past the last byte of the frame
+     * @return true If the frame is a well-formed Modbus TCP ADU
+     */
+    template <class Iterator>
+    static constexpr bool
+    valid(Iterator begin, Iterator end) noexcept
+    {
+        if (static_cast<std::size_t>(end - begin) < min_adu_length) [[unlikely]] {
+            return false;
+        }
+        auto const prefix = func::data<mbap_prefix>::deserialize(begin);
+        auto const length = static_cast<std::size_t>(end - begin) - prefix_length;
+        return (prefix.protocol_id.get() == protocol_id) && (static_cast<std::size_t>(prefix.length.get()) == length);
+    }
+
+    /**
+     * @brief Returns the full ADU length announced by the MBAP header
+     *
+     * Used to cut frames out of a byte stream: `begin` must point to at least `prefix_length` received bytes.
+     *
+     * @param begin Iterator to the first byte of the frame
+     * @return The number of bytes the complete frame occupies
+     */
+    template <class Iterator>
+    static constexpr std::size_t
+    expected_length(Iterator begin) noexcept
+    {
+        return prefix_length + func::data<func::msb_t<std::uint16_t>>::deserialize(begin + 4).get();
+    }
+
+    template <class Iterator>
+    static constexpr std::uint16_t
+    transaction(Iterator begin) noexcept
+    {
+        return func::data<func::msb_t<std::uint16_t>>::deserialize(begin).get();
+    }
+
+    template <class Iterator>
+    static constexpr void
+    transaction(Iterator begin, std::uint16_t id) noexcept
+    {
+        func::data<func::msb_t<std::uint16_t>>::serialize(func::msb_t<std::uint16_t>{id}, begin);
+    }
+
+    /**
+     * @brief Carries the transaction id and the unit identifier of a request over to its reply
+     *
+     * @param request Iterator to the first byte of the request frame
+     * @param reply Iterator to the first byte of the reply frame
+     */
+    template <class InputIterator, class OutputIterator>
+    static constexpr void
+    reply(InputIterator request, OutputIterator reply) noexcept
+    {
+        std::copy(request, request + 2, reply);
+        *(reply + prefix_length) = *(request + prefix_length);
+    }
+
+    /**
+     * @brief Checks for the unit identifier a server accepts regardless of its own id
+     *
+     * A TCP server is addressed by its IP, clients put 0xFF (or 0) into the unit identifier.
+     */
+    static constexpr bool
+    any_unit(std::uint8_t unit) noexcept
+    {
+        return unit == no_unit;
+    }
+
+    /**
+     * @brief Byte-wise reception, there is no checksum to accumulate and the header is checked once complete
+     */
+    class stream {
+    public:
+        constexpr void
+        reset() noexcept
+        {}
+
+        constexpr void
+        update(std::uint8_t) noexcept
+        {}
+
+        template <class Iterator>
+        [[nodiscard]] constexpr bool
+        valid(Iterator begin, Iterator end) const noexcept
+        {
+            return mbap::valid(begin, end);
+        }
+    };
+};
+
+/**
+ * @brief Maps the checksum or framing argument of the packet accessors onto a framing policy
+ *
+ * The accessors historically take the CRC type; a bare CRC means serial line framing with that checksum.
+ */
+template <class T>
+struct framing_of {
+    using type = crc_framing<T>;
+};
+
+template <framing_policy T>
+struct framing_of<T> {
+    using type = T;
+};
+
+template <class T>
+using framing_of_t = typename framing_of<T>::type;
+
+/**
+ * @brief Copies a frame from one framing into another
+ *
+ * The PDU is copied as is, the destination frame is sealed and gets the transaction id of the source, if both have one.
+ *
+ * @tparam From The framing of the source frame.
+ * @tparam To The framing of the destination frame.
+ * @param begin Iterator to the first byte of the source frame
+ * @param end Iterator past the last byte of the source frame
+ * @param out Iterator to the first byte of the destination, room for the PDU and the framing of `To` is required
+ * @return Iterator past the last byte of the destination frame
+ */
+template <framing_policy From, framing_policy To, class InputIterator, class OutputIterator>
+constexpr OutputIterator
+reframe(InputIterator begin, InputIterator end, OutputIterator out) noexcept
+{
+    auto const body_end = std::copy(begin + From::prefix_length, end - From::suffix_length, out + To::prefix_length);
+    To::transaction(out, From::transaction(begin));
+    return To::seal(out, body_end);
+}
+
+}    // namespace xitren::modbus
@@ -15,27 +15,24 @@ namespace xitren::modbus::functions {
 /**
  * @brief This function is used to process the request of the diagnostics.
  *
- * @tparam TInputs The input data type.
- * @tparam TCoils The coil data type.
- * @tparam TInputRegisters The input register data type.
- * @tparam THoldingRegisters The holding register data type.
- * @tparam Fifo The FIFO size.
+ * @tparam Slave The slave type, slave_base or a descendant the hooks are resolved on.
  * @param slave The reference to the Modbus slave object.
  * @param pack The input packet of the request.
  *
  * @return An exception object indicating the result of the operation.
  */
-template <typename TInputs, typename TCoils, typename TInputRegisters, typename THoldingRegisters, std::uint16_t Fifo>
+template <class Slave>
 exception
-diagnostics(slave_base<TInputs, TCoils, TInputRegisters, THoldingRegisters, Fifo>& slave)
+diagnostics(Slave& slave)
 {
-    using slave_type  = slave_base<TInputs, TCoils, TInputRegisters, THoldingRegisters, Fifo>;
-    using return_type = typename slave_type::msg_type::template fields_in<header, func::msb_t<std::uint16_t>,
+    using slave_type   = Slave;
+    using framing_type = typename slave_type::framing_type;
+    using return_type  = typename slave_type::msg_type::template fields_in<header, func::msb_t<std::uint16_t>,
                                                                           func::msb_t<std::uint16_t>>;
     //=========Check parameters=====================================================================
     auto pack = slave.input()
                     .template deserialize_no_check<header, func::msb_t<std::uint16_t>, func::msb_t<std::uint16_t>,
-                                                   crc16ansi>();
+                                                   framing_type>();
     //=========Request processing===================================================================
     switch (pack.fields->get()) {
     case static_cast<std::uint16_t>(diagnostics_sub_function::return_query_data):
@@ -44,8 +41,8 @@ diagnostics(slave_base<TInputs, TCoils, TInputRegisters, THoldingRegisters, Fifo
          *
          * @param slave The Modbus slave object.
          */
-        std::copy(slave.input().storage().begin(), slave.input().storage().begin() + slave.input().size(),
-                  slave.output().storage().begin());
+        std::copy(slave.input().storage().data(), slave.input().storage().data() + slave.input().size(),
+                  slave.output().storage().data());
         slave.output().size(slave.input().size());
         break;
     case static_cast<std::uint16_t>(diagnostics_sub_function::restart_comm_option):
@@ -67,7 +64,7 @@ diagnostics(slave_base<TInputs, TCoils, TInputRegisters, THoldingRegisters, Fifo
          */
         func::msb_t<std::uint16_t> val{slave.diagnostic_register()};
         return_type                data{{slave.id(), pack.header->function_code}, *(pack.fields), 1, &val};
-        slave.output().template serialize<header, func::msb_t<std::uint16_t>, func::msb_t<std::uint16_t>, crc16ansi>(
+        slave.output().template serialize<header, func::msb_t<std::uint16_t>, func::msb_t<std::uint16_t>, framing_type>(
             data);
     } break;
     case static_cast<std::uint16_t>(diagnostics_sub_function::force_listen_only_mode):
@@ -102,7 +99,7 @@ diagnostics(slave_base<TInputs, TCoils, TInputRegisters, THoldingRegisters, Fifo
          */
         func::msb_t<std::uint16_t> val{slave.get_counter(pack.fields->get())};
         return_type                data{{slave.id(), pack.header->function_code}, *(pack.fields), 1, &val};
-        slave.output().template serialize<header, func::msb_t<std::uint16_t>, func::msb_t<std::uint16_t>, crc16ansi>(
+        slave.output().template serialize<header, func::msb_t<std::uint16_t>, func::msb_t<std::uint16_t>, framing_type>(
             data);
     } break;
     default:
@@ -15,22 +15,20 @@ namespace xitren::modbus::functions {
 /**
  * @brief This function is used to respond to a request for device identification information.
  *
- * @tparam TInputs The input data type.
- * @tparam TCoils The coil data type.
- * @tparam TInputRegisters The input register data type.
- * @tparam THoldingRegisters The holding register data type.
- * @tparam Fifo The FIFO size.
+ * @tparam Slave The slave type, slave_base or a descendant the hooks are resolved on.
  * @param slave The Modbus slave object.
  * @return exception The exception code.
  */
-template <typename TInputs, typename TCoils, typename TInputRegisters, typename THoldingRegisters, std::uint16_t Fifo>
+template <class Slave>
 exception
-identification(slave_base<TInputs, TCoils, TInputRegisters, THoldingRegisters, Fifo>& slave)
+identification(Slave& slave)
 {
-    using slave_type  = slave_base<TInputs, TCoils, TInputRegisters, THoldingRegisters, Fifo>;
-    using return_type = typename slave_type::msg_type::template fields_in<header, response_identification, char>;
+    using slave_type   = Slave;
+    using framing_type = typename slave_type::framing_type;
+    using return_type  = typename slave_type::msg_type::template fields_in<header, response_identification, char>;
     //=========Check parameters=====================================================================
-    auto pack = slave.input().template deserialize_no_check<header, request_identification, std::uint8_t, crc16ansi>();
+    auto pack
+        = slave.input().template deserialize_no_check<header, request_identification, std::uint8_t, framing_type>();
     if (pack.fields->mei_type != modbus_base::mei_type) {
         return exception::illegal_data_value;
     }
@@ -85,7 +83,7 @@ identification(slave_base<TInputs, TCoils, TInputRegisters, THoldingRegisters, F
     default:
         return exception::unknown_exception;
     }
-    slave.output().template serialize<header, response_identification, char, crc16ansi>(data);
+    slave.output().template serialize<header, response_identification, char, framing_type>(data);
     return exception::no_error;
 }
 
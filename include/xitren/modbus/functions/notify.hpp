@@ -0,0 +1,61 @@
+/*!
+     _ _
+__ _(_) |_ _ _ ___ _ _
+\ \ / |  _| '_/ -_) ' \
+/_\_\_|\__|_| \___|_||_|
+* @date 15.02.2024
+*/
+#pragma once
+
+#include <xitren/modbus/changes.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace xitren::modbus::functions {
+
+/**
+ * @brief Reports a write that changed holding registers
+ *
+ * Marks the changed registers in the tracker of the slave if one is attached, see slave_base::track(), then calls
+ * changed_holdings().
+ *
+ * @tparam Slave The slave type, slave_base or a descendant the hooks are resolved on.
+ */
+template <class Slave>
+void
+holdings_written(Slave& slave, std::size_t start, std::span<std::uint16_t const> before,
+                 std::span<std::uint16_t const> after) noexcept
+{
+    if (auto* const tracker = slave.holding_tracker(); tracker != nullptr) {
+        changes::for_each_register_mask(
+            before.data(), after.data(), after.size(),
+            [&](std::size_t base, std::uint64_t mask) { tracker->mark(start + base, mask); });
+        tracker->commit();
+    }
+    slave.changed_holdings(start, before, after);
+}
+
+/**
+ * @brief Reports a write that changed coils, `before` and `after` are Modbus bit fields of `count` coils
+ *
+ * Marks the changed coils in the tracker of the slave if one is attached, see slave_base::track(), then calls
+ * changed_coils().
+ *
+ * @tparam Slave The slave type, slave_base or a descendant the hooks are resolved on.
+ */
+template <class Slave>
+void
+coils_written(Slave& slave, std::size_t start, std::size_t count, std::span<std::uint8_t const> before,
+              std::span<std::uint8_t const> after) noexcept
+{
+    if (auto* const tracker = slave.coil_tracker(); tracker != nullptr) {
+        changes::for_each_bit_mask(before.data(), after.data(), count,
+                                   [&](std::size_t base, std::uint64_t mask) { tracker->mark(start + base, mask); });
+        tracker->commit();
+    }
+    slave.changed_coils(start, count, before, after);
+}
+
+}    // namespace xitren::modbus::functions
@@ -7,6 +7,7 @@ __ _(_) |_ _ _ ___ _ _
 */
 #pragma once
 
+#include <xitren/modbus/bits_engine.hpp>
 #include <xitren/modbus/modbus.hpp>
 #include <xitren/modbus/packet.hpp>
 
@@ -15,11 +16,7 @@ namespace xitren::modbus::functions {
 /**
  * @brief The function is used to read a set of coils from a device.
  *
- * @tparam TInputs The input data type.
- * @tparam TCoils The coil data type.
- * @tparam TInputRegisters The input register data type.
- * @tparam THoldingRegisters The holding register data type.
- * @tparam Fifo The fifo size.
+ * @tparam Slave The slave type, slave_base or a descendant the hooks are resolved on.
  *
  * @param slave The reference to the slave object.
  *
@@ -29,50 +26,58 @@ namespace xitren::modbus::functions {
  * passed in the request, and if the parameters are valid, it reads the coils from the device and returns
  * the data in the response. If the parameters are not valid, the function returns an exception.
  */
-template <typename TInputs, typename TCoils, typename TInputRegisters, typename THoldingRegisters, std::uint16_t Fifo>
+template <class Slave>
 exception
-read_coils(slave_base<TInputs, TCoils, TInputRegisters, THoldingRegisters, Fifo>& slave)
+read_coils(Slave& slave)
 {
-    using slave_type  = slave_base<TInputs, TCoils, TInputRegisters, THoldingRegisters, Fifo>;
-    using return_type = typename slave_type::msg_type::template fields_in<header, std::uint8_t, std::uint8_t>;
+    using slave_type   = Slave;
+    using framing_type = typename slave_type::framing_type;
+    using return_type  = typename slave_type::msg_type::template fields_in<header, std::uint8_t, std::uint8_t>;
     //=========Check parameters=====================================================================
     if (slave_type::request_type_read::length != slave.input().size()) {
         return exception::bad_data;
     }
     auto pack
         = slave.input()
-              .template deserialize_no_check<header, request_fields_read, func::msb_t<std::uint16_t>, crc16ansi>();
+              .template deserialize_no_check<header, request_fields_read, func::msb_t<std::uint16_t>, framing_type>();
     if ((pack.fields->quantity.get() < 1) || (pack.fields->quantity.get() > slave_type::max_read_bits)) {
         return exception::illegal_data_value;
     }
     if (!slave_type::address_valid(pack.fields->starting_address.get(), pack.fields->quantity.get(),
-                                   slave.coils().size())) {
+                                   slave.coils())) {
         return exception::illegal_data_address;
     }
     //=========Request processing===================================================================
     if (pack.fields->quantity.get() == 0) {
         packet<header, std::uint8_t, crc16ansi> ret_pack{{slave.id(), pack.header->function_code}, {0}};
     } else {
-        static std::array<std::uint8_t, slave_type::max_read_bits / 8> coils_collect;
+        auto* coils_collect = slave.output().template payload<header, std::uint8_t, std::uint8_t, framing_type>();
         std::uint16_t const coils_collect_num{static_cast<std::uint16_t>((pack.fields->quantity.get() % 8)
                                                                              ? (pack.fields->quantity.get() / 8 + 1)
                                                                              : (pack.fields->quantity.get() / 8))};
         std::uint16_t const coils_collect_start{pack.fields->starting_address.get()};
-        std::uint16_t const max_read_bytes = slave_type::max_read_bits / 8;
-        for (std::uint16_t i = 0; (i < max_read_bytes) && (i < coils_collect_num); i++) {
-            coils_collect[i] = 0;
-            for (std::uint16_t j = 0;
-                 (j < 8) && (static_cast<std::size_t>(i * 8 + j + coils_collect_start) < slave.coils().size()); j++) {
-                if (slave.coils()[i * 8 + j + coils_collect_start]) {
-                    coils_collect[i] |= 1 << j;
+        if constexpr (contiguous_bits<typename slave_type::coils_type>) {
+            bits_engine::pack(slave.coils().data() + coils_collect_start, pack.fields->quantity.get(), coils_collect);
+        } else if constexpr (packed_bit_container<typename slave_type::coils_type>) {
+            slave.coils().read(coils_collect_start, pack.fields->quantity.get(), coils_collect);
+        } else {
+            std::uint16_t const max_read_bytes = slave_type::max_read_bits / 8;
+            for (std::uint16_t i = 0; (i < max_read_bytes) && (i < coils_collect_num); i++) {
+                coils_collect[i] = 0;
+                for (std::uint16_t j = 0;
+                     (j < 8) && (static_cast<std::size_t>(i * 8 + j + coils_collect_start) < slave.coils().size());
+                     j++) {
+                    if (slave.coils()[i * 8 + j + coils_collect_start]) {
+                        coils_collect[i] |= 1 << j;
+                    }
                 }
             }
         }
         return_type data{{slave.id(), pack.header->function_code},
                          static_cast<std::uint8_t>(coils_collect_num),
                          coils_collect_num,
-                         coils_collect.begin()};
-        slave.output().template serialize<header, std::uint8_t, std::uint8_t, crc16ansi>(data);
+                         nullptr};
+        slave.output().template serialize<header, std::uint8_t, std::uint8_t, framing_type>(data);
     }
     return exception::no_error;
 }
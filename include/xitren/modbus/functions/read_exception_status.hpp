@@ -15,11 +15,7 @@ namespace xitren::modbus::functions {
 /**
  * @brief Reads the exception status register of a Modbus slave device.
  *
- * @tparam TInputs Type of the input registers of the slave device.
- * @tparam TCoils Type of the coils of the slave device.
- * @tparam TInputRegisters Type of the input registers of the slave device.
- * @tparam THoldingRegisters Type of the holding registers of the slave device.
- * @tparam Fifo The size of the input queue of the slave device.
+ * @tparam Slave The slave type, slave_base or a descendant the hooks are resolved on.
  * @param slave The Modbus slave device to read the exception status from.
  * @return exception The exception code returned by the slave device.
  *
@@ -40,22 +36,23 @@ namespace xitren::modbus::functions {
  * Finally, the function returns the exception code of the slave device. If the slave device returned an exception code,
  * this will be returned by the function. Otherwise, an exception code of `exception::no_error` will be returned.
  */
-template <typename TInputs, typename TCoils, typename TInputRegisters, typename THoldingRegisters, std::uint16_t Fifo>
+template <class Slave>
 exception
-read_exception_status(slave_base<TInputs, TCoils, TInputRegisters, THoldingRegisters, Fifo>& slave)
+read_exception_status(Slave& slave)
 {
-    using slave_type  = slave_base<TInputs, TCoils, TInputRegisters, THoldingRegisters, Fifo>;
-    using return_type = typename slave_type::msg_type::template fields_in<header, std::uint8_t, std::uint8_t>;
+    using slave_type   = Slave;
+    using framing_type = typename slave_type::framing_type;
+    using return_type  = typename slave_type::msg_type::template fields_in<header, std::uint8_t, std::uint8_t>;
     //=========Check parameters=====================================================================
     if (slave_type::request_type_err::length != slave.input().size()) {
         return exception::bad_data;
     }
     auto pack
         = slave.input()
-              .template deserialize_no_check<header, request_fields_read, func::msb_t<std::uint16_t>, crc16ansi>();
+              .template deserialize_no_check<header, request_fields_read, func::msb_t<std::uint16_t>, framing_type>();
     //=========Request processing===================================================================
     return_type data{{slave.id(), pack.header->function_code}, slave.exception_status(), 0, nullptr};
-    slave.output().template serialize<header, std::uint8_t, std::uint8_t, crc16ansi>(data);
+    slave.output().template serialize<header, std::uint8_t, std::uint8_t, framing_type>(data);
     return exception::no_error;
 }
 
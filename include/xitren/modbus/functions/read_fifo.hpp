@@ -12,19 +12,20 @@ __ _(_) |_ _ _ ___ _ _
 
 namespace xitren::modbus::functions {
 
-template <typename TInputs, typename TCoils, typename TInputRegisters, typename THoldingRegisters, std::uint16_t Fifo>
+template <class Slave>
 exception
-read_fifo(slave_base<TInputs, TCoils, TInputRegisters, THoldingRegisters, Fifo>& slave)
+read_fifo(Slave& slave)
 {
-    using slave_type = slave_base<TInputs, TCoils, TInputRegisters, THoldingRegisters, Fifo>;
-    using return_type =
+    using slave_type   = Slave;
+    using framing_type = typename slave_type::framing_type;
+    using return_type  =
         typename slave_type::msg_type::template fields_in<header, request_fields_fifo, func::msb_t<std::uint16_t>>;
     //=========Check parameters=====================================================================
     if (slave_type::request_type_fifo::length != slave.input().size()) {
         return exception::bad_data;
     }
     auto pack
-        = slave.input().template deserialize_no_check<header, func::msb_t<std::uint16_t>, std::uint8_t, crc16ansi>();
+        = slave.input().template deserialize_no_check<header, func::msb_t<std::uint16_t>, std::uint8_t, framing_type>();
     if (!((slave.fifo().head() <= pack.fields->get()) && (pack.fields->get() < slave.fifo().tail()))) {
         return exception::illegal_data_address;
     }
@@ -33,13 +34,14 @@ read_fifo(slave_base<TInputs, TCoils, TInputRegisters, THoldingRegisters, Fifo>&
     std::uint16_t const count{
         static_cast<std::uint16_t>(std::min(slave_type::max_read_fifo, static_cast<std::uint16_t>(slave.fifo().size()))
                                    - static_cast<std::uint16_t>(start))};
-    static std::array<func::msb_t<std::uint16_t>, slave_type::max_read_fifo> inputs_collect;
-    std::copy(slave.fifo().begin() + start, slave.fifo().begin() + start + count, inputs_collect.begin());
-    static return_type data{{slave.id(), pack.header->function_code},
-                            {count * sizeof(std::uint16_t) + sizeof(std::uint16_t), count},
-                            count,
-                            inputs_collect.begin()};
-    slave.output().template serialize<header, request_fields_fifo, func::msb_t<std::uint16_t>, crc16ansi>(data);
+    auto* inputs_collect
+        = slave.output().template payload<header, request_fields_fifo, func::msb_t<std::uint16_t>, framing_type>();
+    std::copy(slave.fifo().begin() + start, slave.fifo().begin() + start + count, inputs_collect);
+    return_type data{{slave.id(), pack.header->function_code},
+                     {count * sizeof(std::uint16_t) + sizeof(std::uint16_t), count},
+                     count,
+                     nullptr};
+    slave.output().template serialize<header, request_fields_fifo, func::msb_t<std::uint16_t>, framing_type>(data);
 
     return exception::no_error;
 }
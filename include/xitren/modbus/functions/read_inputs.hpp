@@ -7,6 +7,7 @@ __ _(_) |_ _ _ ___ _ _
 */
 #pragma once
 
+#include <xitren/modbus/bits_engine.hpp>
 #include <xitren/modbus/modbus.hpp>
 #include <xitren/modbus/packet.hpp>
 
@@ -15,11 +16,7 @@ namespace xitren::modbus::functions {
 /**
  * @brief Reads input registers from a Modbus slave device.
  *
- * @tparam TInputs Type of the input bit-field.
- * @tparam TCoils Type of the coil-field.
- * @tparam TInputRegisters Type of the input register-field.
- * @tparam THoldingRegisters Type of the holding register-field.
- * @tparam Fifo Maximum size of the input queue.
+ * @tparam Slave The slave type, slave_base or a descendant the hooks are resolved on.
  * @param slave The Modbus slave device to read from.
  * @return exception Returns an exception code indicating the result of the operation.
  *
@@ -41,12 +38,13 @@ namespace xitren::modbus::functions {
  * input bit-field and returns them in a response packet. The response packet contains the number
  * of registers that were read, and the data for the registers.
  */
-template <typename TInputs, typename TCoils, typename TInputRegisters, typename THoldingRegisters, std::uint16_t Fifo>
+template <class Slave>
 exception
-read_inputs(slave_base<TInputs, TCoils, TInputRegisters, THoldingRegisters, Fifo>& slave)
+read_inputs(Slave& slave)
 {
-    using slave_type = slave_base<TInputs, TCoils, TInputRegisters, THoldingRegisters, Fifo>;
-    using return_type =
+    using slave_type   = Slave;
+    using framing_type = typename slave_type::framing_type;
+    using return_type  =
         typename slave_type::slave_type::msg_type::template fields_in<header, std::uint8_t, std::uint8_t>;
     //=========Check parameters=====================================================================
     if (slave_type::request_type_read::length != slave.input().size()) {
@@ -54,38 +52,46 @@ read_inputs(slave_base<TInputs, TCoils, TInputRegisters, THoldingRegisters, Fifo
     }
     auto pack
         = slave.input()
-              .template deserialize_no_check<header, request_fields_read, func::msb_t<std::uint16_t>, crc16ansi>();
+              .template deserialize_no_check<header, request_fields_read, func::msb_t<std::uint16_t>, framing_type>();
     if ((pack.fields->quantity.get() < 1) || (pack.fields->quantity.get() > slave_type::max_read_bits)) {
         return exception::illegal_data_value;
     }
     if (!slave_type::address_valid(pack.fields->starting_address.get(), pack.fields->quantity.get(),
-                                   slave.inputs().size())) {
+                                   slave.inputs())) {
         return exception::illegal_data_address;
     }
     //=========Request processing===================================================================
     if (pack.fields->quantity.get() == 0) {
         packet<header, std::uint8_t, crc16ansi> ret_pack{{slave.id(), pack.header->function_code}, {0}};
     } else {
-        static std::array<std::uint8_t, slave_type::max_read_bits / 8> inputs_collect;
+        auto* inputs_collect = slave.output().template payload<header, std::uint8_t, std::uint8_t, framing_type>();
         std::uint16_t const inputs_collect_num{static_cast<std::uint16_t>((pack.fields->quantity.get() % 8)
                                                                               ? (pack.fields->quantity.get() / 8 + 1)
                                                                               : (pack.fields->quantity.get() / 8))};
         std::uint16_t const inputs_collect_start{pack.fields->starting_address.get()};
-        std::uint16_t const max_read_bytes = slave_type::max_read_bits / 8;
-        for (std::uint16_t i = 0; (i < max_read_bytes) && (i < inputs_collect_num); i++) {
-            inputs_collect[i] = 0;
-            for (std::uint16_t j = 0;
-                 (j < 8) && (static_cast<std::size_t>(i * 8 + j + inputs_collect_start) < slave.inputs().size()); j++) {
-                if (slave.inputs()[i * 8 + j + inputs_collect_start]) {
-                    inputs_collect[i] |= 1 << j;
+        if constexpr (contiguous_bits<typename slave_type::inputs_type>) {
+            bits_engine::pack(slave.inputs().data() + inputs_collect_start, pack.fields->quantity.get(),
+                              inputs_collect);
+        } else if constexpr (packed_bit_container<typename slave_type::inputs_type>) {
+            slave.inputs().read(inputs_collect_start, pack.fields->quantity.get(), inputs_collect);
+        } else {
+            std::uint16_t const max_read_bytes = slave_type::max_read_bits / 8;
+            for (std::uint16_t i = 0; (i < max_read_bytes) && (i < inputs_collect_num); i++) {
+                inputs_collect[i] = 0;
+                for (std::uint16_t j = 0;
+                     (j < 8) && (static_cast<std::size_t>(i * 8 + j + inputs_collect_start) < slave.inputs().size());
+                     j++) {
+                    if (slave.inputs()[i * 8 + j + inputs_collect_start]) {
+                        inputs_collect[i] |= 1 << j;
+                    }
                 }
             }
         }
         return_type data{{slave.id(), pack.header->function_code},
                          static_cast<std::uint8_t>(inputs_collect_num),
                          inputs_collect_num,
-                         inputs_collect.begin()};
-        slave.output().template serialize<header, std::uint8_t, std::uint8_t, crc16ansi>(data);
+                         nullptr};
+        slave.output().template serialize<header, std::uint8_t, std::uint8_t, framing_type>(data);
     }
     return exception::no_error;
 }
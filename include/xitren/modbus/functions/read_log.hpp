@@ -15,11 +15,7 @@ namespace xitren::modbus::functions {
 /**
  * @brief Reads the log of the slave.
  *
- * @tparam TInputs The input bit field type.
- * @tparam TCoils The coil bit field type.
- * @tparam TInputRegisters The input register field type.
- * @tparam THoldingRegisters The holding register field type.
- * @tparam Fifo The fifo size.
+ * @tparam Slave The slave type, slave_base or a descendant the hooks are resolved on.
  * @param slave The slave to read the log from.
  * @return exception An exception code indicating the result of the operation.
  *
@@ -50,30 +46,34 @@ namespace xitren::modbus::functions {
  * around to the beginning. For example, if the log size is 10 and the starting address is 15, then only 5 log entries
  * will be returned.
  */
-template <typename TInputs, typename TCoils, typename TInputRegisters, typename THoldingRegisters, std::uint16_t Fifo>
+template <class Slave>
 exception
-read_log(slave_base<TInputs, TCoils, TInputRegisters, THoldingRegisters, Fifo>& slave)
+read_log(Slave& slave)
 {
-    using slave_type  = slave_base<TInputs, TCoils, TInputRegisters, THoldingRegisters, Fifo>;
-    using return_type = typename slave_type::msg_type::template fields_in<header, request_fields_log, std::uint8_t>;
+    using slave_type   = Slave;
+    using framing_type = typename slave_type::framing_type;
+    using msg_type     = typename slave_type::msg_type;
+    using return_type  = typename msg_type::template fields_in<header, request_fields_log, std::uint8_t>;
     //=========Check parameters=====================================================================
     if (slave_type::request_type_log::length != slave.input().size()) {
         return exception::bad_data;
     }
-    auto pack = slave.input().template deserialize_no_check<header, request_fields_log, std::uint8_t, crc16ansi>();
+    auto pack = slave.input().template deserialize_no_check<header, request_fields_log, std::uint8_t, framing_type>();
     //=========Request processing===================================================================
-    static std::array<std::uint8_t, slave_type::max_read_log_bytes> inputs_collect;
-    auto                                                            address = pack.fields->address.get();
-    auto                                                            size    = pack.fields->quantity.get();
-    auto head = static_cast<std::uint16_t>(slave.log().head());
-    auto tail = static_cast<std::uint16_t>(slave.log().tail());
+    constexpr auto fits     = msg_type::template capacity<header, request_fields_log, std::uint8_t, framing_type>();
+    constexpr auto capacity = static_cast<std::uint16_t>(std::min<std::size_t>(slave_type::max_read_log_bytes, fits));
+    auto* inputs_collect = slave.output().template payload<header, request_fields_log, std::uint8_t, framing_type>();
+    auto  address        = pack.fields->address.get();
+    auto  size           = pack.fields->quantity.get();
+    auto  head           = static_cast<std::uint16_t>(slave.log().head());
+    auto  tail           = static_cast<std::uint16_t>(slave.log().tail());
     if (address < head || address > tail) {
         address = head;
     }
-    size = std::min(size, static_cast<std::uint16_t>(tail - address));
-    std::copy(slave.log().begin() + address, slave.log().begin() + address + size, inputs_collect.begin());
-    return_type data{{slave.id(), pack.header->function_code}, {address, size}, size, inputs_collect.begin()};
-    slave.output().template serialize<header, request_fields_log, std::uint8_t, crc16ansi>(data);
+    size = std::min({size, static_cast<std::uint16_t>(tail - address), capacity});
+    std::copy(slave.log().begin() + address, slave.log().begin() + address + size, inputs_collect);
+    return_type data{{slave.id(), pack.header->function_code}, {address, size}, size, nullptr};
+    slave.output().template serialize<header, request_fields_log, std::uint8_t, framing_type>(data);
     return exception::no_error;
 }
 
@@ -7,55 +7,86 @@ __ _(_) |_ _ _ ___ _ _
 */
 #pragma once
 
+#include <xitren/modbus/bits_engine.hpp>
+#include <xitren/modbus/functions/notify.hpp>
 #include <xitren/modbus/modbus.hpp>
 #include <xitren/modbus/packet.hpp>
 
+#include <algorithm>
+#include <array>
+#include <span>
+
 namespace xitren::modbus::functions {
 
 /**
  * @brief This function is used to process the request of the write_coils.
  *
- * @tparam TInputs The input data type.
- * @tparam TCoils The coil data type.
- * @tparam TInputRegisters The input register data type.
- * @tparam THoldingRegisters The holding register data type.
- * @tparam Fifo The FIFO size.
+ * @tparam Slave The slave type, slave_base or a descendant the hooks are resolved on.
  * @param slave The reference to the Modbus slave object.
  * @param pack The input packet of the request.
  *
  * @return An exception object indicating the result of the operation.
+ *
+ * changed_coils() is called once if any coil changed.
  */
-template <typename TInputs, typename TCoils, typename TInputRegisters, typename THoldingRegisters, std::uint16_t Fifo>
+template <class Slave>
 exception
-write_coils(slave_base<TInputs, TCoils, TInputRegisters, THoldingRegisters, Fifo>& slave)
+write_coils(Slave& slave)
 {
-    using slave_type  = slave_base<TInputs, TCoils, TInputRegisters, THoldingRegisters, Fifo>;
-    using return_type = typename slave_type::msg_type::template fields_in<header, request_fields_read, std::uint8_t>;
+    using slave_type   = Slave;
+    using framing_type = typename slave_type::framing_type;
+    using return_type  = typename slave_type::msg_type::template fields_in<header, request_fields_read, std::uint8_t>;
     //=========Check parameters=====================================================================
     auto pack
-        = slave.input().template deserialize_no_check<header, request_fields_wr_single, std::uint8_t, crc16ansi>();
+        = slave.input().template deserialize_no_check<header, request_fields_wr_single, std::uint8_t, framing_type>();
     std::uint8_t const coils_collect_num{static_cast<std::uint8_t>(
         (pack.fields->quantity.get() % 8) ? (pack.fields->quantity.get() / 8 + 1) : (pack.fields->quantity.get() / 8))};
     if ((pack.fields->quantity.get() < 1) || (slave_type::max_write_bits < pack.fields->quantity.get())
-        || (coils_collect_num != pack.fields->count)) {
+        || (coils_collect_num != pack.fields->count)
+        || (slave.input().size()
+            != framing_type::prefix_length + sizeof(header) + sizeof(request_fields_wr_single) + pack.fields->count
+                   + framing_type::suffix_length)) {
         return exception::illegal_data_value;
     }
     if (!slave_type::address_valid(pack.fields->starting_address.get(), pack.fields->quantity.get(),
-                                   slave.coils().size())) {
+                                   slave.coils())) {
         return exception::illegal_data_address;
     }
     //=========Request processing===================================================================
-    for (std::size_t i{}; i < pack.fields->quantity.get(); i++) {
-        std::uint8_t const i_bytes = i / 8;
-        std::uint8_t const ii      = 1 << (i % 8);
-        slave.changed_coil(pack.fields->starting_address.get() + i,
-                           slave.coils()[pack.fields->starting_address.get() + i] = (pack.data[i_bytes] & ii));
+    using field_type = std::array<std::uint8_t, (slave_type::max_write_bits + 7) / 8>;
+    auto const        start    = pack.fields->starting_address.get();
+    std::size_t const quantity = pack.fields->quantity.get();
+    field_type        before{};
+    field_type        after{};
+    std::copy(pack.data, pack.data + coils_collect_num, after.begin());
+    if ((quantity % 8) != 0) {
+        after[coils_collect_num - 1] &= static_cast<std::uint8_t>((1U << (quantity % 8)) - 1);
+    }
+    if constexpr (contiguous_bits<typename slave_type::coils_type>) {
+        bits_engine::pack(slave.coils().data() + start, quantity, before.data());
+        bits_engine::unpack(pack.data, quantity, slave.coils().data() + start);
+    } else if constexpr (packed_bit_container<typename slave_type::coils_type>) {
+        slave.coils().read(start, quantity, before.data());
+        slave.coils().write(start, quantity, pack.data);
+    } else {
+        for (std::size_t i{}; i < quantity; i++) {
+            std::uint8_t const i_bytes = i / 8;
+            std::uint8_t const ii      = 1 << (i % 8);
+            if (slave.coils()[start + i]) {
+                before[i_bytes] |= ii;
+            }
+            slave.coils()[start + i] = (pack.data[i_bytes] & ii);
+        }
+    }
+    if (!std::equal(before.begin(), before.begin() + coils_collect_num, after.begin())) {
+        coils_written(slave, start, quantity, std::span<std::uint8_t const>{before.data(), coils_collect_num},
+                      std::span<std::uint8_t const>{after.data(), coils_collect_num});
     }
     return_type data{{slave.id(), pack.header->function_code},
                      {pack.fields->starting_address.get(), pack.fields->quantity.get()},
                      0,
                      nullptr};
-    slave.output().template serialize<header, request_fields_read, std::uint8_t, crc16ansi>(data);
+    slave.output().template serialize<header, request_fields_read, std::uint8_t, framing_type>(data);
     return exception::no_error;
 }
 
@@ -7,9 +7,12 @@ __ _(_) |_ _ _ ___ _ _
 */
 #pragma once
 
+#include <xitren/modbus/functions/notify.hpp>
 #include <xitren/modbus/modbus.hpp>
 #include <xitren/modbus/packet.hpp>
 
+#include <span>
+
 namespace xitren::modbus::functions {
 
 /*!
@@ -31,32 +34,30 @@ namespace xitren::modbus::functions {
  * the function returns an `exception::illegal_data_address` error.
  * 4. Reads the current value of the register at the specified address.
  * 5. Writes the new value to the register, calculated by applying the mask to the current value.
- * 6. Updates the changed_registers map with the new value.
+ * 6. Calls changed_holdings() if the value changed.
  * 7. Copies the input buffer to the output buffer.
  * 8. Sets the size of the output buffer to the size of the input buffer.
  * 9. Returns an `exception::no_error` error.
  *
- * @tparam TInputs Type of the input buffer.
- * @tparam TCoils Type of the coils buffer.
- * @tparam TInputRegisters Type of the input registers buffer.
- * @tparam THoldingRegisters Type of the holding registers buffer.
- * @tparam Fifo Size of the FIFO queue.
+ * @tparam Slave The slave type, slave_base or a descendant the hooks are resolved on.
  *
  * @param slave A reference to the Modbus slave object.
  * @param pack A `request_fields_wr_mask` object that contains the request parameters.
  * @return An `exception` value indicating the result of the operation.
  */
-template <typename TInputs, typename TCoils, typename TInputRegisters, typename THoldingRegisters, std::uint16_t Fifo>
+template <class Slave>
 exception
-write_register_mask(slave_base<TInputs, TCoils, TInputRegisters, THoldingRegisters, Fifo>& slave)
+write_register_mask(Slave& slave)
 {
-    using slave_type = slave_base<TInputs, TCoils, TInputRegisters, THoldingRegisters, Fifo>;
+    using slave_type   = Slave;
+    using framing_type = typename slave_type::framing_type;
     //=========Check parameters=====================================================================
     if (slave_type::request_type_read::length != slave.input().size()) {
         return exception::bad_data;
     }
-    auto pack = slave.input().template deserialize_no_check<header, request_fields_wr_mask, std::uint8_t, crc16ansi>();
-    if (pack.fields->starting_address >= slave.holding_registers().size()) {
+    auto pack
+        = slave.input().template deserialize_no_check<header, request_fields_wr_mask, std::uint8_t, framing_type>();
+    if (!slave_type::address_valid(pack.fields->starting_address.get(), 1, slave.holding_registers())) {
         return exception::illegal_data_address;
     }
     //=========Request processing===================================================================
@@ -64,9 +65,12 @@ write_register_mask(slave_base<TInputs, TCoils, TInputRegisters, THoldingRegiste
     std::uint16_t const value
         = (current & pack.fields->and_mask.get()) | (pack.fields->or_mask.get() & (~pack.fields->and_mask.get()));
     slave.holding_registers()[pack.fields->starting_address.get()] = value;
-    slave.changed_holding(pack.fields->starting_address.get(), value);
-    std::copy(slave.input().storage().begin(), slave.input().storage().begin() + slave.input().size(),
-              slave.output().storage().begin());
+    if (current != value) {
+        holdings_written(slave, pack.fields->starting_address.get(), std::span<std::uint16_t const>{&current, 1},
+                         std::span<std::uint16_t const>{&value, 1});
+    }
+    std::copy(slave.input().storage().data(), slave.input().storage().data() + slave.input().size(),
+              slave.output().storage().data());
     slave.output().size(slave.input().size());
     return exception::no_error;
 }
@@ -7,19 +7,21 @@ __ _(_) |_ _ _ ___ _ _
 */
 #pragma once
 
+#include <xitren/modbus/functions/notify.hpp>
 #include <xitren/modbus/modbus.hpp>
 #include <xitren/modbus/packet.hpp>
+#include <xitren/modbus/registers_engine.hpp>
+
+#include <algorithm>
+#include <array>
+#include <span>
 
 namespace xitren::modbus::functions {
 
 /**
  * @brief Writes multiple holding register values to the device.
  *
- * @tparam TInputs Type of the input buffer.
- * @tparam TCoils Type of the coils buffer.
- * @tparam TInputRegisters Type of the input registers buffer.
- * @tparam THoldingRegisters Type of the holding registers buffer.
- * @tparam Fifo Size of the FIFO queue.
+ * @tparam Slave The slave type, slave_base or a descendant the hooks are resolved on.
  *
  * @param slave A reference to the Modbus slave object.
  * @param pack A `request_fields_wr_mask` object that contains the request parameters.
@@ -28,32 +30,61 @@ namespace xitren::modbus::functions {
  * This function is used to write multiple holding register values to the device. The function takes a reference to the
  * Modbus slave object, which contains the input and output buffers for the request. The function deserializes the
  * request data, checks the parameters, and then processes the request. The function updates the holding register values
- * in the slave object and serializes the response data.
+ * in the slave object and serializes the response data. changed_holdings() is called once if any value changed.
  */
-template <typename TInputs, typename TCoils, typename TInputRegisters, typename THoldingRegisters, std::uint16_t Fifo>
+template <class Slave>
 exception
-write_registers(slave_base<TInputs, TCoils, TInputRegisters, THoldingRegisters, Fifo>& slave)
+write_registers(Slave& slave)
 {
-    using slave_type  = slave_base<TInputs, TCoils, TInputRegisters, THoldingRegisters, Fifo>;
-    using return_type = typename slave_type::msg_type::template fields_in<header, request_fields_read, std::uint16_t>;
+    using slave_type   = Slave;
+    using framing_type = typename slave_type::framing_type;
+    using return_type  = typename slave_type::msg_type::template fields_in<header, request_fields_read, std::uint16_t>;
     //=========Check parameters=====================================================================
     auto pack
         = slave.input()
-              .template deserialize_no_check<header, request_fields_wr_multi, func::msb_t<std::uint16_t>, crc16ansi>();
+              .template deserialize_no_check<header, request_fields_wr_multi, func::msb_t<std::uint16_t>,
+                                             framing_type>();
+    if ((pack.fields->quantity.get() < 1) || (slave_type::max_write_registers < pack.fields->quantity.get())
+        || (pack.fields->count != pack.fields->quantity.get() * sizeof(std::uint16_t))
+        || (slave.input().size()
+            != framing_type::prefix_length + sizeof(header) + sizeof(request_fields_wr_multi) + pack.fields->count
+                   + framing_type::suffix_length)) {
+        return exception::illegal_data_value;
+    }
     if (!slave_type::address_valid(pack.fields->starting_address.get(), pack.fields->quantity.get(),
-                                   slave.holding_registers().size())) {
+                                   slave.holding_registers())) {
         return exception::illegal_data_address;
     }
     //=========Request processing===================================================================
-    for (std::size_t i{}; i < pack.fields->quantity.get(); i++) {
-        slave.changed_holding(pack.fields->starting_address.get() + i,
-                              slave.holding_registers()[pack.fields->starting_address.get() + i] = pack.data[i].get());
+    auto const                                                 start    = pack.fields->starting_address.get();
+    std::size_t const                                          quantity = pack.fields->quantity.get();
+    std::array<std::uint16_t, slave_type::max_write_registers> before;
+    std::array<std::uint16_t, slave_type::max_write_registers> written;
+    std::uint16_t const*                                       after{written.data()};
+    if constexpr (contiguous_registers<typename slave_type::holding_regs_type>) {
+        auto* const image = slave.holding_registers().data() + start;
+        std::copy(image, image + quantity, before.begin());
+        registers_engine::from_wire(reinterpret_cast<std::uint8_t const*>(pack.data), quantity, image);
+        after = image;
+    } else if constexpr (snapshot_registers<typename slave_type::holding_regs_type>) {
+        slave.holding_registers().read(start, quantity, before.data());
+        registers_engine::from_wire(reinterpret_cast<std::uint8_t const*>(pack.data), quantity, written.data());
+        slave.holding_registers().update(start, std::span<std::uint16_t const>{written.data(), quantity});
+    } else {
+        for (std::size_t i{}; i < quantity; i++) {
+            before[i] = slave.holding_registers()[start + i];
+            written[i] = slave.holding_registers()[start + i] = pack.data[i].get();
+        }
+    }
+    if (!std::equal(before.begin(), before.begin() + quantity, after)) {
+        holdings_written(slave, start, std::span<std::uint16_t const>{before.data(), quantity},
+                         std::span<std::uint16_t const>{after, quantity});
     }
     return_type data{{slave.id(), pack.header->function_code},
                      {pack.fields->starting_address.get(), pack.fields->quantity.get()},
                      0,
                      nullptr};
-    slave.output().template serialize<header, request_fields_read, std::uint16_t, crc16ansi>(data);
+    slave.output().template serialize<header, request_fields_read, std::uint16_t, framing_type>(data);
     return exception::no_error;
 }
 
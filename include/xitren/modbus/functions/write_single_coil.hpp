@@ -7,46 +7,54 @@ __ _(_) |_ _ _ ___ _ _
 */
 #pragma once
 
+#include <xitren/modbus/functions/notify.hpp>
 #include <xitren/modbus/modbus.hpp>
 #include <xitren/modbus/packet.hpp>
 
+#include <span>
+
 namespace xitren::modbus::functions {
 
 /**
  * @brief This function is used to process the request of the write_single_coil.
  *
- * @tparam TInputs The input data type.
- * @tparam TCoils The coil data type.
- * @tparam TInputRegisters The input register data type.
- * @tparam THoldingRegisters The holding register data type.
- * @tparam Fifo The FIFO size.
+ * @tparam Slave The slave type, slave_base or a descendant the hooks are resolved on.
  * @param slave The reference to the Modbus slave object.
  * @param pack The input packet of the request.
  *
  * @return An exception object indicating the result of the operation.
+ *
+ * changed_coils() is called if the coil changed.
  */
-template <typename TInputs, typename TCoils, typename TInputRegisters, typename THoldingRegisters, std::uint16_t Fifo>
+template <class Slave>
 exception
-write_single_coil(slave_base<TInputs, TCoils, TInputRegisters, THoldingRegisters, Fifo>& slave)
+write_single_coil(Slave& slave)
 {
-    using slave_type = slave_base<TInputs, TCoils, TInputRegisters, THoldingRegisters, Fifo>;
+    using slave_type   = Slave;
+    using framing_type = typename slave_type::framing_type;
     //=========Check parameters=====================================================================
     if (slave_type::request_type_read::length != slave.input().size()) {
         return exception::bad_data;
     }
-    auto pack = slave.input().template deserialize_no_check<header, request_fields_read, std::uint8_t, crc16ansi>();
+    auto pack = slave.input().template deserialize_no_check<header, request_fields_read, std::uint8_t, framing_type>();
     if ((pack.fields->quantity.get() != slave_type::on_coil_value)
         && (pack.fields->quantity.get() != slave_type::off_coil_value)) {
         return exception::illegal_data_value;
     }
-    if (pack.fields->starting_address.get() >= slave.coils().size()) {
+    if (!slave_type::address_valid(pack.fields->starting_address.get(), 1, slave.coils())) {
         return exception::illegal_data_address;
     }
     //=========Request processing===================================================================
-    slave.coils()[pack.fields->starting_address.get()] = pack.fields->quantity.get() == slave_type::on_coil_value;
-    slave.changed_coil(pack.fields->starting_address.get(), pack.fields->quantity.get() == slave_type::on_coil_value);
-    std::copy(slave.input().storage().begin(), slave.input().storage().begin() + slave.input().size(),
-              slave.output().storage().begin());
+    auto const         address = pack.fields->starting_address.get();
+    std::uint8_t const before  = slave.coils()[address] ? 1 : 0;
+    std::uint8_t const after   = (pack.fields->quantity.get() == slave_type::on_coil_value) ? 1 : 0;
+    slave.coils()[address]     = (after != 0);
+    if (before != after) {
+        coils_written(slave, address, 1, std::span<std::uint8_t const>{&before, 1},
+                      std::span<std::uint8_t const>{&after, 1});
+    }
+    std::copy(slave.input().storage().data(), slave.input().storage().data() + slave.input().size(),
+              slave.output().storage().data());
     slave.output().size(slave.input().size());
     return exception::no_error;
 }
@@ -7,19 +7,18 @@ __ _(_) |_ _ _ ___ _ _
 */
 #pragma once
 
+#include <xitren/modbus/functions/notify.hpp>
 #include <xitren/modbus/modbus.hpp>
 #include <xitren/modbus/packet.hpp>
 
+#include <span>
+
 namespace xitren::modbus::functions {
 
 /**
  * @brief Writes single register values to the device.
  *
- * @tparam TInputs Type of the input buffer.
- * @tparam TCoils Type of the coils buffer.
- * @tparam TInputRegisters Type of the input registers buffer.
- * @tparam THoldingRegisters Type of the holding registers buffer.
- * @tparam Fifo Size of the FIFO queue.
+ * @tparam Slave The slave type, slave_base or a descendant the hooks are resolved on.
  *
  * @param slave A reference to the Modbus slave object.
  * @param pack An object that contains the request parameters.
@@ -28,26 +27,33 @@ namespace xitren::modbus::functions {
  * This function is used to write single holding register values to the device. The function takes a reference to the
  * Modbus slave object, which contains the input and output buffers for the request. The function deserializes the
  * request data, checks the parameters, and then processes the request. The function updates the holding register values
- * in the slave object and serializes the response data.
+ * in the slave object and serializes the response data. changed_holdings() is called if the value changed.
  */
-template <typename TInputs, typename TCoils, typename TInputRegisters, typename THoldingRegisters, std::uint16_t Fifo>
+template <class Slave>
 exception
-write_single_register(slave_base<TInputs, TCoils, TInputRegisters, THoldingRegisters, Fifo>& slave)
+write_single_register(Slave& slave)
 {
-    using slave_type = slave_base<TInputs, TCoils, TInputRegisters, THoldingRegisters, Fifo>;
+    using slave_type   = Slave;
+    using framing_type = typename slave_type::framing_type;
     //=========Check parameters=====================================================================
     if (slave_type::request_type_read::length != slave.input().size()) {
         return exception::bad_data;
     }
-    auto pack = slave.input().template deserialize_no_check<header, request_fields_read, std::uint8_t, crc16ansi>();
-    if (pack.fields->starting_address.get() >= slave.holding_registers().size()) {
+    auto pack = slave.input().template deserialize_no_check<header, request_fields_read, std::uint8_t, framing_type>();
+    if (!slave_type::address_valid(pack.fields->starting_address.get(), 1, slave.holding_registers())) {
         return exception::illegal_data_address;
     }
     //=========Request processing===================================================================
-    slave.holding_registers()[pack.fields->starting_address.get()] = pack.fields->quantity.get();
-    slave.changed_holding(pack.fields->starting_address.get(), pack.fields->quantity.get());
-    std::copy(slave.input().storage().begin(), slave.input().storage().begin() + slave.input().size(),
-              slave.output().storage().begin());
+    auto const          address = pack.fields->starting_address.get();
+    std::uint16_t const before  = slave.holding_registers()[address];
+    std::uint16_t const after   = pack.fields->quantity.get();
+    slave.holding_registers()[address] = after;
+    if (before != after) {
+        holdings_written(slave, address, std::span<std::uint16_t const>{&before, 1},
+                         std::span<std::uint16_t const>{&after, 1});
+    }
+    std::copy(slave.input().storage().data(), slave.input().storage().data() + slave.input().size(),
+              slave.output().storage().data());
     slave.output().size(slave.input().size());
     return exception::no_error;
 }
@@ -10,8 +10,17 @@ __ _(_) |_ _ _ ___ _ _
 #include <xitren/modbus/commands/command.hpp>
 #include <xitren/modbus/master.hpp>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <ranges>
+#include <thread>
+#include <type_traits>
 #include <variant>
 
 namespace xitren::modbus {
@@ -103,8 +112,28 @@ namespace xitren::modbus {
  * The modbus_master class is designed to be lightweight and fast. The modbus_master class is designed to be lightweight
  *and fast, so that it can be used in applications where speed is critical, such as in real-time control systems. The
  *modbus_master class is designed to be fast in terms of both execution time and response time.
+ *
+ * The ADU framing is a template parameter: `master` talks Modbus RTU, `basic_master<mbap>` talks Modbus TCP. Commands
+ * always build serial line frames, the master re-frames them on the way out and back.
+ *
+ * With a framing that carries transaction ids the master can pipeline: up to `Window` requests are in flight at once,
+ * each in its own slot with its own clone of the command and its own reply timeout. Replies are matched back to the
+ * slot by transaction id, in any order.
+ *
+ * @tparam Framing The ADU framing policy.
+ * @tparam Window The number of requests that may be in flight at once.
  **/
-class master : public modbus_base {
+template <framing_policy Framing, std::size_t Window = 1>
+class basic_master : public basic_modbus_base<Framing> {
+    static_assert(Window > 0, "Window must be more than 0!");
+    static_assert((Window == 1) || Framing::pipelining, "Pipelining needs a framing with transaction ids!");
+
+    using base_type = basic_modbus_base<Framing>;
+    using base_type::error_;
+    using base_type::input_msg_;
+    using base_type::output_msg_;
+    using base_type::send;
+    using base_type::prepare_output;
 
     /**
      * @brief A structure that contains the slave address and function code of a request.
@@ -137,7 +166,26 @@ class master : public modbus_base {
         }
     };
 
+    /**
+     * @brief An outstanding request: the command clone waiting for its reply, the transaction id it was sent with and
+     * its deadline on the shared timer.
+     */
+    struct slot_data {
+        command*                    command_{nullptr};
+        command::command_vault_type vault_{};
+        std::uint16_t               transaction_{};
+        std::size_t                 deadline_{};
+    };
+
 public:
+    using typename base_type::framing_type;
+    using typename base_type::msg_type;
+
+    /**
+     * @brief The number of requests that may be in flight at once
+     */
+    static constexpr std::size_t window = Window;
+
     /**
      * @brief Sends a request to the slave device asynchronously.
      *
@@ -145,35 +193,17 @@ public:
      *modbus_command object, which contains the request data. The modbus_command object is cloned, and the request data
      *is copied into the output message buffer. The output message buffer is then sent to the slave device.
      *
-     * If the master device is currently processing a request, this function returns false. Otherwise, if the request
-     *can be sent, the function returns true.
+     * If all slots of the window are taken by requests waiting for replies, this function returns false. Otherwise, if
+     *the request can be sent, the function returns true.
      *
      * @param in_data The modbus_command object that contains the request data.
      * @return true If the request was sent successfully.
-     * @return false If the master device is currently processing a request.
+     * @return false If the master device has no free slot for the request.
      */
     bool
     run_async(command const& in_data)
     {
-        if (command_ != nullptr) {
-            // If the master device is currently processing a request, return false.
-            WARN() << "busy";
-            return false;
-        }
-
-        // Get a pointer to the beginning and end of the request data.
-        auto const st{in_data.begin()};
-        auto const fn{in_data.begin() + in_data.size()};
-
-        // Copy the request data into the output message buffer.
-        std::copy(st, fn, output_msg_.storage().begin());
-        output_msg_.size(in_data.size());
-
-        // Clone the modbus_command object.
-        command_ = in_data.clone(vault_);
-
-        // Send the output message to the slave device.
-        return push(output_msg_);
+        return run_async_as(*this, in_data);
     }
 
     /*!
@@ -185,7 +215,7 @@ public:
      * @param in_data The modbus_command object to be sent to the slave.
      * @return modbus_master& A reference to the modbus_master object.
      */
-    master&
+    basic_master&
     operator<<(command const& in_data)
     {
         run_async(in_data);
@@ -198,10 +228,16 @@ public:
      * @param out_data The modbus command object to store the received data
      * @return modbus_master& A reference to the modbus master object
      */
-    master&
+    basic_master&
     operator>>(command& out_data)
     {
-        out_data.receive(input_msg_);
+        if constexpr (std::is_same_v<framing_type, command::framing_type>) {
+            out_data.receive(input_msg_);
+        } else {
+            command::msg_type pdu{};
+            unframe(input_msg_, pdu);
+            out_data.receive(pdu);
+        }
         return *this;
     }
 
@@ -213,65 +249,148 @@ public:
     timer_stop()
         = 0;
 
+    /*!
+     * @brief Starts the reply timeout of one slot.
+     *
+     * The default shares the single timer of timer_start() between all slots: every slot keeps its deadline, counted
+     * in the microseconds the timer ran, and timer_expired() expires the overdue slots only and starts the timer again
+     * for the next deadline. A request sent while the timer runs for others does not restart it, its deadline counts
+     * from the next expiry, so it waits at least its timeout and at most the timeout running already longer.
+     * Pipelined masters that need exact timeouts per request override it together with slot_timer_stop() and report
+     * with slot_expired().
+     *
+     * @param slot The slot the request was sent from.
+     * @param microseconds The timeout.
+     * @return `true` if the timer was started, `false` otherwise.
+     */
+    virtual bool
+    slot_timer_start(std::size_t slot, std::size_t microseconds)
+    {
+        return shared_timer_start_as(*this, slot, microseconds);
+    }
+
+    /*!
+     * @brief Stops the reply timeout of one slot.
+     *
+     * The default stops the shared timer once no request is left in flight.
+     *
+     * @param slot The slot that got its reply.
+     * @return `true` if the timer was stopped, `false` otherwise.
+     */
+    virtual bool
+    slot_timer_stop([[maybe_unused]] std::size_t slot)
+    {
+        return shared_timer_stop_as(*this);
+    }
+
     virtual void
     wait()
     {}
 
+    /*!
+     * @brief Called when the request of a slot is done, after the callback of its command.
+     *
+     * @param slot The slot of the request, it is free again.
+     * @param result The error of the reply, or exception::gateway_target if the request timed out.
+     */
+    virtual void
+    completed([[maybe_unused]] std::size_t slot, [[maybe_unused]] exception result) noexcept
+    {}
+
     /*!
      * @brief This function is called when the timer expires.
      *
      * This function handles the various states of the master and updates the state machine.
      * If the state is `master_state::waiting_reply`, the state is set to `master_state::processing_error` and the
-     * `no_answer` function of the command is called. The `command_` pointer is set to `nullptr`. If the state is not
-     * `master_state::waiting_reply`, a warning is printed.
-     *
-     * @param state_ The current state of the master.
+     * `no_answer` function of every overdue command is called, their slots are freed. If the state is not
+     * `master_state::waiting_reply`, a warning is printed. The shared timer is started again for the requests left in
+     * flight. Without the shared timer, i.e. with slot_timer_start() overridden, every outstanding command expires.
      */
-    void
+    virtual void
     timer_expired()
     {
+        auto const shared{timing_};
+        if (shared) {
+            now_    = alarm_;
+            timing_ = false;
+        }
         switch (state_) {
         case master_state::waiting_reply:
             TRACE() << "wait -> proc_err";
             state_ = master_state::processing_error;
-            if (command_ != nullptr) {
-                command_->no_answer();
-                command_ = nullptr;
+            for (std::size_t slot{}; slot < window; slot++) {
+                if (!shared || (slots_[slot].deadline_ <= now_)) {
+                    expire(slot);
+                }
             }
             break;
         default:
             WARN() << "state undefined: " << static_cast<int>(state_);
             break;
         }
+        if (shared && !timing_ && !rearm()) [[unlikely]] {
+            TRACE() << "-> un_err";
+            state_ = master_state::unrecoverable_error;
+        }
     }
 
-    exception
-    received() noexcept override
+    /*!
+     * @brief This function is called when the reply timeout of one slot expires.
+     *
+     * The `no_answer` function of the command waiting in the slot is called and the slot is freed, the other requests
+     * in flight keep waiting. The timer of the slot is stopped, as for a reply.
+     *
+     * @param slot The slot whose timer expired.
+     */
+    virtual void
+    slot_expired(std::size_t slot)
     {
-        switch (state_) {
-        case master_state::waiting_reply:
-            if (command_ != nullptr) {
-                return received_command();
-            }
-            TRACE() << "wait -> un_err";
+        if ((slot >= window) || (slots_[slot].command_ == nullptr)) [[unlikely]] {
+            WARN() << "slot idle: " << slot;
+            return;
+        }
+        TRACE() << "wait -> proc_err";
+        state_ = master_state::processing_error;
+        expire(slot);
+        if (!slot_timer_stop(slot)) [[unlikely]] {
+            TRACE() << "proc_err -> un_err";
             state_ = master_state::unrecoverable_error;
-            return exception::unknown_exception;
-            break;
-        default:
-            WARN() << "state undef: " << static_cast<int>(state_);
-            break;
         }
-        return exception::no_error;
+    }
+
+    /*!
+     * @brief Returns the number of requests waiting for replies.
+     *
+     * @return The number of taken slots.
+     */
+    [[nodiscard]] inline std::size_t
+    in_flight() const noexcept
+    {
+        return static_cast<std::size_t>(
+            std::ranges::count_if(slots_, [](slot_data const& slot) { return slot.command_ != nullptr; }));
+    }
+
+    exception
+    received() noexcept override
+    {
+        return received_as(*this);
     }
 
     /*!
      * @brief Returns whether the master is currently idle or waiting for a reply.
      *
+     * A pipelined master also accepts replies while the previous one has not been processed yet.
+     *
      * @return `true` if the master is idle or waiting for a reply, `false` otherwise.
      */
     inline bool
     idle() noexcept override
     {
+        if constexpr (window > 1) {
+            if ((master_state::unrecoverable_error != state_) && (in_flight() > 0)) {
+                return true;
+            }
+        }
         return (master_state::idle == state_) || (master_state::waiting_reply == state_);
     }
 
@@ -289,9 +408,14 @@ public:
         switch (state_) {
         case master_state::processing_reply:
         case master_state::processing_error:
-            // Trace that the state is being changed to idle.
-            TRACE() << "proc -> idle";
-            state_ = master_state::idle;
+            // Keep waiting if other requests are in flight, otherwise go idle.
+            if (in_flight() > 0) {
+                TRACE() << "proc -> wait";
+                state_ = master_state::waiting_reply;
+            } else {
+                TRACE() << "proc -> idle";
+                state_ = master_state::idle;
+            }
             break;
         case master_state::waiting_reply:
         case master_state::idle:
@@ -331,23 +455,13 @@ public:
      * @brief Sends a message to the slave and waits for a response.
      *
      * @param msg The message to send.
+     * @param slot The slot that waits for the response.
      * @return `true` if the message was sent successfully, `false` otherwise.
      */
     bool
-    push(msg_type& msg)
+    push(msg_type& msg, std::size_t slot = 0)
     {
-        state_ = master_state::waiting_reply;
-        if (!send(msg.storage().begin(), msg.storage().begin() + msg.size())) {
-            TRACE() << "wait -> un_err";
-            state_ = master_state::unrecoverable_error;
-            return false;
-        }
-        if (!timer_start(100)) {
-            TRACE() << "wait -> un_err";
-            state_ = master_state::unrecoverable_error;
-            return false;
-        }
-        return true;
+        return push_as(*this, msg, slot);
     }
 
     /*!
@@ -360,23 +474,247 @@ public:
     reset() noexcept override
     {
         TRACE() << "-> idle";
-        state_   = master_state::idle;
-        error_   = exception::no_error;
-        command_ = nullptr;
+        state_  = master_state::idle;
+        error_  = exception::no_error;
+        timing_ = false;
+        for (std::size_t slot{}; slot < window; slot++) {
+            release(slot);
+        }
     }
 
-    ~master() override = default;
+    ~basic_master() override = default;
 
 protected:
+    /*!
+     * @brief Returns the index of the first slot without a request in flight, or `window` if all are taken.
+     */
+    [[nodiscard]] inline std::size_t
+    free_slot() const noexcept
+    {
+        for (std::size_t i{}; i < window; i++) {
+            if (slots_[i].command_ == nullptr) {
+                return i;
+            }
+        }
+        return window;
+    }
+
+    /**
+     * @brief run_async() with the hooks called on `self`
+     */
+    template <class Self>
+    bool
+    run_async_as(Self& self, command const& in_data)
+    {
+        auto const slot{free_slot()};
+        if (slot == window) {
+            // If every slot is waiting for a reply, return false.
+            WARN() << "busy";
+            return false;
+        }
+
+        // Copy the request data into the output message buffer, or straight into the TX buffer of the transport.
+        prepare_output(self.transmit_buffer());
+        frame(in_data, output_msg_);
+
+        // Clone the modbus_command object.
+        slots_[slot].command_ = in_data.clone(slots_[slot].vault_);
+
+        // Send the output message to the slave device, a request that did not go out frees its slot again.
+        return push_as(self, output_msg_, slot);
+    }
+
+    /**
+     * @brief push() with the hooks called on `self`
+     *
+     * A request that fails to go out or to start its timer frees its slot. The master only enters the
+     * unrecoverable_error state if no other request is left in flight, so their replies are still accepted.
+     */
+    template <class Self>
+    bool
+    push_as(Self& self, msg_type& msg, std::size_t slot)
+    {
+        framing_type::transaction(msg.storage().data(), ++transaction_);
+        slots_[slot].transaction_ = framing_type::transaction(msg.storage().data());
+        state_                    = master_state::waiting_reply;
+        if (!self.send(msg.storage().data(), msg.storage().data() + msg.size())
+            || !self.slot_timer_start(slot, 100)) [[unlikely]] {
+            release(slot);
+            if (in_flight() == 0) {
+                TRACE() << "wait -> un_err";
+                state_ = master_state::unrecoverable_error;
+            }
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief slot_timer_start() on the shared timer, with timer_start() called on `self`
+     */
+    template <class Self>
+    bool
+    shared_timer_start_as(Self& self, std::size_t slot, std::size_t microseconds)
+    {
+        if (timing_) {
+            slots_[slot].deadline_ = alarm_ + microseconds;
+            return true;
+        }
+        slots_[slot].deadline_ = now_ + microseconds;
+        alarm_                 = slots_[slot].deadline_;
+        timing_                = true;
+        return self.timer_start(microseconds);
+    }
+
+    /**
+     * @brief slot_timer_stop() on the shared timer, with timer_stop() called on `self`
+     */
+    template <class Self>
+    bool
+    shared_timer_stop_as(Self& self)
+    {
+        if (in_flight() > 0) {
+            return true;
+        }
+        timing_ = false;
+        return self.timer_stop();
+    }
+
+    /**
+     * @brief received() with the hooks called on `self`
+     */
+    template <class Self>
+    exception
+    received_as(Self& self) noexcept
+    {
+        switch (state_) {
+        case master_state::processing_reply:
+        case master_state::processing_error:
+            if constexpr (window == 1) {
+                WARN() << "state undef: " << static_cast<int>(state_);
+                break;
+            }
+            [[fallthrough]];
+        case master_state::waiting_reply:
+            if (in_flight() > 0) {
+                return received_command_as(self);
+            }
+            TRACE() << "wait -> un_err";
+            state_ = master_state::unrecoverable_error;
+            return exception::unknown_exception;
+            break;
+        default:
+            WARN() << "state undef: " << static_cast<int>(state_);
+            break;
+        }
+        return exception::no_error;
+    }
+
     volatile master_state state_{
         master_state::
             idle};    // FIXME: See p.20 of
                       // https://wiki.yandex-team.ru/lavka/dev/robolab/programmirovanie/01-koncepcii-i-instrukcii/c-embedded-guidelines/?revision=149426615
 
 private:
-    request_data                ask_{};
-    command*                    command_{nullptr};
-    command::command_vault_type vault_{};
+    request_data                   ask_{};
+    std::array<slot_data, Window>  slots_{};
+    std::uint16_t                  transaction_{};
+    std::size_t                    now_{};      /*!< The microseconds the shared timer ran */
+    std::size_t                    alarm_{};    /*!< When the shared timer expires next */
+    bool                           timing_{};   /*!< The shared timer runs */
+
+    /*!
+     * @brief Returns the index of the slot waiting for a transaction, or `window` if none is.
+     */
+    [[nodiscard]] inline std::size_t
+    find_slot(std::uint16_t transaction) const noexcept
+    {
+        for (std::size_t i{}; i < window; i++) {
+            if ((slots_[i].command_ != nullptr) && (slots_[i].transaction_ == transaction)) {
+                return i;
+            }
+        }
+        return window;
+    }
+
+    /*!
+     * @brief Starts the shared timer for the earliest deadline of the requests in flight, if any
+     */
+    bool
+    rearm()
+    {
+        std::optional<std::size_t> next{};
+        for (auto const& slot : slots_) {
+            if ((slot.command_ != nullptr) && (!next || (slot.deadline_ < *next))) {
+                next = slot.deadline_;
+            }
+        }
+        if (!next) {
+            return true;
+        }
+        alarm_  = std::max(*next, now_ + 1);
+        timing_ = true;
+        return timer_start(alarm_ - now_);
+    }
+
+    /*!
+     * @brief Destroys the command cloned into a slot and frees the slot
+     */
+    inline void
+    release(std::size_t slot) noexcept
+    {
+        if (slots_[slot].command_ != nullptr) {
+            std::destroy_at(slots_[slot].command_);
+            slots_[slot].command_ = nullptr;
+        }
+    }
+
+    inline void
+    expire(std::size_t slot) noexcept
+    {
+        if (slots_[slot].command_ != nullptr) {
+            slots_[slot].command_->no_answer();
+            release(slot);
+            completed(slot, exception::gateway_target);
+        }
+    }
+
+    /*!
+     * @brief Copies a serial line command frame into a message using the master framing
+     *
+     * @param in_data The command to take the frame from.
+     * @param msg The message to fill.
+     */
+    static inline void
+    frame(command const& in_data, msg_type& msg) noexcept
+    {
+        if constexpr (std::is_same_v<framing_type, command::framing_type>) {
+            std::copy(in_data.begin(), in_data.begin() + in_data.size(), msg.storage().data());
+            msg.size(in_data.size());
+        } else {
+            auto const begin    = msg.storage().data();
+            auto const pdu_end  = in_data.begin() + in_data.size() - command::framing_type::suffix_length;
+            auto const body_end = std::copy(in_data.begin(), pdu_end, begin + framing_type::prefix_length);
+            msg.size(static_cast<std::size_t>(framing_type::seal(begin, body_end) - begin));
+        }
+    }
+
+    /*!
+     * @brief Copies the PDU of a received message into a serial line frame for the commands
+     *
+     * The checksum bytes are only reserved: replies are checked by the transport framing, commands do not check them.
+     *
+     * @param msg The received message.
+     * @param pdu The serial line frame to fill.
+     */
+    static inline void
+    unframe(msg_type const& msg, command::msg_type& pdu) noexcept
+    {
+        auto const body = msg.storage().data() + framing_type::prefix_length;
+        auto const size = msg.size() - framing_type::prefix_length - framing_type::suffix_length;
+        std::copy(body, body + size, pdu.storage().data());
+        pdu.size(size + command::framing_type::suffix_length);
+    }
 
     inline bool
     wait_input_msg()
@@ -390,34 +728,41 @@ private:
     /*!
      * @brief This function is used to handle incoming commands from the slave.
      *
-     * If the command is from a different slave, it is stored in the command_vault_type vault_ and the master enters the
+     * The reply is matched to its slot by transaction id, replies to no outstanding request are dropped.
+     * If the command is from a different slave, it is kept in its slot and the master enters the
      * waiting_reply state. If the command is from the correct slave, it is processed and the master enters the
      * processing_reply state. If an error occurs during processing, the master enters the unrecoverable_error state.
      *
      * @return An exception indicating the type of error that occurred.
      */
+    template <class Self>
     inline exception
-    received_command() noexcept
+    received_command_as(Self& self) noexcept
     {
-        if (command_ == nullptr) [[unlikely]] {
+        auto const slot{find_slot(framing_type::transaction(input_msg_.storage().data()))};
+        if (slot == window) [[unlikely]] {
+            WARN() << "stale transaction";
             return exception::no_error;
         }
-        auto* cmd{command_};
-        command_ = nullptr;
+        auto* cmd{slots_[slot].command_};
+        slots_[slot].command_ = nullptr;
         (*this) >> (*(cmd));
-        if (cmd->error() == exception::bad_slave) {
-            state_   = master_state::waiting_reply;
-            command_ = cmd;
-        } else {
-            state_ = master_state::processing_reply;
-            if (!timer_stop()) [[unlikely]] {
-                state_ = master_state::unrecoverable_error;
-            }
+        auto const result{cmd->error()};
+        if (result == exception::bad_slave) {
+            state_                = master_state::waiting_reply;
+            slots_[slot].command_ = cmd;
+            return result;
         }
-        if (state_ == master_state::unrecoverable_error) {
+        // The clone is done with before completed() may reuse the slot.
+        std::destroy_at(cmd);
+        state_ = master_state::processing_reply;
+        if (!self.slot_timer_stop(slot)) [[unlikely]] {
+            state_ = master_state::unrecoverable_error;
+            completed(slot, exception::unknown_exception);
             return exception::unknown_exception;
         }
-        return (*(cmd)).error();
+        completed(slot, result);
+        return result;
     }
 
     // This function deserializes a Modbus message from the input buffer.
@@ -425,10 +770,10 @@ private:
     // The exception object indicates any errors that occurred during deserialization.
     // The function throws an exception if an error occurs.
     template <typename Header, typename Fields, typename Type>
-    inline std::pair<msg_type::fields_out_ptr<Header, Fields, Type>, exception>
+    inline std::pair<typename msg_type::template fields_out_ptr<Header, Fields, Type>, exception>
     input_msg(std::uint8_t slave)
     {
-        auto pack = input_msg_.template deserialize_no_check<Header, Fields, Type, crc16ansi>();
+        auto pack = input_msg_.template deserialize_no_check<Header, Fields, Type, framing_type>();
 
         // Check if the slave ID of the incoming message matches the expected slave ID.
         // If not, set the state to processing error and return an exception indicating a bad slave.
@@ -462,11 +807,11 @@ private:
      * @return An exception indicating the result of the request
      */
     static inline exception
-    request(master& master, std::uint8_t slave, diagnostics_sub_function sub, std::uint16_t& data)
+    request(basic_master& master, std::uint8_t slave, diagnostics_sub_function sub, std::uint16_t& data)
     {
         master.ask_ = {slave, function::diagnostic};
         master.output_msg_
-            .template serialize<header, func::msb_t<std::uint16_t>, func::msb_t<std::uint16_t>, crc16ansi>(
+            .template serialize<header, func::msb_t<std::uint16_t>, func::msb_t<std::uint16_t>, framing_type>(
                 {{slave, static_cast<uint8_t>(function::diagnostic)}, static_cast<uint16_t>(sub), 0, nullptr});
 
         if (!master.push(master.output_msg_)) {
@@ -475,7 +820,8 @@ private:
         if (!master.wait_input_msg()) [[unlikely]] {
             return exception::bad_slave;
         }
-        auto [pack, err] = master.input_msg<header, func::msb_t<std::uint16_t>, func::msb_t<std::uint16_t>>(slave);
+        auto [pack, err]
+            = master.template input_msg<header, func::msb_t<std::uint16_t>, func::msb_t<std::uint16_t>>(slave);
         if ((master.error_ = err) != exception::no_error) [[unlikely]]
             return err;
         if (pack.size != 1) [[unlikely]]
@@ -485,4 +831,272 @@ private:
     }
 };
 
+/**
+ * @brief Modbus RTU master
+ */
+using master = basic_master<rtu>;
+
+/**
+ * @brief A master whose hooks are resolved at compile time
+ *
+ * `Derived` is the final class implementing send(), timer_start(), timer_stop() and optionally transmit_buffer().
+ * run_async(), receive() and the reply timeouts call them on `Derived`, so no call of a transaction goes through the
+ * virtual table. The virtual interface keeps working for code that holds the master by a base reference.
+ *
+ * @tparam Derived The final class derived from static_master, its hooks must be public.
+ * @tparam Master The master to build on, e.g. `master` or `basic_master<mbap, 4>`.
+ */
+template <class Derived, class Master = master>
+class static_master : public Master {
+public:
+    using Master::Master;
+
+    bool
+    run_async(command const& in_data)
+    {
+        return Master::run_async_as(derived(), in_data);
+    }
+
+    static_master&
+    operator<<(command const& in_data)
+    {
+        run_async(in_data);
+        return *this;
+    }
+
+    /**
+     * @brief Receives a message, see basic_modbus_base::receive()
+     */
+    template <class InputIterator>
+    constexpr exception
+    receive(InputIterator begin, InputIterator end) noexcept
+    {
+        return Master::receive_as(derived(), begin, end);
+    }
+
+    exception
+    received() noexcept override
+    {
+        return Master::received_as(derived());
+    }
+
+    bool
+    slot_timer_start(std::size_t slot, std::size_t microseconds) override
+    {
+        return Master::shared_timer_start_as(derived(), slot, microseconds);
+    }
+
+    bool
+    slot_timer_stop([[maybe_unused]] std::size_t slot) override
+    {
+        return Master::shared_timer_stop_as(derived());
+    }
+
+private:
+    Derived&
+    derived() noexcept
+    {
+        static_assert(std::is_final_v<Derived>, "Derived must be final for its hooks to be called directly!");
+        return static_cast<Derived&>(*this);
+    }
+};
+
+/**
+ * @brief A master with a synchronous, blocking request call
+ *
+ * run() sends a command and puts the calling thread to sleep on a condition variable until completed() reports the
+ * request done: its reply arrived through receive(), its reply timeout expired through timer_expired() or
+ * slot_expired(), or the deadline of the caller passed, which expires the request. No core is spent while the reply is
+ * on its way, the caller is woken exactly when the transaction completes.
+ *
+ * Every slot keeps its own waiter, so with a window of several slots as many threads wait in run() at once, each for
+ * its own request. The reply path and the timer may run on other threads: the receive functions, received(),
+ * timer_expired() and slot_expired() take the lock of the master. A transport answering from inside send(), or a
+ * callback calling them, is on the thread holding the lock already and goes on without it; run() itself is rejected
+ * there.
+ *
+ * @tparam Master The master to build on, e.g. `master` or `basic_master<mbap, 4>`.
+ */
+template <class Master = master>
+class blocking_master : public Master {
+public:
+    using clock = std::chrono::steady_clock;
+    using Master::Master;
+    using Master::window;
+
+    /**
+     * @brief Sends a command and waits for it to complete
+     *
+     * The callback of the command runs before run() returns, on the thread completing the request.
+     *
+     * @param in_data The command to send.
+     * @param deadline The latest point in time to wait until.
+     * @return The error of the reply, e.g. exception::no_error
+     * @return exception::gateway_target If no reply came in time
+     * @return exception::slave_or_server_busy If all slots are taken, or if called from send() or a callback
+     * @return exception::slave_or_server_failure If the request could not be sent
+     */
+    exception
+    run(command const& in_data, clock::time_point deadline)
+    {
+        if (owned()) [[unlikely]] {
+            return exception::slave_or_server_busy;
+        }
+        std::unique_lock<std::mutex> lock{mutex_};
+        auto const                   slot{Master::free_slot()};
+        if (slot == window) [[unlikely]] {
+            return exception::slave_or_server_busy;
+        }
+        auto& waiter = waiters_[slot];
+        waiter       = {true, false, exception::no_error};
+        {
+            owner_guard const owner{owner_};
+            if (!Master::run_async(in_data)) [[unlikely]] {
+                waiter = {};
+                return exception::slave_or_server_failure;
+            }
+        }
+        if (!done_.wait_until(lock, deadline, [&waiter] { return waiter.done; })) {
+            owner_guard const owner{owner_};
+            Master::slot_expired(slot);
+        }
+        auto const result = waiter.result;
+        waiter            = {};
+        return result;
+    }
+
+    /**
+     * @brief Sends a command and waits at most `timeout` for it to complete, see run()
+     */
+    exception
+    run(command const& in_data, std::chrono::microseconds timeout)
+    {
+        return run(in_data, clock::now() + timeout);
+    }
+
+    /**
+     * @brief Receives a reply under the lock of the master, see basic_modbus_base::receive()
+     */
+    template <class InputIterator>
+    exception
+    receive(InputIterator begin, InputIterator end) noexcept
+    {
+        return locked([&] { return Master::receive(begin, end); });
+    }
+
+    /**
+     * @brief Receives a reply in place under the lock of the master, see basic_modbus_base::receive_in_place()
+     */
+    exception
+    receive_in_place(std::span<std::uint8_t> frame) noexcept
+    {
+        return locked([this, frame] { return Master::receive_in_place(frame); });
+    }
+
+    /**
+     * @brief Receives a reply byte under the lock of the master, see basic_modbus_base::receive_byte()
+     */
+    exception
+    receive_byte(std::uint8_t byte) noexcept
+    {
+        return locked([this, byte] { return Master::receive_byte(byte); });
+    }
+
+    /**
+     * @brief Completes a reply received byte-wise under the lock of the master, see basic_modbus_base::receive_end()
+     */
+    exception
+    receive_end() noexcept
+    {
+        return locked([this] { return Master::receive_end(); });
+    }
+
+    exception
+    received() noexcept override
+    {
+        return locked([this] { return Master::received(); });
+    }
+
+    void
+    timer_expired() override
+    {
+        locked([this] { Master::timer_expired(); });
+    }
+
+    void
+    slot_expired(std::size_t slot) override
+    {
+        locked([this, slot] { Master::slot_expired(slot); });
+    }
+
+    void
+    completed(std::size_t slot, exception result) noexcept override
+    {
+        Master::completed(slot, result);
+        auto& waiter = waiters_[slot];
+        if (waiter.waiting && !waiter.done) {
+            waiter.result = result;
+            waiter.done   = true;
+            done_.notify_all();
+        }
+    }
+
+private:
+    /**
+     * @brief The caller of run() waiting for the request of a slot
+     */
+    struct waiter_data {
+        bool      waiting{};
+        bool      done{};
+        exception result{exception::no_error};
+    };
+
+    /**
+     * @brief Marks the calling thread as the holder of the lock for its scope
+     */
+    class owner_guard {
+    public:
+        explicit owner_guard(std::atomic<std::thread::id>& owner) noexcept : owner_{owner}
+        {
+            owner_.store(std::this_thread::get_id(), std::memory_order_relaxed);
+        }
+
+        owner_guard(owner_guard const&) = delete;
+        owner_guard&
+        operator=(owner_guard const&)
+            = delete;
+
+        ~owner_guard() noexcept { owner_.store(std::thread::id{}, std::memory_order_relaxed); }
+
+    private:
+        std::atomic<std::thread::id>& owner_;
+    };
+
+    std::mutex                      mutex_{};
+    std::condition_variable         done_{};
+    std::atomic<std::thread::id>    owner_{};
+    std::array<waiter_data, window> waiters_{};
+
+    /**
+     * @brief Returns true if the calling thread holds the lock, i.e. it is inside send() or a callback
+     */
+    [[nodiscard]] inline bool
+    owned() const noexcept
+    {
+        return owner_.load(std::memory_order_relaxed) == std::this_thread::get_id();
+    }
+
+    template <class Function>
+    auto
+    locked(Function&& function) noexcept
+    {
+        if (owned()) {
+            return function();
+        }
+        std::lock_guard<std::mutex> const lock{mutex_};
+        owner_guard const                 owner{owner_};
+        return function();
+    }
+};
+
 }    // namespace xitren::modbus
@@ -11,6 +11,7 @@ __ _(_) |_ _ _ ___ _ _
 #include <xitren/modbus/packet.hpp>
 
 #include <limits>
+#include <span>
 #include <type_traits>
 
 namespace xitren::modbus {
@@ -391,7 +392,8 @@ constexpr std::uint8_t error_reply_mask = 0x80;
  * | unknown_exception  | 0x10 | Unknown exception                                                                   |
  * | missed_data        | 0x11 | Data length is incorrect                                                            |
  * | bad_slave          | 0x12 | Slave address incorrect                                                             |
- * | max                | 0x13 | Maximum number of exceptions                                                        |
+ * | nothing_to_do      | 0x13 | The object is idle, nothing was processed                                           |
+ * | max                | 0x14 | Maximum number of exceptions                                                        |
  *
  * The exception codes are divided into two categories: client-generated exceptions and server-generated exceptions.
  * Client-generated exceptions are generated by the MODBUS client (such as a software application) and are used to
@@ -417,6 +419,7 @@ enum class exception : std::uint8_t {
     unknown_exception,          ///< Unknown exception.
     missed_data,                ///< Data length is incorrect.
     bad_slave,                  ///< Slave address incorrect.
+    nothing_to_do,              ///< The object is idle, nothing was processed.
     max                         ///< Maximum number of exceptions.
 };
 
@@ -914,9 +917,17 @@ struct __attribute__((__packed__)) error_fields {
  * This class provides a base implementation of the Modbus protocol. It defines
  * constants, data types, and functions that are common to all Modbus
  * implementations.
+ *
+ * @tparam Framing The ADU framing policy, rtu for serial lines or mbap for Modbus TCP.
  */
-class modbus_base {
+template <framing_policy Framing>
+class basic_modbus_base {
 public:
+    /**
+     * @brief The ADU framing policy
+     */
+    using framing_type = Framing;
+
     /**
      * @brief The broadcast address
      *
@@ -1007,7 +1018,7 @@ public:
      * This is the maximum length of the ADU, which is the actual data portion of
      * the Modbus message, without the header and CRC.
      */
-    static constexpr std::uint16_t max_adu_length = 256;
+    static constexpr std::uint16_t max_adu_length = framing_type::max_adu_length;
 
     /**
      * @brief The minimum length of the ADU
@@ -1015,7 +1026,7 @@ public:
      * This is the minimum length of the ADU, which is the actual data portion of
      * the Modbus message, without the header and CRC.
      */
-    static constexpr std::uint16_t min_adu_length = 3;
+    static constexpr std::uint16_t min_adu_length = framing_type::min_adu_length;
 
     /**
      * @brief The maximum function ID
@@ -1063,9 +1074,9 @@ public:
      * @brief The request type for reading
      *
      * This is the request type for reading, which is a packet with a header,
-     * request fields, and a CRC.
+     * request fields, and the framing (CRC or MBAP prefix).
      */
-    using request_type_read = packet<header, request_fields_read, crc16ansi>;
+    using request_type_read = typename framing_type::template packet_type<header, request_fields_read>;
 
     /**
      * @brief The request type for writing a single register
@@ -1073,7 +1084,7 @@ public:
      * This is the request type for writing a single register, which is a packet
      * with a header, request fields, and a CRC.
      */
-    using request_type_wr_single = packet<header, request_fields_wr_single, crc16ansi>;
+    using request_type_wr_single = typename framing_type::template packet_type<header, request_fields_wr_single>;
 
     /**
      * @brief The request type for writing a mask of registers
@@ -1081,7 +1092,7 @@ public:
      * This is the request type for writing a mask of registers, which is a packet
      * with a header, request fields, and a CRC.
      */
-    using request_type_wr_mask = packet<header, request_fields_wr_mask, crc16ansi>;
+    using request_type_wr_mask = typename framing_type::template packet_type<header, request_fields_wr_mask>;
 
     /**
      * @brief The request type for errors
@@ -1089,7 +1100,7 @@ public:
      * This is the request type for errors, which is a packet with a header and a
      * CRC.
      */
-    using request_type_err = packet<header, null_field, crc16ansi>;
+    using request_type_err = typename framing_type::template packet_type<header, null_field>;
 
     /**
      * @brief The request type for the FIFO
@@ -1097,7 +1108,7 @@ public:
      * This is the request type for the FIFO, which is a packet with a header and a
      * function code.
      */
-    using request_type_fifo = packet<header, func::msb_t<std::uint16_t>, crc16ansi>;
+    using request_type_fifo = typename framing_type::template packet_type<header, func::msb_t<std::uint16_t>>;
 
     /**
      * @brief The request type for the log
@@ -1105,7 +1116,7 @@ public:
      * This is the request type for the log, which is a packet with a header,
      * request fields, and a CRC.
      */
-    using request_type_log = packet<header, request_fields_log, crc16ansi>;
+    using request_type_log = typename framing_type::template packet_type<header, request_fields_log>;
 
     /**
      * @brief The request type for the log level
@@ -1113,7 +1124,7 @@ public:
      * This is the request type for the log level, which is a packet with a header
      * and a CRC.
      */
-    using request_type_log_level = packet<header, null_field, crc16ansi>;
+    using request_type_log_level = typename framing_type::template packet_type<header, null_field>;
 
     /**
      * @brief The message type
@@ -1144,6 +1155,95 @@ protected:
      */
     std::uint16_t                diagnostic_register_{};
     std::array<std::uint16_t, 8> counters_{};
+    /**
+     * @brief The state of the byte-wise reception, see receive_byte()
+     */
+    typename framing_type::stream stream_{};
+    std::size_t                   stream_size_{};
+    bool                          stream_overrun_{};
+
+    /**
+     * @brief Points the output message to the TX buffer of the transport, if it gives one
+     */
+    inline void
+    prepare_output() noexcept
+    {
+        prepare_output(transmit_buffer());
+    }
+
+    inline void
+    prepare_output(std::span<std::uint8_t> buffer) noexcept
+    {
+        if (buffer.size() >= max_adu_length) {
+            output_msg_.borrow(buffer);
+        } else {
+            output_msg_.release();
+        }
+    }
+
+    /**
+     * @brief Checks a complete frame before it is taken in
+     */
+    template <class InputIterator>
+    constexpr exception
+    accept(InputIterator begin, InputIterator end) noexcept
+    {
+        return accept(idle(), begin, end);
+    }
+
+    /**
+     * @brief Checks a complete frame, `ready` is the result of idle() of the caller
+     */
+    template <class InputIterator>
+    constexpr exception
+    accept(bool ready, InputIterator begin, InputIterator end) noexcept
+    {
+        if (!ready) [[unlikely]] {
+            increment_counter(diagnostics_sub_function::return_bus_char_overrun_count);
+            increment_counter(diagnostics_sub_function::return_server_busy_count);
+            ERROR() << "busy";
+            return exception::slave_or_server_busy;
+        }
+        if ((end - begin) < min_adu_length) [[unlikely]] {
+            increment_counter(diagnostics_sub_function::return_bus_comm_error_count);
+            ERROR() << "ADU < " << min_adu_length;
+            return exception::bad_data;
+        }
+        if (static_cast<std::size_t>(end - begin) > max_adu_length) [[unlikely]] {
+            increment_counter(diagnostics_sub_function::return_bus_comm_error_count);
+            ERROR() << "ADU > MAX";
+            return exception::bad_data;
+        }
+        if (!framing_type::valid(begin, end)) [[unlikely]] {
+            increment_counter(diagnostics_sub_function::return_bus_comm_error_count);
+            if constexpr (framing_type::suffix_length > 0) {
+                WARN() << "bad_crc";
+                return exception::bad_crc;
+            } else {
+                WARN() << "bad_frame";
+                return exception::bad_data;
+            }
+        }
+        return exception::no_error;
+    }
+
+    /**
+     * @brief receive() with idle() and received() called on `self`
+     */
+    template <class Self, class InputIterator>
+    constexpr exception
+    receive_as(Self& self, InputIterator begin, InputIterator end) noexcept
+    {
+        static_assert(sizeof(*begin) == 1);
+        if (auto const error = accept(self.idle(), begin, end); error != exception::no_error) [[unlikely]] {
+            return error;
+        }
+        input_msg_.release();
+        std::copy(begin, end, input_msg_.storage().data());
+        input_msg_.size(end - begin);
+        TRACE() << "recv msg";
+        return self.received();
+    }
 
 public:
     inline void
@@ -1252,15 +1352,29 @@ public:
      * @return false If the message could not be sent
      */
     virtual bool
-    send(msg_type::array_type::iterator begin, msg_type::array_type::iterator end) noexcept
+    send(typename msg_type::array_type::iterator begin, typename msg_type::array_type::iterator end) noexcept
         = 0;
 
+    /**
+     * @brief Gives the TX buffer of the transport to serialize the next message into
+     *
+     * If the transport returns a buffer of at least `max_adu_length` bytes, the output message is built directly in it
+     * and send() gets iterators into that buffer. By default the message is built in the own storage of the object.
+     *
+     * @return The writable TX buffer or an empty span
+     */
+    virtual std::span<std::uint8_t>
+    transmit_buffer() noexcept
+    {
+        return {};
+    }
+
     /**
      * @brief Receives a message
      *
      * @param begin An iterator to the beginning of the message
      * @param end An iterator to the end of the message
-     * @return exception::bad_data If the message is not long enough
+     * @return exception::bad_data If the message is not long enough or its MBAP header is malformed
      * @return exception::bad_crc If the CRC does not match
      * @return exception::slave_or_server_busy If the slave is busy
      */
@@ -1268,33 +1382,107 @@ public:
     constexpr exception
     receive(InputIterator begin, InputIterator end) noexcept
     {
-        static_assert(sizeof(*begin) == 1);
+        return receive_as(*this, begin, end);
+    }
+
+    /**
+     * @brief Receives a message without copying it
+     *
+     * The input message borrows the frame, it is parsed in place. The buffer is used until the object is idle again and
+     * must not be touched by the transport meanwhile.
+     *
+     * @param frame The received frame, e.g. in the RX buffer of the transport
+     * @return exception::bad_data If the message is not long enough or its MBAP header is malformed
+     * @return exception::bad_crc If the CRC does not match
+     * @return exception::slave_or_server_busy If the slave is busy
+     */
+    exception
+    receive_in_place(std::span<std::uint8_t> frame) noexcept
+    {
+        if (auto const error = accept(frame.begin(), frame.end()); error != exception::no_error) [[unlikely]] {
+            return error;
+        }
+        input_msg_.borrow(frame);
+        input_msg_.size(frame.size());
+        TRACE() << "recv msg in place";
+        return received();
+    }
+
+    /**
+     * @brief Receives one byte of a frame
+     *
+     * The byte is stored in place in the input message and the checksum is updated as it arrives, so the frame is
+     * already validated when the last byte lands. Call receive_end() at the end of the frame, e.g. on the 3.5
+     * character silence of a serial line.
+     *
+     * @param byte The received byte
+     * @return exception::no_error If the byte was stored
+     * @return exception::bad_data If the frame is longer than the maximal ADU, the rest of the frame is dropped
+     * @return exception::slave_or_server_busy If the previous message is still being processed, the byte is dropped
+     */
+    constexpr exception
+    receive_byte(std::uint8_t byte) noexcept
+    {
+        if (!idle()) [[unlikely]] {
+            return exception::slave_or_server_busy;
+        }
+        if (stream_size_ >= max_adu_length) [[unlikely]] {
+            stream_overrun_ = true;
+            return exception::bad_data;
+        }
+        if (stream_size_ == 0) {
+            input_msg_.release();
+        }
+        input_msg_.storage()[stream_size_++] = byte;
+        stream_.update(byte);
+        return exception::no_error;
+    }
+
+    /**
+     * @brief Completes the frame received by receive_byte()
+     *
+     * Errors are counted and reported like receive() does, the byte-wise reception restarts in any case.
+     *
+     * @return exception::bad_data If the frame is too short, too long or its MBAP header is malformed
+     * @return exception::bad_crc If the CRC does not match
+     * @return exception::slave_or_server_busy If the slave is busy
+     */
+    constexpr exception
+    receive_end() noexcept
+    {
+        auto const size    = stream_size_;
+        auto const overrun = stream_overrun_;
+        auto const valid   = stream_.valid(input_msg_.storage().data(), input_msg_.storage().data() + size);
+        stream_.reset();
+        stream_size_    = 0;
+        stream_overrun_ = false;
         if (!idle()) [[unlikely]] {
             increment_counter(diagnostics_sub_function::return_bus_char_overrun_count);
             increment_counter(diagnostics_sub_function::return_server_busy_count);
             ERROR() << "busy";
             return exception::slave_or_server_busy;
         }
-        if ((end - begin) < min_adu_length) [[unlikely]] {
+        if (size < min_adu_length) [[unlikely]] {
             increment_counter(diagnostics_sub_function::return_bus_comm_error_count);
-            ERROR() << "ADU < 3";
+            ERROR() << "ADU < " << min_adu_length;
             return exception::bad_data;
         }
-        if (static_cast<std::size_t>(end - begin) > max_adu_length) [[unlikely]] {
-            increment_counter(diagnostics_sub_function::return_bus_comm_error_count);
+        if (overrun) [[unlikely]] {
+            increment_counter(diagnostics_sub_function::return_bus_char_overrun_count);
             ERROR() << "ADU > MAX";
             return exception::bad_data;
         }
-        auto const crc_ptr        = end - sizeof(crc16ansi::value_type);
-        auto       crc            = func::data<crc16ansi::value_type>::deserialize(crc_ptr);
-        auto       crc_calculated = crc16ansi::calculate(begin, crc_ptr);
-        if (crc.get() != crc_calculated.get()) {
+        if (!valid) [[unlikely]] {
             increment_counter(diagnostics_sub_function::return_bus_comm_error_count);
-            WARN() << "bad_crc";
-            return exception::bad_crc;
+            if constexpr (framing_type::suffix_length > 0) {
+                WARN() << "bad_crc";
+                return exception::bad_crc;
+            } else {
+                WARN() << "bad_frame";
+                return exception::bad_data;
+            }
         }
-        std::copy(begin, end, input_msg_.storage().begin());
-        input_msg_.size(end - begin);
+        input_msg_.size(size);
         TRACE() << "recv msg";
         return received();
     }
@@ -1371,13 +1559,26 @@ public:
     /**
      * @brief Destroys the modbus_base object
      */
-    virtual ~modbus_base() = default;
+    virtual ~basic_modbus_base() = default;
 };
 
+/**
+ * @brief The serial line (Modbus RTU) protocol base
+ */
+using modbus_base = basic_modbus_base<rtu>;
+
 template <std::uint16_t Inputs, std::uint16_t Coils, std::uint16_t InputRegisters, std::uint16_t HoldingRegisters,
-          std::uint16_t Fifo = 1>
+          std::uint16_t Fifo = 1, framing_policy Framing = rtu, function... Functions>
 class slave;
 
+template <std::uint16_t Inputs, std::uint16_t Coils, std::uint16_t InputRegisters, std::uint16_t HoldingRegisters,
+          std::uint16_t Fifo = 1, framing_policy Framing = rtu, function... Functions>
+class packed_slave;
+
+template <std::uint16_t Inputs, std::uint16_t Coils, std::uint16_t InputRegisters, std::uint16_t HoldingRegisters,
+          std::uint16_t Fifo = 1, framing_policy Framing = rtu, function... Functions>
+class concurrent_slave;
+
 /**
  * @brief Concept to check if a type is a container
  *
@@ -1389,22 +1590,82 @@ class slave;
  * - `size_type`, which is an unsigned integer type used to represent the size of the container; and
  * - `value_type`, which is the type of the elements stored in the container.
  *
- * In addition, the type must provide two non-member functions:
- * - `size(T const& c)`, which returns the size of the container `c` as a `size_type`; and
- * - `operator[](T const& c, size_type n)`, which returns a reference to the element at index `n` in the container `c`.
+ * In addition, the type must provide two member functions:
+ * - `size()`, which returns the size of the container as a `size_type`; and
+ * - `operator[](size_type n)`, which gives access to the element at index `n`: a reference or a proxy that converts
+ *   to `value_type` and can be assigned one, so bits may be stored packed (see packed_bits).
  *
  **/
 template <class T>
-concept modbus_slave_container = requires(T a, std::size_t s) {
+concept modbus_slave_container = requires(T a, std::size_t s, typename T::value_type v) {
     {
         a.size()
     } -> std::same_as<typename T::size_type>;
     {
         a[s]
-    } -> std::same_as<typename T::value_type&>;
+    } -> std::convertible_to<typename T::value_type>;
+    a[s] = v;
+};
+
+/**
+ * @brief Concept of a bit container storing its bools contiguously, one per byte, e.g. `std::array<bool, N>`
+ *
+ * Ranges of such containers are packed and unpacked in bulk by bits_engine.
+ */
+template <class T>
+concept contiguous_bits = std::same_as<typename T::value_type, bool> && requires(T a) {
+    {
+        a.data()
+    } -> std::convertible_to<bool const*>;
+};
+
+/**
+ * @brief Concept of a register container storing its registers contiguously, e.g. `std::array<std::uint16_t, N>`
+ *
+ * Ranges of such containers are converted from and to the wire byte order in bulk by registers_engine.
+ */
+template <class T>
+concept contiguous_registers = std::same_as<typename T::value_type, std::uint16_t> && requires(T a) {
+    {
+        a.data()
+    } -> std::convertible_to<std::uint16_t const*>;
+};
+
+/**
+ * @brief Concept of a bit container reading and writing ranges in the Modbus bit field layout, e.g. packed_bits
+ */
+template <class T>
+concept packed_bit_container
+    = std::same_as<typename T::value_type, bool>
+      && requires(T a, T const& c, std::size_t s, std::uint8_t* out, std::uint8_t const* in) {
+             c.read(s, s, out);
+             a.write(s, s, in);
+         };
+
+/**
+ * @brief Concept of a register container copying ranges out as one consistent snapshot and publishing ranges at once,
+ * e.g. concurrent_registers
+ */
+template <class T>
+concept snapshot_registers
+    = std::same_as<typename T::value_type, std::uint16_t>
+      && requires(T a, T const& c, std::size_t s, std::uint16_t* out, std::span<std::uint16_t const> in) {
+             c.read(s, s, out);
+             a.update(s, in);
+         };
+
+/**
+ * @brief Concept of a container that does not store every address up to its size(), e.g. sparse_image
+ */
+template <class T>
+concept sparse_container = requires(T const& c, std::size_t s) {
+    {
+        c.contains(s, s)
+    } -> std::convertible_to<bool>;
 };
 
 template <modbus_slave_container TInputs, modbus_slave_container TCoils, modbus_slave_container TInputRegisters,
-          modbus_slave_container THoldingRegisters, std::uint16_t Fifo>
+          modbus_slave_container THoldingRegisters, std::uint16_t Fifo, framing_policy Framing = rtu,
+          function... Functions>
 class slave_base;
 }    // namespace xitren::modbus
@@ -0,0 +1,197 @@
+/*!
+_ _
+__ _(_) |_ _ _ ___ _ _
+\ \ / |  _| '_/ -_) ' \
+/_\_\_|\__|_| \___|_||_|
+* @date 15.02.2024
+*/
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace xitren::modbus {
+
+/**
+ * @brief A fixed size array of bits stored in 64-bit words
+ *
+ * Takes one bit per coil or discrete input instead of one byte. Ranges are read and written in the Modbus bit field
+ * layout (LSB first) with shifts and masks on whole words, 64 bits per step, whatever the alignment of the range.
+ *
+ * @tparam Size The number of bits.
+ */
+template <std::size_t Size>
+class packed_bits {
+public:
+    using word_type  = std::uint64_t;
+    using size_type  = std::size_t;
+    using value_type = bool;
+
+    static constexpr size_type word_bits = 64;
+    static constexpr size_type words     = (Size + word_bits - 1) / word_bits;
+
+    /**
+     * @brief Proxy to a single bit
+     */
+    class reference {
+    public:
+        constexpr reference(word_type& word, word_type mask) noexcept : word_{word}, mask_{mask} {}
+
+        constexpr reference(reference const&) noexcept = default;
+
+        constexpr
+        operator bool() const noexcept
+        {
+            return (word_ & mask_) != 0;
+        }
+
+        constexpr reference&
+        operator=(bool value) noexcept
+        {
+            word_ = value ? (word_ | mask_) : (word_ & ~mask_);
+            return *this;
+        }
+
+        constexpr reference&
+        operator=(reference const& other) noexcept
+        {
+            return *this = static_cast<bool>(other);
+        }
+
+        ~reference() noexcept = default;
+
+    private:
+        word_type& word_;
+        word_type  mask_;
+    };
+
+    [[nodiscard]] constexpr size_type
+    size() const noexcept
+    {
+        return Size;
+    }
+
+    constexpr reference
+    operator[](size_type index) noexcept
+    {
+        return {words_[index / word_bits], word_type{1} << (index % word_bits)};
+    }
+
+    constexpr bool
+    operator[](size_type index) const noexcept
+    {
+        return test(index);
+    }
+
+    [[nodiscard]] constexpr bool
+    test(size_type index) const noexcept
+    {
+        return (words_[index / word_bits] >> (index % word_bits)) & 1U;
+    }
+
+    constexpr void
+    set(size_type index, bool value) noexcept
+    {
+        (*this)[index] = value;
+    }
+
+    constexpr void
+    fill(bool value) noexcept
+    {
+        words_.fill(value ? ~word_type{} : word_type{});
+    }
+
+    /**
+     * @brief Packs the bits [start, start + count) into Modbus bit field bytes, the last byte is padded with zeros
+     *
+     * @param start The first bit.
+     * @param count The number of bits, the range must be within the array.
+     * @param dst The destination, `(count + 7) / 8` bytes.
+     */
+    constexpr void
+    read(size_type start, size_type count, std::uint8_t* dst) const noexcept
+    {
+        for (; count > 0; start += word_bits) {
+            auto const bits  = std::min(count, word_bits);
+            auto       value = extract(start);
+            if (bits < word_bits) {
+                value &= (word_type{1} << bits) - 1;
+            }
+            for (size_type byte{}; byte * 8 < bits; byte++) {
+                *dst++ = static_cast<std::uint8_t>(value >> (byte * 8));
+            }
+            count -= bits;
+        }
+    }
+
+    /**
+     * @brief Unpacks Modbus bit field bytes into the bits [start, start + count)
+     *
+     * @param start The first bit.
+     * @param count The number of bits, the range must be within the array.
+     * @param src The source, `(count + 7) / 8` bytes.
+     */
+    constexpr void
+    write(size_type start, size_type count, std::uint8_t const* src) noexcept
+    {
+        for (; count > 0; start += word_bits) {
+            auto const bits = std::min(count, word_bits);
+            word_type  value{};
+            for (size_type byte{}; byte * 8 < bits; byte++) {
+                value |= word_type{*src++} << (byte * 8);
+            }
+            auto const mask = (bits < word_bits) ? ((word_type{1} << bits) - 1) : ~word_type{};
+            deposit(start, value & mask, mask);
+            count -= bits;
+        }
+    }
+
+    /**
+     * @brief The underlying words, bit i is bit i % 64 of word i / 64
+     */
+    [[nodiscard]] constexpr std::array<word_type, words> const&
+    data() const noexcept
+    {
+        return words_;
+    }
+
+    constexpr std::array<word_type, words>&
+    data() noexcept
+    {
+        return words_;
+    }
+
+private:
+    std::array<word_type, words> words_{};
+
+    /**
+     * @brief The 64 bits starting at `start`, bits past the end are zero
+     */
+    [[nodiscard]] constexpr word_type
+    extract(size_type start) const noexcept
+    {
+        auto const index = start / word_bits;
+        auto const shift = start % word_bits;
+        word_type  value{words_[index] >> shift};
+        if ((shift != 0) && (index + 1 < words)) {
+            value |= words_[index + 1] << (word_bits - shift);
+        }
+        return value;
+    }
+
+    constexpr void
+    deposit(size_type start, word_type value, word_type mask) noexcept
+    {
+        auto const index = start / word_bits;
+        auto const shift = start % word_bits;
+        words_[index]    = (words_[index] & ~(mask << shift)) | (value << shift);
+        if ((shift != 0) && (index + 1 < words)) {
+            auto const high   = word_bits - shift;
+            words_[index + 1] = (words_[index + 1] & ~(mask >> high)) | (value >> high);
+        }
+    }
+};
+
+}    // namespace xitren::modbus
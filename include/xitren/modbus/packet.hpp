@@ -10,9 +10,13 @@ __ _(_) |_ _ _ ___ _ _
 #include <xitren/circular_buffer.hpp>
 #include <xitren/func/data.hpp>
 #include <xitren/modbus/crc16ansi.hpp>
+#include <xitren/modbus/framing.hpp>
 
+#include <algorithm>
+#include <array>
 #include <concepts>
 #include <cstdint>
+#include <span>
 
 namespace xitren::modbus {
 
@@ -242,6 +246,30 @@ class packet_accessor {
 
 public:
     using array_type = std::array<std::uint8_t, Max>;
+    using view_type  = std::span<std::uint8_t>;
+
+    constexpr packet_accessor() noexcept = default;
+
+    /**
+     * Copies the packet into the own storage of the new accessor, a borrowed buffer is not shared.
+     */
+    constexpr packet_accessor(packet_accessor const& other) noexcept : size_{other.size_}
+    {
+        std::copy(other.view_.data(), other.view_.data() + size_, storage_.begin());
+    }
+
+    constexpr packet_accessor&
+    operator=(packet_accessor const& other) noexcept
+    {
+        if (this != &other) {
+            size_ = other.size_;
+            std::copy(other.view_.data(), other.view_.data() + size_, storage_.begin());
+            view_ = storage_;
+        }
+        return *this;
+    }
+
+    ~packet_accessor() noexcept = default;
 
     /**
      * A structure used to return packet fields.
@@ -334,21 +362,24 @@ public:
      * @tparam Header The packet header type.
      * @tparam Fields The packet fields type.
      * @tparam Type The packet data type.
-     * @tparam Crc The CRC type.
+     * @tparam Framing The CRC type or the framing policy of the ADU.
      * @return A structure containing the packet fields.
      */
-    template <typename Header, typename Fields, typename Type, crc::crc_concept Crc>
+    template <typename Header, typename Fields, typename Type, typename Framing>
     auto
     deserialize_no_check() const noexcept
     {
         using return_type          = fields_out_ptr<Header, Fields, Type>;
-        constexpr size_type length = (sizeof(Header) + sizeof(Fields) + sizeof(typename Crc::value_type));
+        using framing_type         = framing_of_t<Framing>;
+        constexpr size_type length = (framing_type::prefix_length + sizeof(Header) + sizeof(Fields)
+                                      + framing_type::suffix_length);
         static_assert(sizeof(Type) != 0);
         static_assert(Max >= length);
         size_type const variable_part = (size_ - length) / sizeof(Type);
-        auto            header_conv   = reinterpret_cast<Header const*>(storage_.begin());
-        auto            fields_conv   = reinterpret_cast<Fields const*>(storage_.begin() + sizeof(Header));
-        auto            data_conv = reinterpret_cast<Type const*>(storage_.begin() + sizeof(Header) + sizeof(Fields));
+        auto const      body          = view_.data() + framing_type::prefix_length;
+        auto            header_conv   = reinterpret_cast<Header const*>(body);
+        auto            fields_conv   = reinterpret_cast<Fields const*>(body + sizeof(Header));
+        auto            data_conv     = reinterpret_cast<Type const*>(body + sizeof(Header) + sizeof(Fields));
         return return_type{header_conv, fields_conv, variable_part, data_conv};
     }
 
@@ -358,61 +389,103 @@ public:
      * @tparam Header The packet header type.
      * @tparam Fields The packet fields type.
      * @tparam Type The packet data type.
-     * @tparam Crc The CRC type.
+     * @tparam Framing The CRC type or the framing policy of the ADU.
      * @return A structure containing the packet fields.
      */
-    template <typename Header, typename Fields, typename Type, crc::crc_concept Crc>
+    template <typename Header, typename Fields, typename Type, typename Framing>
     constexpr auto
     deserialize() const
     {
         using return_type          = fields_out<Header, Fields, Type>;
-        constexpr size_type length = (sizeof(Header) + sizeof(Fields) + sizeof(typename Crc::value_type));
+        using framing_type         = framing_of_t<Framing>;
+        constexpr size_type length = (framing_type::prefix_length + sizeof(Header) + sizeof(Fields)
+                                      + framing_type::suffix_length);
         static_assert(sizeof(Type) != 0);
         static_assert(Max >= length);
         size_type const variable_part = (size_ - length) / sizeof(Type);
         if (((size_ - length) % sizeof(Type))) {
             return return_type{{}, {}, false, 0, nullptr};
         }
-        auto                     header_conv = func::data<Header>::deserialize(storage_.begin());
-        auto                     fields_conv = func::data<Fields>::deserialize(storage_.begin() + sizeof(Header));
-        auto                     crc_conv = func::data<typename Crc::value_type>::deserialize(storage_.begin() + size_
-                                                                                              - sizeof(typename Crc::value_type));
-        typename Crc::value_type crc_calc
-            = Crc::calculate(storage_.begin(), storage_.begin() + size_ - sizeof(typename Crc::value_type));
-        return return_type{header_conv, fields_conv, crc_conv.get() == crc_calc.get(), variable_part,
-                           reinterpret_cast<Type const*>(storage_.begin() + sizeof(Header) + sizeof(Fields))};
+        auto const body        = view_.data() + framing_type::prefix_length;
+        auto       header_conv = func::data<Header>::deserialize(body);
+        auto       fields_conv = func::data<Fields>::deserialize(body + sizeof(Header));
+        return return_type{header_conv, fields_conv, framing_type::valid(view_.data(), view_.data() + size_),
+                           variable_part, reinterpret_cast<Type const*>(body + sizeof(Header) + sizeof(Fields))};
+    }
+
+    /**
+     * Returns the number of data elements that fit into the packet after the header and the fields.
+     *
+     * @tparam Header The packet header type.
+     * @tparam Fields The packet fields type.
+     * @tparam Type The packet data type.
+     * @tparam Framing The CRC type or the framing policy of the ADU.
+     * @return The maximal data size.
+     */
+    template <typename Header, typename Fields, typename Type, typename Framing>
+    static constexpr size_type
+    capacity() noexcept
+    {
+        using framing_type         = framing_of_t<Framing>;
+        constexpr size_type length = (framing_type::prefix_length + sizeof(Header) + sizeof(Fields)
+                                      + framing_type::suffix_length);
+        static_assert(Max >= length);
+        return (Max - length) / sizeof(Type);
+    }
+
+    /**
+     * Returns the place of the packet data, to fill it before serialize() is called with no data pointer.
+     *
+     * Filling the data in place saves a scratch buffer and a copy, at most capacity() elements may be written.
+     *
+     * @tparam Header The packet header type.
+     * @tparam Fields The packet fields type.
+     * @tparam Type The packet data type.
+     * @tparam Framing The CRC type or the framing policy of the ADU.
+     * @return A pointer to the first data element.
+     */
+    template <typename Header, typename Fields, typename Type, typename Framing>
+    Type*
+    payload() noexcept
+    {
+        using framing_type = framing_of_t<Framing>;
+        static_assert(alignof(Type) == 1);
+        return reinterpret_cast<Type*>(view_.data() + framing_type::prefix_length + sizeof(Header) + sizeof(Fields));
     }
 
     /**
      * Serializes packet fields.
      *
+     * If `input.data` is null, the `input.size` data elements are expected to be in place already, see payload().
+     *
      * @tparam Header The packet header type.
      * @tparam Fields The packet fields type.
      * @tparam Type The packet data type.
-     * @tparam Crc The CRC type.
+     * @tparam Framing The CRC type or the framing policy of the ADU.
      * @param input The packet fields to serialize.
      * @return `true` if the serialization was successful, `false` otherwise.
      */
-    template <typename Header, typename Fields, typename Type, crc::crc_concept Crc>
+    template <typename Header, typename Fields, typename Type, typename Framing>
     constexpr bool
     serialize(fields_in<Header, Fields, Type> const& input)
     {
-        constexpr size_type length = (sizeof(Header) + sizeof(Fields) + sizeof(typename Crc::value_type));
+        using framing_type         = framing_of_t<Framing>;
+        constexpr size_type length = (framing_type::prefix_length + sizeof(Header) + sizeof(Fields)
+                                      + framing_type::suffix_length);
         static_assert(sizeof(Type) != 0);
         static_assert(Max >= length);
-        if ((input.size * sizeof(Type) + length) > Max) {
+        if ((input.size * sizeof(Type) + length) > view_.size()) {
             return false;
         }
-        func::data<Header>::serialize(input.header, storage_.begin());
-        func::data<Fields>::serialize(input.fields, storage_.begin() + sizeof(Header));
+        auto const body = view_.data() + framing_type::prefix_length;
+        func::data<Header>::serialize(input.header, body);
+        func::data<Fields>::serialize(input.fields, body + sizeof(Header));
         if ((input.size > 0) && (input.data != nullptr)) {
             std::copy(reinterpret_cast<uint8_t const*>(input.data),
                       reinterpret_cast<uint8_t const*>(input.data + input.size),
-                      reinterpret_cast<uint8_t*>(storage_.begin() + sizeof(Header) + sizeof(Fields)));
+                      reinterpret_cast<uint8_t*>(body + sizeof(Header) + sizeof(Fields)));
         }
-        auto const crc_ptr = storage_.begin() + sizeof(Header) + sizeof(Fields) + input.size * sizeof(Type);
-        typename Crc::value_type const crc{Crc::calculate(storage_.begin(), crc_ptr)};
-        func::data<typename Crc::value_type>::serialize(crc, crc_ptr);
+        framing_type::seal(view_.data(), body + sizeof(Header) + sizeof(Fields) + input.size * sizeof(Type));
         size_ = length + input.size * sizeof(Type);
         return true;
     }
@@ -440,29 +513,62 @@ public:
     }
 
     /**
-     * Returns a reference to the packet storage.
+     * Returns the packet storage, the own storage or the borrowed buffer.
      *
-     * @return A reference to the packet storage.
+     * @return A view of the packet storage.
      */
-    inline array_type&
+    inline view_type
     storage() noexcept
     {
-        return storage_;
+        return view_;
     }
 
     /**
-     * Returns a constant reference to the packet storage.
+     * Returns the packet storage, read only.
      *
-     * @return A constant reference to the packet storage.
+     * @return A constant view of the packet storage.
      */
-    inline array_type const&
+    inline std::span<std::uint8_t const>
     storage() const noexcept
     {
-        return storage_;
+        return view_;
+    }
+
+    /**
+     * Makes the accessor work in place on a buffer owned by someone else, e.g. the RX or TX buffer of a transport.
+     *
+     * Nothing is copied, the buffer must stay valid until release() or the next borrow(). A received frame only needs
+     * its own bytes, serialize() fails if the packet does not fit the buffer.
+     *
+     * @param buffer The buffer, at most `Max` bytes of it are used.
+     */
+    inline void
+    borrow(view_type buffer) noexcept
+    {
+        view_ = buffer.first(std::min(buffer.size(), Max));
+    }
+
+    /**
+     * Returns to the own storage of the accessor, the contents of a borrowed buffer are not copied back.
+     */
+    constexpr void
+    release() noexcept
+    {
+        view_ = storage_;
+    }
+
+    /**
+     * Checks if the accessor works on a borrowed buffer.
+     */
+    [[nodiscard]] constexpr bool
+    borrowed() const noexcept
+    {
+        return view_.data() != storage_.data();
     }
 
 private:
     array_type storage_{};
+    view_type  view_{storage_};
     size_type  size_{};
 };
 
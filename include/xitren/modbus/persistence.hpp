@@ -0,0 +1,676 @@
+/*!
+_ _
+__ _(_) |_ _ _ ___ _ _
+\ \ / |  _| '_/ -_) ' \
+/_\_\_|\__|_| \___|_||_|
+* @date 15.02.2024
+*/
+#pragma once
+
+#include <xitren/modbus/crc16ansi.hpp>
+#include <xitren/modbus/dirty_bits.hpp>
+#include <xitren/modbus/modbus.hpp>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Keeps the coils and holding registers of a slave across restarts
+ *
+ * Two files: a memory mapped snapshot of both tables and an append-only journal of the ranges written since the
+ * snapshot. The journal is appended in batches, a compaction folds it into the snapshot. Values are kept in the host
+ * byte order.
+ */
+namespace xitren::modbus::persistence {
+
+/**
+ * @brief The header at the start of the snapshot file
+ */
+struct snapshot_header {
+    static constexpr std::uint32_t magic_value = 0x5053'4D58;    // "XMSP"
+    static constexpr std::uint32_t layout      = 1;
+
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint32_t coils;
+    std::uint32_t holding_registers;
+    std::uint64_t epoch; /*!< Advanced by every compaction, the journal of another epoch is stale. */
+};
+
+/**
+ * @brief The header at the start of the journal file
+ */
+struct journal_header {
+    static constexpr std::uint32_t magic_value = 0x4A4E'4D58;    // "XMNJ"
+    static constexpr std::uint32_t layout      = 1;
+
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint64_t epoch;
+};
+
+/**
+ * @brief The kind of a journal record
+ */
+enum class record_kind : std::uint8_t { coils = 1, holding_registers = 2 };
+
+/**
+ * @brief The fixed part of a journal record
+ *
+ * A record is followed by its payload, the Modbus bit field of `count` coils or `count` registers, and the CRC-16 of
+ * the record and the payload, LSB first. Replay stops at the first torn or corrupted record.
+ */
+struct record_header {
+    record_kind   kind;
+    std::uint16_t start;
+    std::uint16_t count;
+} __attribute__((__packed__));
+
+/**
+ * @brief The snapshot and the journal of a coils and a holding registers table
+ *
+ * Records are collected in memory by append_coils() / append_holdings() and written to the journal by flush() with a
+ * single write; nothing is synced unless asked. The batch is allocated once by the constructor and holds batch_bytes,
+ * twice the records of both whole tables. compact() writes the tables into the snapshot mapping, syncs it,
+ * advances the epoch and empties the journal; a crash at any point leaves a snapshot that, with the journal of its
+ * epoch, restores the tables as of the last flush.
+ *
+ * Check valid() after construction.
+ *
+ * @tparam Coils The number of coils.
+ * @tparam HoldingRegisters The number of holding registers.
+ */
+template <std::size_t Coils, std::size_t HoldingRegisters>
+class store {
+public:
+    static constexpr std::size_t coil_bytes            = (Coils + 7) / 8;
+    static constexpr std::size_t coils_offset          = 64;
+    static constexpr std::size_t holding_regs_offset   = (coils_offset + coil_bytes + 1) / 2 * 2;
+    static constexpr std::size_t snapshot_size         = holding_regs_offset + HoldingRegisters * 2;
+    static constexpr std::size_t max_record_elements   = 2048;
+    static constexpr std::size_t default_compact_bytes = 1024 * 1024;
+    static constexpr std::size_t record_overhead       = sizeof(record_header) + 2;
+    static constexpr std::size_t image_records
+        = (Coils + max_record_elements - 1) / max_record_elements
+          + (HoldingRegisters + max_record_elements - 1) / max_record_elements;
+    static constexpr std::size_t batch_bytes
+        = 2 * (coil_bytes + HoldingRegisters * 2 + image_records * record_overhead);
+
+    static_assert(sizeof(snapshot_header) <= coils_offset);
+
+    /**
+     * @brief Opens or creates the snapshot and the journal
+     *
+     * A missing or empty snapshot is created with all values zero, as is one whose header is still zero: a crash
+     * between sizing the file and writing the header leaves it so. A snapshot of another layout is rejected.
+     */
+    store(char const* snapshot_path, char const* journal_path) noexcept
+    {
+        int const snapshot_fd{::open(snapshot_path, O_RDWR | O_CREAT | O_CLOEXEC, 0640)};
+        if (snapshot_fd < 0) [[unlikely]] {
+            return;
+        }
+        struct stat info {};
+        bool        fresh{(::fstat(snapshot_fd, &info) == 0) && (info.st_size == 0)};
+        if ((fresh && (::ftruncate(snapshot_fd, snapshot_size) != 0))
+            || (!fresh && (static_cast<std::size_t>(info.st_size) != snapshot_size))) [[unlikely]] {
+            ::close(snapshot_fd);
+            return;
+        }
+        void* address{::mmap(nullptr, snapshot_size, PROT_READ | PROT_WRITE, MAP_SHARED, snapshot_fd, 0)};
+        ::close(snapshot_fd);
+        if (address == MAP_FAILED) [[unlikely]] {
+            return;
+        }
+        snapshot_ = static_cast<std::uint8_t*>(address);
+        fresh     = fresh || (header().magic == 0);
+        if (fresh) {
+            snapshot_header const header{snapshot_header::magic_value, snapshot_header::layout,
+                                         static_cast<std::uint32_t>(Coils),
+                                         static_cast<std::uint32_t>(HoldingRegisters), 0};
+            std::memcpy(snapshot_, &header, sizeof(header));
+            ::msync(snapshot_, snapshot_size, MS_SYNC);
+        } else if (!compatible()) [[unlikely]] {
+            release();
+            return;
+        }
+        journal_fd_ = ::open(journal_path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0640);
+        if ((journal_fd_ < 0) || (::fstat(journal_fd_, &info) != 0)) [[unlikely]] {
+            release();
+            return;
+        }
+        journal_size_ = static_cast<std::size_t>(info.st_size);
+        if ((journal_size_ == 0) && !reset_journal()) [[unlikely]] {
+            release();
+            return;
+        }
+        batch_.reserve(batch_bytes);
+    }
+
+    store(store const&) = delete;
+    store&
+    operator=(store const&)
+        = delete;
+
+    ~store() noexcept
+    {
+        flush(true);
+        release();
+    }
+
+    /**
+     * @brief Returns true if both files are open and the snapshot has the layout of this store
+     */
+    [[nodiscard]] inline bool
+    valid() const noexcept
+    {
+        return (snapshot_ != nullptr) && (journal_fd_ >= 0);
+    }
+
+    [[nodiscard]] inline std::uint64_t
+    epoch() const noexcept
+    {
+        return header().epoch;
+    }
+
+    /**
+     * @brief The bytes in the journal, flushed or not
+     */
+    [[nodiscard]] inline std::size_t
+    journal_size() const noexcept
+    {
+        return journal_size_ + batch_.size();
+    }
+
+    /**
+     * @brief Loads the snapshot and replays the journal of its epoch into the tables
+     *
+     * A journal of another epoch, or the part of it after a torn record, is dropped. Call before serving.
+     *
+     * @return false If the store is not valid or the journal could not be reset
+     */
+    template <class CoilsImage, class HoldingsImage>
+    bool
+    restore(CoilsImage& coils, HoldingsImage& holdings) noexcept
+    {
+        if (!valid()) [[unlikely]] {
+            return false;
+        }
+        load_coils(coils, 0, Coils, snapshot_ + coils_offset);
+        load_holdings(holdings, 0, HoldingRegisters, snapshot_ + holding_regs_offset);
+
+        struct stat info {};
+        if (::fstat(journal_fd_, &info) != 0) [[unlikely]] {
+            return false;
+        }
+        auto const size = static_cast<std::size_t>(info.st_size);
+        if (size < sizeof(journal_header)) {
+            return reset_journal();
+        }
+        void* address{::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, journal_fd_, 0)};
+        if (address == MAP_FAILED) [[unlikely]] {
+            return false;
+        }
+        auto const*    data = static_cast<std::uint8_t const*>(address);
+        journal_header header{};
+        std::memcpy(&header, data, sizeof(header));
+        std::size_t good{};
+        if ((header.magic == journal_header::magic_value) && (header.version == journal_header::layout)
+            && (header.epoch == epoch())) {
+            good = replay(data, size, coils, holdings);
+        }
+        ::munmap(address, size);
+        if (good == 0) {
+            return reset_journal();
+        }
+        if ((good < size) && (::ftruncate(journal_fd_, static_cast<off_t>(good)) != 0)) [[unlikely]] {
+            return false;
+        }
+        journal_size_ = good;
+        return true;
+    }
+
+    /**
+     * @brief Collects a record of the coils [start, start + count), it is written by the next flush()
+     *
+     * @return false If the store is not valid or the batch is full, the records that did not fit are not collected
+     */
+    template <class CoilsImage>
+    bool
+    append_coils(CoilsImage const& coils, std::size_t start, std::size_t count) noexcept
+    {
+        for (; count > 0;) {
+            auto const chunk = std::min(count, max_record_elements);
+            auto*      field = append(record_kind::coils, start, chunk, (chunk + 7) / 8);
+            if (field == nullptr) [[unlikely]] {
+                return false;
+            }
+            if constexpr (packed_bit_container<CoilsImage>) {
+                coils.read(start, chunk, field);
+            } else {
+                for (std::size_t i{}; i < chunk; i++) {
+                    field[i / 8] = static_cast<std::uint8_t>(field[i / 8] | ((coils[start + i] ? 1U : 0U) << (i % 8)));
+                }
+            }
+            seal();
+            start += chunk;
+            count -= chunk;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Collects a record of the holding registers [start, start + count), it is written by the next flush()
+     *
+     * @return false If the store is not valid or the batch is full, the records that did not fit are not collected
+     */
+    template <class HoldingsImage>
+    bool
+    append_holdings(HoldingsImage const& holdings, std::size_t start, std::size_t count) noexcept
+    {
+        for (; count > 0;) {
+            auto const chunk = std::min(count, max_record_elements);
+            auto*      data  = append(record_kind::holding_registers, start, chunk, chunk * 2);
+            if (data == nullptr) [[unlikely]] {
+                return false;
+            }
+            std::uint16_t value{};
+            for (std::size_t i{}; i < chunk; i++) {
+                value = holdings[start + i];
+                std::memcpy(data + i * 2, &value, 2);
+            }
+            seal();
+            start += chunk;
+            count -= chunk;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Writes the collected records to the journal
+     *
+     * A failed write is cut from the journal and the records are kept for the next flush().
+     *
+     * @param sync Wait until the journal is on the disk.
+     * @return false If the journal could not be written
+     */
+    bool
+    flush(bool sync = false) noexcept
+    {
+        if (!valid()) [[unlikely]] {
+            return false;
+        }
+        if (!batch_.empty()) {
+            if (!write_all(batch_.data(), batch_.size())) [[unlikely]] {
+                [[maybe_unused]] auto const cut = ::ftruncate(journal_fd_, static_cast<off_t>(journal_size_));
+                return false;
+            }
+            journal_size_ += batch_.size();
+            batch_.clear();
+        }
+        return !sync || (::fdatasync(journal_fd_) == 0);
+    }
+
+    /**
+     * @brief Folds the journal into the snapshot: stores the tables, advances the epoch and empties the journal
+     *
+     * @return false If a step failed, the previous snapshot and journal then still restore the tables
+     */
+    template <class CoilsImage, class HoldingsImage>
+    bool
+    compact(CoilsImage const& coils, HoldingsImage const& holdings) noexcept
+    {
+        if (!flush(true)) [[unlikely]] {
+            return false;
+        }
+        store_coils(coils, snapshot_ + coils_offset);
+        std::uint16_t value{};
+        for (std::size_t i{}; i < HoldingRegisters; i++) {
+            value = holdings[i];
+            std::memcpy(snapshot_ + holding_regs_offset + i * 2, &value, 2);
+        }
+        if (::msync(snapshot_, snapshot_size, MS_SYNC) != 0) [[unlikely]] {
+            return false;
+        }
+        header().epoch++;
+        if (::msync(snapshot_, coils_offset, MS_SYNC) != 0) [[unlikely]] {
+            return false;
+        }
+        return reset_journal();
+    }
+
+private:
+    std::uint8_t*             snapshot_{};
+    int                       journal_fd_{-1};
+    std::size_t               journal_size_{};
+    std::vector<std::uint8_t> batch_{};
+    std::size_t               record_{};
+
+    [[nodiscard]] snapshot_header&
+    header() const noexcept
+    {
+        return *reinterpret_cast<snapshot_header*>(snapshot_);
+    }
+
+    [[nodiscard]] bool
+    compatible() const noexcept
+    {
+        auto const& item = header();
+        return (item.magic == snapshot_header::magic_value) && (item.version == snapshot_header::layout)
+               && (item.coils == Coils) && (item.holding_registers == HoldingRegisters);
+    }
+
+    void
+    release() noexcept
+    {
+        if (snapshot_ != nullptr) {
+            ::munmap(snapshot_, snapshot_size);
+            snapshot_ = nullptr;
+        }
+        if (journal_fd_ >= 0) {
+            ::close(journal_fd_);
+            journal_fd_ = -1;
+        }
+    }
+
+    bool
+    write_all(std::uint8_t const* data, std::size_t size) noexcept
+    {
+        while (size > 0) {
+            auto const written = ::write(journal_fd_, data, size);
+            if (written < 0) [[unlikely]] {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            data += written;
+            size -= static_cast<std::size_t>(written);
+        }
+        return true;
+    }
+
+    bool
+    reset_journal() noexcept
+    {
+        batch_.clear();
+        journal_header const header{journal_header::magic_value, journal_header::layout, epoch()};
+        if ((::ftruncate(journal_fd_, 0) != 0) || !write_all(reinterpret_cast<std::uint8_t const*>(&header),
+                                                             sizeof(header))) [[unlikely]] {
+            return false;
+        }
+        journal_size_ = sizeof(header);
+        return ::fdatasync(journal_fd_) == 0;
+    }
+
+    /**
+     * @brief Starts a record in the batch, within the capacity reserved by the constructor
+     *
+     * @return The zero filled payload, nullptr if the store is not valid or the record does not fit
+     */
+    std::uint8_t*
+    append(record_kind kind, std::size_t start, std::size_t count, std::size_t payload) noexcept
+    {
+        record_header const fixed{kind, static_cast<std::uint16_t>(start), static_cast<std::uint16_t>(count)};
+        auto const          length = sizeof(fixed) + payload + 2;
+        if (!valid() || (batch_.size() + length > batch_.capacity())) [[unlikely]] {
+            return nullptr;
+        }
+        record_ = batch_.size();
+        batch_.resize(record_ + length);
+        std::memcpy(batch_.data() + record_, &fixed, sizeof(fixed));
+        return batch_.data() + record_ + sizeof(fixed);
+    }
+
+    /**
+     * @brief Closes the record started by append() with its CRC
+     */
+    void
+    seal() noexcept
+    {
+        auto const             size = batch_.size() - record_ - 2;
+        crc16ansi::accumulator crc{};
+        crc.update(batch_.data() + record_, size);
+        auto const value           = crc.value().get();
+        batch_[record_ + size]     = static_cast<std::uint8_t>(value);
+        batch_[record_ + size + 1] = static_cast<std::uint8_t>(value >> 8);
+    }
+
+    /**
+     * @brief Applies the records of a journal
+     *
+     * @return The size of the journal up to the first bad record
+     */
+    template <class CoilsImage, class HoldingsImage>
+    static std::size_t
+    replay(std::uint8_t const* data, std::size_t size, CoilsImage& coils, HoldingsImage& holdings) noexcept
+    {
+        std::size_t at{sizeof(journal_header)};
+        while (at + sizeof(record_header) + 2 <= size) {
+            record_header fixed{};
+            std::memcpy(&fixed, data + at, sizeof(fixed));
+            std::size_t payload{};
+            std::size_t limit{};
+            if (fixed.kind == record_kind::coils) {
+                payload = (fixed.count + 7U) / 8U;
+                limit   = Coils;
+            } else if (fixed.kind == record_kind::holding_registers) {
+                payload = fixed.count * 2U;
+                limit   = HoldingRegisters;
+            } else {
+                break;
+            }
+            auto const length = sizeof(fixed) + payload + 2;
+            if ((at + length > size) || (fixed.start + std::size_t{fixed.count} > limit)) {
+                break;
+            }
+            crc16ansi::accumulator crc{};
+            crc.update(data + at, length);
+            if (!crc.complete()) {
+                break;
+            }
+            auto const* values = data + at + sizeof(fixed);
+            if (fixed.kind == record_kind::coils) {
+                load_coils(coils, fixed.start, fixed.count, values);
+            } else {
+                load_holdings(holdings, fixed.start, fixed.count, values);
+            }
+            at += length;
+        }
+        return at;
+    }
+
+    template <class CoilsImage>
+    static void
+    load_coils(CoilsImage& coils, std::size_t start, std::size_t count, std::uint8_t const* field) noexcept
+    {
+        if constexpr (packed_bit_container<CoilsImage>) {
+            coils.write(start, count, field);
+        } else {
+            for (std::size_t i{}; i < count; i++) {
+                coils[start + i] = ((field[i / 8] >> (i % 8)) & 1U) != 0;
+            }
+        }
+    }
+
+    template <class HoldingsImage>
+    static void
+    load_holdings(HoldingsImage& holdings, std::size_t start, std::size_t count, std::uint8_t const* data) noexcept
+    {
+        if constexpr (contiguous_registers<HoldingsImage>) {
+            std::memcpy(holdings.data() + start, data, count * 2);
+        } else {
+            std::uint16_t value{};
+            for (std::size_t i{}; i < count; i++) {
+                std::memcpy(&value, data + i * 2, 2);
+                holdings[start + i] = value;
+            }
+        }
+    }
+
+    template <class CoilsImage>
+    static void
+    store_coils(CoilsImage const& coils, std::uint8_t* field) noexcept
+    {
+        if constexpr (packed_bit_container<CoilsImage>) {
+            coils.read(0, Coils, field);
+        } else {
+            std::fill(field, field + coil_bytes, std::uint8_t{});
+            for (std::size_t i{}; i < Coils; i++) {
+                field[i / 8] = static_cast<std::uint8_t>(field[i / 8] | ((coils[i] ? 1U : 0U) << (i % 8)));
+            }
+        }
+    }
+};
+
+}    // namespace xitren::modbus::persistence
+
+namespace xitren::modbus {
+
+/**
+ * @brief A slave whose coils and holding registers survive a restart
+ *
+ * The write handlers mark what the masters changed, as for tracked_slave; persist() journals the current values of
+ * the marked ranges and compacts the journal once it grew past the threshold. So the write path only marks bits, and
+ * the disk is touched on the schedule of the application:
+ * @code
+ * persistent_slave<slave<...>> device{"/var/lib/plc/image", "/var/lib/plc/journal", 0x11};
+ * device.restore();
+ * ...
+ * device.persist();    // e.g. every 100 ms, on the thread serving the slave
+ * @endcode
+ * Changes made by the application through holding_registers() or coils() are persisted by the next compaction.
+ *
+ * @tparam Slave The slave to build on, e.g. `slave<...>` or `packed_slave<...>`.
+ */
+template <class Slave>
+class persistent_slave : public Slave {
+public:
+    using typename Slave::coil_changes_type;
+    using typename Slave::holding_changes_type;
+    using store_type = persistence::store<coil_changes_type{}.size(), holding_changes_type{}.size()>;
+
+    /**
+     * @brief Opens the snapshot and the journal, the remaining arguments construct the slave
+     */
+    template <class... Args>
+    persistent_slave(char const* snapshot_path, char const* journal_path, Args&&... args)
+        : Slave(std::forward<Args>(args)...), store_{snapshot_path, journal_path}
+    {
+        Slave::track(&coil_changes_, &holding_changes_);
+    }
+
+    persistent_slave(persistent_slave const&) = delete;
+    persistent_slave&
+    operator=(persistent_slave const&)
+        = delete;
+
+    ~persistent_slave() noexcept { persist(true); }
+
+    /**
+     * @brief Loads the coils and holding registers, call before serving
+     */
+    bool
+    restore() noexcept
+    {
+        return store_.restore(Slave::coils(), Slave::holding_registers());
+    }
+
+    /**
+     * @brief Journals the values changed since the last call, compacts when the journal is over the threshold
+     *
+     * The changes are kept marked until they are in the batch of the store, so a store that is not valid or a batch
+     * full of records a failed flush kept does not grow; changes too scattered for an empty batch are compacted.
+     *
+     * @param sync Wait until the journal is on the disk.
+     */
+    bool
+    persist(bool sync = false) noexcept
+    {
+        if (!journal()) [[unlikely]] {
+            if (!store_.flush(sync)) [[unlikely]] {
+                return false;
+            }
+            if (!journal()) [[unlikely]] {
+                return compact();
+            }
+        }
+        coil_changes_.clear();
+        holding_changes_.clear();
+        if (!store_.flush(sync)) [[unlikely]] {
+            return false;
+        }
+        if (store_.journal_size() > compact_bytes_) {
+            return compact();
+        }
+        return true;
+    }
+
+    /**
+     * @brief Folds the journal into the snapshot now
+     */
+    bool
+    compact() noexcept
+    {
+        if (!store_.compact(Slave::coils(), Slave::holding_registers())) [[unlikely]] {
+            return false;
+        }
+        coil_changes_.clear();
+        holding_changes_.clear();
+        return true;
+    }
+
+    /**
+     * @brief Sets the journal size that triggers a compaction in persist()
+     */
+    void
+    compaction_threshold(std::size_t bytes) noexcept
+    {
+        compact_bytes_ = bytes;
+    }
+
+    inline store_type&
+    store() noexcept
+    {
+        return store_;
+    }
+
+private:
+    coil_changes_type    coil_changes_{};
+    holding_changes_type holding_changes_{};
+    store_type           store_;
+    std::size_t          compact_bytes_{store_type::default_compact_bytes};
+
+    /**
+     * @brief Collects the marked ranges into the batch of the store
+     *
+     * @return false If a record did not fit, the ranges collected again later are only journaled twice
+     */
+    bool
+    journal() noexcept
+    {
+        for (auto const& item : coil_changes_) {
+            if (!store_.append_coils(Slave::coils(), item.start, item.count)) [[unlikely]] {
+                return false;
+            }
+        }
+        for (auto const& item : holding_changes_) {
+            if (!store_.append_holdings(Slave::holding_registers(), item.start, item.count)) [[unlikely]] {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+}    // namespace xitren::modbus
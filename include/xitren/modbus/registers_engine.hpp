@@ -0,0 +1,185 @@
+/*!
+_ _
+__ _(_) |_ _ _ ___ _ _
+\ \ / |  _| '_/ -_) ' \
+/_\_\_|\__|_| \___|_||_|
+* @date 15.02.2024
+*/
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#    include <immintrin.h>
+#    define XITREN_MODBUS_REGISTERS_SSSE3 1
+#elif defined(__aarch64__)
+#    include <arm_neon.h>
+#    define XITREN_MODBUS_REGISTERS_NEON 1
+#endif
+
+/**
+ * @brief Run time engines converting blocks of registers between the host and the wire (big endian) byte order
+ *
+ * On a little endian host both directions swap the two bytes of every register, all engines give identical results:
+ * - `scalar` swaps 4 registers per step in a 64-bit word;
+ * - `ssse3` and `avx2` swap 8 and 16 registers per step with a byte shuffle;
+ * - `neon` swaps 8 registers per step with `rev16`.
+ * On a big endian host the conversion is a copy.
+ *
+ * `to_wire` and `from_wire` call the fastest engine the CPU supports, it is selected once at start-up. The source and
+ * the destination may be the same buffer, they must not overlap otherwise.
+ */
+namespace xitren::modbus::registers_engine {
+
+using engine_type = void (*)(void const*, std::size_t, void*) noexcept;
+
+constexpr std::uint64_t
+swap_lanes(std::uint64_t word) noexcept
+{
+    return ((word & 0x00FF00FF00FF00FFULL) << 8U) | ((word >> 8U) & 0x00FF00FF00FF00FFULL);
+}
+
+/**
+ * @brief Swaps register by register, the reference
+ */
+inline void
+bytewise(void const* src, std::size_t count, void* dst) noexcept
+{
+    auto const* in  = static_cast<std::uint8_t const*>(src);
+    auto*       out = static_cast<std::uint8_t*>(dst);
+    for (std::size_t i{}; i < count; i++, in += 2, out += 2) {
+        std::uint8_t const high{in[0]};
+        out[0] = in[1];
+        out[1] = high;
+    }
+}
+
+inline void
+scalar(void const* src, std::size_t count, void* dst) noexcept
+{
+    auto const* in  = static_cast<std::uint8_t const*>(src);
+    auto*       out = static_cast<std::uint8_t*>(dst);
+    for (; count >= 4; count -= 4, in += 8, out += 8) {
+        std::uint64_t word;
+        std::memcpy(&word, in, sizeof(word));
+        word = swap_lanes(word);
+        std::memcpy(out, &word, sizeof(word));
+    }
+    bytewise(in, count, out);
+}
+
+#if defined(XITREN_MODBUS_REGISTERS_SSSE3)
+__attribute__((target("ssse3"))) inline void
+ssse3(void const* src, std::size_t count, void* dst) noexcept
+{
+    auto const*   in  = static_cast<std::uint8_t const*>(src);
+    auto*         out = static_cast<std::uint8_t*>(dst);
+    __m128i const order{_mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14)};
+    for (; count >= 8; count -= 8, in += 16, out += 16) {
+        __m128i const block{_mm_loadu_si128(reinterpret_cast<__m128i const*>(in))};
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_shuffle_epi8(block, order));
+    }
+    scalar(in, count, out);
+}
+
+__attribute__((target("avx2"))) inline void
+avx2(void const* src, std::size_t count, void* dst) noexcept
+{
+    auto const*   in  = static_cast<std::uint8_t const*>(src);
+    auto*         out = static_cast<std::uint8_t*>(dst);
+    __m256i const order{
+        _mm256_broadcastsi128_si256(_mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14))};
+    for (; count >= 16; count -= 16, in += 32, out += 32) {
+        __m256i const block{_mm256_loadu_si256(reinterpret_cast<__m256i const*>(in))};
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), _mm256_shuffle_epi8(block, order));
+    }
+    ssse3(in, count, out);
+}
+
+inline bool
+ssse3_supported() noexcept
+{
+    return __builtin_cpu_supports("ssse3");
+}
+
+inline bool
+avx2_supported() noexcept
+{
+    return __builtin_cpu_supports("avx2");
+}
+#endif
+
+#if defined(XITREN_MODBUS_REGISTERS_NEON)
+inline void
+neon(void const* src, std::size_t count, void* dst) noexcept
+{
+    auto const* in  = static_cast<std::uint8_t const*>(src);
+    auto*       out = static_cast<std::uint8_t*>(dst);
+    for (; count >= 8; count -= 8, in += 16, out += 16) {
+        vst1q_u8(out, vrev16q_u8(vld1q_u8(in)));
+    }
+    scalar(in, count, out);
+}
+#endif
+
+/**
+ * @brief Picks the fastest engine the CPU supports
+ */
+inline engine_type
+select() noexcept
+{
+#if defined(XITREN_MODBUS_REGISTERS_SSSE3)
+    if (avx2_supported()) {
+        return &avx2;
+    }
+    if (ssse3_supported()) {
+        return &ssse3;
+    }
+#elif defined(XITREN_MODBUS_REGISTERS_NEON)
+    return &neon;
+#endif
+    return &scalar;
+}
+
+/**
+ * @brief The engine selected for this CPU
+ */
+inline engine_type const selected = select();
+
+inline void
+swap(void const* src, std::size_t count, void* dst) noexcept
+{
+    if constexpr (std::endian::native == std::endian::big) {
+        if (src != dst) {
+            std::memcpy(dst, src, count * sizeof(std::uint16_t));
+        }
+    } else if (selected == nullptr) [[unlikely]] {
+        // Called during static initialization, before the selection
+        select()(src, count, dst);
+    } else {
+        selected(src, count, dst);
+    }
+}
+
+/**
+ * @brief Serializes `count` registers into big endian bytes
+ */
+inline void
+to_wire(std::uint16_t const* src, std::size_t count, std::uint8_t* dst) noexcept
+{
+    swap(src, count, dst);
+}
+
+/**
+ * @brief Deserializes `count` big endian registers
+ */
+inline void
+from_wire(std::uint8_t const* src, std::size_t count, std::uint16_t* dst) noexcept
+{
+    swap(src, count, dst);
+}
+
+}    // namespace xitren::modbus::registers_engine
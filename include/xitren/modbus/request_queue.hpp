@@ -0,0 +1,168 @@
+/*!
+_ _
+__ _(_) |_ _ _ ___ _ _
+\ \ / |  _| '_/ -_) ' \
+/_\_\_|\__|_| \___|_||_|
+* @date 15.02.2024
+*/
+#pragma once
+
+#include <xitren/circular_buffer.hpp>
+#include <xitren/modbus/modbus.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+namespace xitren::modbus {
+
+/**
+ * @brief A slave that queues the requests arriving while it is busy instead of rejecting them
+ *
+ * A client pipelining requests, e.g. over Modbus TCP, sends the next frame before the reply to the previous one. A
+ * plain slave answers such a frame with slave_or_server_busy and the client waits for its timeout to retry. Here
+ * receive() checks the frame and keeps it in a ring of `Depth` frames; processing() takes the next one in order as soon
+ * as the slave is idle, parsing it in place in the ring, so the replies go out back to back. Only a frame arriving on a
+ * full ring is rejected as busy.
+ *
+ * The ring and the slave are driven from the same loop, e.g. the transport callback and processing() or drain(); they
+ * are not synchronized with each other.
+ *
+ * @tparam Slave The slave type, e.g. slave or packed_slave.
+ * @tparam Depth The number of frames kept, a queued frame holds its slot until it is served.
+ */
+template <class Slave, std::size_t Depth>
+class queued_slave : public Slave {
+    static_assert(Depth > 0, "The queue must hold at least one frame!");
+
+public:
+    using typename Slave::msg_type;
+
+    /**
+     * @brief A received frame waiting for the slave
+     */
+    struct frame_type {
+        std::uint16_t                 size{};
+        typename msg_type::array_type data{};
+    };
+
+    using queue_type = containers::circular_buffer<frame_type, Depth>;
+
+    static constexpr std::size_t depth = Depth;
+
+    template <class... Args>
+    constexpr explicit queued_slave(Args&&... args) : Slave(std::forward<Args>(args)...)
+    {}
+
+    queued_slave(queued_slave const&) = delete;
+    queued_slave&
+    operator=(queued_slave const&)
+        = delete;
+
+    /**
+     * @brief Receives a message, it is queued if the slave is busy
+     *
+     * @return exception::bad_data If the message is not long enough or its MBAP header is malformed
+     * @return exception::bad_crc If the CRC does not match
+     * @return exception::slave_or_server_busy If the queue is full
+     */
+    template <class InputIterator>
+    constexpr exception
+    receive(InputIterator begin, InputIterator end) noexcept
+    {
+        if (this->idle() && queue_.empty()) [[likely]] {
+            return Slave::receive(begin, end);
+        }
+        if (auto const error = this->accept(!queue_.full(), begin, end); error != exception::no_error) [[unlikely]] {
+            return error;
+        }
+        frame_type item{};
+        item.size = static_cast<std::uint16_t>(end - begin);
+        std::copy(begin, end, item.data.begin());
+        queue_.push(item);
+        return exception::no_error;
+    }
+
+    /**
+     * @brief One step of the slave, the next queued frame is taken when the slave is idle
+     */
+    exception
+    processing() noexcept override
+    {
+        bool const busy   = !this->idle();
+        auto const result = Slave::processing();
+        if (this->idle()) {
+            if (busy) {
+                completed_++;
+            }
+            next();
+        }
+        return ((result == exception::nothing_to_do) && !this->idle()) ? exception::no_error : result;
+    }
+
+    /**
+     * @brief Serves up to `frames` requests, the received one and the queued ones, in one call
+     *
+     * Stops early when the slave reaches slave_state::unrecoverable_error, e.g. on a failed send(), as it makes no
+     * progress from there until reset().
+     *
+     * @return The number of requests completed
+     */
+    std::size_t
+    drain(std::size_t frames) noexcept
+    {
+        auto const start = completed_;
+        while (((completed_ - start) < frames) && !(this->idle() && queue_.empty())
+               && (this->state() != slave_state::unrecoverable_error)) {
+            processing();
+        }
+        return completed_ - start;
+    }
+
+    /**
+     * @brief The number of frames in the ring, a queued frame being served included
+     */
+    [[nodiscard]] inline std::size_t
+    pending() const noexcept
+    {
+        return queue_.size();
+    }
+
+    void
+    reset() noexcept override
+    {
+        Slave::reset();
+        this->input_msg_.release();
+        queue_.clear();
+        serving_ = false;
+    }
+
+private:
+    queue_type  queue_{};
+    std::size_t completed_{};
+    bool        serving_{};
+
+    /**
+     * @brief Drops the frame served, starts the next one in place in the ring
+     */
+    void
+    next() noexcept
+    {
+        if (serving_) {
+            this->input_msg_.release();
+            queue_.pop();
+            serving_ = false;
+        }
+        if (queue_.empty()) {
+            return;
+        }
+        auto& item = queue_.front();
+        this->input_msg_.borrow(item.data);
+        this->input_msg_.size(item.size);
+        serving_ = true;
+        this->received();
+    }
+};
+
+}    // namespace xitren::modbus
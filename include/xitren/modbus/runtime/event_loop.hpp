@@ -0,0 +1,776 @@
+/*!
+_ _
+__ _(_) |_ _ _ ___ _ _
+\ \ / |  _| '_/ -_) ' \
+/_\_\_|\__|_| \___|_||_|
+* @date 15.02.2024
+*/
+#pragma once
+
+#include <xitren/modbus/runtime/unit.hpp>
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace xitren::modbus::runtime {
+
+/**
+ * @brief Routes frames to units by slave id / unit identifier
+ *
+ * A table serves one network of units: a TCP port or a serial line. Lookups are a single indexed load. TCP requests to
+ * unit 0 or 0xFF go to the default unit, the first attached one unless set explicitly.
+ */
+class unit_table {
+public:
+    /**
+     * @brief Attaches a unit under its own id
+     *
+     * @param item The unit, it must outlive the table.
+     * @return false If another unit already has the id
+     */
+    bool
+    attach(unit& item) noexcept
+    {
+        auto& entry = table_[item.unit_id()];
+        if (entry != nullptr) [[unlikely]] {
+            return false;
+        }
+        entry = &item;
+        units_.push_back(&item);
+        if (default_ == nullptr) {
+            default_ = &item;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Sets the unit that serves TCP requests addressed to unit 0 or 0xFF
+     */
+    void
+    default_unit(unit& item) noexcept
+    {
+        default_ = &item;
+    }
+
+    /**
+     * @brief Finds the unit a frame is addressed to
+     *
+     * @param kind The transport the frame came from.
+     * @param id The slave id / unit identifier of the frame.
+     * @return The unit or nullptr
+     */
+    [[nodiscard]] inline unit*
+    find(transport kind, std::uint8_t id) const noexcept
+    {
+        auto* item = table_[id];
+        if ((item == nullptr) && (kind == transport::tcp) && ((id == 0) || mbap::any_unit(id))) {
+            return default_;
+        }
+        return item;
+    }
+
+    /**
+     * @brief All attached units, in the order of attachment
+     */
+    [[nodiscard]] inline std::vector<unit*> const&
+    units() const noexcept
+    {
+        return units_;
+    }
+
+private:
+    std::array<unit*, 256> table_{};
+    std::vector<unit*>     units_{};
+    unit*                  default_{nullptr};
+};
+
+/**
+ * @brief A single threaded epoll event loop serving Modbus TCP connections and serial lines
+ *
+ * All descriptors are non-blocking and level triggered. TCP frames are cut out of the stream by the MBAP length field,
+ * serial (RTU) frames are delimited by the inter-frame silence measured with a timerfd. Each complete frame is routed
+ * through the unit table of its listener or line and served in place, the reply is written to the originating
+ * descriptor; what the kernel does not take right away is kept and flushed on EPOLLOUT.
+ *
+ * Run one loop per core: listeners are opened with SO_REUSEPORT, so the loops of a server share a port and the kernel
+ * balances the connections between them. Everything except stop() must be called from the thread running the loop or
+ * before it is started.
+ *
+ * A descriptor is kept in reserve: when the process is out of descriptors, it is given up to accept and close the
+ * pending connections; without it the listeners wait for a connection to close.
+ */
+class event_loop {
+public:
+    static constexpr std::size_t max_events     = 64;
+    static constexpr std::size_t rx_capacity    = 4096;
+    static constexpr std::size_t tx_capacity    = 64 * 1024;
+    static constexpr int         listen_backlog = 1024;
+
+    /**
+     * @brief Statistics of the loop
+     */
+    struct statistics {
+        std::size_t frames{};      /*!< Frames served. */
+        std::size_t unrouted{};    /*!< Frames no unit was attached for. */
+        std::size_t accepted{};    /*!< Connections accepted. */
+        std::size_t closed{};      /*!< Connections closed. */
+        std::size_t refused{};     /*!< Connections closed at once for lack of descriptors. */
+    };
+
+    event_loop() noexcept
+        : epoll_fd_{::epoll_create1(EPOLL_CLOEXEC)}, wakeup_{*this, ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)}
+    {
+        add(wakeup_, EPOLLIN);
+    }
+
+    event_loop(event_loop const&) = delete;
+    event_loop&
+    operator=(event_loop const&)
+        = delete;
+
+    ~event_loop() noexcept
+    {
+        channels_.clear();
+        if (epoll_fd_ >= 0) {
+            ::close(epoll_fd_);
+        }
+        if (spare_fd_ >= 0) {
+            ::close(spare_fd_);
+        }
+    }
+
+    /**
+     * @brief Returns true if the loop got its epoll and wakeup descriptors
+     */
+    [[nodiscard]] inline bool
+    valid() const noexcept
+    {
+        return (epoll_fd_ >= 0) && (wakeup_.fd() >= 0);
+    }
+
+    /**
+     * @brief Opens a Modbus TCP listener
+     *
+     * @param port The port to listen on, 0 picks an ephemeral one.
+     * @param units The units served on the port, the table must outlive the loop.
+     * @param address The IPv4 address to bind, in host byte order.
+     * @return The bound port or 0 on failure
+     */
+    std::uint16_t
+    listen(std::uint16_t port, unit_table const& units, std::uint32_t address = INADDR_ANY) noexcept
+    {
+        int const fd{::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)};
+        if (fd < 0) [[unlikely]] {
+            return 0;
+        }
+        auto listener = std::make_unique<acceptor>(*this, fd, units);
+        int const on{1};
+        ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        ::setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+        sockaddr_in addr{};
+        addr.sin_family      = AF_INET;
+        addr.sin_port        = htons(port);
+        addr.sin_addr.s_addr = htonl(address);
+        if ((::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0)
+            || (::listen(fd, listen_backlog) != 0)) [[unlikely]] {
+            return 0;
+        }
+        socklen_t length{sizeof(addr)};
+        if (::getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &length) != 0) [[unlikely]] {
+            return 0;
+        }
+        if (!own(std::move(listener), EPOLLIN)) [[unlikely]] {
+            return 0;
+        }
+        return ntohs(addr.sin_port);
+    }
+
+    /**
+     * @brief Serves Modbus RTU on an already configured serial line or pseudo-terminal
+     *
+     * The loop takes the descriptor over, switches it to non-blocking mode and closes it when done, or at once if the
+     * line can not be added.
+     *
+     * @param fd The descriptor.
+     * @param gap The inter-frame silence (3.5 characters at the line speed) that closes a frame.
+     * @param units The units on the line, the table must outlive the loop.
+     * @return true If the line was added
+     */
+    bool
+    attach_serial(int fd, std::chrono::microseconds gap, unit_table const& units) noexcept
+    {
+        if (fd < 0) [[unlikely]] {
+            return false;
+        }
+        int const timer{::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)};
+        if (timer < 0) [[unlikely]] {
+            ::close(fd);
+            return false;
+        }
+        ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+        auto line = std::make_unique<serial_line>(*this, fd, timer, gap, units);
+        if (!add(line->gap_timer(), EPOLLIN)) [[unlikely]] {
+            return false;
+        }
+        return own(std::move(line), EPOLLIN);
+    }
+
+    /**
+     * @brief Runs the loop until stop() is called
+     */
+    void
+    run() noexcept
+    {
+        while (!stop_.load(std::memory_order_relaxed)) {
+            if (run_once(-1) < 0) [[unlikely]] {
+                break;
+            }
+        }
+        stop_.store(false, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Waits for events once and handles them
+     *
+     * @param timeout_ms The epoll_wait timeout, -1 waits forever.
+     * @return The number of handled events or -1 on error
+     */
+    int
+    run_once(int timeout_ms) noexcept
+    {
+        std::array<epoll_event, max_events> events{};
+        int const count{::epoll_wait(epoll_fd_, events.data(), static_cast<int>(events.size()), timeout_ms)};
+        if (count < 0) {
+            return (errno == EINTR) ? 0 : -1;
+        }
+        for (int i{}; i < count; i++) {
+            auto* item = static_cast<channel*>(events[i].data.ptr);
+            if (!item->closed()) [[likely]] {
+                item->on_event(events[i].events);
+            }
+        }
+        for (auto const fd : graveyard_) {
+            channels_.erase(fd);
+            stats_.closed++;
+        }
+        if (!graveyard_.empty()) {
+            resume();
+        }
+        graveyard_.clear();
+        return count;
+    }
+
+    /**
+     * @brief Makes run() return, may be called from any thread
+     */
+    void
+    stop() noexcept
+    {
+        stop_.store(true, std::memory_order_relaxed);
+        std::uint64_t const one{1};
+        [[maybe_unused]] auto const written = ::write(wakeup_.fd(), &one, sizeof(one));
+    }
+
+    [[nodiscard]] inline statistics const&
+    stats() const noexcept
+    {
+        return stats_;
+    }
+
+    /**
+     * @brief The number of open connections and lines
+     */
+    [[nodiscard]] inline std::size_t
+    channels() const noexcept
+    {
+        return channels_.size();
+    }
+
+private:
+    /**
+     * @brief A descriptor registered in the epoll set
+     */
+    class channel : public reply_sink {
+    public:
+        channel(event_loop& loop, int fd, bool socket = true) noexcept : loop_{loop}, fd_{fd}, socket_{socket} {}
+
+        channel(channel const&) = delete;
+        channel&
+        operator=(channel const&)
+            = delete;
+
+        ~channel() noexcept override
+        {
+            if (fd_ >= 0) {
+                ::close(fd_);
+            }
+        }
+
+        virtual void
+        on_event(std::uint32_t events) noexcept
+            = 0;
+
+        /**
+         * @brief Writes a frame straight to the descriptor, the rest is queued until EPOLLOUT
+         */
+        bool
+        write(std::uint8_t const* begin, std::uint8_t const* end) noexcept override
+        {
+            auto const size = static_cast<std::size_t>(end - begin);
+            if (closed_) [[unlikely]] {
+                return false;
+            }
+            std::size_t done{};
+            if (tx_.empty()) [[likely]] {
+                auto const sent = put(begin, size);
+                if (sent < 0) [[unlikely]] {
+                    close();
+                    return false;
+                }
+                done = static_cast<std::size_t>(sent);
+                if (done == size) [[likely]] {
+                    return true;
+                }
+            }
+            if ((tx_.size() + size - done) > tx_capacity) [[unlikely]] {
+                // The peer does not read its replies
+                close();
+                return false;
+            }
+            bool const arm{tx_.empty()};
+            tx_.insert(tx_.end(), begin + done, end);
+            if (arm) {
+                loop_.modify(*this, EPOLLIN | EPOLLOUT);
+            }
+            return true;
+        }
+
+        [[nodiscard]] inline int
+        fd() const noexcept
+        {
+            return fd_;
+        }
+
+        [[nodiscard]] inline bool
+        closed() const noexcept
+        {
+            return closed_;
+        }
+
+        void
+        close() noexcept
+        {
+            if (!closed_) {
+                closed_ = true;
+                loop_.bury(*this);
+            }
+        }
+
+    protected:
+        event_loop& loop_;
+
+        /**
+         * @brief Sends the queued replies, returns false if the channel was closed
+         */
+        bool
+        flush() noexcept
+        {
+            if (tx_.empty()) {
+                return true;
+            }
+            auto const sent = put(tx_.data(), tx_.size());
+            if (sent < 0) [[unlikely]] {
+                close();
+                return false;
+            }
+            tx_.erase(tx_.begin(), tx_.begin() + sent);
+            if (tx_.empty()) {
+                loop_.modify(*this, EPOLLIN);
+            }
+            return true;
+        }
+
+    private:
+        int                       fd_;
+        bool                      socket_;
+        bool                      closed_{false};
+        std::vector<std::uint8_t> tx_{};
+
+        /**
+         * @brief Non-blocking write, returns the number of bytes taken or -1 on error
+         */
+        [[nodiscard]] ssize_t
+        put(std::uint8_t const* data, std::size_t size) const noexcept
+        {
+            ssize_t const sent{socket_ ? ::send(fd_, data, size, MSG_NOSIGNAL) : ::write(fd_, data, size)};
+            if (sent < 0) {
+                return ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR)) ? 0 : -1;
+            }
+            return sent;
+        }
+    };
+
+    /**
+     * @brief The eventfd stop() writes to
+     */
+    class wakeup final : public channel {
+    public:
+        using channel::channel;
+
+        void
+        on_event(std::uint32_t) noexcept override
+        {
+            std::uint64_t                 value{};
+            [[maybe_unused]] auto const read_size = ::read(fd(), &value, sizeof(value));
+        }
+    };
+
+    /**
+     * @brief A Modbus TCP connection
+     */
+    class connection final : public channel {
+    public:
+        connection(event_loop& loop, int fd, unit_table const& units) noexcept : channel{loop, fd}, units_{units} {}
+
+        void
+        on_event(std::uint32_t events) noexcept override
+        {
+            if ((events & EPOLLOUT) && !flush()) [[unlikely]] {
+                return;
+            }
+            if (events & EPOLLIN) [[likely]] {
+                receive();
+            } else if (events & (EPOLLERR | EPOLLHUP)) [[unlikely]] {
+                close();
+            }
+        }
+
+    private:
+        unit_table const&                     units_;
+        std::array<std::uint8_t, rx_capacity> rx_{};
+        std::size_t                           rx_size_{};
+
+        void
+        receive() noexcept
+        {
+            ssize_t const got{::read(fd(), rx_.data() + rx_size_, rx_.size() - rx_size_)};
+            if (got <= 0) {
+                if ((got == 0) || ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR))) {
+                    close();
+                }
+                return;
+            }
+            rx_size_ += static_cast<std::size_t>(got);
+
+            std::size_t offset{};
+            while ((rx_size_ - offset) > mbap::prefix_length) {
+                auto*      frame  = rx_.data() + offset;
+                auto const length = mbap::expected_length(frame);
+                if ((length < mbap::min_adu_length) || (length > mbap::max_adu_length)) [[unlikely]] {
+                    // Lost the frame boundaries, there is no way to resynchronize a stream
+                    close();
+                    return;
+                }
+                if ((rx_size_ - offset) < length) {
+                    break;
+                }
+                loop_.dispatch(transport::tcp, frame, frame + length, units_, *this);
+                if (closed()) [[unlikely]] {
+                    return;
+                }
+                offset += length;
+            }
+            if (offset > 0) {
+                std::memmove(rx_.data(), rx_.data() + offset, rx_size_ - offset);
+                rx_size_ -= offset;
+            }
+        }
+    };
+
+    /**
+     * @brief A listening socket accepting Modbus TCP connections
+     */
+    class acceptor final : public channel {
+    public:
+        acceptor(event_loop& loop, int fd, unit_table const& units) noexcept : channel{loop, fd}, units_{units} {}
+
+        void
+        on_event(std::uint32_t) noexcept override
+        {
+            for (;;) {
+                int const fd{::accept4(this->fd(), nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)};
+                if (fd < 0) {
+                    if ((errno != EMFILE) && (errno != ENFILE)) [[likely]] {
+                        return;
+                    }
+                    // Out of descriptors the level triggered listener stays readable: refuse or stop polling it
+                    if (!loop_.refuse(this->fd())) [[unlikely]] {
+                        loop_.pause(*this);
+                        return;
+                    }
+                    continue;
+                }
+                int const on{1};
+                ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+                if (loop_.own(std::make_unique<connection>(loop_, fd, units_), EPOLLIN)) [[likely]] {
+                    loop_.stats_.accepted++;
+                }
+            }
+        }
+
+    private:
+        unit_table const& units_;
+    };
+
+    class serial_line;
+
+    /**
+     * @brief The timerfd measuring the silence on a serial line
+     */
+    class silence_timer final : public channel {
+    public:
+        silence_timer(event_loop& loop, int fd, serial_line& line) noexcept
+            : channel{loop, fd, false}, line_{line}
+        {}
+
+        void
+        on_event(std::uint32_t) noexcept override
+        {
+            std::uint64_t                 expirations{};
+            [[maybe_unused]] auto const read_size = ::read(fd(), &expirations, sizeof(expirations));
+            line_.silence();
+        }
+
+        void
+        arm(std::chrono::microseconds gap) noexcept
+        {
+            auto const seconds = std::chrono::duration_cast<std::chrono::seconds>(gap);
+            itimerspec spec{};
+            spec.it_value.tv_sec  = static_cast<time_t>(seconds.count());
+            spec.it_value.tv_nsec = static_cast<long>(std::chrono::nanoseconds{gap - seconds}.count());
+            ::timerfd_settime(fd(), 0, &spec, nullptr);
+        }
+
+    private:
+        serial_line& line_;
+    };
+
+    /**
+     * @brief A Modbus RTU line
+     */
+    class serial_line final : public channel {
+    public:
+        serial_line(event_loop& loop, int fd, int timer, std::chrono::microseconds gap,
+                    unit_table const& units) noexcept
+            : channel{loop, fd, false}, timer_{loop, timer, *this}, gap_{gap}, units_{units}
+        {}
+
+        void
+        on_event(std::uint32_t events) noexcept override
+        {
+            if ((events & EPOLLOUT) && !flush()) [[unlikely]] {
+                return;
+            }
+            if (events & EPOLLIN) [[likely]] {
+                receive();
+            } else if (events & (EPOLLERR | EPOLLHUP)) [[unlikely]] {
+                close();
+            }
+        }
+
+        /**
+         * @brief The line was silent for the inter-frame gap: what was received is a frame
+         */
+        void
+        silence() noexcept
+        {
+            if (closed()) [[unlikely]] {
+                return;
+            }
+            if ((rx_size_ >= rtu::min_adu_length) && (rx_size_ <= rtu::max_adu_length)) [[likely]] {
+                loop_.dispatch(transport::serial, rx_.data(), rx_.data() + rx_size_, units_, *this);
+            }
+            rx_size_ = 0;
+        }
+
+        inline silence_timer&
+        gap_timer() noexcept
+        {
+            return timer_;
+        }
+
+    private:
+        silence_timer                         timer_;
+        std::chrono::microseconds             gap_;
+        unit_table const&                     units_;
+        std::array<std::uint8_t, rx_capacity> rx_{};
+        std::size_t                           rx_size_{};
+
+        void
+        receive() noexcept
+        {
+            ssize_t const got{::read(fd(), rx_.data() + rx_size_, rx_.size() - rx_size_)};
+            if (got <= 0) {
+                if ((got == 0) || ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR))) {
+                    close();
+                }
+                return;
+            }
+            rx_size_ += static_cast<std::size_t>(got);
+            if (rx_size_ == rx_.size()) [[unlikely]] {
+                // Noise on the line, drop it
+                rx_size_ = 0;
+            }
+            timer_.arm(gap_);
+        }
+    };
+
+    int                                               epoll_fd_;
+    wakeup                                            wakeup_;
+    std::atomic<bool>                                 stop_{false};
+    std::unordered_map<int, std::unique_ptr<channel>> channels_{};
+    std::vector<int>                                  graveyard_{};
+    std::vector<channel*>                             paused_{};
+    int                                               spare_fd_{::open("/dev/null", O_RDONLY | O_CLOEXEC)};
+    statistics                                        stats_{};
+
+    bool
+    add(channel& item, std::uint32_t events) noexcept
+    {
+        epoll_event event{};
+        event.events   = events;
+        event.data.ptr = &item;
+        return ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, item.fd(), &event) == 0;
+    }
+
+    void
+    modify(channel& item, std::uint32_t events) noexcept
+    {
+        epoll_event event{};
+        event.events   = events;
+        event.data.ptr = &item;
+        ::epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, item.fd(), &event);
+    }
+
+    bool
+    own(std::unique_ptr<channel> item, std::uint32_t events) noexcept
+    {
+        if (!add(*item, events)) [[unlikely]] {
+            return false;
+        }
+        auto const fd = item->fd();
+        channels_.emplace(fd, std::move(item));
+        return true;
+    }
+
+    void
+    bury(channel& item) noexcept
+    {
+        ::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, item.fd(), nullptr);
+        std::erase(paused_, &item);
+        if (channels_.contains(item.fd())) {
+            graveyard_.push_back(item.fd());
+        }
+    }
+
+    /**
+     * @brief Accepts and closes a pending connection on the spare descriptor
+     *
+     * @return true If a connection was refused, false if there is no spare descriptor or no pending connection
+     */
+    bool
+    refuse(int listener) noexcept
+    {
+        if (spare_fd_ < 0) [[unlikely]] {
+            return false;
+        }
+        ::close(spare_fd_);
+        int const fd{::accept4(listener, nullptr, nullptr, SOCK_CLOEXEC)};
+        if (fd >= 0) {
+            ::close(fd);
+            stats_.refused++;
+        }
+        spare_fd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+        return fd >= 0;
+    }
+
+    /**
+     * @brief Stops polling a listener until a channel closes
+     */
+    void
+    pause(channel& item) noexcept
+    {
+        modify(item, 0);
+        paused_.push_back(&item);
+    }
+
+    void
+    resume() noexcept
+    {
+        for (auto* item : paused_) {
+            modify(*item, EPOLLIN);
+        }
+        paused_.clear();
+    }
+
+    /**
+     * @brief Routes a complete frame to its unit
+     */
+    void
+    dispatch(transport kind, std::uint8_t* begin, std::uint8_t* end, unit_table const& units,
+             reply_sink& sink) noexcept
+    {
+        auto const prefix = (kind == transport::tcp) ? mbap::prefix_length : rtu::prefix_length;
+        auto const id     = *(begin + prefix);
+        stats_.frames++;
+        if ((kind == transport::serial) && (id == modbus_base::broadcast_address)) {
+            for (auto* item : units.units()) {
+                item->serve(kind, begin, end, sink);
+            }
+            return;
+        }
+        auto* item = units.find(kind, id);
+        if (item == nullptr) [[unlikely]] {
+            stats_.unrouted++;
+            if (kind == transport::tcp) {
+                reject(begin, sink);
+            }
+            return;
+        }
+        item->serve(kind, begin, end, sink);
+    }
+
+    /**
+     * @brief Answers a TCP request for a unit that is not here with "gateway target device failed to respond"
+     */
+    static void
+    reject(std::uint8_t const* request, reply_sink& sink) noexcept
+    {
+        std::array<std::uint8_t, mbap::prefix_length + sizeof(header) + sizeof(error_fields)> reply{};
+        auto const body = reply.begin() + mbap::prefix_length;
+        std::copy(request + mbap::prefix_length, request + mbap::prefix_length + sizeof(header), body);
+        *(body + 1) |= error_reply_mask;
+        *(body + sizeof(header)) = static_cast<std::uint8_t>(exception::gateway_target);
+        mbap::reply(request, reply.begin());
+        sink.write(reply.begin(), mbap::seal(reply.begin(), reply.end()));
+    }
+};
+
+}    // namespace xitren::modbus::runtime
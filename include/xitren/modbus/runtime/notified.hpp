@@ -0,0 +1,102 @@
+/*!
+_ _
+__ _(_) |_ _ _ ___ _ _
+\ \ / |  _| '_/ -_) ' \
+/_\_\_|\__|_| \___|_||_|
+* @date 15.02.2024
+*/
+#pragma once
+
+#include <xitren/modbus/modbus.hpp>
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+namespace xitren::modbus::runtime {
+
+/**
+ * @brief A slave that wakes its host through an eventfd instead of being polled
+ *
+ * ready() writes the eventfd when a frame is waiting, so the host blocks in epoll or poll on fd() between frames and
+ * calls serve() when the descriptor becomes readable. No CPU is spent while the bus is quiet and no sleep is added to
+ * the turnaround:
+ * @code
+ * notified<my_slave> device{0x11};
+ * // register device.fd() for EPOLLIN, on the event:
+ * device.serve();
+ * @endcode
+ *
+ * @tparam Slave The slave type, a slave_base descendant constructible with the forwarded arguments.
+ */
+template <class Slave>
+class notified : public Slave {
+public:
+    template <class... Args>
+    explicit notified(Args&&... args) noexcept
+        : Slave(std::forward<Args>(args)...), fd_{::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)}
+    {}
+
+    notified(notified const&) = delete;
+    notified&
+    operator=(notified const&)
+        = delete;
+
+    ~notified() noexcept
+    {
+        if (fd_ >= 0) {
+            ::close(fd_);
+        }
+    }
+
+    /**
+     * @brief Returns true if the eventfd was created
+     */
+    [[nodiscard]] inline bool
+    valid() const noexcept
+    {
+        return fd_ >= 0;
+    }
+
+    /**
+     * @brief The descriptor to wait on, readable while a frame is waiting
+     */
+    [[nodiscard]] inline int
+    fd() const noexcept
+    {
+        return fd_;
+    }
+
+    void
+    ready() noexcept override
+    {
+        std::uint64_t const         one{1};
+        [[maybe_unused]] auto const written = ::write(fd_, &one, sizeof(one));
+    }
+
+    /**
+     * @brief Clears the eventfd and runs processing() until there is nothing to do
+     *
+     * @return The number of steps run
+     */
+    std::size_t
+    serve() noexcept
+    {
+        std::uint64_t               value{};
+        [[maybe_unused]] auto const read_size = ::read(fd_, &value, sizeof(value));
+        std::size_t                 steps{};
+        while ((this->state() != slave_state::unrecoverable_error)
+               && (this->processing() != exception::nothing_to_do)) {
+            steps++;
+        }
+        return steps;
+    }
+
+private:
+    int fd_;
+};
+
+}    // namespace xitren::modbus::runtime
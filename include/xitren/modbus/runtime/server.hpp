@@ -0,0 +1,143 @@
+/*!
+_ _
+__ _(_) |_ _ _ ___ _ _
+\ \ / |  _| '_/ -_) ' \
+/_\_\_|\__|_| \___|_||_|
+* @date 15.02.2024
+*/
+#pragma once
+
+#include <xitren/modbus/runtime/event_loop.hpp>
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace xitren::modbus::runtime {
+
+/**
+ * @brief A Modbus TCP server running one event loop per core
+ *
+ * Every loop opens its own SO_REUSEPORT listener on the same port and is pinned to its core, the kernel spreads the
+ * connections between the loops. The units are shared by all loops: hosted slaves serialize their requests, so a
+ * device image is consistent whichever loop serves the connection.
+ */
+class server {
+public:
+    /**
+     * @brief Creates the loops
+     *
+     * @param loops The number of loops, 0 means one per available core.
+     */
+    explicit server(std::size_t loops = 0) noexcept
+    {
+        if (loops == 0) {
+            loops = std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+        }
+        for (std::size_t i{}; i < loops; i++) {
+            loops_.push_back(std::make_unique<event_loop>());
+        }
+    }
+
+    server(server const&) = delete;
+    server&
+    operator=(server const&)
+        = delete;
+
+    ~server() noexcept { stop(); }
+
+    /**
+     * @brief Listens on a port in every loop
+     *
+     * @param port The port, 0 picks an ephemeral one.
+     * @param units The units served on the port, the table must outlive the server.
+     * @param address The IPv4 address to bind, in host byte order.
+     * @return The bound port or 0 on failure
+     */
+    std::uint16_t
+    listen(std::uint16_t port, unit_table const& units, std::uint32_t address = INADDR_ANY) noexcept
+    {
+        for (auto& loop : loops_) {
+            port = loop->listen(port, units, address);
+            if (port == 0) [[unlikely]] {
+                return 0;
+            }
+        }
+        return port;
+    }
+
+    /**
+     * @brief Starts a thread for every loop
+     *
+     * @return false If a loop could not be set up
+     */
+    bool
+    start() noexcept
+    {
+        for (std::size_t i{}; i < loops_.size(); i++) {
+            if (!loops_[i]->valid()) [[unlikely]] {
+                stop();
+                return false;
+            }
+            threads_.emplace_back([loop = loops_[i].get()] { loop->run(); });
+            pin(threads_.back(), i);
+        }
+        return true;
+    }
+
+    /**
+     * @brief Stops the loops and joins their threads
+     */
+    void
+    stop() noexcept
+    {
+        for (auto& loop : loops_) {
+            loop->stop();
+        }
+        for (auto& thread : threads_) {
+            if (thread.joinable()) {
+                thread.join();
+            }
+        }
+        threads_.clear();
+    }
+
+    [[nodiscard]] inline std::size_t
+    size() const noexcept
+    {
+        return loops_.size();
+    }
+
+    /**
+     * @brief Access to a loop, e.g. to attach serial lines before start()
+     */
+    inline event_loop&
+    loop(std::size_t index) noexcept
+    {
+        return *loops_[index];
+    }
+
+private:
+    std::vector<std::unique_ptr<event_loop>> loops_{};
+    std::vector<std::thread>                 threads_{};
+
+    static void
+    pin(std::thread& thread, std::size_t index) noexcept
+    {
+        auto const cores = std::thread::hardware_concurrency();
+        if (cores == 0) {
+            return;
+        }
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(index % cores, &set);
+        ::pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+    }
+};
+
+}    // namespace xitren::modbus::runtime
@@ -0,0 +1,185 @@
+/*!
+_ _
+__ _(_) |_ _ _ ___ _ _
+\ \ / |  _| '_/ -_) ' \
+/_\_\_|\__|_| \___|_||_|
+* @date 15.02.2024
+*/
+#pragma once
+
+#include <xitren/modbus/framing.hpp>
+#include <xitren/modbus/modbus.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <span>
+#include <type_traits>
+
+namespace xitren::modbus::runtime {
+
+/**
+ * @brief The kind of link a frame came from, it selects the framing of the frame
+ */
+enum class transport : std::uint8_t {
+    serial, /*!< Modbus RTU over a serial line or a pseudo-terminal. */
+    tcp     /*!< Modbus TCP (MBAP) over a stream socket. */
+};
+
+/**
+ * @brief Destination of the replies a unit produces while it serves a request
+ */
+class reply_sink {
+public:
+    /**
+     * @brief Queues a complete frame for transmission
+     *
+     * @param begin Pointer to the first byte of the frame
+     * @param end Pointer past the last byte of the frame
+     * @return true If the frame was sent or queued
+     */
+    virtual bool
+    write(std::uint8_t const* begin, std::uint8_t const* end) noexcept
+        = 0;
+
+    virtual ~reply_sink() noexcept = default;
+};
+
+/**
+ * @brief A slave device as seen by the runtime: something that serves complete frames
+ */
+class unit {
+public:
+    /**
+     * @brief The slave id / unit identifier the unit answers to
+     */
+    [[nodiscard]] virtual std::uint8_t
+    unit_id() const noexcept
+        = 0;
+
+    /**
+     * @brief Serves one complete frame, the reply (if any) is written to `sink` before returning
+     *
+     * The frame may be parsed in place, it is left untouched but must be writable.
+     * @param kind The transport the frame came from.
+     * @param begin Pointer to the first byte of the frame
+     * @param end Pointer past the last byte of the frame
+     * @param sink Where the reply goes
+     * @return The result of serving the frame, see slave_base::handle()
+     */
+    virtual exception
+    serve(transport kind, std::uint8_t* begin, std::uint8_t* end, reply_sink& sink) noexcept
+        = 0;
+
+    virtual ~unit() noexcept = default;
+};
+
+/**
+ * @brief Hosts a slave in the runtime
+ *
+ * The adapter implements `send()` of the slave: the reply goes back to the connection the request came from. Frames of
+ * the other transport are re-framed, so an RTU slave can be served over TCP and vice versa. Serving is serialized by a
+ * mutex, a hosted slave may be shared by several event loops.
+ *
+ * @tparam Slave The slave type, a slave_base descendant constructible with the forwarded arguments.
+ */
+template <class Slave>
+class hosted final : public Slave, public unit {
+    using framing_type = typename Slave::framing_type;
+    using iterator     = typename Slave::msg_type::array_type::iterator;
+
+    static constexpr std::size_t buffer_length = std::max(mbap::max_adu_length, rtu::max_adu_length);
+
+public:
+    using Slave::Slave;
+
+    [[nodiscard]] std::uint8_t
+    unit_id() const noexcept override
+    {
+        return Slave::id();
+    }
+
+    exception
+    serve(transport kind, std::uint8_t* begin, std::uint8_t* end, reply_sink& sink) noexcept override
+    {
+        std::lock_guard<std::mutex> const lock{mutex_};
+        auto const frame = (kind == transport::tcp) ? adapt<mbap>(begin, end) : adapt<rtu>(begin, end);
+        if (frame.empty()) [[unlikely]] {
+            return exception::bad_data;
+        }
+        auto const reply = Slave::handle(frame);
+        if (!reply.empty()) {
+            sink_           = &sink;
+            kind_           = kind;
+            auto const data = Slave::output().storage().data();
+            send(data, data + reply.size());
+            sink_ = nullptr;
+        }
+        return Slave::error();
+    }
+
+    bool
+    send(iterator begin, iterator end) noexcept override
+    {
+        if (sink_ == nullptr) [[unlikely]] {
+            return false;
+        }
+        return (kind_ == transport::tcp) ? send_as<mbap>(begin, end) : send_as<rtu>(begin, end);
+    }
+
+private:
+    std::mutex                              mutex_{};
+    reply_sink*                             sink_{nullptr};
+    transport                               kind_{transport::serial};
+    std::uint16_t                           transaction_{};
+    std::uint8_t                            unit_{};
+    std::array<std::uint8_t, buffer_length> buffer_{};
+
+    /**
+     * @brief The frame in the framing of the slave, re-framed into the own buffer if it came in the other one
+     */
+    template <framing_policy From>
+    std::span<std::uint8_t>
+    adapt(std::uint8_t* begin, std::uint8_t* end) noexcept
+    {
+        if constexpr (std::is_same_v<From, framing_type>) {
+            return {begin, end};
+        } else {
+            if ((static_cast<std::size_t>(end - begin) < From::min_adu_length)
+                || (static_cast<std::size_t>(end - begin) > From::max_adu_length) || !From::valid(begin, end))
+                [[unlikely]] {
+                return {};
+            }
+            transaction_ = From::transaction(begin);
+            unit_        = *(begin + From::prefix_length);
+            auto out_end = reframe<From, framing_type>(begin, end, buffer_.begin());
+            if (!From::broadcast && (unit_ != Slave::id())) {
+                // Re-address the request to the hosted slave, the reply gets the original unit back
+                *(buffer_.begin() + framing_type::prefix_length) = Slave::id();
+                out_end = framing_type::seal(buffer_.begin(), out_end - framing_type::suffix_length);
+            }
+            return {buffer_.begin(), out_end};
+        }
+    }
+
+    template <framing_policy To>
+    bool
+    send_as(iterator begin, iterator end) noexcept
+    {
+        if constexpr (std::is_same_v<To, framing_type>) {
+            return sink_->write(begin, end);
+        } else {
+            if (To::broadcast && (unit_ == Slave::broadcast_address)) {
+                // Broadcasts are not answered on a serial line
+                return true;
+            }
+            auto const out_end = reframe<framing_type, To>(begin, end, buffer_.begin());
+            To::transaction(buffer_.begin(), transaction_);
+            *(buffer_.begin() + To::prefix_length) = unit_;
+            return sink_->write(buffer_.begin(), To::seal(buffer_.begin(), out_end - To::suffix_length));
+        }
+    }
+};
+
+}    // namespace xitren::modbus::runtime
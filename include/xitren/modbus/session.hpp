@@ -0,0 +1,97 @@
+/*!
+_ _
+__ _(_) |_ _ _ ___ _ _
+\ \ / |  _| '_/ -_) ' \
+/_\_\_|\__|_| \___|_||_|
+* @date 15.02.2024
+*/
+#pragma once
+
+#include <xitren/modbus/concurrent_image.hpp>
+#include <xitren/modbus/slave.hpp>
+
+#include <cstdint>
+
+namespace xitren::modbus {
+
+/**
+ * @brief A device image many sessions serve at the same time
+ *
+ * The tables are seqlock protected, see concurrent_image.hpp: every session reads a consistent snapshot of the
+ * registers of a request and writes a request atomically, from any thread. The communication event log is not: the
+ * sessions read it for read_log requests without a lock, so the application may only write it while no session is
+ * serving, e.g. before the server starts. For the same reason it must not be the sink of the logger then.
+ */
+template <std::uint16_t Inputs, std::uint16_t Coils, std::uint16_t InputRegisters, std::uint16_t HoldingRegisters>
+using concurrent_device = device_image<concurrent_bits<Inputs>, concurrent_bits<Coils>,
+                                       concurrent_registers<InputRegisters>, concurrent_registers<HoldingRegisters>>;
+
+template <class Image, framing_policy Framing = mbap, class Functions = standard_functions>
+class session;
+
+/**
+ * @brief The protocol state of one connection to a shared device image
+ *
+ * The device model (the tables and the communication event log) lives in the image; a session only keeps what belongs
+ * to a transaction: the state, the error, the input and output messages and the stream reassembly of its connection.
+ * The function set is compiled, no per-session table is kept. A server keeps one session per client on whatever thread
+ * serves the connection, and all of them dispatch against the same image:
+ * @code
+ * concurrent_device<64, 64, 128, 128> plc;
+ * session<decltype(plc)>              client{0x01, plc};    // one per accepted connection
+ * auto const reply = client.handle(frame);
+ * @endcode
+ * The image must be a concurrent_device when sessions run on several threads, and must outlive the sessions. The
+ * diagnostic counters are kept per session, as each serial port of a device keeps its own.
+ *
+ * Most of a session is its input and output messages, 2 x 288 bytes on a 64-bit host; the protocol state, the image
+ * pointers and the run time extension table add up to 256 bytes more.
+ *
+ * @tparam Image The device_image type.
+ * @tparam Framing The ADU framing policy.
+ * @tparam Functions The function_set served.
+ */
+template <class Image, framing_policy Framing, function... Codes>
+class session<Image, Framing, function_set<Codes...>>
+    : public slave_base<typename Image::inputs_type, typename Image::coils_type, typename Image::input_regs_type,
+                        typename Image::holding_regs_type, 1, Framing, Codes...> {
+public:
+    using image_type             = Image;
+    using modbus_slave_base_type = slave_base<typename Image::inputs_type, typename Image::coils_type,
+                                              typename Image::input_regs_type, typename Image::holding_regs_type, 1,
+                                              Framing, Codes...>;
+    using typename modbus_slave_base_type::msg_type;
+
+    static_assert(sizeof...(Codes) > 0, "A session serves a compiled function set!");
+
+    session(std::uint8_t slave_id, image_type& image) noexcept
+        : modbus_slave_base_type::slave_base(slave_id, image.inputs, image.coils, image.input_registers,
+                                             image.holding_registers, image.log),
+          image_{&image}
+    {}
+
+    session(session const&) = delete;
+    session&
+    operator=(session const&)
+        = delete;
+
+    /**
+     * @brief Sessions reply through handle(), override send() to run one with receive() and processing()
+     */
+    bool
+    send(typename msg_type::array_type::iterator, typename msg_type::array_type::iterator) noexcept override
+    {
+        return false;
+    }
+
+    [[nodiscard]] inline image_type&
+    image() const noexcept
+    {
+        return *image_;
+    }
+
+private:
+    image_type* image_;
+};
+
+}    // namespace xitren::modbus
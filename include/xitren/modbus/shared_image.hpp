@@ -0,0 +1,303 @@
+/*!
+_ _
+__ _(_) |_ _ _ ___ _ _
+\ \ / |  _| '_/ -_) ' \
+/_\_\_|\__|_| \___|_||_|
+* @date 15.02.2024
+*/
+#pragma once
+
+#include <xitren/modbus/concurrent_image.hpp>
+#include <xitren/modbus/slave_base.hpp>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+namespace xitren::modbus {
+
+/**
+ * @brief The header at the start of a shared image region
+ *
+ * The creator fills the layout, then publishes the region by storing `magic` last; a process mapping the region checks
+ * the magic, the layout version and the table sizes before it touches the tables. Each table is guarded by its own
+ * seqlock sequence, see concurrent_image.hpp, so readers in any process never block and never write the region.
+ */
+struct shared_header {
+    static constexpr std::uint32_t magic_value = 0x5342'4D58;    // "XMBS"
+    static constexpr std::uint32_t layout      = 1;
+
+    std::atomic<std::uint32_t> magic;
+    std::uint32_t              version;
+    std::uint32_t              inputs;
+    std::uint32_t              coils;
+    std::uint32_t              input_registers;
+    std::uint32_t              holding_registers;
+    std::atomic<std::uint32_t> sequence[4];
+};
+
+static_assert(std::atomic<std::uint32_t>::is_always_lock_free, "The sequences must be address free to be shared");
+
+/**
+ * @brief How a shared image is opened
+ */
+enum class shared_mode {
+    create, /*!< Creates and initializes the region, or maps an existing region with the same layout. */
+    attach  /*!< Maps an existing, initialized region with the same layout. */
+};
+
+/**
+ * @brief A device image in a POSIX shared memory object or a memory mapped file
+ *
+ * Several processes map the same region, e.g. an HMI, the control logic and the Modbus server: each table is a view
+ * of the region with the concurrent_bits / concurrent_registers interface, so an update written by one process is
+ * seen by the others without a copy or a context switch. Serve it with shared_slave.
+ *
+ * Region layout, 64 byte aligned: header, discrete inputs and coils as 64-bit words, input and holding registers.
+ * Check valid() after construction, the region is unmapped when the object is destroyed.
+ *
+ * The seqlocks are not robust: a process killed inside an update() leaves the sequence of that table odd, and every
+ * reader and writer of the table then spins. After a writer crashed, stop the processes sharing the image, remove the
+ * region and create it again.
+ */
+template <std::uint16_t Inputs, std::uint16_t Coils, std::uint16_t InputRegisters, std::uint16_t HoldingRegisters>
+class shared_image {
+public:
+    using inputs_type       = concurrent_bits<Inputs, mapped_storage<std::uint64_t>>;
+    using coils_type        = concurrent_bits<Coils, mapped_storage<std::uint64_t>>;
+    using input_regs_type   = concurrent_registers<InputRegisters, mapped_storage<std::uint16_t>>;
+    using holding_regs_type = concurrent_registers<HoldingRegisters, mapped_storage<std::uint16_t>>;
+
+    static constexpr std::size_t alignment = 64;
+
+    static constexpr std::size_t
+    align(std::size_t offset) noexcept
+    {
+        return (offset + alignment - 1) / alignment * alignment;
+    }
+
+    static constexpr std::size_t inputs_offset       = align(sizeof(shared_header));
+    static constexpr std::size_t coils_offset        = align(inputs_offset + inputs_type::words * 8);
+    static constexpr std::size_t input_regs_offset   = align(coils_offset + coils_type::words * 8);
+    static constexpr std::size_t holding_regs_offset = align(input_regs_offset + InputRegisters * 2);
+    static constexpr std::size_t region_size         = align(holding_regs_offset + HoldingRegisters * 2);
+
+    /**
+     * @brief Maps a POSIX shared memory object
+     *
+     * @param name The object name, e.g. "/plant-image".
+     * @param mode Whether the object may be created.
+     */
+    static shared_image
+    shared_memory(char const* name, shared_mode mode) noexcept
+    {
+        int const flags{(mode == shared_mode::create) ? (O_RDWR | O_CREAT) : O_RDWR};
+        return shared_image{::shm_open(name, flags | O_CLOEXEC, 0660), mode};
+    }
+
+    /**
+     * @brief Maps a file, the image then survives a reboot of the processes
+     */
+    static shared_image
+    file(char const* path, shared_mode mode) noexcept
+    {
+        int const flags{(mode == shared_mode::create) ? (O_RDWR | O_CREAT) : O_RDWR};
+        return shared_image{::open(path, flags | O_CLOEXEC, 0660), mode};
+    }
+
+    /**
+     * @brief Removes a POSIX shared memory object, mappings stay valid until they are unmapped
+     */
+    static bool
+    remove(char const* name) noexcept
+    {
+        return ::shm_unlink(name) == 0;
+    }
+
+    /**
+     * @brief Maps the region of an open descriptor and takes the descriptor over
+     *
+     * An empty region is sized and initialized in the create mode, as is a region whose magic is still zero: its
+     * creator died before publishing it. A region of another size, of another layout version or with other table
+     * sizes is rejected.
+     */
+    shared_image(int fd, shared_mode mode) noexcept
+    {
+        if (fd < 0) [[unlikely]] {
+            return;
+        }
+        struct stat info {};
+        bool const  fresh{(::fstat(fd, &info) == 0) && (info.st_size == 0)};
+        if (fresh && ((mode != shared_mode::create) || (::ftruncate(fd, region_size) != 0))) [[unlikely]] {
+            ::close(fd);
+            return;
+        }
+        if (!fresh && (static_cast<std::size_t>(info.st_size) != region_size)) [[unlikely]] {
+            ::close(fd);
+            return;
+        }
+        void* address{::mmap(nullptr, region_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)};
+        ::close(fd);
+        if (address == MAP_FAILED) [[unlikely]] {
+            return;
+        }
+        region_ = static_cast<std::byte*>(address);
+        if (fresh || ((mode == shared_mode::create) && (header().magic.load(std::memory_order_acquire) == 0))) {
+            auto* header = new (region_) shared_header{};
+            header->version           = shared_header::layout;
+            header->inputs            = Inputs;
+            header->coils             = Coils;
+            header->input_registers   = InputRegisters;
+            header->holding_registers = HoldingRegisters;
+            header->magic.store(shared_header::magic_value, std::memory_order_release);
+        } else if (!compatible()) [[unlikely]] {
+            unmap();
+        }
+    }
+
+    shared_image(shared_image&& other) noexcept : region_{std::exchange(other.region_, nullptr)} {}
+
+    shared_image&
+    operator=(shared_image&& other) noexcept
+    {
+        if (this != &other) {
+            unmap();
+            region_ = std::exchange(other.region_, nullptr);
+        }
+        return *this;
+    }
+
+    shared_image(shared_image const&) = delete;
+    shared_image&
+    operator=(shared_image const&)
+        = delete;
+
+    ~shared_image() noexcept { unmap(); }
+
+    /**
+     * @brief Returns true if the region is mapped and has the layout of this image
+     */
+    [[nodiscard]] inline bool
+    valid() const noexcept
+    {
+        return region_ != nullptr;
+    }
+
+    [[nodiscard]] inline shared_header&
+    header() const noexcept
+    {
+        return *std::launder(reinterpret_cast<shared_header*>(region_));
+    }
+
+    [[nodiscard]] inputs_type
+    inputs() const noexcept
+    {
+        return inputs_type{{table<std::uint64_t>(inputs_offset), &header().sequence[0]}};
+    }
+
+    [[nodiscard]] coils_type
+    coils() const noexcept
+    {
+        return coils_type{{table<std::uint64_t>(coils_offset), &header().sequence[1]}};
+    }
+
+    [[nodiscard]] input_regs_type
+    input_registers() const noexcept
+    {
+        return input_regs_type{{table<std::uint16_t>(input_regs_offset), &header().sequence[2]}};
+    }
+
+    [[nodiscard]] holding_regs_type
+    holding_registers() const noexcept
+    {
+        return holding_regs_type{{table<std::uint16_t>(holding_regs_offset), &header().sequence[3]}};
+    }
+
+private:
+    std::byte* region_{};
+
+    template <class Word>
+    [[nodiscard]] Word*
+    table(std::size_t offset) const noexcept
+    {
+        return reinterpret_cast<Word*>(region_ + offset);
+    }
+
+    [[nodiscard]] bool
+    compatible() const noexcept
+    {
+        auto const& item = header();
+        return (item.magic.load(std::memory_order_acquire) == shared_header::magic_value)
+               && (item.version == shared_header::layout) && (item.inputs == Inputs) && (item.coils == Coils)
+               && (item.input_registers == InputRegisters) && (item.holding_registers == HoldingRegisters);
+    }
+
+    void
+    unmap() noexcept
+    {
+        if (region_ != nullptr) {
+            ::munmap(region_, region_size);
+            region_ = nullptr;
+        }
+    }
+};
+
+/**
+ * @brief A slave serving a shared_image
+ *
+ * The tables are views of the region, the image must be valid and outlive the slave. Other processes update the
+ * inputs and read the coils and holding registers through their own mapping.
+ *
+ * @tparam Image The shared_image type.
+ */
+template <class Image, std::uint16_t Fifo = 1, framing_policy Framing = rtu, function... Functions>
+class shared_slave
+    : public slave_base<typename Image::inputs_type, typename Image::coils_type, typename Image::input_regs_type,
+                        typename Image::holding_regs_type, Fifo, Framing, Functions...> {
+public:
+    using image_type             = Image;
+    using inputs_type            = typename image_type::inputs_type;
+    using coils_type             = typename image_type::coils_type;
+    using input_regs_type        = typename image_type::input_regs_type;
+    using holding_regs_type      = typename image_type::holding_regs_type;
+    using modbus_slave_base_type = slave_base<inputs_type, coils_type, input_regs_type, holding_regs_type, Fifo,
+                                              Framing, Functions...>;
+    using log_type               = typename modbus_slave_base_type::log_type;
+
+    shared_slave(std::uint8_t slave_id, image_type const& image) noexcept
+        : modbus_slave_base_type::slave_base(slave_id, inputs_data_, coils_data_, input_registers_data_,
+                                             holding_registers_data_, log_data_),
+          inputs_data_{image.inputs()},
+          coils_data_{image.coils()},
+          input_registers_data_{image.input_registers()},
+          holding_registers_data_{image.holding_registers()}
+    {}
+
+    inline input_regs_type&
+    input_registers() noexcept
+    {
+        return input_registers_data_;
+    }
+
+    inline inputs_type&
+    inputs() noexcept
+    {
+        return inputs_data_;
+    }
+
+private:
+    inputs_type       inputs_data_;
+    coils_type        coils_data_;
+    input_regs_type   input_registers_data_;
+    holding_regs_type holding_registers_data_;
+    log_type          log_data_{};
+};
+
+}    // namespace xitren::modbus
@@ -7,22 +7,30 @@ __ _(_) |_ _ _ ___ _ _
 */
 #pragma once
 
+#include <xitren/modbus/concurrent_image.hpp>
+#include <xitren/modbus/dirty_bits.hpp>
+#include <xitren/modbus/packed_bits.hpp>
 #include <xitren/modbus/slave_base.hpp>
 
+#include <algorithm>
+#include <array>
 #include <concepts>
 #include <limits>
+#include <span>
+#include <type_traits>
+#include <utility>
 
 namespace xitren::modbus {
 
 template <modbus_slave_container TInputs, modbus_slave_container TCoils, modbus_slave_container TInputRegisters,
-          modbus_slave_container THoldingRegisters, std::uint16_t Fifo>
-class slave_ext : public slave_base<TInputs, TCoils, TInputRegisters, THoldingRegisters, Fifo> {
+          modbus_slave_container THoldingRegisters, std::uint16_t Fifo, framing_policy Framing = rtu>
+class slave_ext : public slave_base<TInputs, TCoils, TInputRegisters, THoldingRegisters, Fifo, Framing> {
     static_assert(Fifo > 0, "FIFO length must be more than 0!");
 
 public:
-    using slave_type          = slave_base<TInputs, TCoils, TInputRegisters, THoldingRegisters, Fifo>;
-    using error_type          = packet<header, error_fields, crc16ansi>;
-    using function_type       = exception (*)(slave_base<TInputs, TCoils, TInputRegisters, THoldingRegisters, Fifo>&);
+    using slave_type          = slave_base<TInputs, TCoils, TInputRegisters, THoldingRegisters, Fifo, Framing>;
+    using error_type          = typename slave_type::error_type;
+    using function_type       = exception (*)(slave_type&);
     using function_table_type = std::array<function_type, slave_type::max_function_id + 1>;
     using fifo_type           = containers::circular_buffer<func::msb_t<std::uint16_t>, Fifo>;
     using log_type            = containers::circular_buffer<std::uint8_t, slave_type::log_size>;
@@ -30,8 +38,9 @@ public:
     constexpr explicit slave_ext(std::uint8_t slave_id, typename slave_type::inputs_type const& inputs,
                                  typename slave_type::coils_type&            coils,
                                  typename slave_type::input_regs_type const& input_regs,
-                                 typename slave_type::holding_regs_type&     holding_regs)
-        : slave_type{slave_id, inputs, coils, input_regs, holding_regs}
+                                 typename slave_type::holding_regs_type&     holding_regs,
+                                 typename slave_type::log_type&              log)
+        : slave_type{slave_id, inputs, coils, input_regs, holding_regs, log}
     {
         slave_type::register_function(function::write_single_coil, &functions::write_single_coil);
         slave_type::register_function(function::write_single_register, &functions::write_single_register);
@@ -66,24 +75,33 @@ private:
     fifo_type fifo_{};
 };
 
-template <std::uint16_t Inputs, std::uint16_t Coils, std::uint16_t InputRegisters, std::uint16_t HoldingRegisters,
-          std::uint16_t Fifo>
-class slave
-    : public slave_base<std::array<bool, Inputs>, std::array<bool, Coils>, std::array<std::uint16_t, InputRegisters>,
-                        std::array<std::uint16_t, HoldingRegisters>, Fifo> {
-protected:
+/**
+ * @brief A slave that owns its device image
+ *
+ * @tparam TInputs The discrete inputs container.
+ * @tparam TCoils The coils container.
+ * @tparam TInputRegisters The input registers container.
+ * @tparam THoldingRegisters The holding registers container.
+ * @tparam Fifo The FIFO length.
+ * @tparam Framing The ADU framing policy.
+ * @tparam Functions The function codes served, see slave_base.
+ */
+template <modbus_slave_container TInputs, modbus_slave_container TCoils, modbus_slave_container TInputRegisters,
+          modbus_slave_container THoldingRegisters, std::uint16_t Fifo, framing_policy Framing, function... Functions>
+class basic_slave
+    : public slave_base<TInputs, TCoils, TInputRegisters, THoldingRegisters, Fifo, Framing, Functions...> {
+public:
     using modbus_slave_base_type
-        = slave_base<std::array<bool, Inputs>, std::array<bool, Coils>, std::array<std::uint16_t, InputRegisters>,
-                     std::array<std::uint16_t, HoldingRegisters>, Fifo>;
-    using inputs_type       = typename modbus_slave_base_type::inputs_type;
-    using coils_type        = typename modbus_slave_base_type::coils_type;
-    using input_regs_type   = typename modbus_slave_base_type::input_regs_type;
-    using holding_regs_type = typename modbus_slave_base_type::holding_regs_type;
+        = slave_base<TInputs, TCoils, TInputRegisters, THoldingRegisters, Fifo, Framing, Functions...>;
+    using inputs_type            = typename modbus_slave_base_type::inputs_type;
+    using coils_type             = typename modbus_slave_base_type::coils_type;
+    using input_regs_type        = typename modbus_slave_base_type::input_regs_type;
+    using holding_regs_type      = typename modbus_slave_base_type::holding_regs_type;
+    using log_type               = typename modbus_slave_base_type::log_type;
 
-public:
-    constexpr explicit slave(std::uint8_t slave_id)
+    constexpr explicit basic_slave(std::uint8_t slave_id)
         : modbus_slave_base_type::slave_base(slave_id, inputs_data_, coils_data_, input_registers_data_,
-                                             holding_registers_data_)
+                                             holding_registers_data_, log_data_)
     {}
 
     inline input_regs_type&
@@ -103,6 +121,387 @@ private:
     coils_type        coils_data_{};
     input_regs_type   input_registers_data_{};
     holding_regs_type holding_registers_data_{};
+    log_type          log_data_{};
+};
+
+/**
+ * @brief A slave keeping one `bool` per discrete input and coil
+ */
+template <std::uint16_t Inputs, std::uint16_t Coils, std::uint16_t InputRegisters, std::uint16_t HoldingRegisters,
+          std::uint16_t Fifo, framing_policy Framing, function... Functions>
+class slave
+    : public basic_slave<std::array<bool, Inputs>, std::array<bool, Coils>, std::array<std::uint16_t, InputRegisters>,
+                         std::array<std::uint16_t, HoldingRegisters>, Fifo, Framing, Functions...> {
+public:
+    constexpr explicit slave(std::uint8_t slave_id) : slave::basic_slave(slave_id) {}
+};
+
+/**
+ * @brief A slave keeping its discrete inputs and coils packed, one bit each
+ *
+ * The image of 65536 coils takes 8 KiB instead of 64 KiB, ranges are read and written by whole words.
+ */
+template <std::uint16_t Inputs, std::uint16_t Coils, std::uint16_t InputRegisters, std::uint16_t HoldingRegisters,
+          std::uint16_t Fifo, framing_policy Framing, function... Functions>
+class packed_slave
+    : public basic_slave<packed_bits<Inputs>, packed_bits<Coils>, std::array<std::uint16_t, InputRegisters>,
+                         std::array<std::uint16_t, HoldingRegisters>, Fifo, Framing, Functions...> {
+public:
+    constexpr explicit packed_slave(std::uint8_t slave_id) : packed_slave::basic_slave(slave_id) {}
+};
+
+/**
+ * @brief A slave whose image the application updates from another thread while the protocol serves it
+ *
+ * Every table is a seqlock image: a read request always replies one consistent snapshot of its range, the application
+ * publishes a range at once with update(), e.g. a multi-register sensor value:
+ * @code
+ * device.input_registers().update(0, std::span<std::uint16_t const>{sample});
+ * @endcode
+ * The protocol never waits for the application, it only retries a copy that raced an update.
+ */
+template <std::uint16_t Inputs, std::uint16_t Coils, std::uint16_t InputRegisters, std::uint16_t HoldingRegisters,
+          std::uint16_t Fifo, framing_policy Framing, function... Functions>
+class concurrent_slave
+    : public basic_slave<concurrent_bits<Inputs>, concurrent_bits<Coils>, concurrent_registers<InputRegisters>,
+                         concurrent_registers<HoldingRegisters>, Fifo, Framing, Functions...> {
+public:
+    constexpr explicit concurrent_slave(std::uint8_t slave_id) : concurrent_slave::basic_slave(slave_id) {}
+};
+
+/**
+ * @brief The image of one unit served by a multi_slave
+ */
+template <modbus_slave_container TInputs, modbus_slave_container TCoils, modbus_slave_container TInputRegisters,
+          modbus_slave_container THoldingRegisters>
+struct device_image {
+    using inputs_type       = TInputs;
+    using coils_type        = TCoils;
+    using input_regs_type   = TInputRegisters;
+    using holding_regs_type = THoldingRegisters;
+    using log_type          = containers::circular_buffer<std::uint8_t, xitren::modbus::log::log_size>;
+
+    TInputs           inputs{};
+    TCoils            coils{};
+    TInputRegisters   input_registers{};
+    THoldingRegisters holding_registers{};
+    log_type          log{};
+};
+
+/**
+ * @brief One slave protocol serving many units, e.g. a gateway emulating the devices behind it
+ *
+ * A frame is routed by its slave id through a table of 256 images: the CRC is checked and the request parsed once, in
+ * the shared input and output messages, and the handler runs on the image of the addressed unit. Frames for ids
+ * without an image are dropped after the lookup. A broadcast runs once on every attached image, the frame is not
+ * checked or parsed again. On Modbus TCP the ids 0 and 0xFF go to the first attached unit.
+ *
+ * The hooks, e.g. changed_holdings(), see the unit being served in id().
+ *
+ * @tparam TInputs The discrete inputs container of each unit.
+ * @tparam TCoils The coils container of each unit.
+ * @tparam TInputRegisters The input registers container of each unit.
+ * @tparam THoldingRegisters The holding registers container of each unit.
+ * @tparam Fifo The FIFO length.
+ * @tparam Framing The ADU framing policy.
+ * @tparam Functions The function codes served, see slave_base.
+ */
+template <modbus_slave_container TInputs, modbus_slave_container TCoils, modbus_slave_container TInputRegisters,
+          modbus_slave_container THoldingRegisters, std::uint16_t Fifo = 1, framing_policy Framing = rtu,
+          function... Functions>
+class multi_slave
+    : public slave_base<TInputs, TCoils, TInputRegisters, THoldingRegisters, Fifo, Framing, Functions...> {
+    using modbus_slave_base_type
+        = slave_base<TInputs, TCoils, TInputRegisters, THoldingRegisters, Fifo, Framing, Functions...>;
+    using modbus_slave_base_type::broadcast_address;
+    using modbus_slave_base_type::error_;
+    using modbus_slave_base_type::input_msg_;
+
+public:
+    using typename modbus_slave_base_type::framing_type;
+    using image_type = device_image<TInputs, TCoils, TInputRegisters, THoldingRegisters>;
+
+    static constexpr std::size_t max_units = 256;
+
+    constexpr multi_slave() noexcept : modbus_slave_base_type::slave_base(broadcast_address) {}
+
+    multi_slave(multi_slave const&) = delete;
+    multi_slave&
+    operator=(multi_slave const&)
+        = delete;
+
+    /**
+     * @brief Serves an image under a slave id
+     *
+     * @param slave_id The id, the broadcast address is not a unit.
+     * @param image The image, it must outlive the slave or be detached.
+     * @return false If the id is the broadcast address or already taken
+     */
+    bool
+    attach(std::uint8_t slave_id, image_type& image) noexcept
+    {
+        if ((slave_id == broadcast_address) || (units_[slave_id] != nullptr)) [[unlikely]] {
+            return false;
+        }
+        units_[slave_id]     = &image;
+        attached_[count_++] = slave_id;
+        return true;
+    }
+
+    /**
+     * @brief Stops serving a slave id
+     */
+    void
+    detach(std::uint8_t slave_id) noexcept
+    {
+        if (units_[slave_id] == nullptr) {
+            return;
+        }
+        units_[slave_id] = nullptr;
+        auto const end   = std::remove(attached_.begin(), attached_.begin() + count_, slave_id);
+        count_           = static_cast<std::size_t>(end - attached_.begin());
+        modbus_slave_base_type::unbind();
+    }
+
+    /**
+     * @brief The image served under a slave id, nullptr if there is none
+     */
+    [[nodiscard]] inline image_type*
+    unit(std::uint8_t slave_id) const noexcept
+    {
+        return units_[slave_id];
+    }
+
+    /**
+     * @brief The number of attached units
+     */
+    [[nodiscard]] inline std::size_t
+    units() const noexcept
+    {
+        return count_;
+    }
+
+    /**
+     * @brief Serves a complete request frame in one call, see slave_base::handle()
+     */
+    std::span<std::uint8_t const>
+    handle(std::span<std::uint8_t> frame) noexcept
+    {
+        if (frame.size() <= framing_type::prefix_length) [[unlikely]] {
+            error_ = exception::bad_data;
+            return {};
+        }
+        auto const slave_id = frame[framing_type::prefix_length];
+        if (!route(slave_id)) [[unlikely]] {
+            error_ = exception::bad_slave;
+            return {};
+        }
+        auto const reply = modbus_slave_base_type::handle_as(*this, frame);
+        if (broadcast(slave_id) && (error_ == exception::no_error)) {
+            input_msg_.borrow(frame);
+            input_msg_.size(frame.size());
+            fan_out();
+            input_msg_.release();
+            input_msg_.size(0);
+        }
+        return reply;
+    }
+
+    exception
+    processing() noexcept override
+    {
+        if (this->state() == slave_state::checking_request) {
+            route(*(input_msg_.storage().data() + framing_type::prefix_length));
+        } else if ((this->state() == slave_state::processing_action)
+                   && broadcast(*(input_msg_.storage().data() + framing_type::prefix_length))) {
+            fan_out();
+            bind(attached_[0]);
+        }
+        return modbus_slave_base_type::step(*this);
+    }
+
+private:
+    std::array<image_type*, max_units>  units_{};
+    std::array<std::uint8_t, max_units> attached_{};
+    std::size_t                         count_{};
+
+    [[nodiscard]] static constexpr bool
+    broadcast(std::uint8_t slave_id) noexcept
+    {
+        return framing_type::broadcast && (slave_id == broadcast_address);
+    }
+
+    void
+    bind(std::uint8_t slave_id) noexcept
+    {
+        auto& image = *units_[slave_id];
+        modbus_slave_base_type::bind(slave_id, image.inputs, image.coils, image.input_registers,
+                                     image.holding_registers, image.log);
+    }
+
+    /**
+     * @brief Binds the image a request for `slave_id` is served on, unbinds if there is none
+     *
+     * @return false If no unit serves the id
+     */
+    bool
+    route(std::uint8_t slave_id) noexcept
+    {
+        if (units_[slave_id] != nullptr) [[likely]] {
+            bind(slave_id);
+            return true;
+        }
+        if ((count_ > 0) && (broadcast(slave_id) || framing_type::any_unit(slave_id))) {
+            bind(attached_[0]);
+            return true;
+        }
+        modbus_slave_base_type::unbind();
+        return false;
+    }
+
+    /**
+     * @brief Runs the checked broadcast request on the units after the first one
+     */
+    void
+    fan_out() noexcept
+    {
+        for (std::size_t i{1}; i < count_; i++) {
+            bind(attached_[i]);
+            modbus_slave_base_type::execute(*this);
+        }
+    }
+};
+
+/**
+ * @brief A slave that tracks which coils and holding registers the masters changed
+ *
+ * Owns the trackers attached with slave_base::track(): the write handlers mark the elements whose value changed and
+ * advance the generation of the image once per changing write. A checkpoint walks the dirty ranges and clears them:
+ * @code
+ * if (device.holding_changes().generation() != saved) {
+ *     for (auto const [start, count] : device.holding_changes()) { store(start, count); }
+ *     device.holding_changes().clear();
+ *     saved = device.holding_changes().generation();
+ * }
+ * @endcode
+ * Changes made by the application through holding_registers() or coils() are not tracked.
+ *
+ * @tparam Slave The slave to build on, e.g. `slave<...>` or `packed_slave<...>`.
+ */
+template <class Slave>
+class tracked_slave : public Slave {
+public:
+    using typename Slave::coil_changes_type;
+    using typename Slave::holding_changes_type;
+
+    template <class... Args>
+    constexpr explicit tracked_slave(Args&&... args) : Slave(std::forward<Args>(args)...)
+    {
+        Slave::track(&coil_changes_, &holding_changes_);
+    }
+
+    tracked_slave(tracked_slave const&) = delete;
+    tracked_slave&
+    operator=(tracked_slave const&)
+        = delete;
+
+    inline coil_changes_type&
+    coil_changes() noexcept
+    {
+        return coil_changes_;
+    }
+
+    [[nodiscard]] inline constexpr coil_changes_type const&
+    coil_changes() const noexcept
+    {
+        return coil_changes_;
+    }
+
+    inline holding_changes_type&
+    holding_changes() noexcept
+    {
+        return holding_changes_;
+    }
+
+    [[nodiscard]] inline constexpr holding_changes_type const&
+    holding_changes() const noexcept
+    {
+        return holding_changes_;
+    }
+
+private:
+    coil_changes_type    coil_changes_{};
+    holding_changes_type holding_changes_{};
+};
+
+/**
+ * @brief A slave whose hooks are resolved at compile time
+ *
+ * `Derived` is the final class implementing send(), changed_coil(), changed_holding(), transmit_buffer() and the other
+ * hooks. receive(), processing() and handle() call them on `Derived`, and the function handlers and the range change
+ * notifications are instantiated for it, so no call of a transaction goes through the virtual table. The virtual
+ * interface keeps working for code that holds the slave by a base reference, e.g. the runtime hosts.
+ *
+ * @tparam Derived The final class derived from static_slave, its hooks must be public.
+ * @tparam Slave The slave to build on, e.g. `slave<...>` or `packed_slave<...>`.
+ */
+template <class Derived, class Slave>
+class static_slave : public Slave {
+public:
+    using Slave::Slave;
+
+    /**
+     * @brief Receives a message, see basic_modbus_base::receive()
+     */
+    template <class InputIterator>
+    constexpr exception
+    receive(InputIterator begin, InputIterator end) noexcept
+    {
+        return Slave::receive_as(derived(), begin, end);
+    }
+
+    exception
+    received() noexcept override
+    {
+        return Slave::received_as(derived());
+    }
+
+    exception
+    processing() noexcept override
+    {
+        return Slave::step(derived());
+    }
+
+    void
+    changed_coils(std::size_t start, std::size_t count, std::span<std::uint8_t const> before,
+                  std::span<std::uint8_t const> after) noexcept override
+    {
+        Slave::changed_coils_as(derived(), start, count, before, after);
+    }
+
+    void
+    changed_holdings(std::size_t start, std::span<std::uint16_t const> before,
+                     std::span<std::uint16_t const> after) noexcept override
+    {
+        Slave::changed_holdings_as(derived(), start, before, after);
+    }
+
+    /**
+     * @brief Serves a complete request frame in one call, see slave_base::handle()
+     */
+    std::span<std::uint8_t const>
+    handle(std::span<std::uint8_t> frame) noexcept
+    {
+        return Slave::handle_as(derived(), frame);
+    }
+
+private:
+    Derived&
+    derived() noexcept
+    {
+        static_assert(std::is_final_v<Derived>, "Derived must be final for its hooks to be called directly!");
+        return static_cast<Derived&>(*this);
+    }
 };
 
 }    // namespace xitren::modbus
@@ -6,6 +6,8 @@ __ _(_) |_ _ _ ___ _ _
 * @date 15.02.2024
 */
 #pragma once
+#include <xitren/modbus/changes.hpp>
+#include <xitren/modbus/dirty_bits.hpp>
 #include <xitren/modbus/functions/diagnostics.hpp>
 #include <xitren/modbus/functions/get_current_log_level.hpp>
 #include <xitren/modbus/functions/identification.hpp>
@@ -24,20 +26,53 @@ __ _(_) |_ _ _ ___ _ _
 #include <xitren/modbus/functions/write_single_register.hpp>
 #include <xitren/modbus/modbus.hpp>
 
+#include <algorithm>
 #include <concepts>
 #include <limits>
+#include <span>
+#include <type_traits>
 #define STRINGIFY(x) #x
 
 namespace xitren::modbus {
 
+/**
+ * @brief A list of function codes
+ */
+template <function... Codes>
+struct function_set {};
+
+/**
+ * @brief The functions a slave serves by default
+ */
+using standard_functions
+    = function_set<function::read_coils, function::read_discrete_inputs, function::read_holding_registers,
+                   function::read_input_registers, function::write_multiple_registers, function::write_single_register,
+                   function::write_multiple_coils, function::write_single_coil, function::read_log,
+                   function::set_max_log_level, function::get_current_log_level, function::diagnostic,
+                   function::read_device_identification>;
+
+/**
+ * @brief The Modbus slave protocol over a device image
+ *
+ * With an empty `Functions` pack the slave dispatches through a per-instance table of 128 function pointers, filled
+ * with the standard functions and changed with register_function(). With function codes in the pack the set is fixed
+ * at compile time: the handlers are called directly and can be inlined, the other handlers are not instantiated, and
+ * register_function() only adds up to `max_extensions` run time functions for the codes outside the pack.
+ *
+ * @tparam Functions The function codes served, e.g. `function::read_holding_registers`.
+ */
 template <modbus_slave_container TInputs, modbus_slave_container TCoils, modbus_slave_container TInputRegisters,
-          modbus_slave_container THoldingRegisters, std::uint16_t Fifo>
-class slave_base : public modbus_base {
+          modbus_slave_container THoldingRegisters, std::uint16_t Fifo, framing_policy Framing, function... Functions>
+class slave_base : public basic_modbus_base<Framing> {
 protected:
-    using inputs_type       = TInputs;
-    using coils_type        = TCoils;
-    using input_regs_type   = TInputRegisters;
-    using holding_regs_type = THoldingRegisters;
+    using base_type = basic_modbus_base<Framing>;
+    using base_type::error_;
+    using base_type::input_msg_;
+    using base_type::output_msg_;
+    using base_type::broadcast_address;
+    using base_type::max_function_id;
+    using base_type::increment_counter;
+    using base_type::prepare_output;
 
     static_assert(std::is_same_v<typename TInputs::value_type, bool>, "Inputs value_type must be bool!");
     static_assert(std::is_same_v<typename TCoils::value_type, bool>, "Coils value_type must be bool!");
@@ -52,61 +87,145 @@ protected:
     static_assert(THoldingRegisters{}.size() > 0, "HoldingRegisters must be more than 0!");
 
 public:
-    using slave_type          = slave_base<TInputs, TCoils, TInputRegisters, THoldingRegisters, Fifo>;
-    using error_type          = packet<header, error_fields, crc16ansi>;
-    using function_type       = exception (*)(slave_base<TInputs, TCoils, TInputRegisters, THoldingRegisters, Fifo>&);
+    using typename base_type::framing_type;
+    using typename base_type::msg_type;
+    using base_type::send;
+    using inputs_type       = TInputs;
+    using coils_type        = TCoils;
+    using input_regs_type   = TInputRegisters;
+    using holding_regs_type = THoldingRegisters;
+    using slave_type = slave_base<TInputs, TCoils, TInputRegisters, THoldingRegisters, Fifo, Framing, Functions...>;
+    using error_type = typename framing_type::template packet_type<header, error_fields>;
+    using function_type       = exception (*)(slave_type&);
+    template <class Self>
+    using handler_type        = exception (*)(Self&);
     using function_table_type = std::array<function_type, max_function_id + 1>;
     using fifo_type           = containers::circular_buffer<func::msb_t<std::uint16_t>, Fifo>;
     using log_type            = containers::circular_buffer<std::uint8_t, xitren::modbus::log::log_size>;
+    using coil_changes_type    = dirty_bits<TCoils{}.size()>;
+    using holding_changes_type = dirty_bits<THoldingRegisters{}.size()>;
+
+    /**
+     * @brief A function registered at run time on a slave with a compiled function set
+     */
+    struct extension_type {
+        std::uint8_t  code;
+        function_type handler;
+    };
+
+    static constexpr bool        compiled       = sizeof...(Functions) > 0;
+    static constexpr std::size_t max_extensions = 8;
+    using extension_table_type                  = std::array<extension_type, max_extensions>;
+    using table_type = std::conditional_t<compiled, extension_table_type, function_table_type>;
 
     constexpr explicit slave_base(std::uint8_t slave_id, inputs_type const& inputs, coils_type& coils,
-                                  input_regs_type const& input_regs, holding_regs_type& holding_regs)
+                                  input_regs_type const& input_regs, holding_regs_type& holding_regs, log_type& log)
         : slave_id_{slave_id},
-          inputs_{inputs},
-          coils_{coils},
-          input_registers_{input_regs},
-          holding_registers_{holding_regs}
-    {
-        register_function(function::read_coils, &functions::read_coils);
-        register_function(function::read_discrete_inputs, &functions::read_inputs);
-        register_function(function::read_holding_registers, &functions::read_holding);
-        register_function(function::read_input_registers, &functions::read_input_regs);
-        register_function(function::write_multiple_registers, &functions::write_registers);
-        register_function(function::write_single_register, &functions::write_single_register);
-        register_function(function::write_multiple_coils, &functions::write_coils);
-        register_function(function::write_single_coil, &functions::write_single_coil);
-        register_function(function::read_log, &functions::read_log);
-        register_function(function::set_max_log_level, &functions::set_max_log_level);
-        register_function(function::get_current_log_level, &functions::get_current_log_level);
-        register_function(function::diagnostic, &functions::diagnostics);
-        register_function(function::read_device_identification, &functions::identification);
+          inputs_{&inputs},
+          coils_{&coils},
+          input_registers_{&input_regs},
+          holding_registers_{&holding_regs},
+          log_{&log}
+    {
+        if constexpr (!compiled) {
+            register_builtin(standard_functions{});
+        }
+    }
+
+    /**
+     * @brief The handler of the library for a function code
+     *
+     * @tparam Self The type the handler is instantiated for, its hooks are called without virtual dispatch if it is
+     * final.
+     * @return The handler, nullptr if the library has none usable by slave_base
+     */
+    template <function Code, class Self = slave_type>
+    static constexpr handler_type<Self>
+    builtin() noexcept
+    {
+        if constexpr (Code == function::read_coils) {
+            return &functions::read_coils;
+        } else if constexpr (Code == function::read_discrete_inputs) {
+            return &functions::read_inputs;
+        } else if constexpr (Code == function::read_holding_registers) {
+            return &functions::read_holding;
+        } else if constexpr (Code == function::read_input_registers) {
+            return &functions::read_input_regs;
+        } else if constexpr (Code == function::write_multiple_registers) {
+            return &functions::write_registers;
+        } else if constexpr (Code == function::write_single_register) {
+            return &functions::write_single_register;
+        } else if constexpr (Code == function::write_multiple_coils) {
+            return &functions::write_coils;
+        } else if constexpr (Code == function::write_single_coil) {
+            return &functions::write_single_coil;
+        } else if constexpr (Code == function::mask_write_register) {
+            return &functions::write_register_mask;
+        } else if constexpr (Code == function::read_exception_status) {
+            return &functions::read_exception_status;
+        } else if constexpr (Code == function::read_log) {
+            return &functions::read_log;
+        } else if constexpr (Code == function::set_max_log_level) {
+            return &functions::set_max_log_level;
+        } else if constexpr (Code == function::get_current_log_level) {
+            return &functions::get_current_log_level;
+        } else if constexpr (Code == function::diagnostic) {
+            return &functions::diagnostics;
+        } else if constexpr (Code == function::read_device_identification) {
+            return &functions::identification;
+        } else {
+            return nullptr;
+        }
     }
 
+    /**
+     * @brief Registers a run time handler
+     *
+     * On a slave with a compiled function set the handler serves a code outside the set, it is dropped if all
+     * `max_extensions` slots are taken.
+     */
     void
     register_function(function const id, function_type const func) noexcept
     {
-        defined_functions_table_[static_cast<std::uint8_t>(id)] = func;
+        if constexpr (compiled) {
+            auto const code = static_cast<std::uint8_t>(id);
+            auto       slot = std::find_if(defined_functions_table_.begin(), defined_functions_table_.end(),
+                                          [code](auto const& item) { return item.code == code; });
+            if (slot == defined_functions_table_.end()) {
+                slot = std::find_if(defined_functions_table_.begin(), defined_functions_table_.end(),
+                                    [](auto const& item) { return item.handler == nullptr; });
+            }
+            if (slot == defined_functions_table_.end()) [[unlikely]] {
+                WARN() << "no free extension slot";
+                return;
+            }
+            *slot = {code, func};
+        } else {
+            defined_functions_table_[static_cast<std::uint8_t>(id)] = func;
+        }
     }
 
+    /**
+     * @brief Removes a run time handler, the compiled function set is not affected
+     */
     void
     unregister_function(function const id) noexcept
     {
-        defined_functions_table_[static_cast<std::uint8_t>(id)] = nullptr;
+        if constexpr (compiled) {
+            for (auto& item : defined_functions_table_) {
+                if (item.code == static_cast<std::uint8_t>(id)) {
+                    item = {};
+                }
+            }
+        } else {
+            defined_functions_table_[static_cast<std::uint8_t>(id)] = nullptr;
+        }
     }
 
     exception
     received() noexcept override
     {
-        switch (state_) {
-        case slave_state::idle:
-            TRACE() << "idle -> check";
-            state_ = slave_state::checking_request;
-            break;
-        default:
-            WARN() << "state undef: " << static_cast<std::uint8_t>(state_);
-            break;
-        }
-        return exception::no_error;
+        return received_as(*this);
     }
 
     constexpr virtual std::string_view
@@ -128,95 +247,89 @@ public:
             BUILD_NUMBER) " " STRINGIFY(COMMIT_ID);
     }
 
+    /**
+     * @brief Called for every coil a write changed, by the default changed_coils()
+     */
     virtual void
     changed_coil(std::size_t, bool) noexcept
     {}
 
+    /**
+     * @brief Called for every holding register a write changed, by the default changed_holdings()
+     */
     virtual void
     changed_holding(std::size_t, std::uint16_t) noexcept
     {}
 
+    /**
+     * @brief Called once per write that changed at least one coil
+     *
+     * `before` and `after` are the Modbus bit fields (LSB first, zero padded) of the `count` coils written from
+     * `start`. The default calls changed_coil() for every coil that changed.
+     */
+    virtual void
+    changed_coils(std::size_t start, std::size_t count, std::span<std::uint8_t const> before,
+                  std::span<std::uint8_t const> after) noexcept
+    {
+        changed_coils_as(*this, start, count, before, after);
+    }
+
+    /**
+     * @brief Called once per write that changed at least one holding register
+     *
+     * `before` and `after` are the values of the registers written from `start`. The default calls changed_holding()
+     * for every register that changed.
+     */
+    virtual void
+    changed_holdings(std::size_t start, std::span<std::uint16_t const> before,
+                     std::span<std::uint16_t const> after) noexcept
+    {
+        changed_holdings_as(*this, start, before, after);
+    }
+
     virtual void
     restart_comm() noexcept
     {}
 
+    /**
+     * @brief Called by received() when a frame is waiting for processing()
+     *
+     * The host wakes its loop here, e.g. by writing an eventfd, instead of polling processing(). It may be called from
+     * the context receiving the frame, it must not call processing() itself.
+     */
+    virtual void
+    ready() noexcept
+    {}
+
+    /**
+     * @brief Runs one step of the state machine
+     *
+     * @return exception::nothing_to_do If the slave is idle, the host may sleep until the next ready()
+     */
     exception
     processing() noexcept override
     {
-        static header head{};
-
-        switch (state_) {
-        case slave_state::checking_request:
-            head = func::data<header>::deserialize(input_msg_.storage().begin());
-
-            if ((head.slave_id != slave_id_) && (head.slave_id != broadcast_address)) [[likely]] {
-                TRACE() << "check -> idle";
-                state_ = slave_state::idle;
-                input_msg_.size(0);
-                TRACE() << "bad_slave";
-                return exception::bad_slave;
-            }
-
-            increment_counter(diagnostics_sub_function::return_bus_message_count);
+        return step(*this);
+    }
 
-            if ((head.function_code >= max_function_id) || (defined_functions_table_[head.function_code] == nullptr))
-                [[unlikely]] {
-                TRACE() << "check -> err_reply";
-                state_ = slave_state::formatting_error_reply;
-                input_msg_.size(0);
-                increment_counter(diagnostics_sub_function::return_server_exception_error_count);
-                WARN() << "illegal_function";
-                return error_ = exception::illegal_function;
-            }
-            state_ = slave_state::processing_action;
-            break;
-        case slave_state::processing_action:
-            if (exception::no_error == (error_ = defined_functions_table_[head.function_code](*this))) [[likely]] {
-                TRACE() << "proc -> reply";
-                state_ = slave_state::formatting_reply;
-            } else [[unlikely]] {
-                increment_counter(diagnostics_sub_function::return_server_exception_error_count);
-                TRACE() << "proc -> err_reply";
-                state_ = slave_state::formatting_error_reply;
-            }
-            if (head.slave_id == broadcast_address) [[unlikely]] {
-                increment_counter(diagnostics_sub_function::return_server_no_response_count);
-                state_ = slave_state::idle;
-            }
-            input_msg_.size(0);
-            break;
-        case slave_state::formatting_reply:
-            if (!silent_) {
-                send(output_msg_.storage().begin(), output_msg_.storage().begin() + output_msg_.size());
-            }
-            output_msg_.size(0);
-            TRACE() << "reply -> idle";
-            state_ = slave_state::idle;
-            break;
-        case slave_state::formatting_error_reply:
-            output_msg_.template serialize<header, error_fields, uint8_t, crc16ansi>(
-                {{slave_id_, static_cast<uint8_t>(head.function_code | error_reply_mask)}, {error_}, 0, nullptr});
-            if (!silent_) {
-                if (!send(output_msg_.storage().begin(), output_msg_.storage().begin() + output_msg_.size()))
-                    [[unlikely]] {
-                    TRACE() << "err_reply -> un_err";
-                    state_ = slave_state::unrecoverable_error;
-                    ERROR() << "unknown_exception";
-                    return error_ = exception::unknown_exception;
-                }
-            }
-            output_msg_.size(0);
-            input_msg_.size(0);
-            error_ = exception::no_error;
-            TRACE() << "err_reply -> idle";
-            state_ = slave_state::idle;
-            break;
-        default:
-            WARN() << "state undef: " << static_cast<std::uint8_t>(state_);
-        case slave_state::idle:
-            break;
-        }
-        return exception::no_error;
+    /**
+     * @brief Serves a complete request frame in one call
+     *
+     * The fast path for hosts that are not cooperative loops: the frame is validated, dispatched and the reply is
+     * serialized in one pass, without going through the states of processing(). The frame is parsed in place and is not
+     * used after the call. send() is not called, the reply is returned instead and stays valid until the next request.
+     * The slave must be idle, the state machine is left untouched.
+     *
+     * After the call error() tells the outcome: exception::no_error for a normal reply, the Modbus exception of an
+     * error reply, or the reception error (bad_crc, bad_data, bad_slave, slave_or_server_busy) of an unanswered frame.
+     *
+     * @param frame The received frame
+     * @return The reply frame, a view into the output message; empty if the request is not answered
+     */
+    std::span<std::uint8_t const>
+    handle(std::span<std::uint8_t> frame) noexcept
+    {
+        return handle_as(*this, frame);
     }
 
     inline bool
@@ -240,37 +353,61 @@ public:
     [[nodiscard]] inline constexpr inputs_type const&
     inputs() const noexcept
     {
-        return inputs_;
+        return *inputs_;
     }
 
     inline coils_type&
     coils() noexcept
     {
-        return coils_;
+        return *coils_;
     }
 
     [[nodiscard]] inline constexpr coils_type&
     coils() const noexcept
     {
-        return coils_;
+        return *coils_;
     }
 
     [[nodiscard]] inline constexpr input_regs_type const&
     input_registers() const noexcept
     {
-        return input_registers_;
+        return *input_registers_;
     }
 
     inline holding_regs_type&
     holding_registers() noexcept
     {
-        return holding_registers_;
+        return *holding_registers_;
     }
 
     [[nodiscard]] inline constexpr holding_regs_type&
     holding_registers() const noexcept
     {
-        return holding_registers_;
+        return *holding_registers_;
+    }
+
+    /**
+     * @brief Attaches the trackers the write handlers mark the changed coils and holding registers in
+     *
+     * Tracking is off by default, nullptr detaches a tracker. See tracked_slave.
+     */
+    inline void
+    track(coil_changes_type* coils, holding_changes_type* holdings) noexcept
+    {
+        coil_tracker_    = coils;
+        holding_tracker_ = holdings;
+    }
+
+    inline coil_changes_type*
+    coil_tracker() noexcept
+    {
+        return coil_tracker_;
+    }
+
+    inline holding_changes_type*
+    holding_tracker() noexcept
+    {
+        return holding_tracker_;
     }
 
     inline void
@@ -314,13 +451,13 @@ public:
     inline log_type&
     log() noexcept
     {
-        return log_;
+        return *log_;
     }
 
     [[nodiscard]] inline constexpr log_type const&
     log() const noexcept
     {
-        return log_;
+        return *log_;
     }
 
     static bool
@@ -329,26 +466,396 @@ public:
         return ((std::numeric_limits<std::uint16_t>::max() - addr) >= cnt) && ((addr + cnt) <= size);
     }
 
+    /**
+     * @brief Checks that the addresses [addr, addr + cnt) exist in a table, holes of a sparse_container included
+     */
+    template <modbus_slave_container Container>
+    static constexpr bool
+    address_valid(std::uint16_t addr, std::uint16_t cnt, Container const& table) noexcept
+    {
+        if constexpr (sparse_container<Container>) {
+            return table.contains(addr, cnt);
+        } else {
+            return (std::size_t{addr} + cnt) <= table.size();
+        }
+    }
+
     template <std::ranges::common_range Array>
     slave_base&
     to_log(Array const& in_data)
     {
         for (auto const& item : in_data) {
-            log_.push(item);
+            log_->push(item);
         }
         return *this;
     }
 
+protected:
+    /**
+     * @brief A slave without an image, it answers no request until bind() gives it one
+     */
+    constexpr explicit slave_base(std::uint8_t slave_id) noexcept : slave_id_{slave_id}
+    {
+        if constexpr (!compiled) {
+            register_builtin(standard_functions{});
+        }
+    }
+
+    /**
+     * @brief Serves the image of another unit from now on, e.g. the unit a request is routed to
+     */
+    constexpr void
+    bind(std::uint8_t slave_id, inputs_type const& inputs, coils_type& coils, input_regs_type const& input_regs,
+         holding_regs_type& holding_regs, log_type& log) noexcept
+    {
+        slave_id_          = slave_id;
+        inputs_            = &inputs;
+        coils_             = &coils;
+        input_registers_   = &input_regs;
+        holding_registers_ = &holding_regs;
+        log_               = &log;
+    }
+
+    /**
+     * @brief Drops the image, requests are not answered until the next bind()
+     */
+    constexpr void
+    unbind() noexcept
+    {
+        inputs_            = nullptr;
+        coils_             = nullptr;
+        input_registers_   = nullptr;
+        holding_registers_ = nullptr;
+        log_               = nullptr;
+    }
+
+    /**
+     * @brief Runs the function of the checked request, it serializes the reply
+     *
+     * The request must have passed the checks of handle() or processing(); running it again on another bound image
+     * does not parse the frame again.
+     */
+    template <class Self>
+    exception
+    execute(Self& self) noexcept
+    {
+        auto const result = call(self, head_.function_code);
+        if (result != exception::no_error) [[unlikely]] {
+            increment_counter(diagnostics_sub_function::return_server_exception_error_count);
+        }
+        framing_type::reply(input_msg_.storage().data(), output_msg_.storage().data());
+        return result;
+    }
+
+    /**
+     * @brief changed_coils() with changed_coil() called on `self`
+     */
+    template <class Self>
+    static void
+    changed_coils_as(Self& self, std::size_t start, std::size_t count, std::span<std::uint8_t const> before,
+                     std::span<std::uint8_t const> after) noexcept
+    {
+        changes::for_each_bit(before.data(), after.data(), count,
+                              [&](std::size_t i, bool value) { self.changed_coil(start + i, value); });
+    }
+
+    /**
+     * @brief changed_holdings() with changed_holding() called on `self`
+     */
+    template <class Self>
+    static void
+    changed_holdings_as(Self& self, std::size_t start, std::span<std::uint16_t const> before,
+                        std::span<std::uint16_t const> after) noexcept
+    {
+        changes::for_each_register(before.data(), after.data(), after.size(),
+                                   [&](std::size_t i) { self.changed_holding(start + i, after[i]); });
+    }
+
+    /**
+     * @brief received() with the hooks called on `self`
+     */
+    template <class Self>
+    exception
+    received_as(Self& self) noexcept
+    {
+        switch (state_) {
+        case slave_state::idle:
+            TRACE() << "idle -> check";
+            prepare_output(self.transmit_buffer());
+            state_ = slave_state::checking_request;
+            self.ready();
+            break;
+        default:
+            WARN() << "state undef: " << static_cast<std::uint8_t>(state_);
+            break;
+        }
+        return exception::no_error;
+    }
+
+    /**
+     * @brief One step of the state machine, the hooks are called on `self`
+     */
+    template <class Self>
+    exception
+    step(Self& self) noexcept
+    {
+        switch (state_) {
+        case slave_state::checking_request:
+            switch (check_request()) {
+            case exception::bad_slave:
+                TRACE() << "check -> idle";
+                state_ = slave_state::idle;
+                input_msg_.size(0);
+                TRACE() << "bad_slave";
+                return exception::bad_slave;
+            case exception::illegal_function:
+                TRACE() << "check -> err_reply";
+                state_ = slave_state::formatting_error_reply;
+                input_msg_.size(0);
+                WARN() << "illegal_function";
+                return error_ = exception::illegal_function;
+            default:
+                state_ = slave_state::processing_action;
+                break;
+            }
+            break;
+        case slave_state::processing_action:
+            if (exception::no_error == (error_ = execute(self))) [[likely]] {
+                TRACE() << "proc -> reply";
+                state_ = slave_state::formatting_reply;
+            } else [[unlikely]] {
+                TRACE() << "proc -> err_reply";
+                state_ = slave_state::formatting_error_reply;
+            }
+            if (broadcasted()) [[unlikely]] {
+                increment_counter(diagnostics_sub_function::return_server_no_response_count);
+                state_ = slave_state::idle;
+            }
+            input_msg_.size(0);
+            break;
+        case slave_state::formatting_reply:
+            if (!silent_) {
+                self.send(output_msg_.storage().data(), output_msg_.storage().data() + output_msg_.size());
+            }
+            output_msg_.size(0);
+            TRACE() << "reply -> idle";
+            state_ = slave_state::idle;
+            break;
+        case slave_state::formatting_error_reply:
+            format_error_reply();
+            if (!silent_) {
+                if (!self.send(output_msg_.storage().data(), output_msg_.storage().data() + output_msg_.size()))
+                    [[unlikely]] {
+                    TRACE() << "err_reply -> un_err";
+                    state_ = slave_state::unrecoverable_error;
+                    ERROR() << "unknown_exception";
+                    return error_ = exception::unknown_exception;
+                }
+            }
+            output_msg_.size(0);
+            input_msg_.size(0);
+            error_ = exception::no_error;
+            TRACE() << "err_reply -> idle";
+            state_ = slave_state::idle;
+            break;
+        case slave_state::idle:
+            return exception::nothing_to_do;
+        default:
+            WARN() << "state undef: " << static_cast<std::uint8_t>(state_);
+            break;
+        }
+        return exception::no_error;
+    }
+
+    /**
+     * @brief handle() with the hooks called on `self`
+     */
+    template <class Self>
+    std::span<std::uint8_t const>
+    handle_as(Self& self, std::span<std::uint8_t> frame) noexcept
+    {
+        if ((error_ = this->accept(self.idle(), frame.begin(), frame.end())) != exception::no_error) [[unlikely]] {
+            return {};
+        }
+        input_msg_.borrow(frame);
+        input_msg_.size(frame.size());
+        prepare_output(self.transmit_buffer());
+        error_ = check_request();
+        if (error_ == exception::no_error) [[likely]] {
+            error_ = execute(self);
+        }
+
+        if ((error_ != exception::no_error) && (error_ != exception::bad_slave)) [[unlikely]] {
+            format_error_reply();
+        }
+        input_msg_.release();
+        input_msg_.size(0);
+        if (error_ == exception::bad_slave) [[unlikely]] {
+            return {};
+        }
+        if (broadcasted()) [[unlikely]] {
+            increment_counter(diagnostics_sub_function::return_server_no_response_count);
+            return {};
+        }
+        if (silent_) [[unlikely]] {
+            return {};
+        }
+        return {output_msg_.storage().data(), output_msg_.size()};
+    }
+
 private:
-    std::uint8_t const     slave_id_;
+    /**
+     * @brief Decodes the header of the request and looks its function up
+     *
+     * @return exception::bad_slave If the request is for another slave
+     * @return exception::illegal_function If the function is not registered
+     */
+    exception
+    check_request() noexcept
+    {
+        head_ = func::data<header>::deserialize(input_msg_.storage().data() + framing_type::prefix_length);
+        if (inputs_ == nullptr) [[unlikely]] {
+            return exception::bad_slave;
+        }
+        if ((head_.slave_id != slave_id_) && (head_.slave_id != broadcast_address)
+            && !framing_type::any_unit(head_.slave_id)) [[likely]] {
+            return exception::bad_slave;
+        }
+        increment_counter(diagnostics_sub_function::return_bus_message_count);
+        if ((head_.function_code >= max_function_id) || !supported(head_.function_code)) [[unlikely]] {
+            increment_counter(diagnostics_sub_function::return_server_exception_error_count);
+            return exception::illegal_function;
+        }
+        return exception::no_error;
+    }
+
+    template <function... Codes>
+    constexpr void
+    register_builtin(function_set<Codes...>) noexcept
+    {
+        (register_function(Codes, builtin<Codes>()), ...);
+    }
+
+    /**
+     * @brief The run time handler of a code, nullptr if there is none
+     */
+    [[nodiscard]] function_type
+    extension(std::uint8_t code) const noexcept
+    {
+        for (auto const& item : defined_functions_table_) {
+            if ((item.code == code) && (item.handler != nullptr)) {
+                return item.handler;
+            }
+        }
+        return nullptr;
+    }
+
+    [[nodiscard]] bool
+    supported(std::uint8_t code) const noexcept
+    {
+        if constexpr (compiled) {
+            return ((code == static_cast<std::uint8_t>(Functions)) || ...) || (extension(code) != nullptr);
+        } else {
+            return defined_functions_table_[code] != nullptr;
+        }
+    }
+
+    template <function Code, class Self>
+    static exception
+    invoke(Self& self) noexcept
+    {
+        constexpr handler_type<Self> handler{builtin<Code, Self>()};
+        static_assert(handler != nullptr, "The function has no built-in handler, register it at run time");
+        return handler(self);
+    }
+
+    /**
+     * @brief Calls the built-in handler of `code` among `Codes` directly
+     *
+     * @return true If `code` is one of `Codes`
+     */
+    template <class Self, function... Codes>
+    static bool
+    call_builtin(Self& self, std::uint8_t code, exception& result, function_set<Codes...>) noexcept
+    {
+        return (((code == static_cast<std::uint8_t>(Codes)) && ((result = invoke<Codes>(self)), true)) || ...);
+    }
+
+    /**
+     * @brief Calls the handler of a supported code
+     *
+     * The compiled set is a chain of compares with direct calls. Calls on another `Self` than slave_base also go
+     * directly to the standard handlers, unless they were replaced at run time.
+     */
+    template <class Self>
+    exception
+    call(Self& self, std::uint8_t code) noexcept
+    {
+        exception result{exception::illegal_function};
+        if constexpr (compiled) {
+            if (call_builtin(self, code, result, function_set<Functions...>{})) [[likely]] {
+                return result;
+            }
+            return extension(code)(*this);
+        } else if constexpr (std::is_same_v<Self, slave_type>) {
+            return defined_functions_table_[code](*this);
+        } else {
+            if (standard(code) && call_builtin(self, code, result, standard_functions{})) [[likely]] {
+                return result;
+            }
+            return defined_functions_table_[code](*this);
+        }
+    }
+
+    /**
+     * @brief The table still holds the standard handler of `code`
+     */
+    [[nodiscard]] bool
+    standard(std::uint8_t code) const noexcept
+    {
+        return standard(code, standard_functions{});
+    }
+
+    template <function... Codes>
+    [[nodiscard]] bool
+    standard(std::uint8_t code, function_set<Codes...>) const noexcept
+    {
+        return (((code == static_cast<std::uint8_t>(Codes)) && (defined_functions_table_[code] == builtin<Codes>()))
+                || ...);
+    }
+
+    /**
+     * @brief Serializes the exception reply for the last error
+     */
+    void
+    format_error_reply() noexcept
+    {
+        output_msg_.template serialize<header, error_fields, uint8_t, framing_type>(
+            {{slave_id_, static_cast<uint8_t>(head_.function_code | error_reply_mask)}, {error_}, 0, nullptr});
+        framing_type::reply(input_msg_.storage().data(), output_msg_.storage().data());
+    }
+
+    /**
+     * @brief The request is a broadcast, it is never answered
+     */
+    [[nodiscard]] bool
+    broadcasted() const noexcept
+    {
+        return framing_type::broadcast && (head_.slave_id == broadcast_address);
+    }
+
+    std::uint8_t           slave_id_;
     bool                   silent_{};
     volatile slave_state   state_ = slave_state::idle;
-    inputs_type const&     inputs_;
-    coils_type&            coils_;
-    input_regs_type const& input_registers_;
-    holding_regs_type&     holding_registers_;
-    function_table_type    defined_functions_table_{};
-    log_type               log_{};
+    inputs_type const*     inputs_{};
+    coils_type*            coils_{};
+    input_regs_type const* input_registers_{};
+    holding_regs_type*     holding_registers_{};
+    coil_changes_type*     coil_tracker_{};
+    holding_changes_type*  holding_tracker_{};
+    log_type*              log_{};
+    table_type             defined_functions_table_{};
+    header                 head_{};    // The request being processed
 };
 
 }    // namespace xitren::modbus
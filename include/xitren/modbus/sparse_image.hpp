@@ -0,0 +1,234 @@
+/*!
+_ _
+__ _(_) |_ _ _ ___ _ _
+\ \ / |  _| '_/ -_) ' \
+/_\_\_|\__|_| \___|_||_|
+* @date 15.02.2024
+*/
+#pragma once
+
+#include <xitren/modbus/bits_engine.hpp>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace xitren::modbus {
+
+/**
+ * @brief The addresses [start, start + count) of a sparse image
+ */
+struct address_range {
+    std::uint32_t start;
+    std::uint32_t count;
+};
+
+/**
+ * @brief A table that only stores the addresses of its ranges
+ *
+ * A device exposing registers at 0-99, 30000-30099 and 40000-40999 keeps 1200 values instead of 41000:
+ * @code
+ * using holdings = sparse_registers<address_range{0, 100}, address_range{30000, 100}, address_range{40000, 1000}>;
+ * @endcode
+ * The ranges are sorted and stored back to back. An address is found in O(log ranges) in an Eytzinger (BFS) ordered
+ * copy of the range starts, without branches on the data. size() is the end of the last range; address_valid() asks
+ * contains(), so a request reaching into a hole is answered with illegal_data_address. Ranges may touch: a request
+ * across touching ranges is valid.
+ *
+ * @tparam T The value type, `bool` for bits or `std::uint16_t` for registers.
+ * @tparam Ranges The address ranges, ascending and disjoint.
+ */
+template <class T, address_range... Ranges>
+class sparse_image {
+    static_assert(sizeof...(Ranges) > 0, "A sparse image needs at least one range!");
+
+public:
+    using value_type = T;
+    using size_type  = std::size_t;
+
+    static constexpr size_type                                    ranges = sizeof...(Ranges);
+    static constexpr std::array<address_range, sizeof...(Ranges)> table{Ranges...};
+    static constexpr size_type                                    npos = ranges;
+
+    /**
+     * @brief The number of values stored
+     */
+    static constexpr size_type stored = (static_cast<size_type>(Ranges.count) + ...);
+
+    static_assert(
+        [] {
+            for (size_type i{}; i < ranges; i++) {
+                if ((table[i].count == 0) || (table[i].start + table[i].count > 65536)
+                    || ((i > 0) && (table[i - 1].start + table[i - 1].count > table[i].start))) {
+                    return false;
+                }
+            }
+            return true;
+        }(),
+        "The ranges must be non-empty, ascending, disjoint and within the 16-bit address space!");
+
+    [[nodiscard]] constexpr size_type
+    size() const noexcept
+    {
+        return table[ranges - 1].start + table[ranges - 1].count;
+    }
+
+    /**
+     * @brief Finds the range an address belongs to
+     *
+     * @return The index of the range or npos for an address in a hole
+     */
+    [[nodiscard]] static constexpr size_type
+    find(size_type address) noexcept
+    {
+        size_type node{1};
+        while (node <= ranges) {
+            node = 2 * node + static_cast<size_type>(search_starts[node] <= address);
+        }
+        // The last node taken to the left holds the first start above the address
+        node >>= std::countr_one(node) + 1;
+        auto const above = (node == 0) ? ranges : search_rank[node];
+        if (above == 0) {
+            return npos;
+        }
+        auto const& item = table[above - 1];
+        return (address < item.start + item.count) ? above - 1 : npos;
+    }
+
+    /**
+     * @brief Checks that all the addresses [start, start + count) are stored
+     */
+    [[nodiscard]] constexpr bool
+    contains(size_type start, size_type count) const noexcept
+    {
+        auto index = find(start);
+        if (index == npos) {
+            return false;
+        }
+        for (auto const end = start + count; end > table[index].start + table[index].count; index++) {
+            if ((index + 1 == ranges) || (table[index + 1].start != table[index].start + table[index].count)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief The value at a stored address, see contains()
+     */
+    constexpr value_type&
+    operator[](size_type address) noexcept
+    {
+        return data_[slot(address)];
+    }
+
+    constexpr value_type const&
+    operator[](size_type address) const noexcept
+    {
+        return data_[slot(address)];
+    }
+
+    /**
+     * @brief Copies the registers [start, start + count), the range must be stored
+     */
+    constexpr void
+    read(size_type start, size_type count, std::uint16_t* dst) const noexcept
+        requires std::same_as<T, std::uint16_t>
+    {
+        auto const* from = data_.data() + slot(start);
+        std::copy(from, from + count, dst);
+    }
+
+    /**
+     * @brief Stores the registers [start, start + values.size()), the range must be stored
+     */
+    constexpr void
+    update(size_type start, std::span<std::uint16_t const> values) noexcept
+        requires std::same_as<T, std::uint16_t>
+    {
+        std::copy(values.begin(), values.end(), data_.data() + slot(start));
+    }
+
+    /**
+     * @brief Packs the bits [start, start + count) into Modbus bit field bytes, the range must be stored
+     */
+    void
+    read(size_type start, size_type count, std::uint8_t* dst) const noexcept
+        requires std::same_as<T, bool>
+    {
+        bits_engine::pack(data_.data() + slot(start), count, dst);
+    }
+
+    /**
+     * @brief Unpacks Modbus bit field bytes into the bits [start, start + count), the range must be stored
+     */
+    void
+    write(size_type start, size_type count, std::uint8_t const* src) noexcept
+        requires std::same_as<T, bool>
+    {
+        bits_engine::unpack(src, count, data_.data() + slot(start));
+    }
+
+private:
+    /**
+     * @brief The position of each range in the storage
+     */
+    static constexpr std::array<size_type, ranges> offsets = [] {
+        std::array<size_type, ranges> result{};
+        for (size_type i{1}; i < ranges; i++) {
+            result[i] = result[i - 1] + table[i - 1].count;
+        }
+        return result;
+    }();
+
+    /**
+     * @brief The sorted index of each node of the Eytzinger tree, the root is node 1
+     */
+    static constexpr std::array<size_type, ranges + 1> search_rank = [] {
+        std::array<size_type, ranges + 1> result{};
+        size_type                         next{};
+        auto                              fill = [&](auto& self, size_type node) -> void {
+            if (node <= ranges) {
+                self(self, 2 * node);
+                result[node] = next++;
+                self(self, 2 * node + 1);
+            }
+        };
+        fill(fill, 1);
+        return result;
+    }();
+
+    static constexpr std::array<size_type, ranges + 1> search_starts = [] {
+        std::array<size_type, ranges + 1> result{};
+        for (size_type node{1}; node <= ranges; node++) {
+            result[node] = table[search_rank[node]].start;
+        }
+        return result;
+    }();
+
+    std::array<value_type, stored> data_{};
+
+    [[nodiscard]] static constexpr size_type
+    slot(size_type address) noexcept
+    {
+        auto const index = find(address);
+        return (index == npos) ? 0 : offsets[index] + (address - table[index].start);
+    }
+};
+
+/**
+ * @brief Sparse discrete inputs or coils, one `bool` per stored address
+ */
+template <address_range... Ranges>
+using sparse_bits = sparse_image<bool, Ranges...>;
+
+/**
+ * @brief Sparse input or holding registers
+ */
+template <address_range... Ranges>
+using sparse_registers = sparse_image<std::uint16_t, Ranges...>;
+
+}    // namespace xitren::modbus
@@ -0,0 +1,183 @@
+#include "modbus_capture.hpp"
+
+#include <xitren/modbus/bits_engine.hpp>
+#include <xitren/modbus/packed_bits.hpp>
+#include <xitren/modbus/slave.hpp>
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <random>
+#include <vector>
+
+using namespace xitren::modbus;
+
+namespace {
+
+constexpr std::size_t field = 300;
+
+std::vector<bool>
+random_bits(std::size_t size, unsigned seed)
+{
+    std::mt19937                generator{seed};
+    std::bernoulli_distribution coin{0.5};
+    std::vector<bool>           result(size);
+    for (std::size_t i{}; i < size; i++) {
+        result[i] = coin(generator);
+    }
+    return result;
+}
+
+void
+check_engine(bits_engine::pack_type pack, bits_engine::unpack_type unpack)
+{
+    auto const reference = random_bits(field + 16, 0xb175);
+    bool       bools[field + 16];
+    std::copy(reference.begin(), reference.end(), bools);
+    for (std::size_t offset{}; offset < 16; offset++) {
+        for (std::size_t count{}; count + offset <= field; count++) {
+            std::array<std::uint8_t, field / 8 + 2> expected{};
+            std::array<std::uint8_t, field / 8 + 2> packed{};
+            packed.fill(0xA5);
+            bits_engine::pack_bitwise(bools + offset, count, expected.data());
+            pack(bools + offset, count, packed.data());
+            ASSERT_TRUE(std::equal(expected.begin(), expected.begin() + (count + 7) / 8, packed.begin()))
+                << "offset " << offset << " count " << count;
+            ASSERT_EQ(packed[(count + 7) / 8], 0xA5) << "count " << count;
+
+            bool unpacked[field + 1];
+            unpacked[count] = true;
+            unpack(expected.data(), count, unpacked);
+            ASSERT_TRUE(std::equal(bools + offset, bools + offset + count, unpacked)) << "count " << count;
+            ASSERT_TRUE(unpacked[count]) << "count " << count;
+        }
+    }
+}
+
+constexpr std::uint16_t bits = 1000;
+
+std::vector<std::uint8_t>
+request(std::uint8_t function, std::uint16_t address, std::uint16_t count)
+{
+    return {function,
+            static_cast<std::uint8_t>(address >> 8U),
+            static_cast<std::uint8_t>(address),
+            static_cast<std::uint8_t>(count >> 8U),
+            static_cast<std::uint8_t>(count)};
+}
+
+}    // namespace
+
+TEST(modbus_bits_test, layout)
+{
+    std::array<bool, 10> const  bools{true, false, true, true, false, false, false, false, false, true};
+    std::array<std::uint8_t, 2> packed{};
+    bits_engine::pack_bitwise(bools.data(), bools.size(), packed.data());
+    EXPECT_EQ(packed[0], 0x0D);
+    EXPECT_EQ(packed[1], 0x02);
+    static_assert(bits_engine::gather(0x0000000001010001ULL) == 0x0D);
+    static_assert(bits_engine::spread(0x0D) == 0x0000000001010001ULL);
+}
+
+TEST(modbus_bits_test, scalar) { check_engine(&bits_engine::pack_scalar, &bits_engine::unpack_scalar); }
+
+TEST(modbus_bits_test, simd)
+{
+#if defined(XITREN_MODBUS_BITS_SSE2)
+    check_engine(&bits_engine::pack_sse2, &bits_engine::unpack_sse2);
+    if (!bits_engine::avx2_supported()) {
+        GTEST_SKIP() << "No AVX2";
+    }
+    check_engine(&bits_engine::pack_avx2, &bits_engine::unpack_avx2);
+#elif defined(XITREN_MODBUS_BITS_NEON)
+    check_engine(&bits_engine::pack_neon, &bits_engine::unpack_neon);
+#else
+    GTEST_SKIP() << "No SIMD engine";
+#endif
+}
+
+TEST(modbus_bits_test, selected) { check_engine(bits_engine::selected.pack, bits_engine::selected.unpack); }
+
+TEST(modbus_bits_test, packed_bits)
+{
+    auto const         reference = random_bits(field, 0x9ac4);
+    packed_bits<field> image{};
+    for (std::size_t i{}; i < field; i++) {
+        image[i] = reference[i];
+    }
+    for (std::size_t i{}; i < field; i++) {
+        ASSERT_EQ(image.test(i), reference[i]);
+    }
+    EXPECT_EQ(sizeof(packed_bits<65536>), 8192);
+
+    bool bools[field];
+    std::copy(reference.begin(), reference.end(), bools);
+    for (std::size_t start{}; start < 70; start++) {
+        for (std::size_t count{}; count + start <= field; count++) {
+            std::array<std::uint8_t, field / 8 + 1> expected{};
+            std::array<std::uint8_t, field / 8 + 1> packed{};
+            bits_engine::pack_bitwise(bools + start, count, expected.data());
+            image.read(start, count, packed.data());
+            ASSERT_EQ(expected, packed) << "start " << start << " count " << count;
+        }
+    }
+
+    // Writes touch their range only
+    auto const written = random_bits(field, 0x3172);
+    bool       update[field];
+    std::copy(written.begin(), written.end(), update);
+    for (std::size_t start{}; start < 70; start += 7) {
+        for (std::size_t count{1}; count + start <= field; count += 13) {
+            packed_bits<field>                      target{image};
+            std::array<std::uint8_t, field / 8 + 1> source{};
+            bits_engine::pack_bitwise(update, count, source.data());
+            target.write(start, count, source.data());
+            for (std::size_t i{}; i < field; i++) {
+                bool const expected = ((i >= start) && (i < start + count)) ? written[i - start] : reference[i];
+                ASSERT_EQ(target.test(i), expected) << "start " << start << " count " << count << " bit " << i;
+            }
+        }
+    }
+}
+
+TEST(modbus_bits_test, packed_slave)
+{
+    using plain_type  = tests::capture<slave<bits, bits, 1, 1>>;
+    using packed_type = tests::capture<packed_slave<bits, bits, 1, 1>>;
+    static_assert(modbus_slave_container<packed_bits<bits>>);
+    static_assert(packed_bit_container<packed_bits<bits>>);
+
+    auto const  image = random_bits(bits, 0x51a7);
+    plain_type  plain{tests::slave_id};
+    packed_type packed{tests::slave_id};
+    for (std::size_t i{}; i < bits; i++) {
+        plain.coils()[i] = plain.inputs()[i] = image[i];
+        packed.coils()[i] = packed.inputs()[i] = image[i];
+    }
+
+    std::mt19937 generator{0x5eed};
+    for (std::size_t n{}; n < 500; n++) {
+        auto const address = static_cast<std::uint16_t>(generator() % bits);
+        auto const count   = static_cast<std::uint16_t>(1 + generator() % (bits - address));
+        for (std::uint8_t const function : {0x01, 0x02}) {
+            auto const query    = request(function, address, count);
+            auto const expected = plain.request(query);
+            ASSERT_EQ(expected[1], function);
+            ASSERT_EQ(expected, packed.request(query)) << "address " << address << " count " << count;
+        }
+
+        auto const written = std::min<std::uint16_t>(count, modbus_base::max_write_bits);
+        auto       query   = request(0x0F, address, written);
+        query.push_back(static_cast<std::uint8_t>((written + 7) / 8));
+        for (std::size_t i{}; i < (written + 7U) / 8U; i++) {
+            query.push_back(static_cast<std::uint8_t>(generator()));
+        }
+        auto const expected = plain.request(query);
+        ASSERT_EQ(expected[1], 0x0F);
+        ASSERT_EQ(expected, packed.request(query));
+        for (std::size_t i{}; i < bits; i++) {
+            ASSERT_EQ(plain.coils()[i], static_cast<bool>(packed.coils()[i])) << "coil " << i;
+        }
+    }
+    EXPECT_LT(sizeof(packed_type), sizeof(plain_type));
+}
@@ -0,0 +1,239 @@
+#include <xitren/modbus/commands/read_registers.hpp>
+#include <xitren/modbus/master.hpp>
+#include <xitren/modbus/slave.hpp>
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace xitren::modbus;
+using namespace xitren::modbus::commands;
+using namespace std::chrono_literals;
+
+namespace {
+
+template <class Framing>
+class device_type : public slave<4, 4, 4, 4, 1, Framing> {
+public:
+    device_type() : slave<4, 4, 4, 4, 1, Framing>(0x22) {}
+
+    bool
+    send(typename device_type::msg_type::array_type::iterator,
+         typename device_type::msg_type::array_type::iterator) noexcept override
+    {
+        return true;
+    }
+};
+
+/**
+ * @brief How the simulated line completes a request
+ */
+enum class line { answer_inline, answer_thread, mute, expire_thread };
+
+/**
+ * @brief A master on a simulated line
+ *
+ * A thread started from send() blocks on the lock of the master until run() waits, so it completes the request at a
+ * known point without any sleep.
+ */
+class line_master : public blocking_master<> {
+public:
+    device_type<rtu>          device{};
+    line                      mode{line::answer_inline};
+    std::vector<std::uint8_t> request{};
+    std::thread               responder{};
+
+    ~line_master() override { join(); }
+
+    bool
+    send(msg_type::array_type::iterator begin, msg_type::array_type::iterator end) noexcept override
+    {
+        request.assign(begin, end);
+        join();
+        switch (mode) {
+        case line::answer_inline:
+            answer();
+            break;
+        case line::answer_thread:
+            responder = std::thread{[this] { answer(); }};
+            break;
+        case line::expire_thread:
+            responder = std::thread{[this] { timer_expired(); }};
+            break;
+        default:
+            break;
+        }
+        return true;
+    }
+
+    bool
+    timer_start(std::size_t) override
+    {
+        return true;
+    }
+
+    bool
+    timer_stop() override
+    {
+        return true;
+    }
+
+    void
+    join()
+    {
+        if (responder.joinable()) {
+            responder.join();
+        }
+    }
+
+private:
+    void
+    answer()
+    {
+        auto const                      reply = device.handle(request);
+        std::vector<std::uint8_t> const frame{reply.begin(), reply.end()};
+        receive(frame.begin(), frame.end());
+    }
+};
+
+/**
+ * @brief A pipelined TCP master, the requests sent are collected for the test to answer in any order
+ */
+class pipelined_master : public blocking_master<basic_master<mbap, 4>> {
+public:
+    bool
+    send(msg_type::array_type::iterator begin, msg_type::array_type::iterator end) noexcept override
+    {
+        std::lock_guard<std::mutex> const lock{line_mutex_};
+        requests_.emplace_back(begin, end);
+        sent_.notify_all();
+        return true;
+    }
+
+    bool
+    timer_start(std::size_t) override
+    {
+        return true;
+    }
+
+    bool
+    timer_stop() override
+    {
+        return true;
+    }
+
+    std::vector<std::vector<std::uint8_t>>
+    wait_requests(std::size_t count)
+    {
+        std::unique_lock<std::mutex> lock{line_mutex_};
+        sent_.wait(lock, [this, count] { return requests_.size() >= count; });
+        return std::exchange(requests_, {});
+    }
+
+private:
+    std::mutex                             line_mutex_{};
+    std::condition_variable                sent_{};
+    std::vector<std::vector<std::uint8_t>> requests_{};
+};
+
+}    // namespace
+
+TEST(modbus_blocking_test, reply)
+{
+    line_master master;
+    master.device.holding_registers()[1] = 0xBEEF;
+    master.mode                          = line::answer_thread;
+
+    std::uint16_t  value{};
+    read_registers request{0x22, 1, 1, [&](exception error, std::uint16_t* begin, std::uint16_t*) {
+                               if (error == exception::no_error) {
+                                   value = *begin;
+                               }
+                           }};
+    EXPECT_TRUE(exception::no_error == master.run(request, 10s));
+    EXPECT_EQ(value, 0xBEEF);
+    EXPECT_EQ(master.in_flight(), 0);
+
+    // Answered from inside send()
+    master.mode                          = line::answer_inline;
+    master.device.holding_registers()[1] = 0x1234;
+    EXPECT_TRUE(exception::no_error == master.run(request, 10s));
+    EXPECT_EQ(value, 0x1234);
+
+    // run() from a callback, on the thread holding the lock, is rejected
+    exception      nested{exception::no_error};
+    read_registers outer{0x22, 1, 1, [&](exception, std::uint16_t*, std::uint16_t*) {
+                             nested = master.run(request, 10s);
+                         }};
+    EXPECT_TRUE(exception::no_error == master.run(outer, 10s));
+    EXPECT_TRUE(exception::slave_or_server_busy == nested);
+}
+
+TEST(modbus_blocking_test, deadline)
+{
+    line_master master;
+    master.mode = line::mute;
+
+    exception      answer{exception::no_error};
+    read_registers request{0x22, 1, 1, [&](exception error, std::uint16_t*, std::uint16_t*) { answer = error; }};
+    EXPECT_TRUE(exception::gateway_target == master.run(request, line_master::clock::now()));
+    EXPECT_EQ(master.in_flight(), 0);
+    EXPECT_TRUE(exception::bad_slave == answer);
+
+    // The reply timeout of the master completes the request as well, through the virtual hook
+    master.mode = line::expire_thread;
+    EXPECT_TRUE(exception::gateway_target == master.run(request, 10min));
+    master.join();
+    EXPECT_EQ(master.in_flight(), 0);
+}
+
+TEST(modbus_blocking_test, window)
+{
+    pipelined_master  master;
+    device_type<mbap> device;
+    device.holding_registers()[0] = 0x1111;
+    device.holding_registers()[1] = 0x2222;
+
+    std::array<std::uint16_t, 2> values{};
+    std::array<exception, 2>     results{exception::unknown_exception, exception::unknown_exception};
+    std::vector<std::thread>     callers;
+    for (std::uint16_t i{}; i < 2; i++) {
+        callers.emplace_back([&, i] {
+            read_registers request{0x22, i, 1, [&, i](exception error, std::uint16_t* begin, std::uint16_t*) {
+                                       if (error == exception::no_error) {
+                                           values[i] = *begin;
+                                       }
+                                   }};
+            results[i] = master.run(request, 10min);
+        });
+    }
+    auto requests = master.wait_requests(2);
+
+    // A caller whose deadline passes expires its own request only
+    read_registers late{0x22, 2, 1, [](exception, std::uint16_t*, std::uint16_t*) {}};
+    EXPECT_TRUE(exception::gateway_target == master.run(late, pipelined_master::clock::now()));
+    master.wait_requests(1);
+    EXPECT_EQ(master.in_flight(), 2);
+
+    // Replies out of order wake their own callers, in place or byte-wise under the lock as well
+    auto const                reply = device.handle(requests[1]);
+    std::vector<std::uint8_t> frame{reply.begin(), reply.end()};
+    EXPECT_TRUE(exception::no_error == master.receive_in_place(frame));
+    auto const bytes = device.handle(requests[0]);
+    for (auto byte : std::vector<std::uint8_t>{bytes.begin(), bytes.end()}) {
+        EXPECT_TRUE(exception::no_error == master.receive_byte(byte));
+    }
+    EXPECT_TRUE(exception::no_error == master.receive_end());
+    for (auto& item : callers) {
+        item.join();
+    }
+    EXPECT_TRUE(exception::no_error == results[0]);
+    EXPECT_TRUE(exception::no_error == results[1]);
+    EXPECT_EQ(values[0], 0x1111);
+    EXPECT_EQ(values[1], 0x2222);
+    EXPECT_EQ(master.in_flight(), 0);
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <xitren/modbus/framing.hpp>
+#include <xitren/modbus/modbus.hpp>
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace xitren::modbus::tests {
+
+/**
+ * @brief The slave id the requests of the tests are addressed to
+ */
+constexpr std::uint8_t slave_id = 0x11;
+
+/**
+ * @brief Frames a request PDU for slave_id on a serial line, with its CRC
+ */
+inline std::vector<std::uint8_t>
+rtu_request(std::vector<std::uint8_t> pdu)
+{
+    pdu.insert(pdu.begin(), slave_id);
+    pdu.resize(pdu.size() + rtu::suffix_length);
+    rtu::seal(pdu.begin(), pdu.end() - rtu::suffix_length);
+    return pdu;
+}
+
+/**
+ * @brief A slave on a simulated serial line
+ *
+ * The arguments construct `Slave`. Requests are given as PDUs: request() and write() serve them at once through
+ * handle(), deliver() queues them through receive(). Replies sent through send() are kept in `replies` without their
+ * CRC, send() fails while `broken` is set.
+ *
+ * @tparam Slave The RTU slave to test.
+ */
+template <class Slave>
+class capture : public Slave {
+public:
+    std::vector<std::vector<std::uint8_t>> replies{};
+    bool                                   broken{};
+
+    template <class... Args>
+    explicit capture(Args&&... args) : Slave(std::forward<Args>(args)...)
+    {}
+
+    bool
+    send(typename Slave::msg_type::array_type::iterator begin,
+         typename Slave::msg_type::array_type::iterator end) noexcept override
+    {
+        replies.emplace_back(begin, end - rtu::suffix_length);
+        return !broken;
+    }
+
+    /**
+     * @brief Serves a request, returns the reply without its CRC
+     */
+    std::vector<std::uint8_t>
+    request(std::vector<std::uint8_t> pdu)
+    {
+        auto       frame = rtu_request(std::move(pdu));
+        auto const reply = this->handle(frame);
+        if (reply.empty()) {
+            return {};
+        }
+        return {reply.begin(), reply.end() - rtu::suffix_length};
+    }
+
+    /**
+     * @brief Serves a write request that must succeed
+     */
+    void
+    write(std::vector<std::uint8_t> pdu)
+    {
+        auto frame = rtu_request(std::move(pdu));
+        this->handle(frame);
+        ASSERT_TRUE(exception::no_error == this->error());
+    }
+
+    /**
+     * @brief Receives a request, see basic_modbus_base::receive()
+     */
+    exception
+    deliver(std::vector<std::uint8_t> pdu)
+    {
+        auto const frame = rtu_request(std::move(pdu));
+        return this->receive(frame.begin(), frame.end());
+    }
+};
+
+}    // namespace xitren::modbus::tests
@@ -0,0 +1,99 @@
+#include "modbus_capture.hpp"
+
+#include <xitren/modbus/concurrent_image.hpp>
+#include <xitren/modbus/slave.hpp>
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace xitren::modbus;
+
+namespace {
+
+using device_type = tests::capture<concurrent_slave<256, 256, 125, 125, 1>>;
+
+}    // namespace
+
+TEST(modbus_concurrent_test, image)
+{
+    concurrent_registers<10>           registers;
+    std::array<std::uint16_t, 3> const values{0x1234, 0x5678, 0x9ABC};
+    registers.update(4, values);
+    EXPECT_EQ(registers.version(), 2);
+    std::array<std::uint16_t, 5> out{};
+    registers.read(3, out.size(), out.data());
+    EXPECT_EQ(out, (std::array<std::uint16_t, 5>{0, 0x1234, 0x5678, 0x9ABC, 0}));
+    registers[9] = 7;
+    EXPECT_EQ(registers[9], 7);
+
+    concurrent_bits<150> bits;
+    std::array<bool, 70> ones{};
+    ones.fill(true);
+    bits.update(60, ones);
+    bits[3] = true;
+    EXPECT_TRUE(bits[3]);
+    EXPECT_FALSE(bits[59]);
+    EXPECT_TRUE(bits[129]);
+    EXPECT_FALSE(bits[130]);
+    std::array<std::uint8_t, 2> field{};
+    bits.read(56, 10, field.data());
+    EXPECT_EQ(field, (std::array<std::uint8_t, 2>{0xF0, 0x03}));
+    std::array<std::uint8_t, 1> const clear{0x05};
+    bits.write(126, 5, clear.data());
+    bits.read(124, 8, field.data());
+    EXPECT_EQ(field[0], 0x17);
+}
+
+TEST(modbus_concurrent_test, protocol)
+{
+    device_type                        device{tests::slave_id};
+    std::array<std::uint16_t, 2> const sample{0x0102, 0x0304};
+    device.input_registers().update(1, sample);
+    auto const reply = device.request({0x04, 0x00, 0x00, 0x00, 0x03});
+    EXPECT_EQ(reply, (std::vector<std::uint8_t>{0x11, 0x04, 0x06, 0x00, 0x00, 0x01, 0x02, 0x03, 0x04}));
+    device.request({0x10, 0x00, 0x05, 0x00, 0x02, 0x04, 0x00, 0x07, 0x00, 0x09});
+    EXPECT_EQ(device.holding_registers()[5], 7);
+    EXPECT_EQ(device.holding_registers()[6], 9);
+    device.request({0x0F, 0x00, 0x08, 0x00, 0x0A, 0x02, 0xF3, 0x03});
+    auto const coils = device.request({0x01, 0x00, 0x08, 0x00, 0x0A});
+    ASSERT_GE(coils.size(), 5U);
+    EXPECT_EQ(coils[3], 0xF3);
+    EXPECT_EQ(coils[4], 0x03);
+}
+
+TEST(modbus_concurrent_test, consistent_snapshot)
+{
+    device_type       device{tests::slave_id};
+    std::atomic<bool> stop{};
+    std::thread       writer([&]() {
+        std::array<std::uint16_t, 125> values{};
+        std::array<bool, 256>          bits{};
+        for (std::uint16_t n{}; !stop.load(std::memory_order_relaxed); n++) {
+            values.fill(n);
+            bits.fill((n & 1U) != 0);
+            device.input_registers().update(0, values);
+            device.inputs().update(0, bits);
+        }
+    });
+
+    for (std::size_t round{}; round < 20000; round++) {
+        auto const registers = device.request({0x04, 0x00, 0x00, 0x00, 0x7D});
+        ASSERT_EQ(registers.size(), 3U + 250U);
+        for (std::size_t i{5}; i < 253; i += 2) {
+            ASSERT_EQ(registers[i], registers[3]) << "round " << round << " byte " << i;
+            ASSERT_EQ(registers[i + 1], registers[4]) << "round " << round << " byte " << i;
+        }
+        auto const inputs = device.request({0x02, 0x00, 0x00, 0x01, 0x00});
+        ASSERT_EQ(inputs.size(), 3U + 32U);
+        for (std::size_t i{3}; i < 35; i++) {
+            ASSERT_TRUE((inputs[i] == 0x00) || (inputs[i] == 0xFF)) << "round " << round;
+            ASSERT_EQ(inputs[i], inputs[3]) << "round " << round << " byte " << i;
+        }
+    }
+    stop = true;
+    writer.join();
+}
@@ -0,0 +1,206 @@
+#include <xitren/modbus/commands/read_identification.hpp>
+#include <xitren/modbus/commands/read_registers.hpp>
+#include <xitren/modbus/commands/write_register.hpp>
+#include <xitren/modbus/coroutine.hpp>
+#include <xitren/modbus/master.hpp>
+#include <xitren/modbus/slave.hpp>
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <span>
+#include <vector>
+
+using namespace xitren::modbus;
+using namespace xitren::modbus::commands;
+
+namespace {
+
+class device_type : public slave<4, 4, 4, 8, 1> {
+public:
+    device_type() : slave(0x22) {}
+
+    bool
+    send(msg_type::array_type::iterator, msg_type::array_type::iterator) noexcept override
+    {
+        return true;
+    }
+};
+
+/**
+ * @brief A master on a simulated line, the request sent is answered by answer()
+ */
+class line_master : public coro::awaitable_master<> {
+public:
+    std::vector<std::uint8_t> request{};
+
+    bool
+    send(msg_type::array_type::iterator begin, msg_type::array_type::iterator end) noexcept override
+    {
+        request.assign(begin, end);
+        return true;
+    }
+
+    bool
+    timer_start(std::size_t) override
+    {
+        return true;
+    }
+
+    bool
+    timer_stop() override
+    {
+        return true;
+    }
+};
+
+using executor_type = coro::executor<>;
+using client_type   = coro::client<line_master, executor_type>;
+
+/**
+ * @brief Delivers the replies of the device until the master has nothing in flight
+ */
+template <class Client>
+std::size_t
+answer(Client& bus, device_type& device)
+{
+    std::size_t replies{};
+    while (bus.master().in_flight() > 0) {
+        auto const                      reply = device.handle(bus.master().request);
+        std::vector<std::uint8_t> const frame{reply.begin(), reply.end()};
+        bus.receive(frame.begin(), frame.end());
+        replies++;
+    }
+    return replies;
+}
+
+coro::task<std::uint16_t>
+sum(client_type& bus, std::uint16_t address)
+{
+    std::array<std::uint16_t, 2> values{};
+    auto const read = co_await bus.read<read_registers>(std::span{values}, 0x22, address, 2);
+    if (!read || (read.size != values.size())) {
+        co_return 0;
+    }
+    co_return static_cast<std::uint16_t>(values[0] + values[1]);
+}
+
+coro::task<>
+cycle(client_type& bus, exception& result)
+{
+    auto const total = co_await sum(bus, 0);
+    result           = (co_await bus.command<write_register>(0x22, 4, total)).error;
+}
+
+}    // namespace
+
+TEST(modbus_coroutine_test, read_compute_write)
+{
+    executor_type loop;
+    line_master   master;
+    device_type   device;
+    client_type   bus{master, loop};
+    device.holding_registers()[0] = 0x1200;
+    device.holding_registers()[1] = 0x0034;
+
+    auto const heap = coro::frame_arena::heap_frames();
+    for (std::uint16_t round{}; round < 8; round++) {
+        exception result{exception::unknown_exception};
+        EXPECT_TRUE(loop.spawn(cycle(bus, result)));
+        EXPECT_EQ(loop.run(), 1);
+        EXPECT_EQ(loop.frames().used(), 2);
+        EXPECT_EQ(answer(bus, device), 2);
+        EXPECT_TRUE(exception::no_error == result);
+        EXPECT_EQ(device.holding_registers()[4], 0x1234);
+        EXPECT_EQ(loop.frames().used(), 0);
+    }
+    // Every frame came from the pool
+    EXPECT_EQ(coro::frame_arena::heap_frames(), heap);
+
+    // A command rejected on construction does not suspend
+    exception rejected{exception::no_error};
+    EXPECT_TRUE(loop.spawn([](client_type& client, exception& result) -> coro::task<> {
+        std::array<std::uint16_t, 2> value{};
+        result = (co_await client.read<read_registers>(std::span{value}, 0x22, 0xFFFF, 2)).error;
+    }(bus, rejected)));
+    loop.run();
+    EXPECT_TRUE(exception::illegal_data_address == rejected);
+    EXPECT_EQ(master.in_flight(), 0);
+}
+
+TEST(modbus_coroutine_test, timeout)
+{
+    executor_type loop;
+    line_master   master;
+    client_type   bus{master, loop};
+
+    coro::reply answer{};
+    bool        done{};
+    EXPECT_TRUE(loop.spawn([](client_type& client, coro::reply& out, bool& flag) -> coro::task<> {
+        std::array<char, 32> text{};
+        out  = co_await client.read<read_identification>(std::span{text}, 0x22, 0x01);
+        flag = true;
+    }(bus, answer, done)));
+    loop.run();
+    EXPECT_FALSE(done);
+    EXPECT_EQ(master.in_flight(), 1);
+
+    // The reply timer of the master resumes the coroutine with the error
+    bus.timer_expired();
+    EXPECT_TRUE(done);
+    EXPECT_TRUE(exception::gateway_target == answer.error);
+    EXPECT_EQ(answer.size, 0);
+    EXPECT_EQ(loop.frames().used(), 0);
+}
+
+TEST(modbus_coroutine_test, exception_reply)
+{
+    executor_type loop;
+    line_master   master;
+    device_type   device;
+    client_type   bus{master, loop};
+
+    // The command skips its callback on an exception reply, the coroutine is resumed all the same
+    coro::reply result{};
+    EXPECT_TRUE(loop.spawn([](client_type& client, coro::reply& out) -> coro::task<> {
+        std::array<std::uint16_t, 2> values{};
+        out = co_await client.read<read_registers>(std::span{values}, 0x22, 0x40, 2);
+    }(bus, result)));
+    loop.run();
+    EXPECT_EQ(answer(bus, device), 1);
+    EXPECT_TRUE(exception::illegal_function == result.error);
+    EXPECT_EQ(result.size, 0);
+    EXPECT_EQ(loop.reserved(), 0);
+    EXPECT_EQ(loop.frames().used(), 0);
+}
+
+TEST(modbus_coroutine_test, full_queue)
+{
+    coro::executor<1> loop;
+    line_master       master;
+    device_type       device;
+    coro::client      bus{master, loop};
+    using bus_type = decltype(bus);
+
+    // A coroutine only suspends with a place of the queue kept for its resumption
+    coro::reply first{};
+    coro::reply second{exception::unknown_exception};
+    EXPECT_TRUE(loop.spawn([](bus_type& client, coro::reply& out, coro::reply& refused) -> coro::task<> {
+        EXPECT_TRUE(client.executor().spawn([](bus_type& nested, coro::reply& result) -> coro::task<> {
+            result = co_await nested.command<write_register>(0x22, 1, 1);
+        }(client, refused)));
+        out = co_await client.command<write_register>(0x22, 0, 7);
+    }(bus, first, second)));
+    loop.run();
+    EXPECT_TRUE(exception::slave_or_server_busy == first.error);
+    EXPECT_EQ(master.in_flight(), 1);
+    EXPECT_EQ(loop.reserved(), 1);
+
+    // The queue place reserved is not given away
+    EXPECT_FALSE(loop.spawn([](bus_type&) -> coro::task<> { co_return; }(bus)));
+    EXPECT_EQ(answer(bus, device), 1);
+    EXPECT_TRUE(exception::no_error == second.error);
+    EXPECT_EQ(device.holding_registers()[1], 1);
+    EXPECT_EQ(loop.reserved(), 0);
+    EXPECT_EQ(loop.frames().used(), 0);
+}
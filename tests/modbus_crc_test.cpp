@@ -0,0 +1,94 @@
+#include <xitren/modbus/crc16ansi.hpp>
+#include <xitren/modbus/crc16ansi_engine.hpp>
+
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+
+using namespace xitren::modbus;
+
+namespace {
+
+std::vector<std::uint8_t>
+random_bytes(std::size_t size, std::uint32_t seed)
+{
+    std::mt19937                    generator{seed};
+    std::uniform_int_distribution<> byte{0, 255};
+    std::vector<std::uint8_t>       result(size);
+    for (auto& item : result) {
+        item = static_cast<std::uint8_t>(byte(generator));
+    }
+    return result;
+}
+
+void
+check_engine(crc16_engine::engine_type engine)
+{
+    // Every length around the folding block sizes, at every alignment
+    auto const data = random_bytes(300, 0x5eed);
+    for (std::size_t offset{}; offset < 16; offset++) {
+        for (std::size_t size{}; size + offset <= data.size(); size++) {
+            ASSERT_EQ(engine(data.data() + offset, size), crc16_engine::bitwise(data.data() + offset, size))
+                << "offset " << offset << " size " << size;
+        }
+    }
+}
+
+}    // namespace
+
+TEST(modbus_crc_test, known_vector)
+{
+    std::array<std::uint8_t, 9> const data{'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+    EXPECT_EQ(crc16_engine::bitwise(data.data(), data.size()), 0x4B37);
+    EXPECT_EQ(crc16ansi::calculate(data.begin(), data.end()).get(), 0x4B37);
+    constexpr std::array<std::uint8_t, 3> constant{0x01, 0x02, 0x03};
+    static_assert(crc16ansi::calculate(constant).get()
+                  == crc16_engine::update_bitwise(crc16_engine::initial, constant.data(), constant.size()));
+}
+
+TEST(modbus_crc_test, slice4) { check_engine(&crc16_engine::slice4); }
+
+TEST(modbus_crc_test, slice8) { check_engine(&crc16_engine::slice8); }
+
+TEST(modbus_crc_test, folding)
+{
+#if defined(XITREN_MODBUS_CRC_CLMUL)
+    if (!crc16_engine::clmul_supported()) {
+        GTEST_SKIP() << "No PCLMULQDQ";
+    }
+    check_engine(&crc16_engine::clmul);
+#elif defined(XITREN_MODBUS_CRC_PMULL)
+    check_engine(&crc16_engine::pmull);
+#else
+    GTEST_SKIP() << "No carry-less multiplication";
+#endif
+}
+
+TEST(modbus_crc_test, selected) { check_engine(crc16_engine::selected); }
+
+TEST(modbus_crc_test, accumulator)
+{
+    auto const             data = random_bytes(300, 0xacc);
+    crc16ansi::accumulator acc{};
+    for (std::size_t size{}; size < data.size(); size++) {
+        ASSERT_EQ(acc.value().get(), crc16_engine::bitwise(data.data(), size)) << "size " << size;
+        acc.update(data[size]);
+    }
+    acc.reset();
+    acc.update(data.data(), 100);
+    acc.update(data.data() + 100, 200);
+    EXPECT_EQ(acc.value().get(), crc16_engine::bitwise(data.data(), data.size()));
+
+    // A frame followed by its own checksum leaves a zero residue
+    std::array<std::uint8_t, 8> frame{0x22, 0x01, 0x00, 0x00, 0x00, 0x08, 0x3A, 0x9F};
+    acc.reset();
+    for (auto const byte : frame) {
+        EXPECT_FALSE(acc.complete());
+        acc.update(byte);
+    }
+    EXPECT_TRUE(acc.complete());
+    frame[6] ^= 0x01;
+    acc.reset();
+    acc.update(frame.data(), frame.size());
+    EXPECT_FALSE(acc.complete());
+}
@@ -0,0 +1,110 @@
+#include "modbus_capture.hpp"
+
+#include <xitren/modbus/dirty_bits.hpp>
+#include <xitren/modbus/slave.hpp>
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <vector>
+
+using namespace xitren::modbus;
+
+namespace {
+
+constexpr std::size_t field = 300;
+
+using range_list = std::vector<std::pair<std::size_t, std::size_t>>;
+
+template <class Tracker>
+range_list
+ranges(Tracker const& tracker)
+{
+    range_list result;
+    for (auto const& item : tracker) {
+        result.emplace_back(item.start, item.count);
+    }
+    return result;
+}
+
+range_list
+reference_ranges(std::vector<bool> const& dirty)
+{
+    range_list result;
+    for (std::size_t i{}; i < dirty.size();) {
+        if (!dirty[i]) {
+            i++;
+            continue;
+        }
+        auto const start = i;
+        for (; (i < dirty.size()) && dirty[i]; i++) {}
+        result.emplace_back(start, i - start);
+    }
+    return result;
+}
+
+}    // namespace
+
+TEST(modbus_dirty_test, ranges)
+{
+    std::mt19937 generator{0xd1e7};
+    for (std::size_t round{}; round < 200; round++) {
+        dirty_bits<field> tracker;
+        std::vector<bool> reference(field);
+        for (std::size_t n{}; n < round % 9; n++) {
+            auto const start = generator() % field;
+            auto const mask  = (std::uint64_t{generator()} << 32U) | generator();
+            auto const bits  = std::min<std::size_t>(64, field - start);
+            auto const used  = (bits < 64) ? (mask & ((std::uint64_t{1} << bits) - 1)) : mask;
+            tracker.mark(start, used);
+            for (std::size_t i{}; i < bits; i++) {
+                if ((used >> i) & 1U) {
+                    reference[start + i] = true;
+                }
+            }
+        }
+        tracker.mark_range(round % field, std::min<std::size_t>(round % 70, field - round % field));
+        for (std::size_t i{}; i < std::min<std::size_t>(round % 70, field - round % field); i++) {
+            reference[round % field + i] = true;
+        }
+        ASSERT_EQ(ranges(tracker), reference_ranges(reference)) << "round " << round;
+        for (std::size_t i{}; i < field; i++) {
+            ASSERT_EQ(tracker.test(i), reference[i]) << "round " << round << " bit " << i;
+        }
+        tracker.clear();
+        EXPECT_FALSE(tracker.dirty());
+        EXPECT_TRUE(tracker.begin() == tracker.end());
+    }
+}
+
+TEST(modbus_dirty_test, tracked_slave)
+{
+    tests::capture<tracked_slave<slave<100, 100, 10, 100, 1>>>        plain{tests::slave_id};
+    tests::capture<tracked_slave<packed_slave<100, 100, 10, 100, 1>>> packed{tests::slave_id};
+    EXPECT_EQ(plain.holding_changes().size(), 100);
+
+    plain.write({0x10, 0x00, 0x02, 0x00, 0x03, 0x06, 0x00, 0x01, 0x00, 0x00, 0x00, 0x03});
+    plain.write({0x06, 0x00, 0x40, 0x00, 0x09});
+    EXPECT_EQ(ranges(plain.holding_changes()), (range_list{{2, 1}, {4, 1}, {64, 1}}));
+    EXPECT_EQ(plain.holding_changes().generation(), 2);
+
+    // Unchanged values are not marked and do not advance the generation
+    plain.holding_changes().clear();
+    plain.write({0x10, 0x00, 0x02, 0x00, 0x03, 0x06, 0x00, 0x01, 0x00, 0x00, 0x00, 0x03});
+    EXPECT_FALSE(plain.holding_changes().dirty());
+    EXPECT_EQ(plain.holding_changes().generation(), 2);
+    plain.write({0x10, 0x00, 0x3F, 0x00, 0x02, 0x04, 0x00, 0x07, 0x00, 0x09});
+    EXPECT_EQ(ranges(plain.holding_changes()), (range_list{{63, 1}}));
+    EXPECT_EQ(plain.holding_changes().generation(), 3);
+
+    for (std::vector<std::uint8_t> const& request : std::vector<std::vector<std::uint8_t>>{
+             {0x0F, 0x00, 0x3C, 0x00, 0x0A, 0x02, 0xF3, 0x03},    // coils 60, 61, 64 to 69
+             {0x05, 0x00, 0x3D, 0x00, 0x00},                      // coil 61 off
+             {0x05, 0x00, 0x05, 0xFF, 0x00}}) {                   // coil 5
+        plain.write(request);
+        packed.write(request);
+    }
+    EXPECT_EQ(ranges(plain.coil_changes()), (range_list{{5, 1}, {60, 2}, {64, 6}}));
+    EXPECT_EQ(ranges(packed.coil_changes()), ranges(plain.coil_changes()));
+    EXPECT_EQ(packed.coil_changes().generation(), 3);
+}
@@ -63,9 +63,9 @@ public:
     }
 };
 
-template <typename T, size_t Size, size_t Size1>
+template <typename Expected, typename Actual>
 bool
-arrays_match(std::array<T, Size> const& expected, std::array<T, Size1> const& actual, std::size_t size)
+arrays_match(Expected const& expected, Actual const& actual, std::size_t size)
 {
     std::cout << "===========Expected " << std::endl;
     std::cout << std::noshowbase << std::internal << std::setfill('0');
@@ -131,9 +131,9 @@ public:
         return end_last_;
     }
 
-    template <std::size_t Size>
+    template <class Buffer>
     void
-    data(std::array<std::uint8_t, Size> const& nd, std::size_t size)
+    data(Buffer const& nd, std::size_t size)
     {
         receive(nd.begin(), nd.begin() + size);
         processing();
@@ -0,0 +1,125 @@
+#include <xitren/modbus/slave.hpp>
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <vector>
+
+using namespace xitren::modbus;
+
+namespace {
+
+using bits_type      = std::array<bool, 64>;
+using registers_type = std::array<std::uint16_t, 16>;
+
+class gateway : public multi_slave<bits_type, bits_type, registers_type, registers_type, 1, rtu> {
+public:
+    std::vector<std::uint8_t> sent{};
+    std::vector<std::uint8_t> writers{};
+
+    bool
+    send(msg_type::array_type::iterator begin, msg_type::array_type::iterator end) noexcept override
+    {
+        sent.assign(begin, end - rtu::suffix_length);
+        return true;
+    }
+
+    void
+    changed_holding(std::size_t, std::uint16_t) noexcept override
+    {
+        writers.push_back(id());
+    }
+
+    static std::vector<std::uint8_t>
+    frame(std::uint8_t slave_id, std::vector<std::uint8_t> pdu)
+    {
+        pdu.insert(pdu.begin(), slave_id);
+        pdu.resize(pdu.size() + rtu::suffix_length);
+        rtu::seal(pdu.begin(), pdu.end() - rtu::suffix_length);
+        return pdu;
+    }
+
+    std::vector<std::uint8_t>
+    request(std::uint8_t slave_id, std::vector<std::uint8_t> pdu)
+    {
+        auto       adu   = frame(slave_id, std::move(pdu));
+        auto const reply = handle(adu);
+        if (reply.empty()) {
+            return {};
+        }
+        return {reply.begin(), reply.end() - rtu::suffix_length};
+    }
+};
+
+}    // namespace
+
+TEST(modbus_multi_test, routing)
+{
+    gateway             device;
+    gateway::image_type first{};
+    gateway::image_type second{};
+    EXPECT_TRUE(device.attach(3, first));
+    EXPECT_TRUE(device.attach(7, second));
+    EXPECT_FALSE(device.attach(7, first));
+    EXPECT_FALSE(device.attach(0, first));
+    EXPECT_EQ(device.units(), 2);
+    EXPECT_EQ(device.unit(7), &second);
+
+    first.input_registers[2]  = 0x0102;
+    second.input_registers[2] = 0x0304;
+    EXPECT_EQ(device.request(3, {0x04, 0x00, 0x02, 0x00, 0x01}),
+              (std::vector<std::uint8_t>{0x03, 0x04, 0x02, 0x01, 0x02}));
+    EXPECT_EQ(device.request(7, {0x04, 0x00, 0x02, 0x00, 0x01}),
+              (std::vector<std::uint8_t>{0x07, 0x04, 0x02, 0x03, 0x04}));
+    EXPECT_EQ(device.request(7, {0x04, 0x00, 0x10, 0x00, 0x01}), (std::vector<std::uint8_t>{0x07, 0x84, 0x02}));
+
+    // Nobody answers for a unit without an image
+    EXPECT_TRUE(device.request(5, {0x04, 0x00, 0x02, 0x00, 0x01}).empty());
+    EXPECT_TRUE(exception::bad_slave == device.error());
+
+    device.request(7, {0x06, 0x00, 0x01, 0x12, 0x34});
+    EXPECT_EQ(second.holding_registers[1], 0x1234);
+    EXPECT_EQ(first.holding_registers[1], 0);
+    EXPECT_EQ(device.writers, (std::vector<std::uint8_t>{7}));
+
+    device.detach(7);
+    EXPECT_EQ(device.units(), 1);
+    EXPECT_TRUE(device.request(7, {0x04, 0x00, 0x02, 0x00, 0x01}).empty());
+    EXPECT_EQ(device.request(3, {0x04, 0x00, 0x02, 0x00, 0x01}).size(), 5);
+}
+
+TEST(modbus_multi_test, broadcast)
+{
+    gateway                            device;
+    std::array<gateway::image_type, 3> units{};
+    for (std::uint8_t i{}; i < units.size(); i++) {
+        ASSERT_TRUE(device.attach(static_cast<std::uint8_t>(10 + i), units[i]));
+    }
+
+    EXPECT_TRUE(device.request(0, {0x10, 0x00, 0x04, 0x00, 0x02, 0x04, 0x00, 0x07, 0x00, 0x09}).empty());
+    EXPECT_TRUE(exception::no_error == device.error());
+    for (auto const& unit : units) {
+        EXPECT_EQ(unit.holding_registers[4], 7);
+        EXPECT_EQ(unit.holding_registers[5], 9);
+    }
+    EXPECT_EQ(device.writers, (std::vector<std::uint8_t>{10, 10, 11, 11, 12, 12}));
+
+    // The same through the cooperative state machine
+    device.writers.clear();
+    auto const adu = gateway::frame(0, {0x05, 0x00, 0x21, 0xFF, 0x00});
+    device.receive(adu.begin(), adu.end());
+    while (!device.idle()) {
+        device.processing();
+    }
+    for (auto const& unit : units) {
+        EXPECT_TRUE(unit.coils[0x21]);
+    }
+    EXPECT_TRUE(device.sent.empty());
+
+    auto const read = gateway::frame(11, {0x01, 0x00, 0x21, 0x00, 0x01});
+    device.receive(read.begin(), read.end());
+    while (!device.idle()) {
+        device.processing();
+    }
+    EXPECT_EQ(device.sent, (std::vector<std::uint8_t>{0x0B, 0x01, 0x01, 0x01}));
+}
@@ -0,0 +1,180 @@
+#include "modbus_capture.hpp"
+
+#include <xitren/modbus/persistence.hpp>
+#include <xitren/modbus/slave.hpp>
+
+#include <gtest/gtest.h>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <array>
+#include <csignal>
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+using namespace xitren::modbus;
+
+namespace {
+
+class modbus_persistence_test : public ::testing::Test {
+protected:
+    std::string const snapshot{"/tmp/xitren-modbus-snapshot-" + std::to_string(::getpid())};
+    std::string const journal{"/tmp/xitren-modbus-journal-" + std::to_string(::getpid())};
+
+    void
+    SetUp() override
+    {
+        TearDown();
+    }
+
+    void
+    TearDown() override
+    {
+        std::remove(snapshot.c_str());
+        std::remove(journal.c_str());
+    }
+};
+
+}    // namespace
+
+TEST_F(modbus_persistence_test, restore)
+{
+    using device_type = tests::capture<persistent_slave<slave<16, 100, 4, 100, 1>>>;
+    {
+        device_type device{snapshot.c_str(), journal.c_str(), tests::slave_id};
+        ASSERT_TRUE(device.store().valid());
+        ASSERT_TRUE(device.restore());
+        device.write({0x10, 0x00, 0x02, 0x00, 0x02, 0x04, 0x12, 0x34, 0x56, 0x78});
+        device.write({0x0F, 0x00, 0x3C, 0x00, 0x0A, 0x02, 0xF3, 0x03});
+        EXPECT_TRUE(device.persist());
+        device.write({0x06, 0x00, 0x63, 0xBE, 0xEF});
+    }
+    // A torn record at the end of the journal is dropped
+    std::ofstream{journal, std::ios::app | std::ios::binary} << "\x02\x05";
+
+    device_type device{snapshot.c_str(), journal.c_str(), tests::slave_id};
+    ASSERT_TRUE(device.restore());
+    EXPECT_EQ(device.holding_registers()[2], 0x1234);
+    EXPECT_EQ(device.holding_registers()[3], 0x5678);
+    EXPECT_EQ(device.holding_registers()[99], 0xBEEF);
+    EXPECT_TRUE(device.coils()[60]);
+    EXPECT_FALSE(device.coils()[62]);
+    EXPECT_TRUE(device.coils()[69]);
+    EXPECT_FALSE(device.coils()[70]);
+    EXPECT_EQ(device.store().epoch(), 0);
+}
+
+TEST_F(modbus_persistence_test, unwritten_header)
+{
+    using store_type = persistence::store<16, 16>;
+    // A crash after the snapshot was sized leaves it zero
+    std::ofstream{snapshot, std::ios::binary} << std::string(store_type::snapshot_size, '\0');
+
+    std::array<bool, 16>          coils{};
+    std::array<std::uint16_t, 16> holdings{};
+    {
+        store_type store{snapshot.c_str(), journal.c_str()};
+        ASSERT_TRUE(store.valid());
+        EXPECT_EQ(store.epoch(), 0);
+        ASSERT_TRUE(store.restore(coils, holdings));
+        holdings[5] = 0xBEEF;
+        EXPECT_TRUE(store.append_holdings(holdings, 5, 1));
+    }
+    store_type store{snapshot.c_str(), journal.c_str()};
+    ASSERT_TRUE(store.valid());
+    holdings[5] = 0;
+    ASSERT_TRUE(store.restore(coils, holdings));
+    EXPECT_EQ(holdings[5], 0xBEEF);
+}
+
+TEST_F(modbus_persistence_test, compaction)
+{
+    using device_type = tests::capture<persistent_slave<packed_slave<16, 100, 4, 100, 1>>>;
+    {
+        device_type device{snapshot.c_str(), journal.c_str(), tests::slave_id};
+        ASSERT_TRUE(device.restore());
+        device.compaction_threshold(64);
+        device.write({0x10, 0x00, 0x00, 0x00, 0x03, 0x06, 0x00, 0x01, 0x00, 0x02, 0x00, 0x03});
+        device.write({0x05, 0x00, 0x07, 0xFF, 0x00});
+        EXPECT_TRUE(device.persist());
+        EXPECT_EQ(device.store().epoch(), 0);
+        device.write({0x10, 0x00, 0x10, 0x00, 0x10, 0x20, 0x00, 0x01, 0x00, 0x02, 0x00, 0x03, 0x00, 0x04, 0x00,
+                      0x05, 0x00, 0x06, 0x00, 0x07, 0x00, 0x08, 0x00, 0x09, 0x00, 0x0A, 0x00, 0x0B, 0x00, 0x0C,
+                      0x00, 0x0D, 0x00, 0x0E, 0x00, 0x0F, 0x00, 0x10});
+        EXPECT_TRUE(device.persist());
+        EXPECT_EQ(device.store().epoch(), 1);
+        EXPECT_EQ(device.store().journal_size(), sizeof(persistence::journal_header));
+        device.write({0x06, 0x00, 0x00, 0x00, 0x2A});
+    }
+    device_type device{snapshot.c_str(), journal.c_str(), tests::slave_id};
+    ASSERT_TRUE(device.restore());
+    EXPECT_EQ(device.holding_registers()[0], 0x2A);
+    EXPECT_EQ(device.holding_registers()[2], 3);
+    EXPECT_EQ(device.holding_registers()[31], 0x10);
+    EXPECT_TRUE(device.coils()[7]);
+    EXPECT_FALSE(device.coils()[6]);
+
+    // A snapshot of another layout is rejected
+    persistence::store<100, 101> other{snapshot.c_str(), journal.c_str()};
+    EXPECT_FALSE(other.valid());
+}
+
+TEST_F(modbus_persistence_test, failed_flush)
+{
+    using device_type = tests::capture<persistent_slave<slave<16, 100, 4, 100, 1>>>;
+    {
+        device_type device{snapshot.c_str(), journal.c_str(), tests::slave_id};
+        ASSERT_TRUE(device.restore());
+        device.write({0x10, 0x00, 0x02, 0x00, 0x02, 0x04, 0x12, 0x34, 0x56, 0x78});
+
+        // The journal may grow by a few bytes only, the write of the batch is torn
+        auto const header = device.store().journal_size();
+        auto const action = std::signal(SIGXFSZ, SIG_IGN);
+        rlimit     limit{};
+        ASSERT_EQ(::getrlimit(RLIMIT_FSIZE, &limit), 0);
+        auto tight     = limit;
+        tight.rlim_cur = header + 3;
+        ASSERT_EQ(::setrlimit(RLIMIT_FSIZE, &tight), 0);
+        auto const failed = device.persist();
+        ASSERT_EQ(::setrlimit(RLIMIT_FSIZE, &limit), 0);
+        std::signal(SIGXFSZ, action);
+        EXPECT_FALSE(failed);
+        EXPECT_EQ(std::ifstream(journal, std::ios::binary | std::ios::ate).tellg(), header);
+
+        // The batch kept is written by the next flush
+        EXPECT_TRUE(device.persist());
+        EXPECT_GT(device.store().journal_size(), header);
+    }
+    device_type device{snapshot.c_str(), journal.c_str(), tests::slave_id};
+    ASSERT_TRUE(device.restore());
+    EXPECT_EQ(device.holding_registers()[2], 0x1234);
+    EXPECT_EQ(device.holding_registers()[3], 0x5678);
+}
+
+TEST_F(modbus_persistence_test, bounded_batch)
+{
+    using store_type = persistence::store<16, 16>;
+    std::array<bool, 16> const          coils{};
+    std::array<std::uint16_t, 16> const holdings{};
+    {
+        store_type store{snapshot.c_str(), journal.c_str()};
+        ASSERT_TRUE(store.valid());
+        auto const  header = store.journal_size();
+        std::size_t records{};
+        while (store.append_holdings(holdings, 0, 16)) {
+            records++;
+        }
+        EXPECT_GT(records, 0);
+        EXPECT_LE(store.journal_size() - header, store_type::batch_bytes);
+        EXPECT_TRUE(store.flush());
+        EXPECT_TRUE(store.append_coils(coils, 0, 16));
+    }
+
+    // A store that could not open its files collects nothing
+    store_type broken{"/nonexistent/snapshot", journal.c_str()};
+    EXPECT_FALSE(broken.valid());
+    EXPECT_FALSE(broken.append_holdings(holdings, 0, 16));
+    EXPECT_EQ(broken.journal_size(), 0);
+}
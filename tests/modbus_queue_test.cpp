@@ -0,0 +1,83 @@
+#include "modbus_capture.hpp"
+
+#include <xitren/modbus/request_queue.hpp>
+#include <xitren/modbus/slave.hpp>
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+using namespace xitren::modbus;
+
+namespace {
+
+template <std::size_t Depth>
+using device_type = tests::capture<queued_slave<slave<16, 16, 16, 16, 1>, Depth>>;
+
+}    // namespace
+
+TEST(modbus_queue_test, pipelined)
+{
+    device_type<4> device{tests::slave_id};
+    EXPECT_TRUE(exception::no_error == device.deliver({0x06, 0x00, 0x01, 0x12, 0x34}));
+    EXPECT_TRUE(exception::no_error == device.deliver({0x03, 0x00, 0x01, 0x00, 0x01}));
+    EXPECT_TRUE(exception::no_error == device.deliver({0x03, 0x00, 0x10, 0x00, 0x01}));
+    EXPECT_TRUE(exception::no_error == device.deliver({0x05, 0x00, 0x02, 0xFF, 0x00}));
+    EXPECT_EQ(device.pending(), 3);
+
+    // The replies go out back to back and in order
+    EXPECT_EQ(device.drain(16), 4);
+    EXPECT_EQ(device.pending(), 0);
+    EXPECT_TRUE(device.idle());
+    ASSERT_EQ(device.replies.size(), 4);
+    EXPECT_EQ(device.replies[0], (std::vector<std::uint8_t>{0x11, 0x06, 0x00, 0x01, 0x12, 0x34}));
+    EXPECT_EQ(device.replies[1], (std::vector<std::uint8_t>{0x11, 0x03, 0x02, 0x12, 0x34}));
+    EXPECT_EQ(device.replies[2], (std::vector<std::uint8_t>{0x11, 0x83, 0x02}));
+    EXPECT_EQ(device.replies[3], (std::vector<std::uint8_t>{0x11, 0x05, 0x00, 0x02, 0xFF, 0x00}));
+    EXPECT_TRUE(device.coils()[2]);
+    EXPECT_EQ(device.get_counter(diagnostics_sub_function::return_bus_message_count), 4);
+}
+
+TEST(modbus_queue_test, bounded)
+{
+    device_type<2> device{tests::slave_id};
+    for (std::uint8_t i{}; i < 3; i++) {
+        EXPECT_TRUE(exception::no_error == device.deliver({0x06, 0x00, i, 0x00, i}));
+    }
+    EXPECT_TRUE(exception::slave_or_server_busy == device.deliver({0x06, 0x00, 0x03, 0x00, 0x03}));
+    EXPECT_EQ(device.get_counter(diagnostics_sub_function::return_server_busy_count), 1);
+
+    EXPECT_EQ(device.drain(2), 2);
+    EXPECT_EQ(device.pending(), 1);
+
+    // A corrupted frame is not queued
+    std::vector<std::uint8_t> bad{0x11, 0x06, 0x00, 0x04, 0x00, 0x04, 0x00, 0x00};
+    EXPECT_TRUE(exception::bad_crc == device.receive(bad.begin(), bad.end()));
+    EXPECT_EQ(device.pending(), 1);
+    EXPECT_TRUE(exception::no_error == device.deliver({0x06, 0x00, 0x05, 0x00, 0x05}));
+    EXPECT_EQ(device.drain(8), 2);
+    EXPECT_EQ(device.replies.size(), 4);
+    EXPECT_EQ(device.holding_registers()[2], 2);
+    EXPECT_EQ(device.holding_registers()[3], 0);
+    EXPECT_EQ(device.holding_registers()[5], 5);
+}
+
+TEST(modbus_queue_test, failed_send)
+{
+    device_type<4> device{tests::slave_id};
+    device.broken = true;
+    EXPECT_TRUE(exception::no_error == device.deliver({0x03, 0x00, 0x10, 0x00, 0x01}));
+    EXPECT_TRUE(exception::no_error == device.deliver({0x03, 0x00, 0x01, 0x00, 0x01}));
+
+    // The error reply can not go out, draining stops instead of spinning
+    EXPECT_EQ(device.drain(16), 0);
+    EXPECT_EQ(device.state(), slave_state::unrecoverable_error);
+    EXPECT_EQ(device.replies.size(), 1);
+
+    device.broken = false;
+    device.reset();
+    EXPECT_EQ(device.pending(), 0);
+    EXPECT_TRUE(exception::no_error == device.deliver({0x03, 0x00, 0x01, 0x00, 0x01}));
+    EXPECT_EQ(device.drain(16), 1);
+    EXPECT_EQ(device.replies.size(), 2);
+}
@@ -0,0 +1,112 @@
+#include <xitren/modbus/commands/read_registers.hpp>
+#include <xitren/modbus/registers_engine.hpp>
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <random>
+#include <vector>
+
+using namespace xitren::modbus;
+
+namespace {
+
+constexpr std::size_t field = 300;
+
+std::vector<std::uint8_t>
+random_bytes(std::size_t size, unsigned seed)
+{
+    std::mt19937              generator{seed};
+    std::vector<std::uint8_t> result(size);
+    for (auto& item : result) {
+        item = static_cast<std::uint8_t>(generator());
+    }
+    return result;
+}
+
+void
+check_engine(registers_engine::engine_type engine)
+{
+    auto const source = random_bytes((field + 16) * 2, 0x4e91);
+    for (std::size_t offset{}; offset < 16; offset++) {
+        for (std::size_t count{}; count + offset <= field; count++) {
+            std::vector<std::uint8_t> expected(field * 2 + 2, 0xA5);
+            std::vector<std::uint8_t> swapped(field * 2 + 2, 0xA5);
+            registers_engine::bytewise(source.data() + offset, count, expected.data() + 1);
+            engine(source.data() + offset, count, swapped.data() + 1);
+            ASSERT_EQ(expected, swapped) << "offset " << offset << " count " << count;
+
+            // In place
+            std::vector<std::uint8_t> block(source.begin() + static_cast<std::ptrdiff_t>(offset),
+                                            source.begin() + static_cast<std::ptrdiff_t>(offset + count * 2));
+            engine(block.data(), count, block.data());
+            ASSERT_TRUE(std::equal(block.begin(), block.end(), expected.begin() + 1)) << "count " << count;
+        }
+    }
+}
+
+}    // namespace
+
+TEST(modbus_registers_test, layout)
+{
+    std::array<std::uint16_t, 3> const values{0x1234, 0xABCD, 0x00FF};
+    std::array<std::uint8_t, 6>        wire{};
+    registers_engine::to_wire(values.data(), values.size(), wire.data());
+    EXPECT_EQ(wire, (std::array<std::uint8_t, 6>{0x12, 0x34, 0xAB, 0xCD, 0x00, 0xFF}));
+
+    std::array<std::uint16_t, 3> back{};
+    registers_engine::from_wire(wire.data(), wire.size() / 2, back.data());
+    EXPECT_EQ(back, values);
+    static_assert(registers_engine::swap_lanes(0x0102030405060708ULL) == 0x0201040306050807ULL);
+}
+
+TEST(modbus_registers_test, scalar) { check_engine(&registers_engine::scalar); }
+
+TEST(modbus_registers_test, simd)
+{
+#if defined(XITREN_MODBUS_REGISTERS_SSSE3)
+    if (!registers_engine::ssse3_supported()) {
+        GTEST_SKIP() << "No SSSE3";
+    }
+    check_engine(&registers_engine::ssse3);
+    if (!registers_engine::avx2_supported()) {
+        GTEST_SKIP() << "No AVX2";
+    }
+    check_engine(&registers_engine::avx2);
+#elif defined(XITREN_MODBUS_REGISTERS_NEON)
+    check_engine(&registers_engine::neon);
+#else
+    GTEST_SKIP() << "No SIMD engine";
+#endif
+}
+
+TEST(modbus_registers_test, selected) { check_engine(registers_engine::selected); }
+
+TEST(modbus_registers_test, command)
+{
+    std::array<std::uint16_t, modbus_base::max_read_registers> got{};
+    std::size_t                                                size{};
+    commands::read_registers request(0x11, 0, modbus_base::max_read_registers,
+                                     [&](exception error, std::uint16_t* begin, std::uint16_t* end) {
+                                         ASSERT_EQ(error, exception::no_error);
+                                         size = static_cast<std::size_t>(end - begin);
+                                         std::copy(begin, end, got.begin());
+                                     });
+
+    std::vector<std::uint8_t> reply{0x11, 0x03, modbus_base::max_read_registers * 2};
+    for (std::uint16_t i{}; i < modbus_base::max_read_registers; i++) {
+        reply.push_back(static_cast<std::uint8_t>(i));
+        reply.push_back(static_cast<std::uint8_t>(0x80 | i));
+    }
+    reply.resize(reply.size() + rtu::suffix_length);
+    rtu::seal(reply.begin(), reply.end() - rtu::suffix_length);
+    packet_accessor<modbus_base::max_adu_length> message{};
+    message.size(reply.size());
+    std::copy(reply.begin(), reply.end(), message.storage().begin());
+
+    EXPECT_EQ(request.receive(message), exception::no_error);
+    ASSERT_EQ(size, modbus_base::max_read_registers);
+    for (std::uint16_t i{}; i < modbus_base::max_read_registers; i++) {
+        ASSERT_EQ(got[i], static_cast<std::uint16_t>((i << 8U) | 0x80 | i)) << "register " << i;
+    }
+}
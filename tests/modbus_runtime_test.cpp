@@ -0,0 +1,235 @@
+#include <xitren/modbus/runtime/event_loop.hpp>
+#include <xitren/modbus/runtime/notified.hpp>
+#include <xitren/modbus/runtime/server.hpp>
+#include <xitren/modbus/slave.hpp>
+
+#include <poll.h>
+#include <sys/resource.h>
+
+#include <gtest/gtest.h>
+#include <thread>
+
+using namespace xitren::modbus;
+using namespace xitren::modbus::runtime;
+
+using tcp_device = hosted<slave<10, 10, 10, 10, 64, mbap>>;
+using rtu_device = hosted<slave<10, 10, 10, 10>>;
+
+namespace {
+
+class polled_device : public notified<slave<10, 10, 10, 10>> {
+public:
+    polled_device() : notified(0x22) {}
+
+    std::vector<std::uint8_t> sent{};
+
+    bool
+    send(msg_type::array_type::iterator begin, msg_type::array_type::iterator end) noexcept override
+    {
+        sent.assign(begin, end);
+        return true;
+    }
+};
+
+bool
+readable(int fd)
+{
+    pollfd item{fd, POLLIN, 0};
+    return ::poll(&item, 1, 0) == 1;
+}
+
+int
+connect_to(std::uint16_t port)
+{
+    int const   fd{::socket(AF_INET, SOCK_STREAM, 0)};
+    sockaddr_in addr{};
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    EXPECT_EQ(::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), 0);
+    return fd;
+}
+
+std::vector<std::uint8_t>
+exchange(int fd, std::vector<std::uint8_t> const& request, std::size_t expected)
+{
+    EXPECT_EQ(::write(fd, request.data(), request.size()), static_cast<ssize_t>(request.size()));
+    std::vector<std::uint8_t> reply(expected);
+    std::size_t               got{};
+    while (got < expected) {
+        pollfd item{fd, POLLIN, 0};
+        if (::poll(&item, 1, 2000) <= 0) {
+            break;
+        }
+        auto const size = ::read(fd, reply.data() + got, expected - got);
+        if (size <= 0) {
+            break;
+        }
+        got += static_cast<std::size_t>(size);
+    }
+    reply.resize(got);
+    return reply;
+}
+
+}    // namespace
+
+TEST(modbus_runtime_test, tcp_loop)
+{
+    tcp_device device{0x22};
+    device.holding_registers()[0] = 0x1234;
+    unit_table units{};
+    EXPECT_TRUE(units.attach(device));
+    EXPECT_FALSE(units.attach(device));
+
+    event_loop loop{};
+    ASSERT_TRUE(loop.valid());
+    auto const port = loop.listen(0, units, INADDR_LOOPBACK);
+    ASSERT_NE(port, 0);
+    std::thread runner{[&loop] { loop.run(); }};
+
+    int const fd = connect_to(port);
+    // Two pipelined requests in one segment
+    std::vector<std::uint8_t> const request{0x00, 0x01, 0x00, 0x00, 0x00, 0x06, 0x22, 0x03, 0x00, 0x00, 0x00, 0x01,
+                                            0x00, 0x02, 0x00, 0x00, 0x00, 0x06, 0xFF, 0x03, 0x00, 0x00, 0x00, 0x01};
+    std::vector<std::uint8_t> const expected{0x00, 0x01, 0x00, 0x00, 0x00, 0x05, 0x22, 0x03, 0x02, 0x12, 0x34,
+                                             0x00, 0x02, 0x00, 0x00, 0x00, 0x05, 0xFF, 0x03, 0x02, 0x12, 0x34};
+    EXPECT_EQ(exchange(fd, request, expected.size()), expected);
+
+    // No such unit
+    std::vector<std::uint8_t> const lost{0x00, 0x03, 0x00, 0x00, 0x00, 0x06, 0x30, 0x03, 0x00, 0x00, 0x00, 0x01};
+    std::vector<std::uint8_t> const rejected{0x00, 0x03, 0x00, 0x00, 0x00, 0x03, 0x30, 0x83, 0x0B};
+    EXPECT_EQ(exchange(fd, lost, rejected.size()), rejected);
+
+    // A request split over two segments
+    EXPECT_EQ(::write(fd, request.data(), 5), 5);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    std::vector<std::uint8_t> const rest{request.begin() + 5, request.begin() + 12};
+    EXPECT_EQ(exchange(fd, rest, 11), std::vector<std::uint8_t>(expected.begin(), expected.begin() + 11));
+
+    ::close(fd);
+    loop.stop();
+    runner.join();
+    EXPECT_EQ(loop.stats().frames, 4);
+    EXPECT_EQ(loop.stats().unrouted, 1);
+    EXPECT_EQ(loop.stats().accepted, 1);
+}
+
+TEST(modbus_runtime_test, serial_line)
+{
+    rtu_device device{0x22};
+    device.holding_registers()[1] = 0xABCD;
+    unit_table units{};
+    units.attach(device);
+
+    std::array<int, 2> fds{};
+    ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds.data()), 0);
+    event_loop loop{};
+    ASSERT_TRUE(loop.attach_serial(fds[0], std::chrono::microseconds{2000}, units));
+    std::thread runner{[&loop] { loop.run(); }};
+
+    std::vector<std::uint8_t> request{0x22, 0x03, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00};
+    rtu::seal(request.data(), request.data() + 6);
+    auto const reply = exchange(fds[1], request, 7);
+    ASSERT_EQ(reply.size(), 7);
+    EXPECT_TRUE(rtu::valid(reply.data(), reply.data() + reply.size()));
+    EXPECT_EQ(reply[2], 0x02);
+    EXPECT_EQ(reply[3], 0xAB);
+    EXPECT_EQ(reply[4], 0xCD);
+
+    ::close(fds[1]);
+    loop.stop();
+    runner.join();
+}
+
+TEST(modbus_runtime_test, out_of_descriptors)
+{
+    tcp_device device{0x22};
+    unit_table units{};
+    units.attach(device);
+    event_loop loop{};
+    auto const port = loop.listen(0, units, INADDR_LOOPBACK);
+    ASSERT_NE(port, 0);
+    int const          client{::socket(AF_INET, SOCK_STREAM, 0)};
+    std::array<int, 2> fds{};
+    ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds.data()), 0);
+
+    // Every descriptor below the limit is taken
+    rlimit limit{};
+    ASSERT_EQ(::getrlimit(RLIMIT_NOFILE, &limit), 0);
+    int const lowest{::dup(0)};
+    ASSERT_GE(lowest, 0);
+    ::close(lowest);
+    auto tight     = limit;
+    tight.rlim_cur = static_cast<rlim_t>(lowest);
+    ASSERT_EQ(::setrlimit(RLIMIT_NOFILE, &tight), 0);
+
+    // The connection is refused on the spare descriptor instead of spinning on the listener
+    sockaddr_in addr{};
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    auto const connected = ::connect(client, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    auto const handled   = loop.run_once(1000);
+    // A serial line that can not be added is closed all the same
+    auto const attached = loop.attach_serial(fds[0], std::chrono::microseconds{2000}, units);
+    ASSERT_EQ(::setrlimit(RLIMIT_NOFILE, &limit), 0);
+
+    EXPECT_EQ(connected, 0);
+    EXPECT_EQ(handled, 1);
+    EXPECT_EQ(loop.stats().refused, 1);
+    EXPECT_EQ(loop.stats().accepted, 0);
+    EXPECT_EQ(loop.run_once(0), 0);
+    std::uint8_t byte{};
+    EXPECT_TRUE(readable(client));
+    EXPECT_EQ(::read(client, &byte, 1), 0);
+    EXPECT_FALSE(attached);
+    EXPECT_EQ(::fcntl(fds[0], F_GETFD), -1);
+    ::close(client);
+    ::close(fds[1]);
+}
+
+TEST(modbus_runtime_test, server_reframes)
+{
+    rtu_device device{0x22};
+    device.holding_registers()[0] = 0x0102;
+    unit_table units{};
+    units.attach(device);
+
+    server loops{2};
+    auto const port = loops.listen(0, units, INADDR_LOOPBACK);
+    ASSERT_NE(port, 0);
+    ASSERT_TRUE(loops.start());
+
+    std::vector<std::uint8_t> const request{0x12, 0x34, 0x00, 0x00, 0x00, 0x06, 0x00, 0x03, 0x00, 0x00, 0x00, 0x01};
+    std::vector<std::uint8_t> const expected{0x12, 0x34, 0x00, 0x00, 0x00, 0x05, 0x00, 0x03, 0x02, 0x01, 0x02};
+    std::array<int, 4>              fds{};
+    for (auto& fd : fds) {
+        fd = connect_to(port);
+    }
+    for (auto fd : fds) {
+        EXPECT_EQ(exchange(fd, request, expected.size()), expected);
+        ::close(fd);
+    }
+    loops.stop();
+}
+
+TEST(modbus_runtime_test, wakeup)
+{
+    polled_device device;
+    ASSERT_TRUE(device.valid());
+    EXPECT_TRUE(exception::nothing_to_do == device.processing());
+    EXPECT_FALSE(readable(device.fd()));
+
+    device.holding_registers()[1] = 0xABCD;
+    std::vector<std::uint8_t> request{0x22, 0x03, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00};
+    rtu::seal(request.data(), request.data() + 6);
+    EXPECT_TRUE(exception::no_error == device.receive(request.begin(), request.end()));
+    EXPECT_TRUE(readable(device.fd()));
+
+    EXPECT_EQ(device.serve(), 3);
+    EXPECT_FALSE(readable(device.fd()));
+    ASSERT_EQ(device.sent.size(), 7);
+    EXPECT_EQ(device.sent[3], 0xAB);
+    EXPECT_EQ(device.sent[4], 0xCD);
+    EXPECT_TRUE(exception::nothing_to_do == device.processing());
+}
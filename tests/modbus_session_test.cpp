@@ -0,0 +1,87 @@
+#include <xitren/modbus/session.hpp>
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace xitren::modbus;
+
+namespace {
+
+using device_type  = concurrent_device<64, 64, 16, 16>;
+using session_type = session<device_type>;
+
+std::vector<std::uint8_t>
+request(session_type& client, std::uint16_t transaction, std::vector<std::uint8_t> pdu)
+{
+    auto const length = static_cast<std::uint16_t>(pdu.size() + 1);
+    std::vector<std::uint8_t> adu{static_cast<std::uint8_t>(transaction >> 8), static_cast<std::uint8_t>(transaction),
+                                  0x00, 0x00, static_cast<std::uint8_t>(length >> 8),
+                                  static_cast<std::uint8_t>(length), 0x01};
+    adu.insert(adu.end(), pdu.begin(), pdu.end());
+    auto const reply = client.handle(adu);
+    if (reply.size() <= mbap::prefix_length) {
+        return {};
+    }
+    return {reply.begin() + mbap::prefix_length, reply.end()};
+}
+
+}    // namespace
+
+TEST(modbus_session_test, shared_image)
+{
+    device_type  plc;
+    session_type first{0x01, plc};
+    session_type second{0x01, plc};
+    // Two messages and the protocol state, see session
+    EXPECT_LE(sizeof(session_type), 2 * sizeof(session_type::msg_type) + 256);
+
+    EXPECT_EQ(request(first, 1, {0x10, 0x00, 0x02, 0x00, 0x02, 0x04, 0x12, 0x34, 0x56, 0x78}),
+              (std::vector<std::uint8_t>{0x01, 0x10, 0x00, 0x02, 0x00, 0x02}));
+    EXPECT_EQ(request(second, 7, {0x03, 0x00, 0x02, 0x00, 0x02}),
+              (std::vector<std::uint8_t>{0x01, 0x03, 0x04, 0x12, 0x34, 0x56, 0x78}));
+    request(second, 8, {0x05, 0x00, 0x21, 0xFF, 0x00});
+    EXPECT_TRUE(plc.coils[0x21]);
+    EXPECT_EQ(request(first, 2, {0x01, 0x00, 0x21, 0x00, 0x01}), (std::vector<std::uint8_t>{0x01, 0x01, 0x01, 0x01}));
+
+    // A failed request leaves the state of the other session alone
+    EXPECT_EQ(request(first, 3, {0x03, 0x00, 0x10, 0x00, 0x01}), (std::vector<std::uint8_t>{0x01, 0x83, 0x02}));
+    EXPECT_TRUE(exception::illegal_data_address == first.error());
+    EXPECT_TRUE(exception::no_error == second.error());
+
+    plc.log.push(0x31);
+    EXPECT_EQ(&first.log(), &second.log());
+}
+
+TEST(modbus_session_test, concurrent_clients)
+{
+    constexpr int            rounds = 2000;
+    device_type              plc;
+    std::atomic<bool>        torn{};
+    std::atomic<bool>        failed{};
+    std::vector<std::thread> clients;
+    for (std::uint8_t client{}; client < 4; client++) {
+        clients.emplace_back([&, client] {
+            session_type link{0x01, plc};
+            for (int i{}; i < rounds; i++) {
+                auto const value = static_cast<std::uint8_t>(client * 16 + (i & 0x0F));
+                auto const write = request(link, static_cast<std::uint16_t>(i),
+                                           {0x10, 0x00, 0x00, 0x00, 0x02, 0x04, 0x00, value, 0x00, value});
+                auto const read  = request(link, static_cast<std::uint16_t>(i), {0x03, 0x00, 0x00, 0x00, 0x02});
+                if ((write.size() != 6) || (read.size() != 7)) {
+                    failed = true;
+                } else if (read[4] != read[6]) {
+                    torn = true;
+                }
+            }
+        });
+    }
+    for (auto& item : clients) {
+        item.join();
+    }
+    EXPECT_FALSE(failed);
+    EXPECT_FALSE(torn);
+}
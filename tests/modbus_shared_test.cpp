@@ -0,0 +1,106 @@
+#include "modbus_capture.hpp"
+
+#include <xitren/modbus/shared_image.hpp>
+
+#include <gtest/gtest.h>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <array>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace xitren::modbus;
+
+namespace {
+
+using image_type  = shared_image<64, 64, 16, 16>;
+using device_type = tests::capture<shared_slave<image_type>>;
+
+std::string
+unique_name()
+{
+    return "/xitren-modbus-test-" + std::to_string(::getpid());
+}
+
+}    // namespace
+
+TEST(modbus_shared_test, shared_memory)
+{
+    auto const name = unique_name();
+    image_type::remove(name.c_str());
+    EXPECT_FALSE(image_type::shared_memory(name.c_str(), shared_mode::attach).valid());
+
+    auto server = image_type::shared_memory(name.c_str(), shared_mode::create);
+    auto hmi    = image_type::shared_memory(name.c_str(), shared_mode::attach);
+    ASSERT_TRUE(server.valid());
+    ASSERT_TRUE(hmi.valid());
+    EXPECT_EQ(hmi.header().version, shared_header::layout);
+    EXPECT_FALSE((shared_image<64, 64, 16, 17>::shared_memory(name.c_str(), shared_mode::attach).valid()));
+
+    // Another process publishes a sample, the server replies it
+    pid_t const child = ::fork();
+    if (child == 0) {
+        auto                               logic = image_type::shared_memory(name.c_str(), shared_mode::attach);
+        std::array<std::uint16_t, 2> const sample{0x0102, 0x0304};
+        logic.input_registers().update(3, sample);
+        logic.inputs()[5] = true;
+        ::_exit(logic.valid() ? 0 : 1);
+    }
+    int status{};
+    ASSERT_EQ(::waitpid(child, &status, 0), child);
+    ASSERT_EQ(WEXITSTATUS(status), 0);
+
+    device_type device{tests::slave_id, server};
+    auto const  registers = device.request({0x04, 0x00, 0x03, 0x00, 0x02});
+    ASSERT_EQ(registers.size(), 7U);
+    EXPECT_EQ(std::vector<std::uint8_t>(registers.begin() + 2, registers.begin() + 7),
+              (std::vector<std::uint8_t>{0x04, 0x01, 0x02, 0x03, 0x04}));
+    auto const inputs = device.request({0x02, 0x00, 0x00, 0x00, 0x08});
+    ASSERT_EQ(inputs.size(), 4U);
+    EXPECT_EQ(inputs[3], 0x20);
+
+    // A master writes, the HMI sees it through its own mapping
+    device.request({0x10, 0x00, 0x01, 0x00, 0x02, 0x04, 0x00, 0x07, 0x00, 0x09});
+    device.request({0x05, 0x00, 0x3F, 0xFF, 0x00});
+    EXPECT_EQ(hmi.holding_registers()[1], 7);
+    EXPECT_EQ(hmi.holding_registers()[2], 9);
+    EXPECT_TRUE(hmi.coils()[63]);
+    EXPECT_TRUE(image_type::remove(name.c_str()));
+}
+
+TEST(modbus_shared_test, file)
+{
+    auto const path = "/tmp" + unique_name() + ".image";
+    std::remove(path.c_str());
+    {
+        auto image = image_type::file(path.c_str(), shared_mode::create);
+        ASSERT_TRUE(image.valid());
+        image.holding_registers()[15] = 0xBEEF;
+    }
+    auto image = image_type::file(path.c_str(), shared_mode::attach);
+    ASSERT_TRUE(image.valid());
+    EXPECT_EQ(image.holding_registers()[15], 0xBEEF);
+    EXPECT_FALSE((shared_image<64, 128, 16, 16>::file(path.c_str(), shared_mode::create).valid()));
+    std::remove(path.c_str());
+}
+
+TEST(modbus_shared_test, unpublished)
+{
+    // A creator that died after sizing the region leaves it zero
+    auto const path = "/tmp" + unique_name() + ".unpublished";
+    std::ofstream{path, std::ios::binary} << std::string(image_type::region_size, '\0');
+    EXPECT_FALSE(image_type::file(path.c_str(), shared_mode::attach).valid());
+    {
+        auto image = image_type::file(path.c_str(), shared_mode::create);
+        ASSERT_TRUE(image.valid());
+        image.coils()[63] = true;
+    }
+    auto image = image_type::file(path.c_str(), shared_mode::attach);
+    ASSERT_TRUE(image.valid());
+    EXPECT_TRUE(image.coils()[63]);
+    std::remove(path.c_str());
+}
@@ -0,0 +1,74 @@
+#include "modbus_capture.hpp"
+
+#include <xitren/modbus/slave.hpp>
+#include <xitren/modbus/sparse_image.hpp>
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <vector>
+
+using namespace xitren::modbus;
+
+namespace {
+
+using bits_type    = sparse_bits<address_range{0, 16}, address_range{1000, 64}>;
+using inputs_type  = sparse_registers<address_range{0, 100}, address_range{30000, 100}>;
+using holding_type = sparse_registers<address_range{0, 100}, address_range{30000, 100}, address_range{40000, 1000},
+                                      address_range{41000, 10}>;
+
+using device_type  = tests::capture<basic_slave<bits_type, bits_type, inputs_type, holding_type, 1, rtu>>;
+
+}    // namespace
+
+TEST(modbus_sparse_test, search)
+{
+    using image_type
+        = sparse_registers<address_range{3, 2}, address_range{10, 5}, address_range{15, 1}, address_range{100, 50},
+                           address_range{200, 1}, address_range{1000, 24}, address_range{65000, 536}>;
+    image_type const image{};
+    EXPECT_EQ(image.size(), 65536);
+    EXPECT_EQ(image_type::stored, 619);
+    for (std::size_t address{}; address < 65536; address++) {
+        std::size_t expected{image_type::npos};
+        for (std::size_t i{}; i < image_type::ranges; i++) {
+            if ((address >= image_type::table[i].start)
+                && (address < image_type::table[i].start + image_type::table[i].count)) {
+                expected = i;
+            }
+        }
+        ASSERT_EQ(image_type::find(address), expected) << "address " << address;
+    }
+    EXPECT_TRUE(image.contains(10, 6));
+    EXPECT_FALSE(image.contains(10, 7));
+    EXPECT_FALSE(image.contains(4, 2));
+    EXPECT_TRUE(image.contains(65000, 536));
+    EXPECT_FALSE(image.contains(0, 1));
+}
+
+TEST(modbus_sparse_test, protocol)
+{
+    device_type device{tests::slave_id};
+    EXPECT_EQ(sizeof(device.holding_registers()), 1210 * sizeof(std::uint16_t));
+
+    std::array<std::uint16_t, 2> const sample{0x0102, 0x0304};
+    device.input_registers().update(30098, sample);
+    EXPECT_EQ(device.request({0x04, 0x75, 0x92, 0x00, 0x02}),
+              (std::vector<std::uint8_t>{0x11, 0x04, 0x04, 0x01, 0x02, 0x03, 0x04}));
+    // Into the hole after 30099
+    EXPECT_EQ(device.request({0x04, 0x75, 0x92, 0x00, 0x03}), (std::vector<std::uint8_t>{0x11, 0x84, 0x02}));
+    EXPECT_EQ(device.request({0x04, 0x00, 0x64, 0x00, 0x01}), (std::vector<std::uint8_t>{0x11, 0x84, 0x02}));
+
+    // Across the touching ranges 40000-40999 and 41000-41009
+    device.request({0x10, 0xA0, 0x27, 0x00, 0x02, 0x04, 0x00, 0x07, 0x00, 0x09});
+    EXPECT_EQ(device.holding_registers()[40999], 7);
+    EXPECT_EQ(device.holding_registers()[41000], 9);
+    EXPECT_EQ(device.request({0x06, 0xA0, 0x32, 0x00, 0x01}), (std::vector<std::uint8_t>{0x11, 0x86, 0x02}));
+    EXPECT_EQ(device.request({0x03, 0xA0, 0x30, 0x00, 0x03}), (std::vector<std::uint8_t>{0x11, 0x83, 0x02}));
+
+    device.request({0x0F, 0x03, 0xE8, 0x00, 0x0A, 0x02, 0xF3, 0x03});
+    EXPECT_EQ(device.request({0x01, 0x03, 0xE8, 0x00, 0x0A}),
+              (std::vector<std::uint8_t>{0x11, 0x01, 0x02, 0xF3, 0x03}));
+    EXPECT_EQ(device.request({0x05, 0x00, 0x10, 0xFF, 0x00}), (std::vector<std::uint8_t>{0x11, 0x85, 0x02}));
+    EXPECT_EQ(device.request({0x01, 0x00, 0x0F, 0x00, 0x02}), (std::vector<std::uint8_t>{0x11, 0x81, 0x02}));
+}
@@ -0,0 +1,397 @@
+#include <xitren/modbus/commands/read_registers.hpp>
+#include <xitren/modbus/master.hpp>
+#include <xitren/modbus/slave.hpp>
+
+#include <gtest/gtest.h>
+
+using namespace xitren::modbus;
+using namespace xitren::modbus::commands;
+
+using tcp_slave_type = slave<10, 10, 10, 10, 64, mbap>;
+
+class test_tcp_slave : public tcp_slave_type {
+
+    bool
+    send(msg_type::array_type::iterator begin, msg_type::array_type::iterator end) noexcept override
+    {
+        last_.assign(begin, end);
+        return true;
+    }
+
+    std::vector<std::uint8_t> last_{};
+
+public:
+    test_tcp_slave() : slave(0x22) {}
+
+    template <class Iterator>
+    void
+    data(Iterator begin, Iterator end)
+    {
+        last_.clear();
+        receive(begin, end);
+        processing();
+        processing();
+        processing();
+    }
+
+    [[nodiscard]] std::vector<std::uint8_t> const&
+    last() const noexcept
+    {
+        return last_;
+    }
+};
+
+class test_tcp_master : public basic_master<mbap> {
+
+    bool
+    send(msg_type::array_type::iterator begin, msg_type::array_type::iterator end) noexcept override
+    {
+        last_.assign(begin, end);
+        return true;
+    }
+
+    std::vector<std::uint8_t> last_{};
+
+public:
+    bool
+    timer_start(std::size_t) override
+    {
+        return true;
+    }
+
+    bool
+    timer_stop() override
+    {
+        return true;
+    }
+
+    [[nodiscard]] std::vector<std::uint8_t> const&
+    last() const noexcept
+    {
+        return last_;
+    }
+};
+
+TEST(modbus_tcp_test, slave_reply_echoes_transaction)
+{
+    test_tcp_slave slave{};
+    slave.holding_registers()[0] = 0x1234;
+    slave.holding_registers()[1] = 0x5678;
+
+    std::array<std::uint8_t, 12> request{0xAB, 0xCD, 0x00, 0x00, 0x00, 0x06, 0x22, 0x03, 0x00, 0x00, 0x00, 0x02};
+    std::vector<std::uint8_t>    expected{0xAB, 0xCD, 0x00, 0x00, 0x00, 0x07, 0x22,
+                                          0x03, 0x04, 0x12, 0x34, 0x56, 0x78};
+    slave.data(request.begin(), request.end());
+    EXPECT_EQ(slave.last(), expected);
+
+    request[6]  = mbap::no_unit;
+    expected[6] = mbap::no_unit;
+    slave.data(request.begin(), request.end());
+    EXPECT_EQ(slave.last(), expected);
+}
+
+TEST(modbus_tcp_test, slave_error_reply)
+{
+    test_tcp_slave                  slave{};
+    std::array<std::uint8_t, 12>    request{0x00, 0x07, 0x00, 0x00, 0x00, 0x06, 0x22, 0x03, 0x00, 0x20, 0x00, 0x02};
+    std::vector<std::uint8_t> const expected{0x00, 0x07, 0x00, 0x00, 0x00, 0x03, 0x22, 0x83, 0x02};
+    slave.data(request.begin(), request.end());
+    EXPECT_EQ(slave.last(), expected);
+}
+
+TEST(modbus_tcp_test, slave_bad_frame)
+{
+    test_tcp_slave slave{};
+    // Length field does not match the frame size
+    std::array<std::uint8_t, 12> request{0x00, 0x01, 0x00, 0x00, 0x00, 0x07, 0x22, 0x03, 0x00, 0x00, 0x00, 0x02};
+    EXPECT_EQ(slave.receive(request.begin(), request.end()), exception::bad_data);
+    // Unknown protocol id
+    request[3] = 0x01;
+    request[5] = 0x06;
+    EXPECT_EQ(slave.receive(request.begin(), request.end()), exception::bad_data);
+    // Other unit
+    request[3] = 0x00;
+    request[6] = 0x23;
+    slave.data(request.begin(), request.end());
+    EXPECT_TRUE(slave.last().empty());
+}
+
+TEST(modbus_tcp_test, master_round_trip)
+{
+    test_tcp_master master{};
+    test_tcp_slave  slave{};
+    slave.holding_registers()[0] = 0x1234;
+    slave.holding_registers()[1] = 0x5678;
+
+    for (std::uint16_t transaction{1}; transaction < 4; transaction++) {
+        bool           called = false;
+        read_registers t1(0x22, 0, 2,
+                          [&](exception err, types::array_type::iterator begin, types::array_type::iterator end) {
+                              EXPECT_EQ(err, exception::no_error);
+                              ASSERT_EQ(std::distance(begin, end), 2);
+                              EXPECT_EQ(begin[0], 0x1234);
+                              EXPECT_EQ(begin[1], 0x5678);
+                              called = true;
+                          });
+        master << t1;
+        std::vector<std::uint8_t> const expected{0x00, static_cast<std::uint8_t>(transaction),
+                                                 0x00, 0x00, 0x00, 0x06, 0x22, 0x03, 0x00, 0x00, 0x00, 0x02};
+        EXPECT_EQ(master.last(), expected);
+
+        slave.data(master.last().begin(), master.last().end());
+        auto reply = slave.last();
+        EXPECT_EQ(mbap::transaction(reply.begin()), transaction);
+
+        // A reply with another transaction id is not ours
+        mbap::transaction(reply.begin(), transaction + 100);
+        master.receive(reply.begin(), reply.end());
+        EXPECT_FALSE(called);
+        EXPECT_EQ(master.state(), master_state::waiting_reply);
+
+        mbap::transaction(reply.begin(), transaction);
+        master.receive(reply.begin(), reply.end());
+        EXPECT_TRUE(called);
+        master.processing();
+        EXPECT_EQ(master.state(), master_state::idle);
+    }
+}
+
+class test_pipelined_master : public basic_master<mbap, 4> {
+
+    bool
+    send(msg_type::array_type::iterator begin, msg_type::array_type::iterator end) noexcept override
+    {
+        if (broken) {
+            return false;
+        }
+        sent_.emplace_back(begin, end);
+        return true;
+    }
+
+    std::vector<std::vector<std::uint8_t>> sent_{};
+
+public:
+    std::array<bool, window> timers{};
+    bool                     broken{};
+
+    bool
+    timer_start(std::size_t) override
+    {
+        return false;
+    }
+
+    bool
+    timer_stop() override
+    {
+        return false;
+    }
+
+    bool
+    slot_timer_start(std::size_t slot, std::size_t) override
+    {
+        timers[slot] = true;
+        return true;
+    }
+
+    bool
+    slot_timer_stop(std::size_t slot) override
+    {
+        timers[slot] = false;
+        return true;
+    }
+
+    [[nodiscard]] std::vector<std::vector<std::uint8_t>> const&
+    sent() const noexcept
+    {
+        return sent_;
+    }
+};
+
+TEST(modbus_tcp_test, master_pipelined)
+{
+    test_pipelined_master master{};
+    test_tcp_slave        slave{};
+    for (std::uint16_t i{}; i < 10; i++) {
+        slave.holding_registers()[i] = static_cast<std::uint16_t>(0x100 + i);
+    }
+
+    std::array<int, test_pipelined_master::window + 1> results{};
+    results.fill(-1);
+    std::vector<read_registers> commands{};
+    for (std::uint16_t i{}; i <= test_pipelined_master::window; i++) {
+        commands.emplace_back(0x22, i, 1,
+                              [&results, i](exception err, types::array_type::iterator begin,
+                                            types::array_type::iterator end) {
+                                  if (err != exception::no_error) {
+                                      results[i] = 0;
+                                      return;
+                                  }
+                                  ASSERT_EQ(std::distance(begin, end), 1);
+                                  results[i] = *begin;
+                              });
+    }
+    for (std::size_t i{}; i < test_pipelined_master::window; i++) {
+        EXPECT_TRUE(master.run_async(commands[i]));
+    }
+    EXPECT_EQ(master.in_flight(), test_pipelined_master::window);
+    EXPECT_FALSE(master.run_async(commands.back()));
+    ASSERT_EQ(master.sent().size(), test_pipelined_master::window);
+
+    // Replies come back out of order
+    std::vector<std::vector<std::uint8_t>> replies{};
+    for (auto const& request : master.sent()) {
+        slave.data(request.begin(), request.end());
+        replies.push_back(slave.last());
+    }
+    EXPECT_EQ(master.receive(replies[2].begin(), replies[2].end()), exception::no_error);
+    EXPECT_EQ(master.receive(replies[0].begin(), replies[0].end()), exception::no_error);
+    EXPECT_EQ(results[2], 0x102);
+    EXPECT_EQ(results[0], 0x100);
+    EXPECT_EQ(results[1], -1);
+    EXPECT_EQ(master.in_flight(), 2);
+    EXPECT_FALSE(master.timers[0]);
+    EXPECT_TRUE(master.timers[1]);
+    EXPECT_FALSE(master.timers[2]);
+    master.processing();
+    EXPECT_EQ(master.state(), master_state::waiting_reply);
+
+    // A freed slot takes a new request while the others still wait
+    EXPECT_TRUE(master.run_async(commands.back()));
+    slave.data(master.sent().back().begin(), master.sent().back().end());
+    auto const last = slave.last();
+
+    // One request times out on its own
+    master.slot_expired(1);
+    EXPECT_EQ(results[1], 0);
+    master.processing();
+    EXPECT_EQ(master.state(), master_state::waiting_reply);
+    // Its late reply is not taken for another request
+    EXPECT_EQ(master.receive(replies[1].begin(), replies[1].end()), exception::no_error);
+    EXPECT_EQ(master.in_flight(), 2);
+
+    EXPECT_EQ(master.receive(last.begin(), last.end()), exception::no_error);
+    EXPECT_EQ(master.receive(replies[3].begin(), replies[3].end()), exception::no_error);
+    EXPECT_EQ(results[3], 0x103);
+    EXPECT_EQ(results[4], 0x104);
+    EXPECT_EQ(master.in_flight(), 0);
+    master.processing();
+    EXPECT_EQ(master.state(), master_state::idle);
+}
+
+TEST(modbus_tcp_test, master_pipelined_send_failure)
+{
+    test_pipelined_master master{};
+    test_tcp_slave        slave{};
+    slave.holding_registers()[0] = 0x100;
+
+    // The callbacks hold the token, every clone released gives its reference back
+    auto const                  token = std::make_shared<int>();
+    std::array<int, 2>          results{-1, -1};
+    std::vector<read_registers> commands{};
+    for (std::uint16_t i{}; i < 2; i++) {
+        commands.emplace_back(
+            0x22, i, 1,
+            [&results, i, token](exception err, types::array_type::iterator begin, types::array_type::iterator) {
+                results[i] = (err == exception::no_error) ? *begin : 0;
+            });
+    }
+    auto const references = token.use_count();
+
+    EXPECT_TRUE(master.run_async(commands[0]));
+    EXPECT_EQ(token.use_count(), references + 1);
+
+    // A request that could not be sent frees its slot, the one in flight is still served
+    master.broken = true;
+    EXPECT_FALSE(master.run_async(commands[1]));
+    EXPECT_EQ(master.in_flight(), 1);
+    EXPECT_EQ(token.use_count(), references + 1);
+    EXPECT_EQ(master.state(), master_state::waiting_reply);
+    EXPECT_TRUE(master.idle());
+
+    ASSERT_EQ(master.sent().size(), 1);
+    slave.data(master.sent().front().begin(), master.sent().front().end());
+    EXPECT_EQ(master.receive(slave.last().begin(), slave.last().end()), exception::no_error);
+    EXPECT_EQ(results[0], 0x100);
+    EXPECT_EQ(results[1], -1);
+    EXPECT_EQ(master.in_flight(), 0);
+    EXPECT_EQ(token.use_count(), references);
+    master.processing();
+    EXPECT_EQ(master.state(), master_state::idle);
+
+    // Expired and reset slots release their clones as well
+    master.broken = false;
+    EXPECT_TRUE(master.run_async(commands[0]));
+    EXPECT_TRUE(master.run_async(commands[1]));
+    EXPECT_EQ(token.use_count(), references + 2);
+    master.slot_expired(0);
+    EXPECT_EQ(results[0], 0);
+    EXPECT_EQ(token.use_count(), references + 1);
+    master.reset();
+    EXPECT_EQ(token.use_count(), references);
+}
+
+class test_shared_timer_master : public basic_master<mbap, 4> {
+public:
+    bool                     broken{};
+    std::vector<std::size_t> timers{};
+
+    bool
+    send(msg_type::array_type::iterator, msg_type::array_type::iterator) noexcept override
+    {
+        return !broken;
+    }
+
+    bool
+    timer_start(std::size_t microseconds) override
+    {
+        timers.push_back(microseconds);
+        return true;
+    }
+
+    bool
+    timer_stop() override
+    {
+        return true;
+    }
+};
+
+TEST(modbus_tcp_test, master_shared_timer)
+{
+    test_shared_timer_master    master{};
+    std::array<int, 2>          results{-1, -1};
+    std::vector<read_registers> commands{};
+    for (std::uint16_t i{}; i < 2; i++) {
+        commands.emplace_back(0x22, i, 1,
+                              [&results, i](exception err, types::array_type::iterator, types::array_type::iterator) {
+                                  results[i] = (err == exception::no_error) ? 1 : 0;
+                              });
+    }
+
+    // A request sent while the timer runs does not restart it
+    EXPECT_TRUE(master.run_async(commands[0]));
+    EXPECT_TRUE(master.run_async(commands[1]));
+    EXPECT_EQ(master.timers.size(), 1);
+
+    // Only the overdue request expires, the timer is started again for the other
+    master.timer_expired();
+    EXPECT_EQ(results[0], 0);
+    EXPECT_EQ(results[1], -1);
+    EXPECT_EQ(master.in_flight(), 1);
+    ASSERT_EQ(master.timers.size(), 2);
+    EXPECT_EQ(master.timers.back(), master.timers.front());
+    master.processing();
+    EXPECT_EQ(master.state(), master_state::waiting_reply);
+
+    master.timer_expired();
+    EXPECT_EQ(results[1], 0);
+    EXPECT_EQ(master.in_flight(), 0);
+    EXPECT_EQ(master.timers.size(), 2);
+    master.processing();
+    EXPECT_EQ(master.state(), master_state::idle);
+
+    // A request that could not be sent does not keep its slot
+    master.broken = true;
+    EXPECT_FALSE(master.run_async(commands[0]));
+    EXPECT_EQ(master.in_flight(), 0);
+    EXPECT_EQ(master.state(), master_state::unrecoverable_error);
+}
@@ -2,6 +2,7 @@
 #include "xitren/modbus/slave.hpp"
 #include <xitren/circular_buffer.hpp>
 #include <xitren/comm/observer.hpp>
+#include <xitren/modbus/commands/read_registers.hpp>
 #include <xitren/modbus/crc16ansi.hpp>
 #include <xitren/modbus/packet.hpp>
 
@@ -89,7 +90,7 @@ class test_custom_slave : public custom_slave_type, public observer_type, public
     }
 
 public:
-    test_custom_slave() : slave_base(0x22, bits_, bits_, registers_, registers_) { exception_status_ = 0x55; }
+    test_custom_slave() : slave_base(0x22, bits_, bits_, registers_, registers_, log_) { exception_status_ = 0x55; }
 
     inline std::vector<std::uint8_t>&
     last()
@@ -110,6 +111,7 @@ private:
     std::vector<std::uint8_t>   last_;
     custom_slave_bits_type      bits_{};
     custom_slave_registers_type registers_{};
+    log_type                    log_{};
 };
 
 class test_master : public master, public observer_type, public observable_type {
@@ -263,3 +265,435 @@ TEST(modbus_test, modbus_slave_crc_first)
     EXPECT_TRUE(slave_state::idle == sl.state());
     sl.reset();
 }
+
+TEST(modbus_test, modbus_slave_receive_byte)
+{
+    test_slave                sl;
+    std::vector<std::uint8_t> request{0x22, 0x01, 0x00, 0x00, 0x00, 0x08, 0x3A, 0x9F};
+    std::vector<std::uint8_t> broken{0x22, 0x01, 0x00, 0x00, 0x00, 0x08, 0x3A, 0x9A};
+
+    for (auto const byte : request) {
+        EXPECT_TRUE(exception::no_error == sl.receive_byte(byte));
+    }
+    EXPECT_TRUE(exception::no_error == sl.receive_end());
+    EXPECT_TRUE(slave_state::checking_request == sl.state());
+    EXPECT_TRUE(exception::slave_or_server_busy == sl.receive_byte(0x22));
+    sl.processing();
+    sl.processing();
+    sl.processing();
+    EXPECT_TRUE(slave_state::idle == sl.state());
+    EXPECT_EQ(sl.last().size(), 6);
+
+    for (auto const byte : broken) {
+        sl.receive_byte(byte);
+    }
+    EXPECT_TRUE(exception::bad_crc == sl.receive_end());
+    EXPECT_TRUE(slave_state::idle == sl.state());
+
+    sl.receive_byte(0x22);
+    EXPECT_TRUE(exception::bad_data == sl.receive_end());
+
+    for (std::size_t i{}; i <= slave_type::max_adu_length; i++) {
+        sl.receive_byte(request[i % request.size()]);
+    }
+    EXPECT_TRUE(exception::bad_data == sl.receive_end());
+
+    // The reception restarts after every error
+    for (auto const byte : request) {
+        sl.receive_byte(byte);
+    }
+    EXPECT_TRUE(exception::no_error == sl.receive_end());
+}
+
+namespace {
+
+class zero_copy_slave : public slave_type {
+public:
+    zero_copy_slave() : slave(0x22) {}
+
+    bool
+    send(msg_type::array_type::iterator begin, msg_type::array_type::iterator end) noexcept override
+    {
+        in_tx_buffer_ = (&*begin == tx_.data());
+        sent_.assign(begin, end);
+        return true;
+    }
+
+    std::span<std::uint8_t>
+    transmit_buffer() noexcept override
+    {
+        return tx_;
+    }
+
+    std::array<std::uint8_t, max_adu_length> tx_{};
+    std::vector<std::uint8_t>               sent_{};
+    bool                                    in_tx_buffer_{};
+};
+
+}    // namespace
+
+TEST(modbus_test, modbus_slave_in_place)
+{
+    zero_copy_slave           sl;
+    std::vector<std::uint8_t> request{0x22, 0x01, 0x00, 0x00, 0x00, 0x08, 0x3A, 0x9F};
+    auto const                original = request;
+
+    EXPECT_TRUE(exception::no_error == sl.receive_in_place(request));
+    EXPECT_TRUE(sl.input().borrowed());
+    EXPECT_EQ(&sl.input().storage()[0], request.data());
+    while (!sl.idle()) {
+        sl.processing();
+    }
+    EXPECT_TRUE(sl.in_tx_buffer_);
+    EXPECT_EQ(sl.sent_.size(), 6);
+    EXPECT_EQ(request, original);
+
+    // A copying receive goes back to the own storage
+    EXPECT_TRUE(exception::no_error == sl.receive(request.begin(), request.end()));
+    EXPECT_FALSE(sl.input().borrowed());
+    while (!sl.idle()) {
+        sl.processing();
+    }
+
+    request[7] ^= 0x01;
+    EXPECT_TRUE(exception::bad_crc == sl.receive_in_place(request));
+    EXPECT_FALSE(sl.input().borrowed());
+
+    // Copies of a borrowing accessor own their data
+    slave_type::msg_type borrowing{};
+    borrowing.borrow(request);
+    borrowing.size(request.size());
+    EXPECT_EQ(borrowing.storage().size(), request.size());
+    EXPECT_EQ(borrowing.storage().data(), request.data());
+    auto const copy{borrowing};
+    EXPECT_FALSE(copy.borrowed());
+    EXPECT_TRUE(std::equal(request.begin(), request.end(), copy.storage().begin()));
+}
+
+TEST(modbus_test, modbus_slave_in_place_short)
+{
+    zero_copy_slave                        sl;
+    std::vector<std::vector<std::uint8_t>> requests{
+        {0x22, 0x10, 0x00, 0x00, 0x00, 0x02, 0x04},                    // data missing
+        {0x22, 0x10, 0x00, 0x00, 0x00, 0x02, 0x02, 0x12, 0x34},        // count does not match
+        {0x22, 0x10, 0x00, 0x00, 0x00, 0x01, 0x02, 0x12, 0x34, 0x56},  // trailing byte
+        {0x22, 0x0F, 0x00, 0x00, 0x00, 0x0A, 0x02},                    // data missing
+        {0x22, 0x0F, 0x00, 0x00, 0x00, 0x0A, 0x02, 0xFF},              // data short
+    };
+    for (auto request : requests) {
+        request.resize(request.size() + rtu::suffix_length);
+        rtu::seal(request.begin(), request.end() - rtu::suffix_length);
+        request.shrink_to_fit();
+        auto const reply = sl.handle(request);
+        EXPECT_TRUE(exception::illegal_data_value == sl.error());
+        ASSERT_EQ(reply.size(), 5);
+        EXPECT_EQ(reply[1], request[1] | 0x80);
+    }
+    EXPECT_EQ(sl.holding_registers(), zero_copy_slave::holding_regs_type{});
+    EXPECT_EQ(sl.coils(), zero_copy_slave::coils_type{});
+}
+
+TEST(modbus_test, modbus_slave_handle)
+{
+    zero_copy_slave                        cooperative;
+    zero_copy_slave                        direct;
+    std::vector<std::vector<std::uint8_t>> requests{
+        {0x22, 0x01, 0x00, 0x00, 0x00, 0x08},                                // read coils
+        {0x22, 0x03, 0x00, 0x00, 0x00, 0x0A},                                // read holding registers
+        {0x22, 0x10, 0x00, 0x02, 0x00, 0x02, 0x04, 0x12, 0x34, 0x56, 0x78},  // write registers
+        {0x22, 0x03, 0x00, 0x08, 0x00, 0x05},                                // illegal data address
+        {0x22, 0x2A, 0x00, 0x00, 0x00, 0x01},                                // illegal function
+        {0x23, 0x03, 0x00, 0x00, 0x00, 0x01},                                // another slave
+        {0x00, 0x06, 0x00, 0x01, 0x00, 0x07},                                // broadcast
+    };
+    for (auto& request : requests) {
+        request.resize(request.size() + rtu::suffix_length);
+        rtu::seal(request.begin(), request.end() - rtu::suffix_length);
+
+        cooperative.sent_.clear();
+        cooperative.receive(request.begin(), request.end());
+        while (!cooperative.idle()) {
+            cooperative.processing();
+        }
+
+        auto const original = request;
+        auto const reply    = direct.handle(request);
+        EXPECT_TRUE(direct.idle());
+        EXPECT_FALSE(direct.input().borrowed());
+        EXPECT_EQ(request, original);
+        EXPECT_EQ(std::vector<std::uint8_t>(reply.begin(), reply.end()), cooperative.sent_);
+        EXPECT_TRUE(reply.empty() || (reply.data() == direct.tx_.data()));
+    }
+    EXPECT_EQ(direct.holding_registers(), cooperative.holding_registers());
+    EXPECT_EQ(direct.holding_registers()[2], 0x1234);
+    EXPECT_EQ(direct.holding_registers()[1], 0x0007);
+    EXPECT_EQ(direct.get_counter(diagnostics_sub_function::return_bus_message_count),
+              cooperative.get_counter(diagnostics_sub_function::return_bus_message_count));
+
+    auto broken = requests.front();
+    broken.back() ^= 0x01;
+    EXPECT_TRUE(direct.handle(broken).empty());
+    EXPECT_TRUE(exception::bad_crc == direct.error());
+    EXPECT_TRUE(direct.handle(requests[4]).size() == 5);
+    EXPECT_TRUE(exception::illegal_function == direct.error());
+}
+
+namespace {
+
+using compiled_slave_type = slave<10, 10, 10, 10, 1, rtu, function::read_coils, function::read_holding_registers,
+                                  function::write_multiple_registers, function::mask_write_register>;
+
+class compiled_slave : public compiled_slave_type {
+public:
+    compiled_slave() : slave(0x22) {}
+
+    bool
+    send(msg_type::array_type::iterator, msg_type::array_type::iterator) noexcept override
+    {
+        return true;
+    }
+};
+
+}    // namespace
+
+TEST(modbus_test, modbus_slave_compiled)
+{
+    static_assert(compiled_slave::compiled && !slave_type::compiled);
+    EXPECT_LT(sizeof(compiled_slave) + 512, sizeof(zero_copy_slave));
+
+    zero_copy_slave                        dynamic;
+    compiled_slave                         fixed;
+    std::vector<std::vector<std::uint8_t>> requests{
+        {0x22, 0x01, 0x00, 0x00, 0x00, 0x08},                                // read coils
+        {0x22, 0x10, 0x00, 0x02, 0x00, 0x02, 0x04, 0x12, 0x34, 0x56, 0x78},  // write registers
+        {0x22, 0x03, 0x00, 0x00, 0x00, 0x0A},                                // read holding registers
+        {0x22, 0x03, 0x00, 0x08, 0x00, 0x05},                                // illegal data address
+    };
+    for (auto& request : requests) {
+        request.resize(request.size() + rtu::suffix_length);
+        rtu::seal(request.begin(), request.end() - rtu::suffix_length);
+        auto const expected = dynamic.handle(request);
+        auto const reply    = fixed.handle(request);
+        EXPECT_TRUE(std::equal(expected.begin(), expected.end(), reply.begin(), reply.end()));
+    }
+
+    // Not in the set: illegal function, until registered at run time
+    std::vector<std::uint8_t> status{0x22, 0x07, 0x00, 0x00, 0x00};
+    rtu::seal(status.begin(), status.end() - rtu::suffix_length);
+    EXPECT_EQ(fixed.handle(status).size(), 5);
+    EXPECT_TRUE(exception::illegal_function == fixed.error());
+    fixed.register_function(function::read_exception_status,
+                            compiled_slave_type::builtin<function::read_exception_status>());
+    EXPECT_EQ(fixed.handle(status).size(), 5);
+    EXPECT_TRUE(exception::no_error == fixed.error());
+    fixed.unregister_function(function::read_exception_status);
+    fixed.handle(status);
+    EXPECT_TRUE(exception::illegal_function == fixed.error());
+
+    // The compiled set stays
+    fixed.unregister_function(function::read_coils);
+    fixed.handle(requests.front());
+    EXPECT_TRUE(exception::no_error == fixed.error());
+}
+
+namespace {
+
+class direct_slave final : public static_slave<direct_slave, slave<10, 10, 10, 10, 1>> {
+public:
+    direct_slave() : static_slave(0x22) {}
+
+    bool
+    send(msg_type::array_type::iterator begin, msg_type::array_type::iterator end) noexcept override
+    {
+        sent_.assign(begin, end);
+        return true;
+    }
+
+    void
+    changed_holding(std::size_t address, std::uint16_t value) noexcept override
+    {
+        input_registers()[address] = value;
+        changes_++;
+    }
+
+    std::vector<std::uint8_t> sent_{};
+    std::size_t               changes_{};
+};
+
+class direct_master final : public static_master<direct_master> {
+public:
+    bool
+    send(msg_type::array_type::iterator begin, msg_type::array_type::iterator end) noexcept override
+    {
+        sent_.assign(begin, end);
+        return true;
+    }
+
+    bool
+    timer_start(std::size_t) override
+    {
+        timers_++;
+        return true;
+    }
+
+    bool
+    timer_stop() override
+    {
+        timers_--;
+        return true;
+    }
+
+    std::vector<std::uint8_t> sent_{};
+    int                       timers_{};
+};
+
+}    // namespace
+
+TEST(modbus_test, modbus_static_slave)
+{
+    zero_copy_slave                        dynamic;
+    direct_slave                           fixed;
+    std::vector<std::vector<std::uint8_t>> requests{
+        {0x22, 0x10, 0x00, 0x02, 0x00, 0x02, 0x04, 0x12, 0x34, 0x56, 0x78},  // write registers
+        {0x22, 0x06, 0x00, 0x05, 0x00, 0x07},                                // write register
+        {0x22, 0x03, 0x00, 0x00, 0x00, 0x0A},                                // read holding registers
+        {0x22, 0x2A, 0x00, 0x00, 0x00, 0x01},                                // illegal function
+    };
+    for (auto& request : requests) {
+        request.resize(request.size() + rtu::suffix_length);
+        rtu::seal(request.begin(), request.end() - rtu::suffix_length);
+        dynamic.sent_.clear();
+        dynamic.receive(request.begin(), request.end());
+        while (!dynamic.idle()) {
+            dynamic.processing();
+        }
+        fixed.sent_.clear();
+        EXPECT_TRUE(exception::no_error == fixed.receive(request.begin(), request.end()));
+        while (!fixed.idle()) {
+            fixed.processing();
+        }
+        EXPECT_EQ(fixed.sent_, dynamic.sent_);
+        auto const reply = fixed.handle(request);
+        EXPECT_EQ(std::vector<std::uint8_t>(reply.begin(), reply.end()), dynamic.sent_);
+    }
+    EXPECT_EQ(fixed.changes_, 3);
+    EXPECT_EQ(fixed.input_registers()[3], 0x5678);
+    EXPECT_EQ(fixed.input_registers()[5], 0x0007);
+}
+
+TEST(modbus_test, modbus_static_master)
+{
+    direct_master master;
+    direct_slave  device;
+    device.holding_registers()[4] = 0xBEEF;
+
+    std::array<std::uint16_t, 2> got{};
+    commands::read_registers     request(0x22, 3, 2, [&](exception error, std::uint16_t* begin, std::uint16_t* end) {
+        ASSERT_TRUE(exception::no_error == error);
+        std::copy(begin, end, got.begin());
+    });
+    ASSERT_TRUE(master.run_async(request));
+    EXPECT_EQ(master.timers_, 1);
+    EXPECT_TRUE(exception::no_error == device.receive(master.sent_.begin(), master.sent_.end()));
+    while (!device.idle()) {
+        device.processing();
+    }
+    EXPECT_TRUE(exception::no_error == master.receive(device.sent_.begin(), device.sent_.end()));
+    EXPECT_EQ(master.timers_, 0);
+    EXPECT_EQ(got, (std::array<std::uint16_t, 2>{0, 0xBEEF}));
+    EXPECT_TRUE(master_state::processing_reply == master.state());
+    master.processing();
+    EXPECT_TRUE(master.idle());
+}
+
+namespace {
+
+template <class Slave>
+class change_slave : public Slave {
+public:
+    using typename Slave::msg_type;
+
+    change_slave() : Slave(0x22) {}
+
+    bool
+    send(typename msg_type::array_type::iterator, typename msg_type::array_type::iterator) noexcept override
+    {
+        return true;
+    }
+
+    void
+    changed_coil(std::size_t address, bool value) noexcept override
+    {
+        coils_.emplace_back(address, value);
+    }
+
+    void
+    changed_holding(std::size_t address, std::uint16_t value) noexcept override
+    {
+        holdings_.emplace_back(address, value);
+    }
+
+    void
+    changed_holdings(std::size_t start, std::span<std::uint16_t const> before,
+                     std::span<std::uint16_t const> after) noexcept override
+    {
+        ranges_.push_back({start, std::vector<std::uint16_t>(before.begin(), before.end()),
+                           std::vector<std::uint16_t>(after.begin(), after.end())});
+        Slave::changed_holdings(start, before, after);
+    }
+
+    void
+    write(std::vector<std::uint8_t> request)
+    {
+        request.insert(request.begin(), 0x22);
+        request.resize(request.size() + rtu::suffix_length);
+        rtu::seal(request.begin(), request.end() - rtu::suffix_length);
+        this->handle(request);
+        ASSERT_TRUE(exception::no_error == this->error());
+    }
+
+    struct range {
+        std::size_t                start;
+        std::vector<std::uint16_t> before;
+        std::vector<std::uint16_t> after;
+    };
+
+    std::vector<std::pair<std::size_t, bool>>          coils_{};
+    std::vector<std::pair<std::size_t, std::uint16_t>> holdings_{};
+    std::vector<range>                                 ranges_{};
+};
+
+}    // namespace
+
+TEST(modbus_test, modbus_slave_changes)
+{
+    change_slave<slave<20, 20, 10, 10, 1>> sl;
+    sl.write({0x10, 0x00, 0x02, 0x00, 0x03, 0x06, 0x00, 0x01, 0x00, 0x00, 0x00, 0x03});
+    ASSERT_EQ(sl.ranges_.size(), 1);
+    EXPECT_EQ(sl.ranges_[0].start, 2);
+    EXPECT_EQ(sl.ranges_[0].before, (std::vector<std::uint16_t>{0, 0, 0}));
+    EXPECT_EQ(sl.ranges_[0].after, (std::vector<std::uint16_t>{1, 0, 3}));
+    EXPECT_EQ(sl.holdings_, (std::vector<std::pair<std::size_t, std::uint16_t>>{{2, 1}, {4, 3}}));
+
+    // Rewriting the same values notifies nothing
+    sl.write({0x10, 0x00, 0x02, 0x00, 0x03, 0x06, 0x00, 0x01, 0x00, 0x00, 0x00, 0x03});
+    sl.write({0x06, 0x00, 0x04, 0x00, 0x03});
+    EXPECT_EQ(sl.ranges_.size(), 1);
+    sl.write({0x06, 0x00, 0x04, 0x00, 0x05});
+    EXPECT_EQ(sl.ranges_.size(), 2);
+    EXPECT_EQ(sl.holdings_, (std::vector<std::pair<std::size_t, std::uint16_t>>{{2, 1}, {4, 3}, {4, 5}}));
+
+    change_slave<packed_slave<20, 20, 10, 10, 1>> packed;
+    for (std::vector<std::uint8_t> const& request : std::vector<std::vector<std::uint8_t>>{
+             {0x0F, 0x00, 0x03, 0x00, 0x0A, 0x02, 0x05, 0xFC},    // coils 3 and 5 on, the padding ignored
+             {0x0F, 0x00, 0x03, 0x00, 0x0A, 0x02, 0x05, 0x00},    // unchanged
+             {0x05, 0x00, 0x03, 0xFF, 0x00},                      // unchanged
+             {0x05, 0x00, 0x03, 0x00, 0x00},                      // coil 3 off
+             {0x0F, 0x00, 0x02, 0x00, 0x03, 0x01, 0x06}}) {       // coil 3 on, coil 2 stays off, coil 4 on
+        sl.write(request);
+        packed.write(request);
+    }
+    std::vector<std::pair<std::size_t, bool>> const expected{{3, true}, {5, true}, {3, false}, {3, true}, {4, true}};
+    EXPECT_EQ(sl.coils_, expected);
+    EXPECT_EQ(packed.coils_, expected);
+}
@@ -0,0 +1,140 @@
+#include <xitren/modbus/commands/read_bits.hpp>
+#include <xitren/modbus/commands/read_registers.hpp>
+#include <xitren/modbus/master.hpp>
+#include <xitren/modbus/slave.hpp>
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace xitren::modbus;
+using namespace xitren::modbus::commands;
+
+namespace {
+
+constexpr std::size_t   threads    = 8;
+constexpr std::size_t   iterations = 2000;
+constexpr std::uint16_t registers  = 100;
+
+using slave_type = slave<registers, registers, registers, registers, 64>;
+
+class loop_slave : public slave_type {
+public:
+    explicit loop_slave(std::uint8_t id) : slave(id) {}
+
+    bool
+    send(msg_type::array_type::iterator begin, msg_type::array_type::iterator end) noexcept override
+    {
+        reply_.assign(begin, end);
+        return true;
+    }
+
+    std::vector<std::uint8_t> reply_{};
+};
+
+class loop_master : public master {
+public:
+    bool
+    send(msg_type::array_type::iterator, msg_type::array_type::iterator) noexcept override
+    {
+        return true;
+    }
+
+    bool
+    timer_start(std::size_t) override
+    {
+        return true;
+    }
+
+    bool
+    timer_stop() override
+    {
+        return true;
+    }
+};
+
+std::uint16_t
+pattern(std::uint8_t id, std::size_t index)
+{
+    return static_cast<std::uint16_t>((id << 8U) | index);
+}
+
+/**
+ * @brief Reads the registers and the coils of its own slave through its own master, returns the number of mismatches
+ */
+std::size_t
+worker(std::uint8_t id, std::atomic<bool> const& go)
+{
+    loop_slave  device{id};
+    loop_master client{};
+    for (std::size_t i{}; i < registers; i++) {
+        device.holding_registers()[i] = pattern(id, i);
+        device.coils()[i]             = ((i + id) % 3) == 0;
+    }
+    while (!go.load()) {
+        std::this_thread::yield();
+    }
+
+    std::size_t errors{};
+    auto        exchange = [&](command const& request) {
+        client << request;
+        device.receive(request.begin(), request.begin() + request.size());
+        while (!device.idle()) {
+            device.processing();
+        }
+        client.receive(device.reply_.begin(), device.reply_.end());
+        while (!client.idle()) {
+            client.processing();
+        }
+    };
+    for (std::size_t n{}; n < iterations; n++) {
+        auto const     start = static_cast<std::uint16_t>(n % (registers / 2));
+        auto const     count = static_cast<std::uint16_t>(1 + n % (registers / 2));
+        std::size_t    seen{};
+        read_registers holding(id, start, count, [&](exception error, std::uint16_t* begin, std::uint16_t* end) {
+            if ((error != exception::no_error) || (static_cast<std::size_t>(end - begin) != count)) {
+                errors++;
+                return;
+            }
+            for (std::size_t i{}; i < count; i++) {
+                errors += (begin[i] != pattern(id, start + i)) ? 1 : 0;
+            }
+            seen++;
+        });
+        exchange(holding);
+        read_bits coils(id, start, count, [&](exception error, bool* begin, bool*) {
+            if (error != exception::no_error) {
+                errors++;
+                return;
+            }
+            for (std::size_t i{}; i < count; i++) {
+                errors += (begin[i] != (((start + i + id) % 3) == 0)) ? 1 : 0;
+            }
+            seen++;
+        });
+        exchange(coils);
+        errors += (seen != 2) ? 1 : 0;
+    }
+    return errors;
+}
+
+}    // namespace
+
+TEST(modbus_thread_test, independent_instances)
+{
+    std::atomic<bool>        go{false};
+    std::vector<std::size_t> errors(threads);
+    std::vector<std::thread> workers{};
+    for (std::size_t i{}; i < threads; i++) {
+        workers.emplace_back([&, i] { errors[i] = worker(static_cast<std::uint8_t>(i + 1), go); });
+    }
+    go.store(true);
+    for (auto& item : workers) {
+        item.join();
+    }
+    for (std::size_t i{}; i < threads; i++) {
+        EXPECT_EQ(errors[i], 0) << "slave " << (i + 1);
+    }
+}